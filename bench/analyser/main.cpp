@@ -0,0 +1,323 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ *  Accuracy and speed of TrackAnalyser on synthesised click tracks.
+ *
+ *  bench-analyser [--bpm 70,80,...,180] [--levels -6,-10,-14] [--seconds 30]
+ *                 [--format wav|ogg] [--seed 1] [--dir /tmp]
+ *                 [--output results.json] [--keep]
+ *
+ *  Every track is a click at the given tempo over a quiet tone bed, framed
+ *  by digital silence of known length. The clicks peak at the given level
+ *  in dBFS, the tone bed is 6 dB below. Reported per track are the errors
+ *  of start and end position, of the tempo (also folded to the nearest
+ *  octave, the analyser does not resolve 2x or 0.5x) and of the gain
+ *  difference to the loudest level of the same tempo, and the wall-clock
+ *  time of both analysis passes.
+ */
+
+#include "audiofixture.h"
+#include "benchmark.h"
+#include "commandline.h"
+#include "trackanalyser.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QUrl>
+#include <QWidget>
+
+#include <gst/gst.h>
+#include <math.h>
+#include <stdio.h>
+
+class AnalyserWaiter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AnalyserWaiter(TrackAnalyser* analyser)
+        : m_finished(false)
+    {
+        // the analyser signals from the GStreamer streaming thread
+        connect(analyser, SIGNAL(finishGain()),
+            this, SLOT(onFinished()), Qt::QueuedConnection);
+        connect(analyser, SIGNAL(finishTempo()),
+            this, SLOT(onFinished()), Qt::QueuedConnection);
+    }
+
+    /** false if the analysis did not finish within timeout */
+    bool wait(int timeout)
+    {
+        QTimer::singleShot(timeout, &m_loop, SLOT(quit()));
+        m_finished = false;
+        m_loop.exec();
+        return m_finished;
+    }
+
+private slots:
+    void onFinished()
+    {
+        m_finished = true;
+        m_loop.quit();
+    }
+
+private:
+    QEventLoop m_loop;
+    bool m_finished;
+};
+
+namespace {
+const int sampleRate = 44100;
+
+struct ClickTrack {
+    int bpm;
+    double level;
+    int leadMs;
+    int bodyMs;
+    int trailMs;
+};
+
+quint32 noise(quint32& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+QVector<qint16> synthesise(const ClickTrack& track, quint32 seed)
+{
+    const int lead = qint64(track.leadMs) * sampleRate / 1000;
+    const int body = qint64(track.bodyMs) * sampleRate / 1000;
+    const int trail = qint64(track.trailMs) * sampleRate / 1000;
+    const double click = 32767.0 * pow(10.0, track.level / 20.0);
+    const double bed = click / 2.0;
+    const int clickLength = sampleRate / 50;
+    const double beat = 60.0 * sampleRate / track.bpm;
+
+    QVector<qint16> samples(lead + body + trail, 0);
+    quint32 state = seed ? seed : 1;
+    for (int i = 0; i < body; i++) {
+        double value = bed * sin(2.0 * M_PI * 220.0 * i / sampleRate);
+
+        // decaying noise burst on every beat
+        int offset = i - int(floor(i / beat) * beat);
+        if (offset < clickLength) {
+            double white = (noise(state) / 2147483648.0) - 1.0;
+            value += click * white * exp(-offset / (sampleRate * 0.005));
+        }
+        samples[lead + i] = qint16(qBound(-32768.0, value, 32767.0));
+    }
+    return samples;
+}
+
+double octaveError(int measured, int expected)
+{
+    double error = measured - expected;
+    double doubled = measured - 2.0 * expected;
+    double halved = measured - expected / 2.0;
+    if (fabs(doubled) < fabs(error))
+        error = doubled;
+    if (fabs(halved) < fabs(error))
+        error = halved;
+    return error;
+}
+
+QList<int> intList(const QString& text)
+{
+    QList<int> values;
+    foreach (QString value, text.split(",", QString::SkipEmptyParts))
+        values << value.trimmed().toInt();
+    return values;
+}
+}
+
+int main(int argc, char* argv[])
+{
+#if QT_VERSION >= 0x050000
+    // the analyser is named after its host widget, nothing is ever shown
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+    QApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("knowthelist-org");
+    QCoreApplication::setApplicationName("knowthelist-bench");
+
+    QStringList arguments = app.arguments();
+    if (CommandLine::hasOption(arguments, "help")) {
+        fprintf(stderr, "usage: bench-analyser [--bpm 70,80,...,180] [--levels -6,-10,-14] [--seconds 30]\n"
+                        "       [--format wav|ogg] [--seed 1] [--dir path] [--output file] [--keep]\n");
+        return 0;
+    }
+
+    QList<int> tempos = intList(CommandLine::option(arguments, "bpm", "70,80,90,100,110,120,130,140,150,160,170,180"));
+    QList<int> levels = intList(CommandLine::option(arguments, "levels", "-6,-10,-14"));
+    int seconds = CommandLine::option(arguments, "seconds", "30").toInt();
+    QString format = CommandLine::option(arguments, "format", "wav");
+    quint32 seed = CommandLine::option(arguments, "seed", "1").toUInt();
+    QString dir = CommandLine::option(arguments, "dir", QDir::tempPath()) + "/knowthelist-bench-analyser";
+    if (tempos.isEmpty() || levels.isEmpty() || seconds <= 0 || (format != "wav" && format != "ogg")) {
+        fprintf(stderr, "invalid options\n");
+        return 1;
+    }
+
+    Benchmark bench("analyser");
+    QString output = CommandLine::option(arguments, "output");
+    if (!output.isEmpty())
+        bench.setOutput(output);
+    bench.setParameter("format", format);
+    bench.setParameter("seconds", seconds);
+
+    gst_init(nullptr, nullptr);
+    AudioFixture::removeTree(dir);
+    QDir().mkpath(dir);
+
+    QWidget host;
+    host.setObjectName("bench");
+    TrackAnalyser* analyser = new TrackAnalyser(&host);
+    AnalyserWaiter waiter(analyser);
+    const int timeout = 120 * 1000;
+
+    int tracks = 0;
+    int failed = 0;
+    int tempoHits = 0;
+    int octaveHits = 0;
+    double startError = 0;
+    double endError = 0;
+    double gainError = 0;
+    int gainCompared = 0;
+    qint64 audioMs = 0;
+    qint64 analysisNs = 0;
+
+    foreach (int bpm, tempos) {
+        double referenceGain = TrackAnalyser::GAIN_INVALID;
+        foreach (int level, levels) {
+            ClickTrack track;
+            track.bpm = bpm;
+            track.level = level;
+            track.leadMs = 500 + (tracks % 4) * 750;
+            track.bodyMs = seconds * 1000;
+            track.trailMs = 1000 + (tracks % 3) * 1500;
+
+            QString name = QString("%1/%2bpm%3dB").arg(dir).arg(bpm).arg(level);
+            if (!AudioFixture::writeWav(name + ".wav", synthesise(track, seed + tracks), sampleRate)) {
+                fprintf(stderr, "could not write %s.wav\n", qPrintable(name));
+                return 1;
+            }
+            if (format == "ogg" && !AudioFixture::encodeOgg(name + ".wav", name + ".ogg")) {
+                fprintf(stderr, "could not encode %s.ogg\n", qPrintable(name));
+                return 1;
+            }
+            QUrl url = QUrl::fromLocalFile(name + "." + format);
+            tracks++;
+
+            QElapsedTimer timer;
+            analyser->setMode(TrackAnalyser::STANDARD);
+            timer.start();
+            analyser->open(url);
+            bool ok = waiter.wait(timeout);
+            qint64 gainNs = timer.nsecsElapsed();
+            double gain = analyser->gainDB();
+            int start = QTime(0, 0).msecsTo(analyser->startPosition());
+            int end = QTime(0, 0).msecsTo(analyser->endPosition());
+
+            analyser->setMode(TrackAnalyser::TEMPO);
+            timer.start();
+            analyser->open(url);
+            ok = waiter.wait(timeout) && ok;
+            qint64 tempoNs = timer.nsecsElapsed();
+            int measuredBpm = analyser->bpm();
+
+            if (!ok || gain == TrackAnalyser::GAIN_INVALID) {
+                fprintf(stderr, "analysis of %s failed\n", qPrintable(url.toLocalFile()));
+                failed++;
+                continue;
+            }
+
+            int expectedStart = track.leadMs;
+            int expectedEnd = track.leadMs + track.bodyMs;
+            int length = expectedEnd + track.trailMs;
+
+            QVariantMap values;
+            values.insert("bpm", bpm);
+            values.insert("level_db", level);
+            values.insert("bpm_measured", measuredBpm);
+            values.insert("bpm_error", measuredBpm - bpm);
+            values.insert("bpm_octave_error", octaveError(measuredBpm, bpm));
+            values.insert("start_ms", expectedStart);
+            values.insert("start_error_ms", start - expectedStart);
+            values.insert("end_ms", expectedEnd);
+            values.insert("end_error_ms", end - expectedEnd);
+            values.insert("gain_db", gain);
+            if (referenceGain == TrackAnalyser::GAIN_INVALID) {
+                referenceGain = gain;
+            } else {
+                // a track quieter by x dB needs x dB more gain
+                double error = (gain - referenceGain) - (levels.first() - level);
+                values.insert("gain_error_db", error);
+                gainError += fabs(error);
+                gainCompared++;
+            }
+            values.insert("gain_ms", gainNs / 1000000.0);
+            values.insert("tempo_ms", tempoNs / 1000000.0);
+            values.insert("realtime_factor", length * 1000000.0 / (gainNs + tempoNs));
+            bench.reportValues("track", values);
+
+            bench.addSample("gain", gainNs);
+            bench.addSample("tempo", tempoNs);
+            bench.addSample("total", gainNs + tempoNs);
+            if (qAbs(measuredBpm - bpm) <= 1)
+                tempoHits++;
+            if (fabs(octaveError(measuredBpm, bpm)) <= 1)
+                octaveHits++;
+            startError += qAbs(start - expectedStart);
+            endError += qAbs(end - expectedEnd);
+            audioMs += length;
+            analysisNs += gainNs + tempoNs;
+        }
+    }
+
+    bench.report("gain");
+    bench.report("tempo");
+    bench.report("total");
+
+    int analysed = tracks - failed;
+    QVariantMap summary;
+    summary.insert("tracks", tracks);
+    summary.insert("failed", failed);
+    if (analysed > 0) {
+        summary.insert("bpm_hit_rate", double(tempoHits) / analysed);
+        summary.insert("bpm_octave_hit_rate", double(octaveHits) / analysed);
+        summary.insert("start_mean_abs_error_ms", startError / analysed);
+        summary.insert("end_mean_abs_error_ms", endError / analysed);
+    }
+    if (gainCompared > 0)
+        summary.insert("gain_mean_abs_error_db", gainError / gainCompared);
+    if (analysisNs > 0)
+        summary.insert("realtime_factor", audioMs * 1000000.0 / analysisNs);
+    bench.reportValues("accuracy", summary);
+
+    delete analyser;
+    if (!CommandLine::hasOption(arguments, "keep"))
+        AudioFixture::removeTree(dir);
+    return failed > 0 ? 1 : 0;
+}
+
+#include "main.moc"
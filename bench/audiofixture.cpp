@@ -0,0 +1,273 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audiofixture.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <gst/gst.h>
+#include <stdio.h>
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+#include <taglib/tstring.h>
+
+namespace {
+const int sampleRate = 44100;
+
+void appendLE(QByteArray& data, quint64 value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        data.append(char((value >> (8 * i)) & 0xff));
+}
+
+void appendBE(QByteArray& data, quint64 value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+        data.append(char((value >> (8 * i)) & 0xff));
+}
+
+quint32 oggCrc(const QByteArray& data)
+{
+    static quint32 table[256];
+    static bool init = false;
+    if (!init) {
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 r = i << 24;
+            for (int j = 0; j < 8; j++)
+                r = (r & 0x80000000) ? (r << 1) ^ 0x04c11db7 : (r << 1);
+            table[i] = r;
+        }
+        init = true;
+    }
+
+    quint32 crc = 0;
+    for (int i = 0; i < data.size(); i++)
+        crc = (crc << 8) ^ table[((crc >> 24) ^ quint8(data.at(i))) & 0xff];
+    return crc;
+}
+
+QByteArray oggPage(const QList<QByteArray>& packets, quint64 granule, int sequence, int flags)
+{
+    QByteArray lacing;
+    QByteArray body;
+    foreach (const QByteArray& packet, packets) {
+        int size = packet.size();
+        while (size >= 255) {
+            lacing.append(char(255));
+            size -= 255;
+        }
+        lacing.append(char(size));
+        body.append(packet);
+    }
+
+    QByteArray page("OggS");
+    page.append(char(0));
+    page.append(char(flags));
+    appendLE(page, granule, 8);
+    appendLE(page, 0x4b544c42, 4);
+    appendLE(page, sequence, 4);
+    appendLE(page, 0, 4);
+    page.append(char(lacing.size()));
+    page.append(lacing);
+    page.append(body);
+
+    quint32 crc = oggCrc(page);
+    for (int i = 0; i < 4; i++)
+        page[22 + i] = char((crc >> (8 * i)) & 0xff);
+    return page;
+}
+
+bool writeFile(const QString& fileName, const QByteArray& data)
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write(data) == data.size();
+}
+}
+
+bool AudioFixture::write(const QString& fileName, int seconds)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "flac")
+        return writeFlac(fileName, seconds);
+    if (suffix == "ogg" || suffix == "oga")
+        return writeOgg(fileName, seconds);
+    return writeMp3(fileName, seconds);
+}
+
+bool AudioFixture::writeMp3(const QString& fileName, int seconds)
+{
+    // MPEG-1 layer III, 128 kbit/s, 44.1 kHz, joint stereo, no padding
+    const int frameSize = 144 * 128000 / sampleRate;
+    QByteArray frame(frameSize, 0);
+    frame[0] = char(0xff);
+    frame[1] = char(0xfb);
+    frame[2] = char(0x90);
+    frame[3] = char(0x64);
+
+    int frames = qMax(1, seconds * sampleRate / 1152);
+    QByteArray data;
+    data.reserve(frames * frameSize);
+    for (int i = 0; i < frames; i++)
+        data.append(frame);
+    return writeFile(fileName, data);
+}
+
+bool AudioFixture::writeFlac(const QString& fileName, int seconds)
+{
+    QByteArray data("fLaC");
+
+    // STREAMINFO, the last metadata block until TagLib adds the comment
+    data.append(char(0x80));
+    appendBE(data, 34, 3);
+    appendBE(data, 4096, 2);
+    appendBE(data, 4096, 2);
+    appendBE(data, 0, 3);
+    appendBE(data, 0, 3);
+    quint64 samples = quint64(seconds) * sampleRate;
+    appendBE(data, (quint64(sampleRate) << 44) | (quint64(1) << 41) | (quint64(15) << 36) | samples, 8);
+    data.append(QByteArray(16, 0));
+
+    // a frame header sync followed by silence stands in for the audio
+    data.append(char(0xff));
+    data.append(char(0xf8));
+    data.append(QByteArray(4094, 0));
+    return writeFile(fileName, data);
+}
+
+bool AudioFixture::writeOgg(const QString& fileName, int seconds)
+{
+    QByteArray identification;
+    identification.append(char(0x01));
+    identification.append("vorbis");
+    appendLE(identification, 0, 4);
+    identification.append(char(2));
+    appendLE(identification, sampleRate, 4);
+    appendLE(identification, 0, 4);
+    appendLE(identification, 128000, 4);
+    appendLE(identification, 0, 4);
+    identification.append(char(0xb8));
+    identification.append(char(0x01));
+
+    QByteArray vendor("knowthelist bench");
+    QByteArray comment;
+    comment.append(char(0x03));
+    comment.append("vorbis");
+    appendLE(comment, vendor.size(), 4);
+    comment.append(vendor);
+    appendLE(comment, 0, 4);
+    comment.append(char(0x01));
+
+    // TagLib does not read the setup header, a stub keeps the packet order
+    QByteArray setup;
+    setup.append(char(0x05));
+    setup.append("vorbis");
+    setup.append(char(0x00));
+    setup.append(char(0x01));
+
+    QByteArray audio(64, 0);
+
+    QByteArray data;
+    data.append(oggPage(QList<QByteArray>() << identification, 0, 0, 0x02));
+    data.append(oggPage(QList<QByteArray>() << comment << setup, 0, 1, 0x00));
+    data.append(oggPage(QList<QByteArray>() << audio, quint64(seconds) * sampleRate, 2, 0x04));
+    return writeFile(fileName, data);
+}
+
+bool AudioFixture::writeWav(const QString& fileName, const QVector<qint16>& samples, int rate)
+{
+    const int bytes = samples.count() * 2;
+    QByteArray data("RIFF");
+    appendLE(data, 36 + bytes, 4);
+    data.append("WAVEfmt ");
+    appendLE(data, 16, 4);
+    appendLE(data, 1, 2);
+    appendLE(data, 1, 2);
+    appendLE(data, rate, 4);
+    appendLE(data, rate * 2, 4);
+    appendLE(data, 2, 2);
+    appendLE(data, 16, 2);
+    data.append("data");
+    appendLE(data, bytes, 4);
+    data.reserve(data.size() + bytes);
+    for (int i = 0; i < samples.count(); i++)
+        appendLE(data, quint16(samples.at(i)), 2);
+    return writeFile(fileName, data);
+}
+
+bool AudioFixture::encodeOgg(const QString& wavName, const QString& oggName)
+{
+    QString description = QString("filesrc location=\"%1\" ! wavparse ! audioconvert ! vorbisenc ! oggmux ! filesink location=\"%2\"")
+                              .arg(wavName)
+                              .arg(oggName);
+    GError* error = nullptr;
+    GstElement* pipeline = gst_parse_launch(description.toUtf8().constData(), &error);
+    if (error) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        if (pipeline)
+            gst_object_unref(pipeline);
+        return false;
+    }
+
+    GstBus* bus = gst_element_get_bus(pipeline);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstMessage* message = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+        GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    bool ok = message && GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+    if (message)
+        gst_message_unref(message);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(pipeline);
+    return ok;
+}
+
+bool AudioFixture::writeTags(const QString& fileName, const Catalogue::Entry& entry)
+{
+    TagLib::FileRef fileref(QFile::encodeName(fileName).constData(), false);
+    if (fileref.isNull() || !fileref.tag())
+        return false;
+
+    TagLib::Tag* tag = fileref.tag();
+    tag->setArtist(TagLib::String(entry.artist.toUtf8().constData(), TagLib::String::UTF8));
+    tag->setTitle(TagLib::String(entry.title.toUtf8().constData(), TagLib::String::UTF8));
+    tag->setAlbum(TagLib::String(entry.album.toUtf8().constData(), TagLib::String::UTF8));
+    tag->setGenre(TagLib::String(entry.genre.toUtf8().constData(), TagLib::String::UTF8));
+    tag->setYear(entry.year.toUInt());
+    tag->setTrack(entry.track);
+    return fileref.save();
+}
+
+bool AudioFixture::removeTree(const QString& path)
+{
+    QFileInfo info(path);
+    if (!info.exists())
+        return true;
+    if (!info.isDir() || info.isSymLink())
+        return QFile::remove(path);
+
+    QDir dir(path);
+    bool ok = true;
+    foreach (QFileInfo entry, dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System))
+        ok = removeTree(entry.absoluteFilePath()) && ok;
+    return dir.rmdir(path) && ok;
+}
@@ -0,0 +1,50 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AUDIOFIXTURE_H
+#define AUDIOFIXTURE_H
+
+#include "catalogue.h"
+
+#include <QString>
+#include <QVector>
+
+/*
+ *  Small audio files for the benchmark tools, written byte by byte so no
+ *  encoder is needed. MP3 files are silent CBR frames, FLAC and Ogg Vorbis
+ *  files carry valid headers and stream length but no real audio data,
+ *  enough for TagLib. Tags are written with TagLib afterwards. WAV files
+ *  hold the given samples.
+ */
+class AudioFixture {
+public:
+    /** The format is taken from the suffix: mp3, flac or ogg */
+    static bool write(const QString& fileName, int seconds);
+    static bool writeTags(const QString& fileName, const Catalogue::Entry& entry);
+
+    static bool writeMp3(const QString& fileName, int seconds);
+    static bool writeFlac(const QString& fileName, int seconds);
+    static bool writeOgg(const QString& fileName, int seconds);
+    /** 16 bit mono PCM with real audio data, for the analyser */
+    static bool writeWav(const QString& fileName, const QVector<qint16>& samples, int rate = 44100);
+    /** Transcodes with the installed GStreamer Vorbis encoder */
+    static bool encodeOgg(const QString& wavName, const QString& oggName);
+
+    static bool removeTree(const QString& path);
+};
+
+#endif // AUDIOFIXTURE_H
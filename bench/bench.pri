@@ -0,0 +1,65 @@
+#
+# Knowthelist benchmark tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Shared settings, the tools link the knowthelist-core library of ../src
+# and build the deck sources they need directly
+
+QT += core \
+    gui \
+    sql
+
+greaterThan(QT_MAJOR_VERSION, 4){
+     QT += widgets concurrent
+     DEFINES += GST_API_VERSION_1
+}
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+CORE_LIB_DIR = $$OUT_PWD/../../src
+include(../src/core/link.pri)
+
+KNOWTHELIST_SRC = $$PWD/../src
+INCLUDEPATH += $$PWD
+
+SOURCES += $$PWD/benchmark.cpp \
+    $$PWD/catalogue.cpp \
+    $$PWD/audiofixture.cpp
+HEADERS += $$PWD/benchmark.h \
+    $$PWD/catalogue.h \
+    $$PWD/audiofixture.h
+
+DESTDIR = $$OUT_PWD/../
+
+macx {
+    DEFINES += GST_API_VERSION_1
+    INCLUDEPATH += /usr/local/include/gstreamer-1.0 \
+        /usr/local/include/glib-2.0 \
+        /usr/local/lib/glib-2.0/include \
+        /usr/local/include
+    LIBS += -L/usr/local/lib \
+        -lgstreamer-1.0 \
+        -lglib-2.0 \
+        -lgobject-2.0 \
+        -ltag \
+        -framework CoreAudio \
+        -framework CoreFoundation
+}
+unix:!macx {
+contains(DEFINES, GST_API_VERSION_1) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += gstreamer-1.0 \
+        taglib alsa
+}
+else {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += gstreamer-0.10 \
+        taglib alsa
+}
+}
+
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
+QMAKE_CXXFLAGS_WARN_ON += -Wno-reorder
@@ -0,0 +1,12 @@
+#
+# Knowthelist benchmark tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+
+TEMPLATE = subdirs
+
+SUBDIRS += collectiondb \
+    scanner \
+    analyser \
+    deck
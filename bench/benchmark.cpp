@@ -0,0 +1,181 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+#include <stdio.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+QString jsonValue(const QVariant& value)
+{
+    switch (value.type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+        return value.toString();
+    case QVariant::Bool:
+        return value.toBool() ? "true" : "false";
+    default:
+        break;
+    }
+    QString text = value.toString();
+    text.replace("\\", "\\\\");
+    text.replace("\"", "\\\"");
+    text.replace("\n", "\\n");
+    return "\"" + text + "\"";
+}
+
+double msec(qint64 nsecs)
+{
+    return nsecs / 1000000.0;
+}
+
+qint64 percentile(const QVector<qint64>& sorted, int percent)
+{
+    if (sorted.isEmpty())
+        return 0;
+    return sorted.at(qMin(sorted.count() - 1, (sorted.count() * percent) / 100));
+}
+}
+
+struct BenchmarkPrivate {
+    QString suite;
+    QVariantMap parameters;
+    QMap<QString, QVector<qint64> > samples;
+    QFile output;
+};
+
+Benchmark::Benchmark(const QString& suite)
+    : p(new BenchmarkPrivate)
+{
+    p->suite = suite;
+    p->output.open(stdout, QIODevice::WriteOnly);
+}
+
+Benchmark::~Benchmark()
+{
+    p->output.close();
+    delete p;
+}
+
+void Benchmark::setParameter(const QString& name, const QVariant& value)
+{
+    p->parameters.insert(name, value);
+}
+
+void Benchmark::clearParameters()
+{
+    p->parameters.clear();
+}
+
+void Benchmark::setOutput(const QString& fileName)
+{
+    p->output.close();
+    p->output.setFileName(fileName);
+    if (!p->output.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        fprintf(stderr, "could not write %s, using stdout\n", qPrintable(fileName));
+        p->output.open(stdout, QIODevice::WriteOnly);
+    }
+}
+
+void Benchmark::addSample(const QString& name, qint64 nsecs)
+{
+    p->samples[name].append(nsecs);
+}
+
+QVector<qint64> Benchmark::samples(const QString& name) const
+{
+    return p->samples.value(name);
+}
+
+void Benchmark::report(const QString& name, const QVariantMap& extra)
+{
+    QVector<qint64> sorted = p->samples.take(name);
+    std::sort(sorted.begin(), sorted.end());
+
+    qint64 total = 0;
+    foreach (qint64 sample, sorted)
+        total += sample;
+
+    QVariantMap values = extra;
+    values.insert("iterations", sorted.count());
+    values.insert("min_ms", msec(sorted.isEmpty() ? 0 : sorted.first()));
+    values.insert("mean_ms", msec(sorted.isEmpty() ? 0 : total / sorted.count()));
+    values.insert("p50_ms", msec(percentile(sorted, 50)));
+    values.insert("p90_ms", msec(percentile(sorted, 90)));
+    values.insert("p99_ms", msec(percentile(sorted, 99)));
+    values.insert("max_ms", msec(sorted.isEmpty() ? 0 : sorted.last()));
+    write(name, values);
+
+    fprintf(stderr, "%-28s %6d x  p50 %10.3f ms  p99 %10.3f ms\n",
+        qPrintable(name), sorted.count(),
+        msec(percentile(sorted, 50)), msec(percentile(sorted, 99)));
+}
+
+void Benchmark::reportValues(const QString& name, const QVariantMap& values)
+{
+    write(name, values);
+
+    QStringList text;
+    QVariantMap::const_iterator it;
+    for (it = values.constBegin(); it != values.constEnd(); ++it)
+        text << it.key() + " " + it.value().toString();
+    fprintf(stderr, "%-28s %s\n", qPrintable(name), qPrintable(text.join(", ")));
+}
+
+void Benchmark::write(const QString& name, const QVariantMap& values)
+{
+    QVariantMap all = p->parameters;
+    QVariantMap::const_iterator it;
+    for (it = values.constBegin(); it != values.constEnd(); ++it)
+        all.insert(it.key(), it.value());
+
+    QStringList fields;
+    fields << "\"suite\": " + jsonValue(p->suite)
+           << "\"name\": " + jsonValue(name);
+    for (it = all.constBegin(); it != all.constEnd(); ++it)
+        fields << jsonValue(it.key()) + ": " + jsonValue(it.value());
+
+    QTextStream stream(&p->output);
+    stream << "{" << fields.join(", ") << "}\n";
+    stream.flush();
+}
+
+long Benchmark::peakRss()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MAC
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QMap>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+/*
+ *  Collects timing samples of the benchmark tools and reports them as
+ *  JSON lines, one object per measurement, on stdout or into a file.
+ *  A short human readable summary goes to stderr.
+ */
+class Benchmark {
+public:
+    explicit Benchmark(const QString& suite);
+    ~Benchmark();
+
+    /** Values added to every following report, e.g. the collection size */
+    void setParameter(const QString& name, const QVariant& value);
+    void clearParameters();
+    void setOutput(const QString& fileName);
+
+    void addSample(const QString& name, qint64 nsecs);
+    QVector<qint64> samples(const QString& name) const;
+
+    /** Report and drop the samples of name, extra values are added as is */
+    void report(const QString& name, const QVariantMap& extra = QVariantMap());
+    /** Report a single value without timing samples */
+    void reportValues(const QString& name, const QVariantMap& values);
+
+    /** Peak resident set size in kB, 0 where unknown */
+    static long peakRss();
+
+private:
+    void write(const QString& name, const QVariantMap& values);
+    struct BenchmarkPrivate* p;
+};
+
+#endif // BENCHMARK_H
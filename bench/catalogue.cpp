@@ -0,0 +1,285 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "catalogue.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <qdebug.h>
+
+#include <algorithm>
+#include <math.h>
+
+namespace {
+const char* genreNames[] = {
+    "Rock", "Pop", "Electronic", "Hip-Hop", "Jazz", "Classical", "Alternative",
+    "Metal", "Dance", "House", "Techno", "Soul", "R&B", "Funk", "Disco",
+    "Reggae", "Blues", "Country", "Folk", "Punk", "Indie", "Ambient",
+    "Soundtrack", "Latin", "Schlager", "Trance", "Drum & Bass", "Dubstep",
+    "Gospel", "World", "Ska", "Grunge", "New Wave", "Hard Rock", "Oldies",
+    "Chanson", nullptr
+};
+
+const char* syllables[] = {
+    "ka", "lo", "mi", "ra", "ven", "tor", "sil", "ber", "an", "dre", "mo",
+    "nix", "el", "sa", "ri", "gon", "ta", "lu", "ne", "vi", "for", "man",
+    "che", "do", "pa", "zu", "ke", "lin", "or", "bel", "fa", "st", "que",
+    "wa", "ro", "ma", "ti", "sen", "hal", "ju", nullptr
+};
+
+int syllableCount()
+{
+    int count = 0;
+    while (syllables[count])
+        count++;
+    return count;
+}
+
+// cumulative Zipf weights 1/k^s, normalised to 1
+QVector<double> zipfCdf(int count, double exponent)
+{
+    QVector<double> cdf(count);
+    double sum = 0;
+    for (int k = 0; k < count; k++) {
+        sum += 1.0 / pow(k + 1, exponent);
+        cdf[k] = sum;
+    }
+    for (int k = 0; k < count; k++)
+        cdf[k] /= sum;
+    return cdf;
+}
+}
+
+Catalogue::Catalogue(quint32 seed, const QString& root)
+    : m_state(seed ? seed : 1)
+    , m_root(root)
+    , m_albumTracks(0)
+    , m_albumTrack(0)
+{
+    for (int i = 0; genreNames[i]; i++)
+        m_genres << genreNames[i];
+    m_genreCdf = zipfCdf(m_genres.count(), 1.1);
+}
+
+quint32 Catalogue::random()
+{
+    // xorshift32, the same numbers on every platform
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+}
+
+double Catalogue::uniform()
+{
+    return random() / 4294967296.0;
+}
+
+double Catalogue::normal(double mean, double deviation)
+{
+    double u1 = qMax(uniform(), 1e-12);
+    double u2 = uniform();
+    return mean + deviation * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+int Catalogue::zipf(const QVector<double>& cdf)
+{
+    double u = uniform();
+    int index = std::lower_bound(cdf.constBegin(), cdf.constEnd(), u) - cdf.constBegin();
+    return qMin(index, cdf.count() - 1);
+}
+
+QString Catalogue::words(int count)
+{
+    static const int syllablesCount = syllableCount();
+
+    QStringList ret;
+    for (int w = 0; w < count; w++) {
+        QString word;
+        int length = 1 + random() % 3;
+        for (int s = 0; s < length; s++)
+            word += syllables[random() % syllablesCount];
+        word[0] = word.at(0).toUpper();
+        ret << word;
+    }
+    return ret.join(" ");
+}
+
+void Catalogue::reset(int rows)
+{
+    // about 40 tracks per artist on average, popular ones have many more
+    int count = qMax(20, rows / 40);
+
+    m_artists.clear();
+    m_artistGenre.clear();
+    m_artistStart.clear();
+    for (int i = 0; i < count; i++) {
+        m_artists << words(1 + random() % 2);
+        m_artistGenre << zipf(m_genreCdf);
+        m_artistStart << qBound(1950, int(normal(1995, 15)), 2020);
+    }
+    m_artistCdf = zipfCdf(count, 1.0);
+    m_albumTracks = 0;
+    m_albumTrack = 0;
+}
+
+void Catalogue::newAlbum()
+{
+    int artist = zipf(m_artistCdf);
+    int genre = (uniform() < 0.8) ? m_artistGenre.at(artist) : zipf(m_genreCdf);
+    int year = qMin(2024, m_artistStart.at(artist) + int(random() % 20));
+
+    m_album.artist = m_artists.at(artist);
+    m_album.genre = m_genres.at(genre);
+    m_album.year = QString::number(year);
+    m_album.album = words(1 + random() % 3);
+    m_album.dir = QString("%1/%2/%3 - %4").arg(m_root).arg(m_album.artist).arg(year).arg(m_album.album);
+    m_albumTracks = 8 + random() % 8;
+    m_albumTrack = 0;
+}
+
+void Catalogue::next(Entry& entry)
+{
+    if (m_artists.isEmpty())
+        reset(1000);
+    if (m_albumTrack >= m_albumTracks)
+        newAlbum();
+
+    m_albumTrack++;
+    entry = m_album;
+    entry.track = m_albumTrack;
+    entry.title = words(1 + random() % 4);
+    entry.length = qBound(45, int(normal(240, 70)), 1200);
+    entry.url = QString("%1/%2 - %3.mp3")
+                    .arg(entry.dir)
+                    .arg(entry.track, 2, 10, QChar('0'))
+                    .arg(entry.title);
+}
+
+bool Catalogue::write(QSqlDatabase db, int rows)
+{
+    reset(rows);
+
+    QHash<QString, int> ids[4];
+    const char* tables[] = { "artist", "album", "genre", "year" };
+    QSqlQuery names[4];
+    for (int t = 0; t < 4; t++) {
+        names[t] = QSqlQuery(db);
+        names[t].prepare(QString("INSERT INTO %1 ( id, name ) VALUES ( ?, ? );").arg(tables[t]));
+    }
+
+    QSqlQuery tags(db);
+    tags.prepare("INSERT INTO tags "
+                 "( id, url, dir, artist, title, album, genre, year, length, track ) "
+                 "VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ? );");
+    QSqlQuery statistics(db);
+    statistics.prepare("INSERT INTO statistics ( url, createdate, accessdate, playcounter ) "
+                       "VALUES ( ?, ?, ?, ? );");
+    QSqlQuery favorites(db);
+    favorites.prepare("INSERT INTO favorites ( url, changedate, rate ) VALUES ( ?, ?, ? );");
+
+    uint now = QDateTime::currentDateTime().toTime_t();
+    Entry entry;
+    db.transaction();
+    for (int i = 0; i < rows; i++) {
+        next(entry);
+
+        QString values[4] = { entry.artist, entry.album + "\t" + entry.dir, entry.genre, entry.year };
+        int id[4];
+        for (int t = 0; t < 4; t++) {
+            QHash<QString, int>::const_iterator it = ids[t].constFind(values[t]);
+            if (it != ids[t].constEnd()) {
+                id[t] = it.value();
+                continue;
+            }
+            id[t] = ids[t].count() + 1;
+            ids[t].insert(values[t], id[t]);
+            names[t].addBindValue(id[t]);
+            names[t].addBindValue(t == 1 ? entry.album : values[t]);
+            if (!names[t].exec()) {
+                qWarning() << Q_FUNC_INFO << names[t].lastError().text();
+                db.rollback();
+                return false;
+            }
+        }
+
+        tags.addBindValue(i + 1);
+        tags.addBindValue(entry.url);
+        tags.addBindValue(entry.dir);
+        tags.addBindValue(id[0]);
+        tags.addBindValue(entry.title);
+        tags.addBindValue(id[1]);
+        tags.addBindValue(id[2]);
+        tags.addBindValue(id[3]);
+        tags.addBindValue(entry.length);
+        tags.addBindValue(entry.track);
+        if (!tags.exec()) {
+            qWarning() << Q_FUNC_INFO << tags.lastError().text();
+            db.rollback();
+            return false;
+        }
+
+        // a third of the tracks has been played, few are rated
+        if (uniform() < 0.3) {
+            int plays = 1 + int(-log(qMax(uniform(), 1e-12)) * 4);
+            uint accessed = now - random() % (365 * 86400);
+            statistics.addBindValue(entry.url);
+            statistics.addBindValue(accessed - random() % (365 * 86400));
+            statistics.addBindValue(accessed);
+            statistics.addBindValue(plays);
+            statistics.exec();
+        }
+        if (uniform() < 0.08) {
+            favorites.addBindValue(entry.url);
+            favorites.addBindValue(now - random() % (365 * 86400));
+            favorites.addBindValue(1 + random() % 5);
+            favorites.exec();
+        }
+
+        if (i > 0 && !(i % 10000)) {
+            db.commit();
+            db.transaction();
+        }
+    }
+    return db.commit();
+}
+
+QString Catalogue::randomArtist()
+{
+    if (m_artists.isEmpty())
+        reset(1000);
+    return m_artists.at(zipf(m_artistCdf));
+}
+
+QString Catalogue::randomGenre()
+{
+    return m_genres.at(zipf(m_genreCdf));
+}
+
+QString Catalogue::randomYear()
+{
+    return QString::number(1960 + random() % 60);
+}
+
+QString Catalogue::randomWord()
+{
+    static const int syllablesCount = syllableCount();
+    return QString(syllables[random() % syllablesCount]) + syllables[random() % syllablesCount];
+}
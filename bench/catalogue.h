@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CATALOGUE_H
+#define CATALOGUE_H
+
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+
+/*
+ *  Deterministic generator of a synthetic music collection. Artists get a
+ *  Zipf distributed popularity, a main genre and a career period, tracks
+ *  come album by album in directories like /music/Artist/Year - Album.
+ *  The same seed always gives the same collection.
+ */
+class Catalogue {
+public:
+    struct Entry {
+        QString url;
+        QString dir;
+        QString artist;
+        QString title;
+        QString album;
+        QString genre;
+        QString year;
+        int length;
+        int track;
+    };
+
+    explicit Catalogue(quint32 seed = 1, const QString& root = "/music");
+
+    /** Prepare artists for a collection of about rows tracks, restarts next() */
+    void reset(int rows);
+    void next(Entry& entry);
+
+    /** Fill tags, artist, album, genre, year, statistics and favorites */
+    bool write(QSqlDatabase db, int rows);
+
+    /** Values to query for, drawn by popularity like user selections */
+    QString randomArtist();
+    QString randomGenre();
+    QString randomYear();
+    QString randomWord();
+
+    quint32 random();
+    double uniform();
+    double normal(double mean, double deviation);
+
+private:
+    int zipf(const QVector<double>& cdf);
+    QString words(int count);
+    void newAlbum();
+
+    quint32 m_state;
+    QString m_root;
+    QStringList m_genres;
+    QVector<double> m_genreCdf;
+    QStringList m_artists;
+    QVector<int> m_artistGenre;
+    QVector<int> m_artistStart;
+    QVector<double> m_artistCdf;
+
+    Entry m_album;
+    int m_albumTracks;
+    int m_albumTrack;
+};
+
+#endif // CATALOGUE_H
@@ -0,0 +1,12 @@
+#
+# Knowthelist benchmark tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Timing of the hot CollectionDB calls on synthetic collections
+
+include(../bench.pri)
+
+TARGET = bench-collectiondb
+
+SOURCES += main.cpp
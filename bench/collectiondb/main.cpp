@@ -0,0 +1,315 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ *  Times the hot CollectionDB calls on synthetic collections.
+ *
+ *  bench-collectiondb [--rows 10000,100000,1000000] [--iterations 200]
+ *                     [--budget 10] [--seed 1] [--output results.json]
+ *                     [--dir /tmp] [--keep]
+ *
+ *  Results are written as JSON lines, one per call and collection size.
+ */
+
+#include "benchmark.h"
+#include "catalogue.h"
+#include "cataloguesnapshot.h"
+#include "collectiondb.h"
+#include "commandline.h"
+#include "similarityindex.h"
+#include "sqlprofiler.h"
+#include "statisticsjournal.h"
+#include "trackindex.h"
+#include "trackweights.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QtSql>
+
+#include <stdio.h>
+
+namespace {
+struct Options {
+    int iterations;
+    qint64 budget;
+};
+
+// runs call until the iterations are done or the time budget is used up
+template <typename Call>
+void measure(Benchmark& bench, const QString& name, const Options& options, Call call)
+{
+    QElapsedTimer total;
+    total.start();
+    for (int i = 0; i < options.iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        call();
+        bench.addSample(name, timer.nsecsElapsed());
+        if (i >= 2 && total.nsecsElapsed() > options.budget)
+            break;
+    }
+    bench.report(name);
+}
+
+struct GetCount {
+    CollectionDB* db;
+    Catalogue* catalogue;
+    void operator()()
+    {
+        // the filter panels mix genre and artist filters
+        switch (catalogue->random() % 3) {
+        case 0:
+            db->getCount("", catalogue->randomGenre(), "");
+            break;
+        case 1:
+            db->getCount("", "", catalogue->randomArtist());
+            break;
+        default:
+            db->getCount("", catalogue->randomGenre(), catalogue->randomArtist());
+            break;
+        }
+    }
+};
+
+struct RandomEntry {
+    CollectionDB* db;
+    QString genre;
+    void operator()() { db->getRandomEntry("", genre, ""); }
+};
+
+// an Auto-DJ refill of 20 tracks, over-sampled as DjSession draws them
+struct RandomEntries {
+    CollectionDB* db;
+    QString genre;
+    void operator()() { db->getRandomEntries("", genre, "", 64); }
+};
+
+// the same refill after the statistics changed, the alias table is built again
+struct WeightTableBuild {
+    CollectionDB* db;
+    QString genre;
+    void operator()()
+    {
+        TrackWeights::instance()->invalidate();
+        db->getRandomEntries("", genre, "", 64);
+    }
+};
+
+// the ten tracks nearest to a random analysed one
+struct SimilarTracks {
+    SimilarityIndex* index;
+    CollectionDB* db;
+    QStringList urls;
+    void operator()() { index->similar(db, urls.at(qrand() % urls.count()), 10); }
+};
+
+struct BuildSimilarityIndex {
+    CollectionDB* db;
+    void operator()()
+    {
+        SimilarityIndex::instance()->invalidate();
+        SimilarityIndex::instance()->count(db);
+    }
+};
+
+// synthetic features in the layout of TrackFeatures::toString()
+void writeFeatures(CollectionDB* db)
+{
+    db->createAnalysisTable();
+    QStringList values;
+    values << "60 + abs(random()) % 120";
+    for (int i = 1; i < TrackFeatures::Count; i++)
+        values << "abs(random()) % 10000 / 10000.0";
+    db->executeSql("INSERT INTO analysis ( url, changedate, features ) "
+                   "SELECT url, 0, " + values.join(" || ' ' || ") + " FROM tags;");
+}
+
+struct SelectArtists {
+    CollectionDB* db;
+    void operator()() { db->selectArtists(); }
+};
+
+struct SelectTracks {
+    CollectionDB* db;
+    Catalogue* catalogue;
+    void operator()() { db->selectTracks("", "", catalogue->randomArtist(), ""); }
+};
+
+struct TreeRoot {
+    CollectionDB* db;
+    void operator()()
+    {
+        db->getCount();
+        db->selectArtists();
+    }
+};
+
+struct QuickFilter {
+    CollectionDB* db;
+    Catalogue* catalogue;
+    void operator()()
+    {
+        db->setFilterString(catalogue->randomWord());
+        db->getCount();
+        db->selectArtists();
+    }
+};
+
+struct HotTracks {
+    CollectionDB* db;
+    void operator()() { db->selectHotTracks(); }
+};
+
+struct BuildIndex {
+    CollectionDB* db;
+    void operator()()
+    {
+        TrackIndex::instance()->invalidate();
+        db->getCount("", "Rock", "");
+    }
+};
+
+bool run(Benchmark& bench, int rows, const QString& fileName, quint32 seed, const Options& options)
+{
+    QFile::remove(fileName);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
+        db.setDatabaseName(fileName);
+        if (!db.open()) {
+            fprintf(stderr, "could not open %s\n", qPrintable(fileName));
+            return false;
+        }
+    }
+    // the singletons keep the database of their first use otherwise
+    StatisticsJournal::instance()->reopen();
+    SqlProfiler::instance()->reopen();
+    CatalogueSnapshot::instance()->reopen();
+
+    bench.clearParameters();
+    bench.setParameter("rows", rows);
+    bench.setParameter("seed", int(seed));
+
+    CollectionDB* database = new CollectionDB();
+    database->executeSql("PRAGMA synchronous = OFF;");
+    database->createTables();
+    database->createStatsTable();
+
+    Catalogue catalogue(seed);
+    QElapsedTimer timer;
+    timer.start();
+    if (!catalogue.write(QSqlDatabase::database(), rows)) {
+        delete database;
+        return false;
+    }
+    QVariantMap generated;
+    generated.insert("duration_ms", timer.elapsed());
+    generated.insert("file_kb", QFileInfo(fileName).size() / 1024);
+    bench.reportValues("generate", generated);
+
+    TrackIndex::instance()->invalidate();
+
+    // a second instance keeps the quick filter away from the other calls
+    CollectionDB* filtered = new CollectionDB();
+
+    Options once = options;
+    once.iterations = qMin(options.iterations, 5);
+
+    BuildIndex buildIndex = { database };
+    measure(bench, "trackIndexBuild", once, buildIndex);
+    GetCount getCount = { database, &catalogue };
+    measure(bench, "getCount", options, getCount);
+    RandomEntry randomEntry = { database, catalogue.randomGenre() };
+    measure(bench, "getRandomEntry", options, randomEntry);
+    RandomEntries randomEntries = { database, randomEntry.genre };
+    measure(bench, "getRandomEntries64", options, randomEntries);
+    WeightTableBuild weightTableBuild = { database, randomEntry.genre };
+    measure(bench, "weightTableBuild", once, weightTableBuild);
+    TrackWeights::instance()->setEnabled(false);
+    measure(bench, "getRandomEntries64Uniform", options, randomEntries);
+    TrackWeights::instance()->setEnabled(true);
+    writeFeatures(database);
+    BuildSimilarityIndex buildSimilarityIndex = { database };
+    measure(bench, "similarityIndexBuild", once, buildSimilarityIndex);
+    QStringList analysed;
+    foreach (const QStringList& row, database->selectSql("SELECT url FROM analysis LIMIT 1000;"))
+        analysed << row.at(0);
+    if (!analysed.isEmpty()) {
+        SimilarTracks similarTracks = { SimilarityIndex::instance(), database, analysed };
+        measure(bench, "similar10", options, similarTracks);
+    }
+    SelectArtists selectArtists = { database };
+    measure(bench, "selectArtists", options, selectArtists);
+    SelectTracks selectTracks = { database, &catalogue };
+    measure(bench, "selectTracks", options, selectTracks);
+    TreeRoot treeRoot = { database };
+    measure(bench, "treeRoot", options, treeRoot);
+    QuickFilter quickFilter = { filtered, &catalogue };
+    measure(bench, "quickFilterTreeRoot", options, quickFilter);
+    HotTracks hotTracks = { database };
+    measure(bench, "selectHotTracks", options, hotTracks);
+
+    delete filtered;
+    delete database;
+    TrackIndex::instance()->invalidate();
+    TrackWeights::instance()->invalidate();
+    SimilarityIndex::instance()->invalidate();
+    QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+    return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("knowthelist-org");
+    QCoreApplication::setApplicationName("knowthelist-bench");
+
+    QStringList arguments = app.arguments();
+    if (CommandLine::hasOption(arguments, "help")) {
+        fprintf(stderr, "usage: bench-collectiondb [--rows 10000,100000,1000000] [--iterations 200]\n"
+                        "       [--budget seconds] [--seed 1] [--output file] [--dir path] [--keep]\n");
+        return 0;
+    }
+
+    Options options;
+    options.iterations = CommandLine::option(arguments, "iterations", "200").toInt();
+    options.budget = qint64(CommandLine::option(arguments, "budget", "10").toInt()) * 1000000000;
+    quint32 seed = CommandLine::option(arguments, "seed", "1").toUInt();
+    QString dir = CommandLine::option(arguments, "dir", QDir::tempPath());
+    QStringList sizes = CommandLine::option(arguments, "rows", "10000,100000,1000000").split(",");
+
+    Benchmark bench("collectiondb");
+    QString output = CommandLine::option(arguments, "output");
+    if (!output.isEmpty())
+        bench.setOutput(output);
+
+    foreach (QString size, sizes) {
+        int rows = size.toInt();
+        if (rows <= 0)
+            continue;
+        QString fileName = QString("%1/knowthelist-bench-%2.db").arg(dir).arg(rows);
+        fprintf(stderr, "%d rows in %s\n", rows, qPrintable(fileName));
+        if (!run(bench, rows, fileName, seed, options))
+            return 1;
+        if (!CommandLine::hasOption(arguments, "keep"))
+            QFile::remove(fileName);
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#
+# Knowthelist benchmark tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Open, seek and play latency of the deck players on a fakesink
+
+include(../bench.pri)
+
+QT += network
+
+TARGET = bench-deck
+
+SOURCES += main.cpp \
+    throttledserver.cpp \
+    $$KNOWTHELIST_SRC/player.cpp \
+    $$KNOWTHELIST_SRC/monitorplayer.cpp \
+    $$KNOWTHELIST_SRC/dropoutmonitor.cpp \
+    $$KNOWTHELIST_SRC/dropoutwatch.cpp \
+    $$KNOWTHELIST_SRC/pcmcache.cpp \
+    $$KNOWTHELIST_SRC/pcmdecoder.cpp \
+    $$KNOWTHELIST_SRC/pcmfeeder.cpp
+HEADERS += throttledserver.h \
+    $$KNOWTHELIST_SRC/player.h \
+    $$KNOWTHELIST_SRC/monitorplayer.h \
+    $$KNOWTHELIST_SRC/dropoutmonitor.h \
+    $$KNOWTHELIST_SRC/dropoutwatch.h \
+    $$KNOWTHELIST_SRC/pcmcache.h \
+    $$KNOWTHELIST_SRC/pcmdecoder.h \
+    $$KNOWTHELIST_SRC/pcmfeeder.h
@@ -0,0 +1,368 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ *  Latency of the deck players without a sound card.
+ *
+ *  bench-deck [--iterations 200] [--seconds 120] [--format wav|ogg]
+ *             [--rate 2048] [--latency 20] [--dir /tmp]
+ *             [--output results.json] [--keep] [--pcm-cache]
+ *
+ *  Player and MonitorPlayer play into a clock synchronised fakesink. For
+ *  local files and for the same files served through a throttled HTTP
+ *  shim (--rate kB/s shared by all connections, --latency ms before the
+ *  first byte of every request) the tool measures
+ *    open         open() until loadFinished, the track is PAUSED
+ *    openBuffer   open() until the preroll buffer reached the sink
+ *    seek         setPosition() while paused until the first buffer
+ *    play         play() until the first buffer after the preroll
+ *    seekPlaying  setPosition() while playing until the first buffer
+ *
+ *  --pcm-cache plays the Player deck from the decoded PCM cache.
+ */
+
+#include "audiofixture.h"
+#include "benchmark.h"
+#include "commandline.h"
+#include "monitorplayer.h"
+#include "pcmcache.h"
+#include "player.h"
+#include "throttledserver.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QMutex>
+#include <QTimer>
+#include <QWidget>
+
+#include <math.h>
+#include <stdio.h>
+
+class DeckWaiter : public QObject {
+    Q_OBJECT
+
+public:
+    DeckWaiter()
+        : m_armed(false)
+        , m_seen(false)
+        , m_latency(0)
+        , m_loaded(false)
+        , m_loadLatency(0)
+    {
+        m_timeout.setSingleShot(true);
+        connect(&m_timeout, SIGNAL(timeout()), &m_loop, SLOT(quit()));
+    }
+
+    void watch(QObject* deck)
+    {
+        connect(deck, SIGNAL(loadFinished()), this, SLOT(onLoaded()));
+    }
+
+    /** Starts the clock, the next buffer at the sink stops it */
+    void arm()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_loaded = false;
+        m_seen = false;
+        m_armed = true;
+        m_timer.start();
+    }
+
+    /** Called from the streaming thread */
+    void notifyBuffer()
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_armed || m_seen)
+            return;
+        m_latency = m_timer.nsecsElapsed();
+        m_seen = true;
+        QMetaObject::invokeMethod(this, "onBuffer", Qt::QueuedConnection);
+    }
+
+    /** false if no buffer arrived within timeout, the server needs the event loop */
+    bool waitBuffer(int timeout, qint64* latency)
+    {
+        QElapsedTimer deadline;
+        deadline.start();
+        while (!seen() && deadline.elapsed() < timeout) {
+            m_timeout.start(qMax(1, int(timeout - deadline.elapsed())));
+            m_loop.exec();
+        }
+        m_timeout.stop();
+
+        QMutexLocker locker(&m_mutex);
+        m_armed = false;
+        *latency = m_latency;
+        return m_seen;
+    }
+
+    bool waitLoaded(int timeout, qint64* latency)
+    {
+        QElapsedTimer deadline;
+        deadline.start();
+        while (!m_loaded && deadline.elapsed() < timeout) {
+            m_timeout.start(qMax(1, int(timeout - deadline.elapsed())));
+            m_loop.exec();
+        }
+        m_timeout.stop();
+        *latency = m_loadLatency;
+        return m_loaded;
+    }
+
+private slots:
+    void onBuffer() { m_loop.quit(); }
+    void onLoaded()
+    {
+        m_loadLatency = m_timer.nsecsElapsed();
+        m_loaded = true;
+        m_loop.quit();
+    }
+
+private:
+    bool seen()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_seen;
+    }
+
+    QMutex m_mutex;
+    QElapsedTimer m_timer;
+    QEventLoop m_loop;
+    QTimer m_timeout;
+    bool m_armed;
+    bool m_seen;
+    qint64 m_latency;
+    bool m_loaded;
+    qint64 m_loadLatency;
+};
+
+namespace {
+const int sampleRate = 44100;
+const int timeout = 30 * 1000;
+DeckWaiter* waiter = nullptr;
+
+#ifdef GST_API_VERSION_1
+GstPadProbeReturn onSinkBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+    Q_UNUSED(data);
+    if (waiter)
+        waiter->notifyBuffer();
+    return GST_PAD_PROBE_OK;
+}
+#else
+gboolean onSinkBuffer(GstPad* pad, GstBuffer* buffer, gpointer data)
+{
+    Q_UNUSED(pad);
+    Q_UNUSED(buffer);
+    Q_UNUSED(data);
+    if (waiter)
+        waiter->notifyBuffer();
+    return TRUE;
+}
+#endif
+
+GstElement* createSink(const char* name)
+{
+    GstElement* sink = gst_element_factory_make("fakesink", name);
+    g_object_set(sink, "sync", TRUE, NULL);
+
+    GstPad* pad = gst_element_get_static_pad(sink, "sink");
+#ifdef GST_API_VERSION_1
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, onSinkBuffer, nullptr, nullptr);
+#else
+    gst_pad_add_buffer_probe(pad, G_CALLBACK(onSinkBuffer), nullptr);
+#endif
+    gst_object_unref(pad);
+    return sink;
+}
+
+QVector<qint16> synthesise(int seconds)
+{
+    // a slow sweep, the content does not matter but should not be silence
+    QVector<qint16> samples(seconds * sampleRate);
+    double phase = 0;
+    for (int i = 0; i < samples.count(); i++) {
+        double frequency = 220.0 + 440.0 * (i % (sampleRate * 4)) / (sampleRate * 4);
+        phase += 2.0 * M_PI * frequency / sampleRate;
+        samples[i] = qint16(8000.0 * sin(phase));
+    }
+    return samples;
+}
+
+QTime randomPosition(const QTime& length, int seconds)
+{
+    int msecs = QTime(0, 0).msecsTo(length);
+    if (msecs <= 0)
+        msecs = seconds * 1000;
+    return QTime(0, 0).addMSecs(msecs / 20 + qrand() % (msecs * 8 / 10));
+}
+
+template <typename Deck>
+bool run(Benchmark& bench, Deck* deck, const QUrl& url, int iterations, int seconds)
+{
+    qint64 latency = 0;
+    for (int i = 0; i < iterations; i++) {
+        waiter->arm();
+        deck->open(url);
+        if (!waiter->waitLoaded(timeout, &latency)) {
+            fprintf(stderr, "open of %s did not finish\n", qPrintable(url.toString()));
+            return false;
+        }
+        bench.addSample("open", latency);
+        if (waiter->waitBuffer(timeout, &latency))
+            bench.addSample("openBuffer", latency);
+
+        // open() seeks to the start once PAUSED, its preroll must not count as ours
+        waiter->arm();
+        waiter->waitBuffer(500, &latency);
+
+        waiter->arm();
+        deck->setPosition(randomPosition(deck->length(), seconds));
+        if (waiter->waitBuffer(timeout, &latency))
+            bench.addSample("seek", latency);
+
+        waiter->arm();
+        deck->play();
+        if (waiter->waitBuffer(timeout, &latency))
+            bench.addSample("play", latency);
+
+        waiter->arm();
+        deck->setPosition(randomPosition(deck->length(), seconds));
+        if (waiter->waitBuffer(timeout, &latency))
+            bench.addSample("seekPlaying", latency);
+
+        deck->stop();
+    }
+
+    QVariantMap extra;
+    extra.insert("url", url.toString());
+    bench.report("open", extra);
+    bench.report("openBuffer", extra);
+    bench.report("seek", extra);
+    bench.report("play", extra);
+    bench.report("seekPlaying", extra);
+    return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+#if QT_VERSION >= 0x050000
+    // the players are widgets, but nothing is ever shown
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+    QApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("knowthelist-org");
+    QCoreApplication::setApplicationName("knowthelist-bench");
+
+    QStringList arguments = app.arguments();
+    if (CommandLine::hasOption(arguments, "help")) {
+        fprintf(stderr, "usage: bench-deck [--iterations 200] [--seconds 120] [--format wav|ogg]\n"
+                        "       [--rate kB/s] [--latency ms] [--dir path] [--output file] [--keep]\n"
+                        "       [--pcm-cache]\n");
+        return 0;
+    }
+
+    int iterations = CommandLine::option(arguments, "iterations", "200").toInt();
+    int seconds = CommandLine::option(arguments, "seconds", "120").toInt();
+    QString format = CommandLine::option(arguments, "format", "wav");
+    qint64 rate = CommandLine::option(arguments, "rate", "2048").toLongLong() * 1024;
+    int latency = CommandLine::option(arguments, "latency", "20").toInt();
+    QString dir = CommandLine::option(arguments, "dir", QDir::tempPath()) + "/knowthelist-bench-deck";
+    if (iterations <= 0 || seconds <= 0 || rate <= 0 || (format != "wav" && format != "ogg")) {
+        fprintf(stderr, "invalid options\n");
+        return 1;
+    }
+
+    Benchmark bench("deck");
+    QString output = CommandLine::option(arguments, "output");
+    if (!output.isEmpty())
+        bench.setOutput(output);
+
+    gst_init(nullptr, nullptr);
+    AudioFixture::removeTree(dir);
+    QDir().mkpath(dir);
+    QString fileName = dir + "/track." + format;
+    if (!AudioFixture::writeWav(dir + "/track.wav", synthesise(seconds), sampleRate)
+        || (format == "ogg" && !AudioFixture::encodeOgg(dir + "/track.wav", fileName))) {
+        fprintf(stderr, "could not write %s\n", qPrintable(fileName));
+        return 1;
+    }
+
+    ThrottledServer server(dir, rate, latency);
+    if (!server.start()) {
+        fprintf(stderr, "could not start the throttled server\n");
+        return 1;
+    }
+
+    bool pcmCache = CommandLine::hasOption(arguments, "pcm-cache");
+    PcmCache::instance()->setEnabled(pcmCache);
+
+    Player::setSinkFactory(createSink);
+    MonitorPlayer::setSinkFactory(createSink);
+    DeckWaiter deckWaiter;
+    waiter = &deckWaiter;
+
+    QWidget host;
+    host.setObjectName("bench");
+    Player* player = new Player(&host);
+    player->prepare();
+    MonitorPlayer* monitor = new MonitorPlayer(&host);
+    monitor->prepare();
+    monitor->enable();
+    deckWaiter.watch(player);
+    deckWaiter.watch(monitor);
+
+    QList<QPair<QString, QUrl> > sources;
+    sources << qMakePair(QString("local"), QUrl::fromLocalFile(fileName))
+            << qMakePair(QString("throttled"), server.url(fileName));
+
+    bool ok = true;
+    for (int i = 0; i < sources.count() && ok; i++) {
+        bench.clearParameters();
+        bench.setParameter("format", format);
+        bench.setParameter("source", sources.at(i).first);
+        if (sources.at(i).first == "throttled") {
+            bench.setParameter("rate_kbs", int(rate / 1024));
+            bench.setParameter("latency_ms", latency);
+        }
+
+        bench.setParameter("deck", "Player");
+        bench.setParameter("pcm_cache", pcmCache);
+        ok = run(bench, player, sources.at(i).second, iterations, seconds);
+        player->close();
+
+        bench.setParameter("deck", "MonitorPlayer");
+        bench.setParameter("pcm_cache", false);
+        ok = ok && run(bench, monitor, sources.at(i).second, iterations, seconds);
+        monitor->close();
+    }
+
+    delete player;
+    delete monitor;
+    waiter = nullptr;
+    if (!CommandLine::hasOption(arguments, "keep"))
+        AudioFixture::removeTree(dir);
+    return ok ? 0 : 1;
+}
+
+#include "main.moc"
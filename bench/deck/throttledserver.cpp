@@ -0,0 +1,229 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "throttledserver.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QRegExp>
+#include <QTcpSocket>
+#include <QTimer>
+
+namespace {
+const int tickInterval = 10;
+
+struct Transfer {
+    Transfer()
+        : file(nullptr)
+        , remaining(0)
+        , readyAt(0)
+        , responding(false)
+    {
+    }
+    ~Transfer() { delete file; }
+
+    QByteArray request;
+    QByteArray header;
+    QFile* file;
+    qint64 remaining;
+    qint64 readyAt;
+    bool responding;
+};
+
+QByteArray contentType(const QString& fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "wav")
+        return "audio/x-wav";
+    if (suffix == "ogg")
+        return "audio/ogg";
+    if (suffix == "flac")
+        return "audio/flac";
+    if (suffix == "mp3")
+        return "audio/mpeg";
+    return "application/octet-stream";
+}
+}
+
+struct ThrottledServerPrivate {
+    QString root;
+    qint64 bytesPerSecond;
+    int latency;
+    QHash<QTcpSocket*, Transfer*> transfers;
+    QTimer tick;
+    QElapsedTimer clock;
+    qint64 lastTick;
+};
+
+ThrottledServer::ThrottledServer(const QString& root, qint64 bytesPerSecond, int latency, QObject* parent)
+    : QTcpServer(parent)
+    , p(new ThrottledServerPrivate)
+{
+    p->root = QDir(root).absolutePath();
+    p->bytesPerSecond = bytesPerSecond;
+    p->latency = latency;
+    p->lastTick = 0;
+    p->tick.setInterval(tickInterval);
+    connect(&p->tick, SIGNAL(timeout()), this, SLOT(onTick()));
+    connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+ThrottledServer::~ThrottledServer()
+{
+    qDeleteAll(p->transfers);
+    delete p;
+}
+
+bool ThrottledServer::start()
+{
+    if (!listen(QHostAddress::LocalHost))
+        return false;
+    p->clock.start();
+    p->tick.start();
+    return true;
+}
+
+QUrl ThrottledServer::url(const QString& fileName) const
+{
+    QString path = QDir(p->root).relativeFilePath(fileName);
+    QUrl url;
+    url.setScheme("http");
+    url.setHost("127.0.0.1");
+    url.setPort(serverPort());
+    url.setPath("/" + path);
+    return url;
+}
+
+void ThrottledServer::onNewConnection()
+{
+    while (hasPendingConnections()) {
+        QTcpSocket* socket = nextPendingConnection();
+        p->transfers.insert(socket, new Transfer);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    }
+}
+
+void ThrottledServer::onReadyRead()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    Transfer* transfer = p->transfers.value(socket);
+    if (!transfer)
+        return;
+
+    transfer->request.append(socket->readAll());
+    if (!transfer->responding && transfer->request.contains("\r\n\r\n"))
+        respond(socket, transfer->request);
+}
+
+void ThrottledServer::onDisconnected()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    delete p->transfers.take(socket);
+    socket->deleteLater();
+}
+
+void ThrottledServer::respond(QTcpSocket* socket, const QByteArray& request)
+{
+    Transfer* transfer = p->transfers.value(socket);
+    transfer->responding = true;
+
+    QString text = QString::fromLatin1(request);
+    QStringList requestLine = text.section("\r\n", 0, 0).split(" ");
+    QString path = requestLine.count() > 1 ? QUrl::fromPercentEncoding(requestLine.at(1).toLatin1()) : QString();
+    QString fileName = QDir::cleanPath(p->root + "/" + path);
+
+    transfer->file = new QFile(fileName);
+    if (requestLine.first() != "GET" || !fileName.startsWith(p->root) || !transfer->file->open(QIODevice::ReadOnly)) {
+        socket->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    qint64 size = transfer->file->size();
+    qint64 from = 0;
+    qint64 to = size - 1;
+    QRegExp range("\r\nRange:\\s*bytes=(\\d+)-(\\d*)", Qt::CaseInsensitive);
+    bool partial = range.indexIn(text) >= 0;
+    if (partial) {
+        from = range.cap(1).toLongLong();
+        if (!range.cap(2).isEmpty())
+            to = qMin(to, range.cap(2).toLongLong());
+        if (from > to) {
+            socket->write(QString("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%1\r\n"
+                                  "Content-Length: 0\r\nConnection: close\r\n\r\n")
+                              .arg(size)
+                              .toLatin1());
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+
+    QByteArray header = partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+    header += "Content-Type: " + contentType(fileName) + "\r\n";
+    header += "Content-Length: " + QByteArray::number(to - from + 1) + "\r\n";
+    if (partial)
+        header += QString("Content-Range: bytes %1-%2/%3\r\n").arg(from).arg(to).arg(size).toLatin1();
+    header += "Accept-Ranges: bytes\r\nConnection: close\r\n\r\n";
+
+    transfer->file->seek(from);
+    transfer->header = header;
+    transfer->remaining = to - from + 1;
+    transfer->readyAt = p->clock.elapsed() + p->latency;
+}
+
+void ThrottledServer::onTick()
+{
+    qint64 now = p->clock.elapsed();
+    qint64 budget = p->bytesPerSecond * (now - p->lastTick) / 1000;
+    p->lastTick = now;
+
+    QList<QTcpSocket*> active;
+    QHash<QTcpSocket*, Transfer*>::const_iterator it;
+    for (it = p->transfers.constBegin(); it != p->transfers.constEnd(); ++it) {
+        Transfer* transfer = it.value();
+        if (transfer->responding && transfer->file && transfer->remaining > 0 && transfer->readyAt <= now)
+            active << it.key();
+    }
+    if (active.isEmpty())
+        return;
+
+    // the cap is shared like the bandwidth of a single slow device
+    qint64 share = qMax(qint64(1), budget / active.count());
+    foreach (QTcpSocket* socket, active) {
+        Transfer* transfer = p->transfers.value(socket);
+        if (!transfer->header.isEmpty()) {
+            socket->write(transfer->header);
+            transfer->header.clear();
+        }
+        if (socket->bytesToWrite() > 2 * share)
+            continue;
+
+        QByteArray data = transfer->file->read(qMin(share, transfer->remaining));
+        if (data.isEmpty()) {
+            socket->disconnectFromHost();
+            continue;
+        }
+        socket->write(data);
+        transfer->remaining -= data.size();
+        if (transfer->remaining <= 0)
+            socket->disconnectFromHost();
+    }
+}
@@ -0,0 +1,53 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THROTTLEDSERVER_H
+#define THROTTLEDSERVER_H
+
+#include <QTcpServer>
+#include <QUrl>
+
+class QTcpSocket;
+
+/*
+ *  Serves the files below a directory over HTTP with a bandwidth cap and a
+ *  delay before the first byte of every response, standing in for slow
+ *  network shares and USB sticks. Range requests are supported, so the
+ *  players can seek. Runs in the thread it was created in.
+ */
+class ThrottledServer : public QTcpServer {
+    Q_OBJECT
+
+public:
+    ThrottledServer(const QString& root, qint64 bytesPerSecond, int latency, QObject* parent = nullptr);
+    ~ThrottledServer();
+
+    bool start();
+    QUrl url(const QString& fileName) const;
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onTick();
+
+private:
+    void respond(QTcpSocket* socket, const QByteArray& request);
+    struct ThrottledServerPrivate* p;
+};
+
+#endif // THROTTLEDSERVER_H
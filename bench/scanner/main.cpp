@@ -0,0 +1,212 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ *  Scan throughput of CollectionUpdater over a generated tree of tagged
+ *  MP3, Ogg Vorbis and FLAC files.
+ *
+ *  bench-scanner [--files 5000] [--runs 3] [--changed 10] [--seed 1]
+ *                [--dir /tmp] [--output results.json] [--keep]
+ *
+ *  Reports files/s and the time spent in the directory walk, in TagLib
+ *  and in SQL for full scans and for an incremental scan after --changed
+ *  percent of the albums got a new track.
+ */
+
+#include "audiofixture.h"
+#include "benchmark.h"
+#include "catalogue.h"
+#include "collectiondb.h"
+#include "collectionupdater.h"
+#include "commandline.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QTimer>
+#include <QtSql>
+
+#include <stdio.h>
+
+class ScanWaiter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ScanWaiter(CollectionUpdater* updater)
+        : m_finished(false)
+    {
+        connect(updater, SIGNAL(progressChanged(int)),
+            this, SLOT(onProgress(int)), Qt::QueuedConnection);
+    }
+
+    /** false if the scan did not finish within timeout */
+    bool wait(int timeout)
+    {
+        QTimer::singleShot(timeout, &m_loop, SLOT(quit()));
+        m_finished = false;
+        m_loop.exec();
+        return m_finished;
+    }
+
+private slots:
+    void onProgress(int percent)
+    {
+        if (percent < 100)
+            return;
+        m_finished = true;
+        m_loop.quit();
+    }
+
+private:
+    QEventLoop m_loop;
+    bool m_finished;
+};
+
+namespace {
+const char* suffixes[] = { "mp3", "mp3", "mp3", "ogg", "flac" };
+
+QString fixtureName(const Catalogue::Entry& entry, int index)
+{
+    QString name = entry.url;
+    name.chop(3);
+    return name + suffixes[index % 5];
+}
+
+QVariantMap scanValues(const CollectionUpdater::ScanStatistics& statistics)
+{
+    QVariantMap values;
+    values.insert("files", statistics.files);
+    values.insert("tracks", statistics.tracks);
+    values.insert("total_ms", statistics.totalTime / 1000000.0);
+    values.insert("walk_ms", statistics.walkTime / 1000000.0);
+    values.insert("taglib_ms", statistics.tagTime / 1000000.0);
+    values.insert("sql_ms", statistics.sqlTime / 1000000.0);
+    values.insert("files_per_s", statistics.totalTime > 0 ? statistics.files * 1e9 / statistics.totalTime : 0.0);
+    values.insert("peak_rss_kb", qlonglong(Benchmark::peakRss()));
+    return values;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("knowthelist-org");
+    QCoreApplication::setApplicationName("knowthelist-bench");
+
+    QStringList arguments = app.arguments();
+    if (CommandLine::hasOption(arguments, "help")) {
+        fprintf(stderr, "usage: bench-scanner [--files 5000] [--runs 3] [--changed 10] [--seed 1]\n"
+                        "       [--dir path] [--output file] [--keep]\n");
+        return 0;
+    }
+
+    int files = CommandLine::option(arguments, "files", "5000").toInt();
+    int runs = CommandLine::option(arguments, "runs", "3").toInt();
+    int changed = CommandLine::option(arguments, "changed", "10").toInt();
+    quint32 seed = CommandLine::option(arguments, "seed", "1").toUInt();
+    QString dir = CommandLine::option(arguments, "dir", QDir::tempPath()) + "/knowthelist-bench-scanner";
+
+    Benchmark bench("scanner");
+    QString output = CommandLine::option(arguments, "output");
+    if (!output.isEmpty())
+        bench.setOutput(output);
+    bench.setParameter("files", files);
+    bench.setParameter("seed", int(seed));
+
+    AudioFixture::removeTree(dir);
+    QDir().mkpath(dir);
+    QString root = dir + "/music";
+
+    // fixtures
+    Catalogue catalogue(seed, root);
+    catalogue.reset(files);
+    QStringList albums;
+    QElapsedTimer timer;
+    timer.start();
+    Catalogue::Entry entry;
+    for (int i = 0; i < files; i++) {
+        catalogue.next(entry);
+        QString fileName = fixtureName(entry, i);
+        if (!AudioFixture::write(fileName, 1 + i % 5) || !AudioFixture::writeTags(fileName, entry)) {
+            fprintf(stderr, "could not write %s\n", qPrintable(fileName));
+            return 1;
+        }
+        if (albums.isEmpty() || albums.last() != entry.dir)
+            albums << entry.dir;
+    }
+    QVariantMap generated;
+    generated.insert("duration_ms", timer.elapsed());
+    generated.insert("albums", albums.count());
+    bench.reportValues("generateFixtures", generated);
+
+    // scratch database, tables exist so the updater does not rebuild
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
+        db.setDatabaseName(dir + "/collection.db");
+        if (!db.open()) {
+            fprintf(stderr, "could not open %s\n", qPrintable(db.databaseName()));
+            return 1;
+        }
+    }
+    CollectionDB database;
+    database.createTables();
+    database.createStatsTable();
+
+    CollectionUpdater updater;
+    ScanWaiter waiter(&updater);
+    const int timeout = 30 * 60 * 1000;
+
+    for (int run = 0; run < runs; run++) {
+        updater.setDirectoryList(QStringList() << root, true);
+        if (!waiter.wait(timeout)) {
+            fprintf(stderr, "full scan did not finish\n");
+            return 1;
+        }
+        QVariantMap values = scanValues(updater.lastScan());
+        values.insert("run", run);
+        bench.reportValues("fullScan", values);
+    }
+
+    // the directory times are compared in seconds
+    QEventLoop pause;
+    QTimer::singleShot(1100, &pause, SLOT(quit()));
+    pause.exec();
+    int changedAlbums = qMax(1, albums.count() * changed / 100);
+    for (int i = 0; i < changedAlbums; i++) {
+        catalogue.next(entry);
+        QString fileName = albums.at((i * albums.count()) / changedAlbums) + "/99 - " + entry.title + ".mp3";
+        AudioFixture::write(fileName, 2);
+        AudioFixture::writeTags(fileName, entry);
+    }
+
+    updater.monitor();
+    if (!waiter.wait(timeout)) {
+        fprintf(stderr, "incremental scan did not finish\n");
+        return 1;
+    }
+    QVariantMap values = scanValues(updater.lastScan());
+    values.insert("changed_dirs", changedAlbums);
+    bench.reportValues("incrementalScan", values);
+
+    if (!CommandLine::hasOption(arguments, "keep"))
+        AudioFixture::removeTree(dir);
+    return 0;
+}
+
+#include "main.moc"
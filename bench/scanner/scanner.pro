@@ -0,0 +1,12 @@
+#
+# Knowthelist benchmark tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Throughput of full and incremental collection scans over generated files
+
+include(../bench.pri)
+
+TARGET = bench-scanner
+
+SOURCES += main.cpp
@@ -1,5 +1,14 @@
 TEMPLATE = subdirs
 
 win32:SUBDIRS += gst
-SUBDIRS += src
+SUBDIRS += core src tools
+
+# the application and the command line tools link the core library
+core.subdir = src/core
+src.depends = core
+tools.depends = core
+
+# benchmark tools, build with: qmake CONFIG+=bench
+bench:SUBDIRS += bench
+bench.depends = core
 
@@ -0,0 +1,639 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cataloguesnapshot.h"
+#include "collectiondb.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QVector>
+#include <qdebug.h>
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+const char fileMagic[8] = { 'K', 'T', 'L', 'C', 'A', 'T', 'L', 'G' };
+const quint32 fileVersion = 2;
+const quint32 byteOrderMark = 0x01020304;
+// a NULL column, e.g. the track number of a file without one
+const qint32 noValue = -1;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 stamp;
+    quint32 trackCount;
+    // offsets from the start of the file
+    quint32 tracks;
+    quint32 browseOrder;
+    quint32 tables[CatalogueSnapshot::TableCount];
+    quint32 tableCounts[CatalogueSnapshot::TableCount];
+    quint32 strings;
+    quint32 stringsSize;
+    quint32 fileSize;
+};
+
+// strings are offsets into the pool, names indices into the name tables
+struct TrackRecord {
+    qint32 id;
+    quint32 url;
+    quint32 dir;
+    quint32 title;
+    quint32 names[CatalogueSnapshot::TableCount];
+    qint32 length;
+    qint32 track;
+};
+
+struct NameEntry {
+    quint32 string;
+    // tracks of an artist are first..first+count of the browse order
+    quint32 first;
+    quint32 count;
+};
+
+// a string is its length in UTF-16 units followed by the units, 4 byte aligned
+class StringPool {
+public:
+    quint32 add(const QString& value)
+    {
+        QHash<QString, quint32>::const_iterator it = m_offsets.constFind(value);
+        if (it != m_offsets.constEnd())
+            return it.value();
+
+        quint32 offset = m_data.size();
+        quint32 length = value.length();
+        m_data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        m_data.append(reinterpret_cast<const char*>(value.constData()), length * sizeof(QChar));
+        while (m_data.size() % 4)
+            m_data.append('\0');
+        m_offsets.insert(value, offset);
+        return offset;
+    }
+    const QByteArray& data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QString, quint32> m_offsets;
+};
+
+// artist, album, track number, id
+struct BrowseLess {
+    explicit BrowseLess(const TrackRecord* tracks)
+        : m_tracks(tracks)
+    {
+    }
+    bool operator()(quint32 a, quint32 b) const
+    {
+        const TrackRecord& x = m_tracks[a];
+        const TrackRecord& y = m_tracks[b];
+        if (x.names[CatalogueSnapshot::Artist] != y.names[CatalogueSnapshot::Artist])
+            return x.names[CatalogueSnapshot::Artist] < y.names[CatalogueSnapshot::Artist];
+        if (x.names[CatalogueSnapshot::Album] != y.names[CatalogueSnapshot::Album])
+            return x.names[CatalogueSnapshot::Album] < y.names[CatalogueSnapshot::Album];
+        if (x.track != y.track)
+            return x.track < y.track;
+        return x.id < y.id;
+    }
+    const TrackRecord* m_tracks;
+};
+
+// the order of CollectionDB::selectTracks: artist and album descending
+struct TrackListLess {
+    explicit TrackListLess(const TrackRecord* tracks)
+        : m_tracks(tracks)
+    {
+    }
+    bool operator()(quint32 a, quint32 b) const
+    {
+        const TrackRecord& x = m_tracks[a];
+        const TrackRecord& y = m_tracks[b];
+        if (x.names[CatalogueSnapshot::Artist] != y.names[CatalogueSnapshot::Artist])
+            return x.names[CatalogueSnapshot::Artist] > y.names[CatalogueSnapshot::Artist];
+        return x.names[CatalogueSnapshot::Album] > y.names[CatalogueSnapshot::Album];
+    }
+    const TrackRecord* m_tracks;
+};
+
+struct IdLess {
+    bool operator()(const TrackRecord& record, qint32 id) const { return record.id < id; }
+};
+
+quint32 align(quint32 offset)
+{
+    return (offset + 7) & ~7u;
+}
+
+qint32 toValue(const QString& value)
+{
+    bool ok = false;
+    int ret = value.toInt(&ok);
+    return ok ? ret : noValue;
+}
+
+QString columnValue(qint32 value)
+{
+    return value == noValue ? QString() : QString::number(value);
+}
+
+bool padTo(QFile& file, qint64 offset)
+{
+    QByteArray zeros(offset - file.pos(), '\0');
+    return zeros.isEmpty() || file.write(zeros) == zeros.size();
+}
+}
+
+struct CatalogueSnapshotPrivate {
+    QMutex mutex;
+    // reads the stamp of the database under the lock of a CollectionDB
+    CollectionDB* collection;
+    QString fileName;
+    QFile file;
+    uchar* data;
+    const Header* header;
+    const TrackRecord* tracks;
+    const quint32* browseOrder;
+    const NameEntry* tables[CatalogueSnapshot::TableCount];
+    const uchar* strings;
+    // open() failed since the last invalidate(), do not try for every query
+    bool checked;
+
+    QString string(quint32 offset) const
+    {
+        if (quint64(offset) + sizeof(quint32) > header->stringsSize)
+            return QString();
+        quint32 length;
+        memcpy(&length, strings + offset, sizeof(length));
+        if (quint64(offset) + sizeof(quint32) + quint64(length) * sizeof(QChar) > header->stringsSize)
+            return QString();
+        return QString(reinterpret_cast<const QChar*>(strings + offset + sizeof(quint32)), length);
+    }
+
+    QString name(int table, quint32 index) const
+    {
+        if (index >= header->tableCounts[table])
+            return QString();
+        return string(tables[table][index].string);
+    }
+
+    /** Index of name in the sorted table, -1 if no track has it */
+    int find(int table, const QString& value) const
+    {
+        int low = 0;
+        int high = header->tableCounts[table];
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (name(table, middle) < value)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low < int(header->tableCounts[table]) && name(table, low) == value)
+            return low;
+        return -1;
+    }
+
+    /** false if a filter names something unknown, nothing matches then */
+    bool resolve(int* filter, const QString& year, const QString& genre, const QString& artist, const QString& album) const
+    {
+        QString values[CatalogueSnapshot::TableCount];
+        values[CatalogueSnapshot::Artist] = artist;
+        values[CatalogueSnapshot::Album] = album;
+        values[CatalogueSnapshot::Genre] = genre;
+        values[CatalogueSnapshot::Year] = year;
+        for (int i = 0; i < CatalogueSnapshot::TableCount; i++) {
+            filter[i] = -1;
+            if (values[i].isEmpty())
+                continue;
+            filter[i] = find(i, values[i]);
+            if (filter[i] < 0)
+                return false;
+        }
+        return true;
+    }
+
+    bool matches(const TrackRecord& record, const int* filter) const
+    {
+        for (int i = 0; i < CatalogueSnapshot::TableCount; i++)
+            if (filter[i] >= 0 && record.names[i] != quint32(filter[i]))
+                return false;
+        return true;
+    }
+
+    /** Browse order positions to look at, an artist has its own range */
+    void range(const int* filter, quint32* begin, quint32* end) const
+    {
+        *begin = 0;
+        *end = header->trackCount;
+        if (filter[CatalogueSnapshot::Artist] >= 0) {
+            const NameEntry& entry = tables[CatalogueSnapshot::Artist][filter[CatalogueSnapshot::Artist]];
+            *begin = qMin(entry.first, header->trackCount);
+            *end = qMin(entry.first + entry.count, header->trackCount);
+        }
+    }
+
+    QStringList row(const TrackRecord& record) const
+    {
+        QStringList ret;
+        ret << string(record.url)
+            << name(CatalogueSnapshot::Artist, record.names[CatalogueSnapshot::Artist])
+            << string(record.title)
+            << name(CatalogueSnapshot::Album, record.names[CatalogueSnapshot::Album])
+            << name(CatalogueSnapshot::Year, record.names[CatalogueSnapshot::Year])
+            << name(CatalogueSnapshot::Genre, record.names[CatalogueSnapshot::Genre])
+            << columnValue(record.track)
+            << columnValue(record.length)
+            // play counter and rate change between scans, CollectionDB reads them live
+            << QString()
+            << QString();
+        return ret;
+    }
+};
+
+CatalogueSnapshot* CatalogueSnapshot::instance()
+{
+    static CatalogueSnapshot* snapshot = new CatalogueSnapshot(QCoreApplication::instance());
+    return snapshot;
+}
+
+CatalogueSnapshot::CatalogueSnapshot(QObject* parent)
+    : QObject(parent)
+    , p(new CatalogueSnapshotPrivate)
+{
+    p->collection = nullptr;
+    p->data = nullptr;
+    p->header = nullptr;
+    p->checked = false;
+    reopen();
+}
+
+CatalogueSnapshot::~CatalogueSnapshot()
+{
+    invalidate();
+    delete p->collection;
+    delete p;
+}
+
+QString CatalogueSnapshot::fileName() const
+{
+    return p->fileName;
+}
+
+bool CatalogueSnapshot::isValid()
+{
+    QMutexLocker locker(&p->mutex);
+    return open();
+}
+
+void CatalogueSnapshot::invalidate()
+{
+    QMutexLocker locker(&p->mutex);
+    if (p->data) {
+        p->file.unmap(p->data);
+        p->file.close();
+    }
+    p->data = nullptr;
+    p->header = nullptr;
+    p->checked = false;
+}
+
+void CatalogueSnapshot::reopen()
+{
+    invalidate();
+    QMutexLocker locker(&p->mutex);
+    // created again on the next open(), for the new default connection
+    delete p->collection;
+    p->collection = nullptr;
+    QFileInfo fileInfo(QSqlDatabase::database().databaseName());
+    p->fileName = fileInfo.absolutePath() + "/" + fileInfo.completeBaseName() + ".catalogue";
+}
+
+bool CatalogueSnapshot::open()
+{
+    // called with the mutex held
+    if (p->data)
+        return true;
+    if (p->checked)
+        return false;
+
+    TraceZone zone("catalogue", "open");
+    p->checked = true;
+
+    p->file.setFileName(p->fileName);
+    if (!p->file.open(QIODevice::ReadOnly))
+        return false;
+    qint64 size = p->file.size();
+    uchar* data = size >= qint64(sizeof(Header)) ? p->file.map(0, size) : nullptr;
+    if (!data) {
+        p->file.close();
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    quint64 count = header->trackCount;
+    bool ok = memcmp(header->magic, fileMagic, sizeof(fileMagic)) == 0
+        && header->version == fileVersion
+        && header->byteOrder == byteOrderMark
+        && qint64(header->fileSize) == size
+        && header->tracks + count * sizeof(TrackRecord) <= quint64(size)
+        && header->browseOrder + count * sizeof(quint32) <= quint64(size)
+        && quint64(header->strings) + header->stringsSize <= quint64(size);
+    for (int i = 0; ok && i < TableCount; i++)
+        ok = header->tables[i] + quint64(header->tableCounts[i]) * sizeof(NameEntry) <= quint64(size);
+
+    // the database changed since the snapshot was written
+    if (ok) {
+        // not in the constructor, CollectionDB creates this instance
+        if (!p->collection)
+            p->collection = new CollectionDB();
+        ok = header->stamp != 0 && p->collection->selectSqlNumber("PRAGMA user_version;") == long(header->stamp);
+    }
+
+    if (!ok) {
+        qDebug() << Q_FUNC_INFO << "not using" << p->fileName;
+        p->file.unmap(data);
+        p->file.close();
+        return false;
+    }
+
+    p->data = data;
+    p->header = header;
+    p->tracks = reinterpret_cast<const TrackRecord*>(data + header->tracks);
+    p->browseOrder = reinterpret_cast<const quint32*>(data + header->browseOrder);
+    for (int i = 0; i < TableCount; i++)
+        p->tables[i] = reinterpret_cast<const NameEntry*>(data + header->tables[i]);
+    p->strings = data + header->strings;
+    qDebug() << Q_FUNC_INFO << header->trackCount << "tracks mapped from" << p->fileName;
+    return true;
+}
+
+int CatalogueSnapshot::trackCount()
+{
+    QMutexLocker locker(&p->mutex);
+    if (!open())
+        return -1;
+    return p->header->trackCount;
+}
+
+bool CatalogueSnapshot::selectNames(Table table, QList<QStringList>& rows, const QString& year, const QString& genre, const QString& artist)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!open())
+        return false;
+
+    rows.clear();
+    int filter[TableCount];
+    if (!p->resolve(filter, year, genre, artist, QString()))
+        return true;
+
+    int count = p->header->tableCounts[table];
+    QVector<bool> used;
+    if (!year.isEmpty() || !genre.isEmpty() || !artist.isEmpty()) {
+        used.fill(false, count);
+        quint32 begin, end;
+        p->range(filter, &begin, &end);
+        for (quint32 i = begin; i < end; i++) {
+            const TrackRecord& record = p->tracks[p->browseOrder[i]];
+            if (p->matches(record, filter) && record.names[table] < quint32(count))
+                used[record.names[table]] = true;
+        }
+    }
+
+    // every name in the tables belongs to a track, years are listed newest first
+    for (int i = 0; i < count; i++) {
+        int index = table == Year ? count - 1 - i : i;
+        if (!used.isEmpty() && !used.at(index))
+            continue;
+        QString name = p->name(table, index);
+        if (!name.isEmpty())
+            rows << (QStringList() << name);
+    }
+    return true;
+}
+
+bool CatalogueSnapshot::selectTracks(QList<QStringList>& rows, const QString& year, const QString& genre, const QString& artist, const QString& album)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!open())
+        return false;
+
+    rows.clear();
+    int filter[TableCount];
+    if (!p->resolve(filter, year, genre, artist, album))
+        return true;
+
+    quint32 begin, end;
+    p->range(filter, &begin, &end);
+    QVector<quint32> selected;
+    for (quint32 i = begin; i < end; i++)
+        if (p->matches(p->tracks[p->browseOrder[i]], filter))
+            selected.append(p->browseOrder[i]);
+
+    // the browse order already sorts by track number inside an album
+    std::stable_sort(selected.begin(), selected.end(), TrackListLess(p->tracks));
+    foreach (quint32 index, selected)
+        rows << p->row(p->tracks[index]);
+    return true;
+}
+
+bool CatalogueSnapshot::selectTrackById(int id, QStringList& row)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!open())
+        return false;
+
+    const TrackRecord* end = p->tracks + p->header->trackCount;
+    const TrackRecord* it = std::lower_bound(p->tracks, end, id, IdLess());
+    row = it != end && it->id == id ? p->row(*it) : QStringList();
+    return true;
+}
+
+bool CatalogueSnapshot::selectTrackAt(int index, QStringList& row)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!open())
+        return false;
+
+    row = index >= 0 && quint32(index) < p->header->trackCount ? p->row(p->tracks[index]) : QStringList();
+    return true;
+}
+
+bool CatalogueSnapshot::selectIndexRows(QList<QStringList>& rows)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!open())
+        return false;
+
+    rows.clear();
+    rows.reserve(p->header->trackCount);
+    for (quint32 i = 0; i < p->header->trackCount; i++) {
+        const TrackRecord& record = p->tracks[i];
+        rows << (QStringList() << QString::number(record.id)
+                               << columnValue(record.length)
+                               << p->string(record.dir)
+                               << p->name(Genre, record.names[Genre])
+                               << p->name(Artist, record.names[Artist]));
+    }
+    return true;
+}
+
+bool CatalogueSnapshot::write(CollectionDB* db)
+{
+    TraceZone zone("catalogue", "write");
+    QElapsedTimer timer;
+    timer.start();
+
+    // stamped before reading, a change while reading resets user_version
+    // to 0 and the file is never used. user_version is signed, keep the
+    // stamp positive and never 0
+    quint32 stamp = qMax(1u, QDateTime::currentDateTime().toTime_t() & 0x7fffffff);
+    if (!db->executeSql(QString("PRAGMA user_version = %1;").arg(stamp)))
+        return false;
+
+    QList<QStringList> rows = db->selectSql("SELECT tags.id, tags.url, tags.dir, tags.title, "
+                                            "artist.name, album.name, genre.name, year.name, "
+                                            "tags.length, tags.track "
+                                            "FROM tags "
+                                            "INNER JOIN artist ON tags.artist = artist.id "
+                                            "INNER JOIN album ON tags.album = album.id "
+                                            "INNER JOIN year ON tags.year = year.id "
+                                            "INNER JOIN genre ON tags.genre = genre.id "
+                                            "ORDER BY tags.id;");
+
+    // a failed query must not look like an empty collection
+    long count = db->selectSqlNumber("SELECT count(*) FROM tags "
+                                     "INNER JOIN artist ON tags.artist = artist.id "
+                                     "INNER JOIN album ON tags.album = album.id "
+                                     "INNER JOIN year ON tags.year = year.id "
+                                     "INNER JOIN genre ON tags.genre = genre.id;");
+    if (count != rows.count()) {
+        qWarning() << Q_FUNC_INFO << "catalogue changed while reading, not written";
+        return false;
+    }
+
+    // the names come first in the pool, the root lists touch a few pages only
+    StringPool pool;
+    const int nameColumn[TableCount] = { 4, 5, 6, 7 };
+    QVector<NameEntry> tables[TableCount];
+    QHash<QString, quint32> indices[TableCount];
+    for (int t = 0; t < TableCount; t++) {
+        QSet<QString> names;
+        foreach (const QStringList& row, rows)
+            names.insert(row.at(nameColumn[t]));
+        QStringList sorted = names.toList();
+        std::sort(sorted.begin(), sorted.end());
+        for (int i = 0; i < sorted.count(); i++) {
+            NameEntry entry;
+            entry.string = pool.add(sorted.at(i));
+            entry.first = 0;
+            entry.count = 0;
+            tables[t].append(entry);
+            indices[t].insert(sorted.at(i), i);
+        }
+    }
+
+    QVector<TrackRecord> tracks(rows.count());
+    for (int i = 0; i < rows.count(); i++) {
+        const QStringList& row = rows.at(i);
+        TrackRecord& record = tracks[i];
+        record.id = row.at(0).toInt();
+        record.url = pool.add(row.at(1));
+        record.dir = pool.add(row.at(2));
+        record.title = pool.add(row.at(3));
+        for (int t = 0; t < TableCount; t++) {
+            record.names[t] = indices[t].value(row.at(nameColumn[t]));
+            tables[t][record.names[t]].count++;
+        }
+        record.length = toValue(row.at(8));
+        record.track = toValue(row.at(9));
+    }
+
+    QVector<quint32> browseOrder(tracks.count());
+    for (int i = 0; i < browseOrder.count(); i++)
+        browseOrder[i] = i;
+    std::sort(browseOrder.begin(), browseOrder.end(), BrowseLess(tracks.constData()));
+    quint32 first = 0;
+    for (int i = 0; i < tables[Artist].count(); i++) {
+        tables[Artist][i].first = first;
+        first += tables[Artist].at(i).count;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.byteOrder = byteOrderMark;
+    header.stamp = stamp;
+    header.trackCount = tracks.count();
+    quint32 offset = align(sizeof(Header));
+    header.tracks = offset;
+    offset = align(offset + tracks.count() * sizeof(TrackRecord));
+    header.browseOrder = offset;
+    offset = align(offset + browseOrder.count() * sizeof(quint32));
+    for (int t = 0; t < TableCount; t++) {
+        header.tables[t] = offset;
+        header.tableCounts[t] = tables[t].count();
+        offset = align(offset + tables[t].count() * sizeof(NameEntry));
+    }
+    header.strings = offset;
+    header.stringsSize = pool.data().size();
+    header.fileSize = offset + pool.data().size();
+
+    QString name = instance()->fileName();
+    QFile file(name + ".tmp");
+    bool ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        && file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+        && padTo(file, header.tracks)
+        && file.write(reinterpret_cast<const char*>(tracks.constData()), tracks.count() * sizeof(TrackRecord))
+            == qint64(tracks.count() * sizeof(TrackRecord))
+        && padTo(file, header.browseOrder)
+        && file.write(reinterpret_cast<const char*>(browseOrder.constData()), browseOrder.count() * sizeof(quint32))
+            == qint64(browseOrder.count() * sizeof(quint32));
+    for (int t = 0; ok && t < TableCount; t++)
+        ok = padTo(file, header.tables[t])
+            && file.write(reinterpret_cast<const char*>(tables[t].constData()), tables[t].count() * sizeof(NameEntry))
+                == qint64(tables[t].count() * sizeof(NameEntry));
+    ok = ok && padTo(file, header.strings) && file.write(pool.data()) == pool.data().size();
+    file.close();
+
+    // a mapped file cannot be replaced everywhere, unmap first
+    instance()->invalidate();
+    ok = ok && (!QFile::exists(name) || QFile::remove(name)) && QFile::rename(file.fileName(), name);
+    if (!ok) {
+        qWarning() << Q_FUNC_INFO << "could not write" << name;
+        QFile::remove(file.fileName());
+        return false;
+    }
+    instance()->invalidate();
+    if (db->selectSqlNumber("PRAGMA user_version;") != long(stamp)) {
+        qWarning() << Q_FUNC_INFO << "catalogue changed while writing, not used";
+        return false;
+    }
+
+    qDebug() << Q_FUNC_INFO << tracks.count() << "tracks," << header.fileSize / 1024 << "kB in"
+             << timer.elapsed() << "ms";
+    return true;
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CATALOGUESNAPSHOT_H
+#define CATALOGUESNAPSHOT_H
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+class CollectionDB;
+
+/*
+ *  Read-only copy of the catalogue in a memory mapped file next to the
+ *  database, written after every scan. Tracks are fixed size records
+ *  ordered by id, names and paths live in a string pool as UTF-16 and are
+ *  referenced by offset, so nothing is parsed when the file is opened and
+ *  only the pages a query touches are read. The artist, album, genre and
+ *  year tables are sorted by name, the root lists of the browsers are
+ *  taken from them directly.
+ *
+ *  The file carries a stamp that is stored as user_version of the
+ *  database before the catalogue is read; every change of the catalogue
+ *  resets it, a snapshot with a different stamp is not used. The select functions return false then
+ *  and the caller asks SQL instead.
+ */
+class CatalogueSnapshot : public QObject {
+    Q_OBJECT
+
+public:
+    enum Table {
+        Artist,
+        Album,
+        Genre,
+        Year,
+        TableCount
+    };
+
+    static CatalogueSnapshot* instance();
+    ~CatalogueSnapshot();
+
+    /** The snapshot of the default database, <name>.catalogue beside it */
+    QString fileName() const;
+    /** Export the catalogue of db and stamp the database, after a scan */
+    static bool write(CollectionDB* db);
+
+    /** Maps the file on first use, false if missing or outdated */
+    bool isValid();
+    /** Unmaps the file, the next use checks it again */
+    void invalidate();
+    /** Follow the default connection again after it was replaced by another database */
+    void reopen();
+    int trackCount();
+
+    /** Distinct non-empty names of table for tracks matching the filters, sorted like the SQL selects */
+    bool selectNames(Table table, QList<QStringList>& rows, const QString& year = QString(), const QString& genre = QString(), const QString& artist = QString());
+    /** Track rows (url, artist, title, album, year, genre, track, length, playcounter, rate), the last two empty */
+    bool selectTracks(QList<QStringList>& rows, const QString& year, const QString& genre, const QString& artist, const QString& album);
+    bool selectTrackById(int id, QStringList& row);
+    bool selectTrackAt(int index, QStringList& row);
+    /** id, length, dir, genre and artist of every track, ordered by id */
+    bool selectIndexRows(QList<QStringList>& rows);
+
+private:
+    explicit CatalogueSnapshot(QObject* parent = nullptr);
+    /** Maps the file unless mapped or failed since the last invalidate() */
+    bool open();
+    struct CatalogueSnapshotPrivate* p;
+};
+
+#endif // CATALOGUESNAPSHOT_H
@@ -18,13 +18,27 @@
 */
 
 #include "collectiondb.h"
+#include "cataloguesnapshot.h"
+#include "similarityindex.h"
+#include "sqlprofiler.h"
+#include "statisticsjournal.h"
+#include "tracer.h"
+#include "trackindex.h"
+#include "trackweights.h"
 
 #include <QtSql>
 
+#include <QDateTime>
 #include <QDesktopServices>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QSet>
 #include <qimage.h>
 
+#include <random>
+
 struct CollectionDbPrivate {
 public:
     uint genreCount;
@@ -41,6 +55,33 @@ public:
     QSqlDatabase* db;
     QSqlQuery* query;
     QMutex mutex;
+    TrackBitmap lastMatch;
+    int lastGeneration;
+    // the full range of ranks without modulo bias, RAND_MAX is 32767 on win32
+    std::mt19937 random;
+
+    quint32 randomBelow(quint32 bound)
+    {
+        return std::uniform_int_distribution<quint32>(0, bound - 1)(random);
+    }
+
+    // called with the mutex held, timer started before locking
+    void profile(const QString& statement, const QElapsedTimer& timer, qint64 waited, int rows)
+    {
+        SqlProfiler* profiler = SqlProfiler::instance();
+        if (!profiler->isEnabled())
+            return;
+
+        qint64 elapsed = timer.nsecsElapsed() - waited;
+        QString plan;
+        if (profiler->isSlow(elapsed)) {
+            QSqlQuery explain(*db);
+            if (explain.exec("EXPLAIN QUERY PLAN " + statement))
+                while (explain.next())
+                    plan += explain.value(explain.record().count() - 1).toString() + "\n";
+        }
+        profiler->record(statement, elapsed, waited, rows, plan);
+    }
 
     QString selectionFilter(QString year = "", QString genre = "", QString artist = "", QString album = "")
     {
@@ -103,6 +144,9 @@ CollectionDB::CollectionDB()
 
     p->genreCount = 0;
     p->resultCount = 0;
+    p->resultLength = 0;
+    p->lastGeneration = -1;
+    p->random.seed(quint32(QDateTime::currentMSecsSinceEpoch()) ^ quint32(quintptr(this)));
     p->sqlQuickFilter = QString("");
 
     p->sqlFromString = "FROM tags "
@@ -121,6 +165,12 @@ CollectionDB::CollectionDB()
                          " INNER JOIN playlists ON tags.url = playlists.url "
                          " LEFT OUTER JOIN statistics ON tags.url = statistics.url "
                          " LEFT OUTER JOIN favorites ON tags.url = favorites.url WHERE 1=1 ";
+
+    // create the singletons here, in the thread owning the database
+    StatisticsJournal::instance();
+    TrackIndex::instance();
+    SqlProfiler::instance();
+    CatalogueSnapshot::instance();
 }
 
 CollectionDB::~CollectionDB()
@@ -172,35 +222,18 @@ bool CollectionDB::isEmpty()
 
 void CollectionDB::incSongCounter(const QString url)
 {
-    QList<QStringList> entries;
-
-    entries = selectSql(QString("SELECT playcounter, createdate FROM statistics WHERE url = '%1';")
-                            .arg(escapeString(url)));
-
-    if (!entries.isEmpty()) {
-        // entry exists, increment playcounter and update accesstime
-        executeSql(QString("REPLACE INTO statistics ( url, createdate, accessdate, playcounter ) VALUES ( '%1', '%2', strftime('%s', 'now'), %3 );")
-                       .arg(escapeString(url))
-                       .arg(entries.at(0)[1])
-                       .arg(entries.at(0)[0] + " + 1"));
-    } else {
-        // entry didnt exist yet, create a new one
-        executeSql(QString("INSERT INTO statistics ( url, createdate, accessdate, playcounter ) VALUES ( '%1', strftime('%s', 'now'), strftime('%s', 'now'), 1 );")
-                       .arg(escapeString(url)));
-    }
+    // written behind by the journal, playback never waits for the database
+    StatisticsJournal::instance()->addPlay(url);
 }
 
 void CollectionDB::setSongRate(const QString url, int rate)
 {
-    // insert or update increment favorites
-    executeSql(QString("INSERT OR REPLACE INTO favorites ( url, changedate, rate ) VALUES ( '%1', strftime('%s', 'now'), %2 );")
-                   .arg(escapeString(url))
-                   .arg(rate));
+    StatisticsJournal::instance()->setRate(url, rate);
 }
 
 void CollectionDB::resetSongCounter()
 {
-    executeSql(QString("DELETE FROM statistics;"));
+    StatisticsJournal::instance()->resetPlays();
     //executeSql( QString( "VACUUM;"));
 }
 
@@ -221,6 +254,8 @@ void CollectionDB::removeSongsInDir(QString path)
 
     executeSql(QString("DELETE FROM tags WHERE dir = '%1';")
                    .arg(escapeString(path)));
+    TrackIndex::instance()->invalidate();
+    invalidateCatalogue();
 }
 
 bool CollectionDB::isDirInCollection(QString path)
@@ -251,38 +286,57 @@ void CollectionDB::removePlaylist(QString name)
 
 long CollectionDB::selectSqlNumber(const QString& statement)
 {
+    TraceZone zone("sql", "selectSqlNumber");
+    if (zone.isActive())
+        zone.setDetail(statement);
+    QElapsedTimer timer;
+    timer.start();
     p->mutex.lock();
+    qint64 waited = timer.nsecsElapsed();
 
+    long ret = -1;
     if (p->query->exec(statement)) {
-        while (p->query->next()) {
-            p->mutex.unlock();
-            return p->query->value(0).toInt();
-        }
+        if (p->query->next())
+            ret = p->query->value(0).toInt();
     } else
         qDebug() << p->query->lastError();
+
+    p->profile(statement, timer, waited, ret < 0 ? 0 : 1);
     p->mutex.unlock();
-    return -1;
+    return ret;
 }
 
 bool CollectionDB::executeSql(const QString& statement)
 {
+    TraceZone zone("sql", "executeSql");
+    if (zone.isActive())
+        zone.setDetail(statement);
+    QElapsedTimer timer;
+    timer.start();
     p->mutex.lock();
+    qint64 waited = timer.nsecsElapsed();
 
-    if (p->query->exec(statement)) {
-        p->mutex.unlock();
-        return true;
-    } else {
+    bool ret = p->query->exec(statement);
+    if (!ret) {
         qDebug() << p->query->lastError();
         qDebug() << "Statement: " << statement;
-        p->mutex.unlock();
-        return false;
     }
+
+    p->profile(statement, timer, waited, ret ? p->query->numRowsAffected() : 0);
+    p->mutex.unlock();
+    return ret;
 }
 
 QList<QStringList> CollectionDB::selectSql(const QString& statement)
 {
+    TraceZone zone("sql", "selectSql");
+    if (zone.isActive())
+        zone.setDetail(statement);
     QList<QStringList> tags;
+    QElapsedTimer timer;
+    timer.start();
     p->mutex.lock();
+    qint64 waited = timer.nsecsElapsed();
     tags.clear();
     int count;
 
@@ -301,6 +355,7 @@ QList<QStringList> CollectionDB::selectSql(const QString& statement)
         qDebug() << "SQL-query: " << statement;
     }
 
+    p->profile(statement, timer, waited, tags.count());
     p->mutex.unlock();
     return tags;
 }
@@ -396,6 +451,10 @@ void CollectionDB::dropTables(bool temporary)
 
     // force to re-read over all count for random entry
     p->resultCount = 0;
+    if (!temporary) {
+        TrackIndex::instance()->invalidate();
+        invalidateCatalogue();
+    }
 }
 
 void CollectionDB::moveTempTables()
@@ -406,17 +465,103 @@ void CollectionDB::moveTempTables()
     executeSql("INSERT INTO genre SELECT * FROM genre_temp;");
     executeSql("INSERT INTO year SELECT * FROM year_temp;");
 
-    // Re-create index to be fast as possible
-    executeSql(QString("REINDEX album_idx;"));
-    executeSql(QString("REINDEX artist_idx;"));
-    executeSql(QString("REINDEX genre_idx;"));
-    executeSql(QString("REINDEX year_idx;"));
-    executeSql(QString("REINDEX url_idx;"));
-    executeSql(QString("REINDEX album_tag;"));
-    executeSql(QString("REINDEX artist_tag;"));
-    executeSql(QString("REINDEX genre_tag;"));
-    executeSql(QString("REINDEX year_tag;"));
-    executeSql(QString("REINDEX url_tag;"));
+    // Re-create index to be fast as possible,
+    // by table as index names change with every shadow build
+    executeSql(QString("REINDEX tags;"));
+    executeSql(QString("REINDEX album;"));
+    executeSql(QString("REINDEX artist;"));
+    executeSql(QString("REINDEX genre;"));
+    executeSql(QString("REINDEX year;"));
+
+    TrackIndex::instance()->invalidate();
+    invalidateCatalogue();
+}
+
+/*
+ *  A full rescan builds the catalogue into *_shadow tables while the live
+ *  tables stay untouched, readers keep seeing the old catalogue until
+ *  swapShadowTables() renames the new tables in one short transaction.
+ */
+void CollectionDB::createShadowTables()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    // leftovers of an interrupted build
+    dropShadowTables();
+
+    executeSql("CREATE TABLE tags_shadow ("
+               "id INTEGER PRIMARY KEY,"
+               "url VARCHAR(120),"
+               "dir VARCHAR(100),"
+               "artist INTEGER,"
+               "title VARCHAR(100),"
+               "album INTEGER,"
+               "genre INTEGER,"
+               "year INTEGER,"
+               "length INTEGER,"
+               "track NUMBER(4) );");
+
+    foreach (QString table, QStringList() << "album" << "artist" << "genre" << "year")
+        executeSql(QString("CREATE TABLE %1_shadow ("
+                           "id INTEGER PRIMARY KEY,"
+                           "name VARCHAR(100) );")
+                       .arg(table));
+}
+
+void CollectionDB::createShadowIndexes()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    // created after the bulk load, named uniquely as the live tables
+    // still own their indexes until the swap
+    QString generation = QString::number(QDateTime::currentDateTime().toTime_t());
+
+    foreach (QString table, QStringList() << "album" << "artist" << "genre" << "year") {
+        executeSql(QString("CREATE INDEX %1_idx_%2 ON %1_shadow( name );")
+                       .arg(table)
+                       .arg(generation));
+        executeSql(QString("CREATE INDEX %1_tag_%2 ON tags_shadow( %1 );")
+                       .arg(table)
+                       .arg(generation));
+    }
+    executeSql(QString("CREATE INDEX url_idx_%1 ON tags_shadow( url );").arg(generation));
+    executeSql("ANALYZE;");
+}
+
+bool CollectionDB::swapShadowTables()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    QStringList tables = QStringList() << "tags" << "album" << "artist" << "genre" << "year";
+    bool ok = executeSql("BEGIN TRANSACTION;");
+
+    foreach (QString table, tables) {
+        if (!ok)
+            break;
+        ok = executeSql(QString("DROP TABLE IF EXISTS %1;").arg(table))
+            && executeSql(QString("ALTER TABLE %1_shadow RENAME TO %1;").arg(table));
+    }
+
+    if (ok)
+        ok = executeSql("END TRANSACTION;");
+    if (!ok) {
+        executeSql("ROLLBACK TRANSACTION;");
+        qWarning() << Q_FUNC_INFO << "keeping the old catalogue";
+    }
+
+    // force to re-read over all count for random entry
+    p->resultCount = 0;
+    if (ok) {
+        TrackIndex::instance()->invalidate();
+        invalidateCatalogue();
+    }
+    return ok;
+}
+
+void CollectionDB::dropShadowTables()
+{
+    foreach (QString table, QStringList() << "tags" << "album" << "artist" << "genre" << "year")
+        executeSql(QString("DROP TABLE IF EXISTS %1_shadow;").arg(table));
 }
 
 void CollectionDB::createStatsTable()
@@ -456,6 +601,117 @@ void CollectionDB::dropStatsTable()
     executeSql("DROP TABLE playlists;");
 }
 
+/*
+ *  analysis caches the gain and silence markers TrackAnalyser found, with
+ *  the modification time of the file. knowthelist-analyse fills it ahead,
+ *  the decks skip analysing unchanged files. Its tempo runs add the
+ *  features SimilarityIndex searches.
+ */
+bool CollectionDB::hasAnalysisFeatures()
+{
+    // no rows if the table is missing, tables of older versions miss the features
+    foreach (const QStringList& row, selectSql("PRAGMA table_info(analysis);"))
+        if (row.count() > 1 && row.at(1) == "features")
+            return true;
+    return false;
+}
+
+bool CollectionDB::hasTrackFeatures()
+{
+    return hasAnalysisFeatures()
+        && selectSqlNumber("SELECT count(*) FROM (SELECT 1 FROM analysis WHERE features IS NOT NULL LIMIT 1);") > 0;
+}
+
+void CollectionDB::createAnalysisTable()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    executeSql(QString("CREATE TABLE IF NOT EXISTS analysis ("
+                       "url VARCHAR(120) UNIQUE,"
+                       "changedate INTEGER,"
+                       "gain REAL,"
+                       "start INTEGER,"
+                       "end INTEGER,"
+                       "length INTEGER,"
+                       "bpm INTEGER,"
+                       "features TEXT );"));
+    if (!hasAnalysisFeatures())
+        executeSql("ALTER TABLE analysis ADD COLUMN features TEXT;");
+}
+
+void CollectionDB::storeAnalysis(const QString& url, long changedate, double gain, int start, int end, int length, int bpm, const QString& features)
+{
+    executeSql(QString("REPLACE INTO analysis ( url, changedate, gain, start, end, length, bpm, features ) "
+                       "VALUES ( '%1', %2, %3, %4, %5, %6, %7, %8 );")
+                   .arg(escapeString(url))
+                   .arg(changedate)
+                   .arg(gain, 0, 'f', 4)
+                   .arg(start)
+                   .arg(end)
+                   .arg(length)
+                   .arg(bpm)
+                   .arg(features.isEmpty() ? QString("NULL") : "'" + escapeString(features) + "'"));
+    if (!features.isEmpty())
+        SimilarityIndex::instance()->invalidate();
+}
+
+QStringList CollectionDB::selectAnalysis(const QString& url)
+{
+    QList<QStringList> rows = selectSql(QString("SELECT changedate, gain, start, end, length, bpm, features "
+                                                "FROM analysis WHERE url = '%1';")
+                                            .arg(escapeString(url)));
+    return rows.isEmpty() ? QStringList() : rows.first();
+}
+
+void CollectionDB::invalidateCatalogue()
+{
+    // a snapshot is only used while its stamp matches
+    executeSql("PRAGMA user_version = 0;");
+    CatalogueSnapshot::instance()->invalidate();
+}
+
+QList<QStringList> CollectionDB::selectTrackRows(const QString& statement)
+{
+    // no commit of the journal between the query and the overlay, it would count twice
+    QReadLocker locker(StatisticsJournal::instance()->commitLock());
+    QList<QStringList> rows = selectSql(statement);
+    StatisticsJournal::instance()->overlay(rows);
+    return rows;
+}
+
+void CollectionDB::overlayStatistics(QList<QStringList>& rows)
+{
+    // the snapshot is written after a scan only, its rows carry no statistics
+    QHash<QString, int> positions;
+    for (int i = 0; i < rows.count(); i++) {
+        if (rows.at(i).count() >= 10)
+            positions.insert(rows.at(i).at(0), i);
+    }
+
+    // a few hundred urls per query keep the statement small
+    QReadLocker locker(StatisticsJournal::instance()->commitLock());
+    QStringList urls = positions.keys();
+    for (int i = 0; i < urls.count(); i += 500) {
+        QStringList keys;
+        foreach (const QString& url, urls.mid(i, 500))
+            keys << "'" + escapeString(url) + "'";
+        QString list = keys.join(",");
+        QList<QStringList> stats = selectSql("SELECT url, playcounter, NULL FROM statistics WHERE url IN (" + list + ") "
+                                             "UNION ALL "
+                                             "SELECT url, NULL, rate FROM favorites WHERE url IN (" + list + ");");
+        foreach (const QStringList& stat, stats) {
+            if (stat.count() < 3 || !positions.contains(stat.at(0)))
+                continue;
+            QStringList& row = rows[positions.value(stat.at(0))];
+            if (!stat.at(1).isEmpty())
+                row[8] = stat.at(1);
+            if (!stat.at(2).isEmpty())
+                row[9] = stat.at(2);
+        }
+    }
+    StatisticsJournal::instance()->overlay(rows);
+}
+
 void CollectionDB::purgeDirCache()
 {
     executeSql(QString("DELETE FROM directories;"));
@@ -485,15 +741,13 @@ ulong CollectionDB::getValueID(QString name, QString value, bool autocreate, boo
     return id;
 }
 
-QStringList CollectionDB::getRandomEntry(QString path, QString genre, QString artist)
+uint CollectionDB::updateMatch(QString path, QString genre, QString artist)
 {
-
-    // retrieve Max_Count
-
     if (genre != p->lastGenre
         || artist != p->lastArtist
         || path != p->lastPath
-        || p->resultCount == 0) {
+        || p->resultCount == 0
+        || p->lastGeneration != TrackIndex::instance()->generation()) {
         //new filter > get new count
         p->lastGenre = genre;
         p->lastArtist = artist;
@@ -501,11 +755,38 @@ QStringList CollectionDB::getRandomEntry(QString path, QString genre, QString ar
 
         p->resultCount = getCount(path, genre, artist);
     }
+    return p->resultCount;
+}
+
+QStringList CollectionDB::getRandomEntry(QString path, QString genre, QString artist)
+{
+
+    // retrieve Max_Count
+    updateMatch(path, genre, artist);
 
     if (p->resultCount > 0) {
-        long randomID = (qrand() % p->resultCount);
-        //qebug() << QString::number(randomID);
-        QList<QStringList> entries = selectRandomEntry(QString::number(randomID), path, genre, artist);
+        // pick by weight or by rank in the matching tracks, then fetch the row by its key
+        quint32 ordinal;
+        if (TrackWeights::instance()->isEnabled())
+            ordinal = TrackWeights::instance()->draw(this, path + "\t" + genre + "\t" + artist, p->lastMatch, 1).value(0);
+        else
+            ordinal = p->lastMatch.select(p->randomBelow(p->resultCount));
+        int id = TrackIndex::instance()->trackId(ordinal);
+
+        QList<QStringList> entries;
+        QStringList entry;
+        if (p->sqlQuickFilter.isEmpty() && CatalogueSnapshot::instance()->selectTrackById(id, entry)) {
+            if (!entry.isEmpty())
+                entries << entry;
+            overlayStatistics(entries);
+            return entries.isEmpty() ? QStringList() : entries.at(0);
+        }
+
+        QString command = "SELECT tags.url, artist.name, tags.title, album.name, year.name, genre.name, tags.track, tags.length, statistics.playcounter, favorites.rate "
+            + p->sqlFromString
+            + p->sqlQuickFilter
+            + " AND tags.id = " + QString::number(id) + " LIMIT 1;";
+        entries = selectTrackRows(command);
 
         if (!entries.isEmpty())
             return entries.at(0);
@@ -517,20 +798,82 @@ QStringList CollectionDB::getRandomEntry(QString path, QString genre, QString ar
     }
 }
 
-QStringList CollectionDB::getRandomEntry()
+QList<QStringList> CollectionDB::getRandomEntries(QString path, QString genre, QString artist, int count)
 {
-    double randMax;
+    QList<QStringList> entries;
+    uint matches = updateMatch(path, genre, artist);
+    if (matches == 0 || count <= 0) {
+        qDebug() << Q_FUNC_INFO << " No Track found matching filter";
+        return entries;
+    }
 
-    randMax = RAND_MAX;
+    QList<int> ids;
+    if (TrackWeights::instance()->isEnabled()) {
+        // distinct tracks by rating, play count and recency from the alias table of the filter
+        QString key = path + "\t" + genre + "\t" + artist;
+        foreach (quint32 ordinal, TrackWeights::instance()->draw(this, key, p->lastMatch, count))
+            ids.append(TrackIndex::instance()->trackId(ordinal));
+    } else {
+        // distinct ranks in the matching tracks by Floyd's sampling, one pass
+        uint wanted = qMin(uint(count), matches);
+        QSet<quint32> ranks;
+        ranks.reserve(wanted);
+        for (quint32 j = matches - wanted; j < matches; j++) {
+            quint32 rank = p->randomBelow(j + 1);
+            ranks.insert(ranks.contains(rank) ? j : rank);
+        }
+        foreach (quint32 rank, ranks)
+            ids.append(TrackIndex::instance()->trackId(p->lastMatch.select(rank)));
+    }
+
+    bool fromSnapshot = p->sqlQuickFilter.isEmpty();
+    foreach (int id, ids) {
+        QStringList entry;
+        if (!fromSnapshot || !CatalogueSnapshot::instance()->selectTrackById(id, entry)) {
+            fromSnapshot = false;
+            break;
+        }
+        if (!entry.isEmpty())
+            entries << entry;
+    }
+
+    if (fromSnapshot) {
+        overlayStatistics(entries);
+    } else {
+        QStringList keys;
+        foreach (int id, ids)
+            keys << QString::number(id);
+        QString command = "SELECT tags.url, artist.name, tags.title, album.name, year.name, genre.name, tags.track, tags.length, statistics.playcounter, favorites.rate "
+            + p->sqlFromString
+            + p->sqlQuickFilter
+            + " AND tags.id IN (" + keys.join(",") + ");";
+        entries = selectTrackRows(command);
+    }
+
+    // neither the set nor the query keep the random order
+    for (int i = entries.count() - 1; i > 0; i--)
+        entries.swap(i, p->randomBelow(i + 1));
+    return entries;
+}
 
+QStringList CollectionDB::getRandomEntry()
+{
     if (p->filterString != p->lastFilterString || p->resultCount == 0) {
         //new genre > get new count
         p->lastFilterString = p->filterString;
         p->resultCount = getCount();
     }
 
-    long randomID = (qrand() / randMax) * p->resultCount;
+    long randomID = p->resultCount > 0 ? p->randomBelow(p->resultCount) : 0;
     //qDebug() << QString::number(randomID);
+    QStringList entry;
+    if (p->sqlQuickFilter.isEmpty() && CatalogueSnapshot::instance()->selectTrackAt(randomID, entry)) {
+        QList<QStringList> entries;
+        if (!entry.isEmpty())
+            entries << entry;
+        overlayStatistics(entries);
+        return entries.isEmpty() ? QStringList() : entries.at(0);
+    }
     QList<QStringList> entries = selectRandomEntry(QString::number(randomID));
 
     if (!entries.isEmpty())
@@ -541,6 +884,12 @@ QStringList CollectionDB::getRandomEntry()
 
 ulong CollectionDB::getCount()
 {
+    if (p->sqlQuickFilter.isEmpty()) {
+        int count = CatalogueSnapshot::instance()->trackCount();
+        if (count >= 0)
+            return count;
+    }
+
     QString command = "SELECT count(distinct tags.url) "
         + p->sqlFromString
         + p->sqlQuickFilter;
@@ -550,33 +899,33 @@ ulong CollectionDB::getCount()
 
 QPair<int, int> CollectionDB::getCount(QStringList paths, QStringList genres, QStringList artists)
 {
-    QString command = "SELECT count(distinct tags.url), sum(tags.length)  FROM tags, artist, genre "
-                      " WHERE tags.artist = artist.id "
-                      " AND tags.artist = artist.id "
-                      " AND tags.genre = genre.id "
-        + p->selectionFilterForRandom(paths, genres, artists) + ";";
+    TrackBitmap tracks = TrackIndex::instance()->match(this, paths, genres, artists);
 
-    QStringList result = selectSql(command).at(0);
     QPair<int, int> pair;
-    pair.first = result[0].toInt();
-    pair.second = result[1].toInt();
+    pair.first = tracks.cardinality();
+    pair.second = TrackIndex::instance()->lengthSum(tracks);
 
     return pair;
 }
 
 uint CollectionDB::getCount(QString path, QString genre, QString artist)
 {
-    QString command = "SELECT count(distinct tags.url), sum(tags.length)  FROM tags, artist, genre "
-                      " WHERE tags.artist = artist.id "
-                      " AND tags.artist = artist.id "
-                      " AND tags.genre = genre.id "
-        + p->selectionFilterForRandom(path, genre, artist) + ";";
+    // the matching tracks are kept for the random pick of getRandomEntry
+    p->lastGeneration = TrackIndex::instance()->generation();
+    p->lastMatch = matchTracks(path, genre, artist);
+    p->resultLength = TrackIndex::instance()->lengthSum(p->lastMatch);
 
-    QStringList result = selectSql(command).at(0);
+    return p->lastMatch.cardinality();
+}
 
-    p->resultLength = result[1].toLong();
+TrackBitmap CollectionDB::matchTracks(QString path, QString genre, QString artist)
+{
+    return TrackIndex::instance()->match(this, path, genre, artist);
+}
 
-    return result[0].toLong();
+long CollectionDB::lengthSum(const TrackBitmap& tracks)
+{
+    return TrackIndex::instance()->lengthSum(tracks);
 }
 
 long CollectionDB::lastLengthSum()
@@ -596,11 +945,16 @@ QList<QStringList> CollectionDB::selectRandomEntry(QString rownum, QString path,
         + p->sqlQuickFilter
         + p->selectionFilterForRandom(path, genre, artist) + " LIMIT 1 OFFSET " + rownum + ";";
 
-    return selectSql(command);
+    QList<QStringList> rows = selectTrackRows(command);
+    return rows;
 }
 
 QList<QStringList> CollectionDB::selectYears()
 {
+    QList<QStringList> rows;
+    if (p->sqlQuickFilter.isEmpty() && CatalogueSnapshot::instance()->selectNames(CatalogueSnapshot::Year, rows))
+        return rows;
+
     QString command = "SELECT DISTINCT year.name "
         + p->sqlFromString
         + p->sqlQuickFilter + "AND year.name <> '' "
@@ -611,6 +965,10 @@ QList<QStringList> CollectionDB::selectYears()
 
 QList<QStringList> CollectionDB::selectGenres()
 {
+    QList<QStringList> rows;
+    if (p->sqlQuickFilter.isEmpty() && CatalogueSnapshot::instance()->selectNames(CatalogueSnapshot::Genre, rows))
+        return rows;
+
     QString command = "SELECT DISTINCT genre.name "
         + p->sqlFromString
         + p->sqlQuickFilter + "AND genre.name <> '' "
@@ -621,6 +979,10 @@ QList<QStringList> CollectionDB::selectGenres()
 
 QList<QStringList> CollectionDB::selectArtists(QString year, QString genre)
 {
+    QList<QStringList> rows;
+    if (p->sqlQuickFilter.isEmpty() && CatalogueSnapshot::instance()->selectNames(CatalogueSnapshot::Artist, rows, year, genre))
+        return rows;
+
     QString command = "SELECT DISTINCT artist.name "
         + p->sqlFromString
         + p->sqlQuickFilter
@@ -632,6 +994,9 @@ QList<QStringList> CollectionDB::selectArtists(QString year, QString genre)
 
 QList<QStringList> CollectionDB::selectAlbums(QString year, QString genre, QString artist)
 {
+    QList<QStringList> rows;
+    if (p->sqlQuickFilter.isEmpty() && CatalogueSnapshot::instance()->selectNames(CatalogueSnapshot::Album, rows, year, genre, artist))
+        return rows;
 
     QString command = "SELECT DISTINCT album.name "
         + p->sqlFromString
@@ -644,16 +1009,26 @@ QList<QStringList> CollectionDB::selectAlbums(QString year, QString genre, QStri
 
 QList<QStringList> CollectionDB::selectTracks(QString year, QString genre, QString artist, QString album)
 {
+    QList<QStringList> rows;
+    if (p->sqlQuickFilter.isEmpty() && CatalogueSnapshot::instance()->selectTracks(rows, year, genre, artist, album)) {
+        overlayStatistics(rows);
+        return rows;
+    }
+
     QString command = "SELECT DISTINCT tags.url, artist.name, tags.title, album.name, year.name, genre.name, tags.track, tags.length, statistics.playcounter, favorites.rate "
         + p->sqlFromString
         + p->sqlQuickFilter
         + p->selectionFilter(year, genre, artist, album) + "ORDER BY artist.name DESC, album.name DESC, tags.track;";
 
-    return selectSql(command);
+    rows = selectTrackRows(command);
+    return rows;
 }
 
 QList<QStringList> CollectionDB::selectHotTracks()
 {
+    // these lists are ordered by the statistics, write pending changes first
+    StatisticsJournal::instance()->sync();
+
     QString command = "SELECT DISTINCT tags.url, artist.name, tags.title, album.name, year.name, genre.name, tags.track, tags.length, statistics.playcounter, favorites.rate "
         + p->sqlFromString + "AND statistics.playcounter>0 "
                              "ORDER BY statistics.playcounter DESC "
@@ -662,8 +1037,35 @@ QList<QStringList> CollectionDB::selectHotTracks()
     return selectSql(command);
 }
 
+QList<QStringList> CollectionDB::selectSimilarTracks(const QString& url, int count)
+{
+    QList<QStringList> ret;
+    QStringList urls = SimilarityIndex::instance()->similar(this, url, count);
+    if (urls.isEmpty())
+        return ret;
+
+    QStringList keys;
+    foreach (const QString& similar, urls)
+        keys << "'" + escapeString(similar) + "'";
+    QString command = "SELECT DISTINCT tags.url, artist.name, tags.title, album.name, year.name, genre.name, tags.track, tags.length, statistics.playcounter, favorites.rate "
+        + p->sqlFromString
+        + "AND tags.url IN (" + keys.join(",") + ");";
+    QList<QStringList> rows = selectTrackRows(command);
+
+    // nearest first, as the index found them
+    QHash<QString, QStringList> byUrl;
+    foreach (const QStringList& row, rows)
+        byUrl.insert(row.at(0), row);
+    foreach (const QString& similar, urls)
+        if (byUrl.contains(similar))
+            ret << byUrl.value(similar);
+    return ret;
+}
+
 QList<QStringList> CollectionDB::selectLastTracks()
 {
+    StatisticsJournal::instance()->sync();
+
     QString command = "SELECT DISTINCT tags.url, artist.name, tags.title, album.name, year.name, genre.name, tags.track, tags.length, statistics.playcounter, favorites.rate "
         + p->sqlFromString + "AND statistics.playcounter>0 "
                              "ORDER BY statistics.accessdate DESC "
@@ -674,6 +1076,8 @@ QList<QStringList> CollectionDB::selectLastTracks()
 
 QList<QStringList> CollectionDB::selectFavoritesTracks()
 {
+    StatisticsJournal::instance()->sync();
+
     QString command = "SELECT DISTINCT tags.url, artist.name, tags.title, album.name, year.name, genre.name, tags.track, tags.length, statistics.playcounter, favorites.rate "
         + p->sqlFromString + "AND favorites.rate>0 "
                              "ORDER BY favorites.rate DESC ";
@@ -698,5 +1102,6 @@ QList<QStringList> CollectionDB::selectPlaylistTracks(QString name)
         + p->sqlFromStringPL + "AND playlists.name ='" + escapeString(name) + "' "
                                                                               "ORDER BY playlists.norder";
 
-    return selectSql(command);
+    QList<QStringList> rows = selectTrackRows(command);
+    return rows;
 }
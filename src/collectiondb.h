@@ -18,7 +18,7 @@
 #ifndef COLLECTIONDB_H
 #define COLLECTIONDB_H
 
-#include "progressbar.h"
+#include "trackindex.h"
 #include <QtSql>
 #include <qdir.h>
 #include <qobject.h>
@@ -56,18 +56,36 @@ public:
     ulong getCount();
     uint getCount(QString path, QString genre, QString artist);
     QPair<int, int> getCount(QStringList paths, QStringList genres, QStringList artists);
+    TrackBitmap matchTracks(QString path, QString genre, QString artist);
+    long lengthSum(const TrackBitmap& tracks);
     long lastLengthSum();
     uint lastMaxCount();
 
     QList<QStringList> selectRandomEntry(QString rownum, QString path = "", QString genre = "", QString artist = "");
     QStringList getRandomEntry();
     QStringList getRandomEntry(QString path, QString genre, QString artist);
+    /** Up to count distinct random tracks of the filter, in random order, in one query */
+    QList<QStringList> getRandomEntries(QString path, QString genre, QString artist, int count);
 
     void createTables(const bool temporary = false);
     void dropTables(const bool temporary = false);
     void moveTempTables();
+    void createShadowTables();
+    void createShadowIndexes();
+    bool swapShadowTables();
+    void dropShadowTables();
     void createStatsTable();
     void dropStatsTable();
+    /** The analysis table exists with the features column of this version */
+    bool hasAnalysisFeatures();
+    /** Some track has features to search similar tracks by, from knowthelist-analyse --tempo */
+    bool hasTrackFeatures();
+    void createAnalysisTable();
+
+    /** Results of TrackAnalyser, times in milliseconds, features as TrackFeatures::toString() */
+    void storeAnalysis(const QString& url, long changedate, double gain, int start, int end, int length, int bpm, const QString& features = QString());
+    /** changedate, gain, start, end, length, bpm and features, empty if not analysed */
+    QStringList selectAnalysis(const QString& url);
     void resetSongCounter();
 
     void purgeDirCache();
@@ -80,6 +98,8 @@ public:
     QList<QStringList> selectYears();
     QList<QStringList> selectGenres();
     QList<QStringList> selectHotTracks();
+    /** Up to count tracks that sound like url, nearest first */
+    QList<QStringList> selectSimilarTracks(const QString& url, int count);
     QList<QStringList> selectLastTracks();
     QList<QStringList> selectFavoritesTracks();
     QList<QStringList> selectPlaylistData();
@@ -91,9 +111,15 @@ signals:
 private slots:
 
 private:
+    void invalidateCatalogue();
+    /** Track rows of statement with the journal's pending changes */
+    QList<QStringList> selectTrackRows(const QString& statement);
+    /** Fill play counter and rate of snapshot rows from the statistics tables and the journal */
+    void overlayStatistics(QList<QStringList>& rows);
+    /** Matches the filter unless it is the last one, returns the count */
+    uint updateMatch(QString path, QString genre, QString artist);
     struct CollectionDbPrivate* p;
     QSqlDatabase db;
-    ProgressBar* m_progress;
     bool m_monitor;
     int m_lastInsertId;
 };
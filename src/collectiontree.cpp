@@ -17,6 +17,7 @@
 
 #include "collectiontree.h"
 #include "collectiontreeitem.h"
+#include "covercache.h"
 #include <QApplication>
 #include <QHeaderView>
 #include <QMenu>
@@ -31,9 +32,22 @@
 
 struct CollectionTreePrivate {
     CollectionDB* database;
+    // owned by the GUI thread, the workers hand over rows only
     QList<Track*> tracks;
     QString filterString;
+    // serializes the workers, canceled once the tree goes away
     QMutex mutex;
+    bool canceled;
+    QList<QFuture<void> > workers;
+
+    void start(const QFuture<void>& future)
+    {
+        for (int i = workers.count() - 1; i >= 0; i--) {
+            if (workers.at(i).isFinished())
+                workers.removeAt(i);
+        }
+        workers.append(future);
+    }
 };
 
 CollectionTree::CollectionTree(QWidget* parent)
@@ -43,6 +57,11 @@ CollectionTree::CollectionTree(QWidget* parent)
 
     p->database = new CollectionDB();
     p->database->executeSql("PRAGMA synchronous = OFF;");
+    p->canceled = false;
+
+    qRegisterMetaType<QList<QStringList> >("QList<QStringList>");
+    connect(this, SIGNAL(tracksFound(QList<QStringList>)),
+        this, SLOT(showTracks(QList<QStringList>)), Qt::QueuedConnection);
 
     setSelectionMode(QAbstractItemView::ExtendedSelection);
     setDragEnabled(true);
@@ -72,7 +91,14 @@ CollectionTree::CollectionTree(QWidget* parent)
 
 CollectionTree::~CollectionTree()
 {
-    p->mutex.tryLock(2000);
+    // the workers use the database and emit to this tree, let them finish
+    p->mutex.lock();
+    p->canceled = true;
+    p->mutex.unlock();
+    foreach (QFuture<void> future, p->workers)
+        future.waitForFinished();
+
+    qDeleteAll(p->tracks);
     delete p;
 }
 
@@ -170,61 +196,70 @@ void CollectionTree::on_itemExpanded(QTreeWidgetItem* item)
 
 void CollectionTree::triggerRandomSelection()
 {
-    QFuture<void> future = QtConcurrent::run(this, &CollectionTree::asynchronTriggerRandomSelection);
+    p->start(QtConcurrent::run(this, &CollectionTree::asynchronTriggerRandomSelection));
 }
 
 void CollectionTree::asynchronTriggerRandomSelection()
 {
     QMutexLocker locker(&p->mutex);
-    p->tracks.clear();
+    if (p->canceled)
+        return;
 
     // init qrand
     QTime time = QTime::currentTime();
     qsrand((uint)time.msec());
 
+    QList<QStringList> tags;
     for (int i = 0; i < 15; i++) {
 
-        Track* track;
+        QStringList tag;
         int r = 0;
 
         do {
-            QStringList tag = p->database->getRandomEntry();
-            track = new Track(tag);
+            tag = p->database->getRandomEntry();
             r++;
-        } while (track->prettyLength() == "?" && r < 3);
+        } while (Track(tag).prettyLength() == "?" && r < 3);
 
-        p->tracks.append(track);
+        tags.append(tag);
     }
 
-    qDebug() << Q_FUNC_INFO << p->tracks.count();
-    emit selectionChanged(p->tracks);
+    qDebug() << Q_FUNC_INFO << tags.count();
+    emit tracksFound(tags);
 }
 
 void CollectionTree::on_currentItemChanged(QTreeWidgetItem* item)
 {
-    QFuture<void> future = QtConcurrent::run(this, &CollectionTree::asynchronCurrentItemChanged, item);
+    if (!item)
+        return;
+
+    // copy the filter, createTrunk() may delete the item while the worker runs
+    CollectionTreeItem* collItem = static_cast<CollectionTreeItem*>(item);
+    p->start(QtConcurrent::run(this, &CollectionTree::asynchronCurrentItemChanged,
+        collItem->year(), collItem->genre(), collItem->artist(), collItem->album()));
 }
 
-void CollectionTree::asynchronCurrentItemChanged(QTreeWidgetItem* item)
+void CollectionTree::asynchronCurrentItemChanged(QString year, QString genre, QString artist, QString album)
 {
     QMutexLocker locker(&p->mutex);
-
-    if (!item)
+    if (p->canceled)
         return;
 
-    QList<QStringList> tags;
-
-    CollectionTreeItem* collItem = static_cast<CollectionTreeItem*>(item);
-    qDebug() << Q_FUNC_INFO << "Artist: " << collItem->artist() << " Album: " << collItem->album() << endl;
+    qDebug() << Q_FUNC_INFO << "Artist: " << artist << " Album: " << album << endl;
 
     //Retrieve songs from database
-    tags = p->database->selectTracks(collItem->year(), collItem->genre(), collItem->artist(), collItem->album());
-
-    //Show songs in parent's tracklist
-    p->tracks.clear();
+    QList<QStringList> tags = p->database->selectTracks(year, genre, artist, album);
 
     qDebug() << Q_FUNC_INFO << "Song count: " << tags.count();
 
+    emit tracksFound(tags);
+}
+
+void CollectionTree::showTracks(QList<QStringList> tags)
+{
+    //Show songs in parent's tracklist, receivers have copied the previous ones
+    qDeleteAll(p->tracks);
+    p->tracks.clear();
+
     //add tags to this track list
     foreach (QStringList tag, tags) {
         //qDebug() << Q_FUNC_INFO <<": is playlistitem; tags:"<<tags;
@@ -232,8 +267,6 @@ void CollectionTree::asynchronCurrentItemChanged(QTreeWidgetItem* item)
     }
 
     emit selectionChanged(p->tracks);
-
-    //qDebug() << Q_FUNC_INFO << "[End]" << endl;
 }
 
 QString CollectionTree::filter()
@@ -287,8 +320,12 @@ void CollectionTree::performDrag()
             qDebug() << Q_FUNC_INFO << ": send Data:" << track->url();
             QStringList tag = track->tagList();
             tags << tag;
-            if (i == 0)
-                cover = QPixmap::fromImage(track->coverImage());
+            if (i == 0) {
+                QImage image;
+                if (!CoverCache::instance()->findCover(track->url(), image) || image.isNull())
+                    image = track->defaultImage();
+                cover = QPixmap::fromImage(image);
+            }
             i++;
         }
     }
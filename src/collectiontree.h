@@ -40,6 +40,7 @@ Q_SIGNALS:
     void selectionChanged(QList<Track*>);
     void wantLoad(QList<Track*>, QString);
     void rescan();
+    void tracksFound(QList<QStringList>);
     
 public slots:
     void on_currentItemChanged( QTreeWidgetItem* item );
@@ -53,6 +54,8 @@ public slots:
     void onLoad1Triggered();
     void onLoad2Triggered();
 
+private slots:
+    void showTracks(QList<QStringList> tags);
 
 private:
     class CollectionTreePrivate * p;
@@ -65,7 +68,7 @@ private:
     bool openContext;
     bool m_dragLocked;
     void showTrackInfo( Track* mb );
-    void asynchronCurrentItemChanged( QTreeWidgetItem* item );
+    void asynchronCurrentItemChanged( QString year, QString genre, QString artist, QString album );
 
 };
 
@@ -18,7 +18,20 @@
 
 #include "collectionupdater.h"
 
+#include "cataloguesnapshot.h"
 #include "collectiondb.h"
+#include "tracer.h"
+#include "track.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QSettings>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
 
 #if QT_VERSION >= 0x050000
 #include <QtConcurrent/QtConcurrent>
@@ -38,15 +51,42 @@ public:
     bool incremental;
     CollectionDB* collectionDB;
     QMutex mutex;
+    CollectionUpdater::ScanStatistics statistics;
+    int tagReaders;
 };
 
-CollectionUpdater::CollectionUpdater()
+// reads the tags of a slice of a batch in a pool thread
+class TagReader : public QRunnable {
+public:
+    TagReader(const QStringList& entries, int begin, int end, QVector<Track>& tracks)
+        : m_entries(entries)
+        , m_begin(begin)
+        , m_end(end)
+        , m_tracks(tracks)
+    {
+    }
+    void run()
+    {
+        for (int i = m_begin; i < m_end; i++)
+            m_tracks[i] = Track(QUrl::fromLocalFile(m_entries.at(i)));
+    }
+
+private:
+    const QStringList& m_entries;
+    int m_begin;
+    int m_end;
+    QVector<Track>& m_tracks;
+};
+
+CollectionUpdater::CollectionUpdater(bool automatic)
 {
     p = new CollectionUpdaterPrivate;
+    p->statistics = CollectionUpdater::ScanStatistics();
+    p->tagReaders = 1;
 
     QSettings settings;
 
-    p->doMonitor = settings.value("Monitor").toBool();
+    p->doMonitor = automatic && settings.value("Monitor").toBool();
     p->dirs = settings.value("Dirs").toStringList();
 
     p->collectionDB = new CollectionDB();
@@ -62,14 +102,18 @@ CollectionUpdater::CollectionUpdater()
         p->collectionDB->createTables();
         p->collectionDB->dropStatsTable();
         p->collectionDB->createStatsTable();
-        scan();
+        if (automatic)
+            scan();
     }
+    if (!p->collectionDB->hasAnalysisFeatures())
+        p->collectionDB->createAnalysisTable();
 
     p->timer = new QTimer(this);
     p->timer->setInterval(600000); //1000 * 60 * 10 = 10min
     connect(p->timer, SIGNAL(timeout()), this, SLOT(monitor()));
     if (p->doMonitor) {
-        monitor();
+        // first check once the event loop runs, not while the window is built
+        QTimer::singleShot(0, this, SLOT(monitor()));
         p->timer->start();
     }
 }
@@ -79,6 +123,13 @@ CollectionUpdater::~CollectionUpdater()
     delete p;
 }
 
+CollectionUpdater::ScanStatistics CollectionUpdater::lastScan()
+{
+    // blocks while a scan is running
+    QMutexLocker locker(&p->mutex);
+    return p->statistics;
+}
+
 void CollectionUpdater::setDoMonitor(bool value)
 {
     p->doMonitor = value;
@@ -88,6 +139,11 @@ void CollectionUpdater::setDoMonitor(bool value)
         p->timer->stop();
 }
 
+void CollectionUpdater::setTagReaders(int count)
+{
+    p->tagReaders = qMax(1, count);
+}
+
 void CollectionUpdater::stop()
 {
     p->isStoped = true;
@@ -129,8 +185,11 @@ void CollectionUpdater::monitor()
         }
     }
 
-    if (!folders.isEmpty())
+    // without changes the scan only writes a missing catalogue snapshot
+    if (!folders.isEmpty() || !CatalogueSnapshot::instance()->isValid())
         QFuture<void> future = QtConcurrent::run(this, &CollectionUpdater::asynchronScan, folders);
+    else
+        Q_EMIT scanFinished();
 }
 
 void CollectionUpdater::scan()
@@ -146,6 +205,13 @@ void CollectionUpdater::asynchronScan(QStringList dirs)
 
     // avoid multiple runs
     QMutexLocker locker(&p->mutex);
+    TraceZone zone("scan", "scan");
+    if (zone.isActive())
+        zone.setDetail(dirs.join(", "));
+
+    QElapsedTimer timer;
+    timer.start();
+    p->statistics = CollectionUpdater::ScanStatistics();
 
     Q_EMIT progressChanged(1);
 
@@ -160,15 +226,31 @@ void CollectionUpdater::asynchronScan(QStringList dirs)
         Q_EMIT progressChanged(((i + 1) * 10) / dirCount);
         readDir(dirs[i], entries);
     }
+    p->statistics.walkTime = timer.nsecsElapsed();
+    if (Tracer::isEnabled()) {
+        qint64 now = Tracer::now();
+        Tracer::instance()->complete("scan", "walk", now - p->statistics.walkTime, now);
+    }
+    p->statistics.files = entries.count();
 
     if (!entries.empty()) {
         Q_EMIT progressChanged(10);
         readTags(entries);
     }
+
+    // the browsers and Auto-DJ read the catalogue from the snapshot
+    if (!CatalogueSnapshot::instance()->isValid())
+        CatalogueSnapshot::write(p->collectionDB);
+
+    p->statistics.totalTime = timer.nsecsElapsed();
+    p->statistics.sqlTime = p->statistics.totalTime - p->statistics.walkTime - p->statistics.tagTime;
+    qDebug() << Q_FUNC_INFO << p->statistics.files << "files in" << p->statistics.totalTime / 1000000 << "ms";
+
     Q_EMIT progressChanged(100);
 
     if (!entries.empty())
         Q_EMIT changesDone();
+    Q_EMIT scanFinished();
 }
 
 void CollectionUpdater::readDir(const QString& dir, QStringList& entries)
@@ -202,58 +284,97 @@ void CollectionUpdater::readDir(const QString& dir, QStringList& entries)
 void CollectionUpdater::readTags(const QStringList& entries)
 {
     qDebug() << Q_FUNC_INFO << " Start";
+    TraceZone zone("scan", "readTags");
 
-    QUrl url;
-    p->collectionDB->createTables(true);
+    // a full scan fills the shadow catalogue, an update the temp tables
+    QString table = p->incremental ? "tags_temp" : "tags_shadow";
+    QString suffix = p->incremental ? "" : "_shadow";
+
+    if (p->incremental)
+        p->collectionDB->createTables(true);
+    else
+        p->collectionDB->createShadowTables();
+
+    const int batchSize = 500;
+    QThreadPool pool;
+    pool.setMaxThreadCount(p->tagReaders);
 
     int entriesCount = entries.count();
-    for (int i = 0; i < entriesCount; i++) {
-        if (!(i % 20))
-            Q_EMIT progressChanged(((i * 90) / entriesCount) + 10);
-
-        url = QUrl::fromLocalFile(entries[i]);
-
-        Track track(url);
-
-        if (track.isValid()) {
-
-            QString command = QString("INSERT INTO tags_temp "
-                                      "( url, dir, artist, title, album, genre, year, length, track ) "
-                                      "VALUES('%1','%2',%3,'%4',%5,%6,%7,%8,%9);")
-                                  .arg(p->collectionDB->escapeString(track.url().toLocalFile()))
-                                  .arg(p->collectionDB->escapeString(track.dirPath()))
-                                  .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("artist", track.artist(), true, !p->incremental))))
-                                  .arg(p->collectionDB->escapeString(track.title()))
-                                  .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("album", track.album(), true, !p->incremental))))
-                                  .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("genre", track.genre(), true, !p->incremental))))
-                                  .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("year", track.year(), true, !p->incremental))))
-                                  .arg(p->collectionDB->escapeString(QString::number(track.length())))
-                                  .arg(p->collectionDB->escapeString(track.tracknumber()));
-
-            p->collectionDB->executeSql(command);
-
-            //stop the process?
-            if (p->isStoped)
-                i = entries.count();
+    for (int begin = 0; begin < entriesCount && !p->isStoped; begin += batchSize) {
+        // the tags of a batch are read first, by several threads if wanted
+        QStringList batch = entries.mid(begin, batchSize);
+        QVector<Track> tracks(batch.count());
+        QElapsedTimer tagTimer;
+        tagTimer.start();
+        if (p->tagReaders > 1) {
+            int slice = (batch.count() + p->tagReaders - 1) / p->tagReaders;
+            for (int s = 0; s < batch.count(); s += slice)
+                pool.start(new TagReader(batch, s, qMin(s + slice, batch.count()), tracks));
+            pool.waitForDone();
+        } else {
+            TagReader(batch, 0, batch.count(), tracks).run();
+        }
+        p->statistics.tagTime += tagTimer.nsecsElapsed();
+
+        // one transaction per batch, held only while inserting, not while reading files
+        p->collectionDB->executeSql("BEGIN TRANSACTION;");
+        for (int i = 0; i < tracks.count(); i++) {
+            if (!((begin + i) % 20)) {
+                Q_EMIT progressChanged((((begin + i) * 90) / entriesCount) + 10);
+                if (Tracer::isEnabled())
+                    Tracer::instance()->counter("scan", "files read", begin + i);
+            }
+
+            Track& track = tracks[i];
+            if (track.isValid()) {
+                p->statistics.tracks++;
+
+                QString command = QString("INSERT INTO " + table + " "
+                                          "( url, dir, artist, title, album, genre, year, length, track ) "
+                                          "VALUES('%1','%2',%3,'%4',%5,%6,%7,%8,%9);")
+                                      .arg(p->collectionDB->escapeString(track.url().toLocalFile()))
+                                      .arg(p->collectionDB->escapeString(track.dirPath()))
+                                      .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("artist" + suffix, track.artist()))))
+                                      .arg(p->collectionDB->escapeString(track.title()))
+                                      .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("album" + suffix, track.album()))))
+                                      .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("genre" + suffix, track.genre()))))
+                                      .arg(p->collectionDB->escapeString(QString::number(p->collectionDB->getValueID("year" + suffix, track.year()))))
+                                      .arg(p->collectionDB->escapeString(QString::number(track.length())))
+                                      .arg(p->collectionDB->escapeString(track.tracknumber()));
+
+                p->collectionDB->executeSql(command);
+
+                //stop the process?
+                if (p->isStoped)
+                    break;
+            }
         }
+        p->collectionDB->executeSql("END TRANSACTION;");
     }
 
     qDebug() << Q_FUNC_INFO << " Insert finish";
 
+    TraceZone commitZone("scan", "commitCatalogue");
+
     //update database only if not stoped
-    if (!p->isStoped) {
+    if (p->isStoped) {
+        qDebug() << Q_FUNC_INFO << " Stop";
+        if (p->incremental)
+            p->collectionDB->dropTables(true);
+        else
+            p->collectionDB->dropShadowTables();
+    } else if (!p->incremental) {
+        // index the new catalogue, then swap it in at once
+        p->collectionDB->createShadowIndexes();
+        if (!p->collectionDB->swapShadowTables())
+            p->collectionDB->dropShadowTables();
+    } else {
         // let's lock the database (will block other threads)
         p->collectionDB->executeSql("BEGIN TRANSACTION;");
 
-        // remove tables and recreate them (quicker than DELETE FROM)
-        if (!p->incremental) {
-            p->collectionDB->dropTables();
-            p->collectionDB->createTables();
-        } else {
-            // remove old entries from database, only
-            for (int i = 0; i < p->dirs.count(); i++)
-                p->collectionDB->removeSongsInDir(p->dirs[i]);
-        }
+        // remove old entries from database, only
+        for (int i = 0; i < p->dirs.count(); i++)
+            p->collectionDB->removeSongsInDir(p->dirs[i]);
 
         // rename tables
         p->collectionDB->moveTempTables();
@@ -261,9 +382,6 @@ void CollectionUpdater::readTags(const QStringList& entries)
         // remove temp tables and unlock database
         p->collectionDB->dropTables(true);
         p->collectionDB->executeSql("END TRANSACTION;");
-    } else {
-
-        qDebug() << Q_FUNC_INFO << " Stop";
     }
 
     qDebug() << Q_FUNC_INFO << " End";
@@ -18,9 +18,7 @@
 #ifndef COLLECTIONUPDATER_H
 #define COLLECTIONUPDATER_H
 
-#include "collectionwidget.h"
-#include "collectionupdater.h"
-
+#include <QObject>
 #include <qstringlist.h>
 #include "collectiondb.h"
 
@@ -31,10 +29,24 @@ class CollectionUpdater : public QObject
 
     public:
 
-        CollectionUpdater();
+        /** Counters of the last finished scan, times in nanoseconds */
+        struct ScanStatistics {
+            int files;
+            int tracks;
+            qint64 walkTime;
+            qint64 tagTime;
+            qint64 sqlTime;
+            qint64 totalTime;
+        };
+
+        /** Without automatic, neither the settings nor a rebuilt database start a scan */
+        explicit CollectionUpdater(bool automatic = true);
         ~CollectionUpdater();
+        ScanStatistics lastScan();
         void setDoMonitor(bool);
         void setDirectoryList(QStringList dirs, bool force=false);
+        /** Threads reading the tags of a scan, one by default */
+        void setTagReaders(int count);
 
         QStringList getRandomEntry(QString);
 
@@ -48,6 +60,7 @@ class CollectionUpdater : public QObject
     signals:
         void changesDone();
         void progressChanged(int percent);
+        void scanFinished();
 
 
     private:
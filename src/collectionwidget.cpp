@@ -104,6 +104,7 @@ CollectionWidget::CollectionWidget(QWidget* parent)
     connect(p->searchEdit, SIGNAL(trackDropped(QString)), this,
         SIGNAL(trackDropped(QString)));
 
+    // the playlist copies the tracks, the tree frees them with its next selection
     connect(p->collectiontree, SIGNAL(selectionChanged(QList<Track*>)), this,
         SIGNAL(selectionChanged(QList<Track*>)));
 
@@ -0,0 +1,51 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "commandline.h"
+
+QString CommandLine::option(const QStringList& arguments, const QString& name, const QString& defaultValue)
+{
+    QString key = "--" + name;
+    for (int i = 0; i < arguments.count(); i++) {
+        if (arguments.at(i) == key && i + 1 < arguments.count())
+            return arguments.at(i + 1);
+        if (arguments.at(i).startsWith(key + "="))
+            return arguments.at(i).mid(key.length() + 1);
+    }
+    return defaultValue;
+}
+
+bool CommandLine::hasOption(const QStringList& arguments, const QString& name)
+{
+    return arguments.contains("--" + name);
+}
+
+QStringList CommandLine::positional(const QStringList& arguments, const QStringList& valueOptions)
+{
+    QStringList ret;
+    // the first argument is the program
+    for (int i = 1; i < arguments.count(); i++) {
+        QString argument = arguments.at(i);
+        if (argument.startsWith("--")) {
+            if (!argument.contains("=") && valueOptions.contains(argument.mid(2)))
+                i++;
+            continue;
+        }
+        ret << argument;
+    }
+    return ret;
+}
@@ -0,0 +1,36 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QString>
+#include <QStringList>
+
+/*
+ *  The argument parser of the command line and benchmark tools.
+ */
+class CommandLine {
+public:
+    /** Options of the form --name value or --name=value */
+    static QString option(const QStringList& arguments, const QString& name, const QString& defaultValue = QString());
+    static bool hasOption(const QStringList& arguments, const QString& name);
+    /** Arguments that are neither options nor their values */
+    static QStringList positional(const QStringList& arguments, const QStringList& valueOptions);
+};
+
+#endif // COMMANDLINE_H
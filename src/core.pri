@@ -0,0 +1,43 @@
+#
+# Knowthelist
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Sources of the core without widgets: collection database, scanner, tags
+# analyser, similarity index, read ahead and the command line parser.
+# Built as the knowthelist-core library by core/core.pro.
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/collectiondb.cpp \
+    $$PWD/cataloguesnapshot.cpp \
+    $$PWD/collectionupdater.cpp \
+    $$PWD/track.cpp \
+    $$PWD/trackanalyser.cpp \
+    $$PWD/trackfeatures.cpp \
+    $$PWD/similarityindex.cpp \
+    $$PWD/statisticsjournal.cpp \
+    $$PWD/trackindex.cpp \
+    $$PWD/trackweights.cpp \
+    $$PWD/sqlprofiler.cpp \
+    $$PWD/json.cpp \
+    $$PWD/readahead.cpp \
+    $$PWD/commandline.cpp \
+    $$PWD/tracer.cpp
+HEADERS += \
+    $$PWD/collectiondb.h \
+    $$PWD/cataloguesnapshot.h \
+    $$PWD/collectionupdater.h \
+    $$PWD/track.h \
+    $$PWD/trackanalyser.h \
+    $$PWD/trackfeatures.h \
+    $$PWD/similarityindex.h \
+    $$PWD/statisticsjournal.h \
+    $$PWD/trackindex.h \
+    $$PWD/trackweights.h \
+    $$PWD/sqlprofiler.h \
+    $$PWD/json.h \
+    $$PWD/readahead.h \
+    $$PWD/commandline.h \
+    $$PWD/tracer.h
@@ -0,0 +1,54 @@
+#
+# Knowthelist
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# The core without widgets as a static library, linked by the application
+# and the command line tools
+
+QT += core \
+    gui \
+    sql
+
+greaterThan(QT_MAJOR_VERSION, 4){
+     QT += concurrent
+     DEFINES += GST_API_VERSION_1
+}
+
+TARGET = knowthelist-core
+TEMPLATE = lib
+CONFIG += staticlib
+include(../core.pri)
+
+# next to the application build, see link.pri
+DESTDIR = $$OUT_PWD/..
+
+win32 {
+    GST_HOME = $$quote($$(GSTREAMER_1_0_ROOT_X86))
+    INCLUDEPATH += $${GST_HOME}\include\gstreamer-1.0 \
+        $${GST_HOME}\include\glib-2.0 \
+        $${GST_HOME}\lib\glib-2.0\include \
+        $${GST_HOME}\include
+}
+macx {
+    DEFINES += GST_API_VERSION_1
+    INCLUDEPATH += /usr/local/include/gstreamer-1.0 \
+        /usr/local/include/glib-2.0 \
+        /usr/local/lib/glib-2.0/include \
+        /usr/local/include
+}
+unix:!macx {
+contains(DEFINES, GST_API_VERSION_1) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += gstreamer-1.0 \
+        taglib
+}
+else {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += gstreamer-0.10 \
+        taglib
+}
+}
+
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
+QMAKE_CXXFLAGS_WARN_ON += -Wno-reorder
@@ -0,0 +1,13 @@
+#
+# Knowthelist
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Links the knowthelist-core library. Set CORE_LIB_DIR to the build
+# directory of src/ first, the library is written there.
+
+INCLUDEPATH += $$PWD/..
+
+LIBS += -L$$CORE_LIB_DIR -lknowthelist-core
+win32-msvc*:PRE_TARGETDEPS += $$CORE_LIB_DIR/knowthelist-core.lib
+else:PRE_TARGETDEPS += $$CORE_LIB_DIR/libknowthelist-core.a
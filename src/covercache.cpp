@@ -0,0 +1,258 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "covercache.h"
+#include "track.h"
+
+#include <QCache>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
+#else
+#include <QDesktopServices>
+#include <QtConcurrentRun>
+#endif
+#include <qdebug.h>
+
+struct CoverCachePrivate {
+    QMutex mutex;
+    QCache<QString, QImage> memory;
+    QString directory;
+    qint64 diskLimit;
+    qint64 diskUsage;
+    QFuture<void> future;
+    bool busy;
+    bool hasPending;
+    QUrl pendingUrl;
+    QSize pendingSize;
+};
+
+namespace {
+QString memoryKey(const QUrl& url, const QSize& size)
+{
+    return QString("%1|%2x%3").arg(url.toLocalFile()).arg(size.width()).arg(size.height());
+}
+
+qint64 imageBytes(const QImage& image)
+{
+#if QT_VERSION >= 0x050a00
+    return image.sizeInBytes();
+#else
+    return image.byteCount();
+#endif
+}
+
+qint64 secsSinceEpoch(const QDateTime& dateTime)
+{
+#if QT_VERSION >= 0x050800
+    return dateTime.toSecsSinceEpoch();
+#else
+    return dateTime.toTime_t();
+#endif
+}
+}
+
+CoverCache* CoverCache::instance()
+{
+    static CoverCache* cache = new CoverCache(QCoreApplication::instance());
+    return cache;
+}
+
+CoverCache::CoverCache(QObject* parent)
+    : QObject(parent)
+    , p(new CoverCachePrivate)
+{
+    p->busy = false;
+    p->hasPending = false;
+    p->diskUsage = -1;
+    setMemoryLimit(16 * 1024);
+    setDiskLimit(64 * 1024);
+
+#if QT_VERSION >= 0x050000
+    QString pathName = QStandardPaths::standardLocations(QStandardPaths::DataLocation).at(0);
+#else
+    QString pathName = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+#endif
+    p->directory = pathName + "/covers";
+    QDir path(p->directory);
+    if (!path.exists())
+        path.mkpath(p->directory);
+}
+
+CoverCache::~CoverCache()
+{
+    p->mutex.lock();
+    p->hasPending = false;
+    p->mutex.unlock();
+    p->future.waitForFinished();
+    delete p;
+}
+
+void CoverCache::setMemoryLimit(int kbytes)
+{
+    QMutexLocker locker(&p->mutex);
+    p->memory.setMaxCost(kbytes);
+}
+
+void CoverCache::setDiskLimit(int kbytes)
+{
+    QMutexLocker locker(&p->mutex);
+    p->diskLimit = (qint64)kbytes * 1024;
+}
+
+bool CoverCache::findCover(const QUrl& url, QImage& image, const QSize& size)
+{
+    QMutexLocker locker(&p->mutex);
+    QImage* cached = p->memory.object(memoryKey(url, size));
+    if (!cached)
+        return false;
+    image = *cached;
+    return true;
+}
+
+void CoverCache::requestCover(const QUrl& url, const QSize& size)
+{
+    QImage image;
+    if (findCover(url, image, size)) {
+        emit coverReady(url, image);
+        return;
+    }
+
+    // only the latest request is of interest, older ones are dropped
+    QMutexLocker locker(&p->mutex);
+    p->pendingUrl = url;
+    p->pendingSize = size;
+    p->hasPending = true;
+    if (!p->busy) {
+        p->busy = true;
+        p->future = QtConcurrent::run(this, &CoverCache::processRequests);
+    }
+}
+
+void CoverCache::processRequests()
+{
+    forever {
+        p->mutex.lock();
+        if (!p->hasPending) {
+            p->busy = false;
+            p->mutex.unlock();
+            return;
+        }
+        QUrl url = p->pendingUrl;
+        QSize size = p->pendingSize;
+        p->hasPending = false;
+        p->mutex.unlock();
+
+        QImage image = loadCover(url, size);
+
+        p->mutex.lock();
+        int cost = qMax(1, (int)(imageBytes(image) / 1024));
+        p->memory.insert(memoryKey(url, size), new QImage(image), cost);
+        p->mutex.unlock();
+
+        emit coverReady(url, image);
+    }
+}
+
+QImage CoverCache::loadCover(const QUrl& url, const QSize& size)
+{
+    QString fileName = url.toLocalFile();
+    QFileInfo fileInfo(fileName);
+    if (fileName.isEmpty() || !fileInfo.exists())
+        return QImage();
+
+    QByteArray fingerprint = QString("%1|%2|%3|%4x%5")
+                                 .arg(fileInfo.absoluteFilePath())
+                                 .arg(fileInfo.size())
+                                 .arg(secsSinceEpoch(fileInfo.lastModified()))
+                                 .arg(size.width())
+                                 .arg(size.height())
+                                 .toUtf8();
+    QString baseName = p->directory + "/"
+        + QCryptographicHash::hash(fingerprint, QCryptographicHash::Sha1).toHex();
+
+    // disk tier: a thumbnail or a marker for files without picture
+    if (QFile::exists(baseName + ".none"))
+        return QImage();
+    QImage image(baseName + ".jpg");
+    if (!image.isNull())
+        return image;
+
+    image = Track::embeddedImage(fileName);
+    if (image.isNull()) {
+        storeCover(image, baseName + ".none");
+        return QImage();
+    }
+
+    if (image.width() > size.width() || image.height() > size.height())
+        image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    storeCover(image, baseName + ".jpg");
+    return image;
+}
+
+void CoverCache::storeCover(const QImage& image, const QString& fileName)
+{
+    // only called from the worker, there is one at a time
+    if (image.isNull()) {
+        QFile marker(fileName);
+        if (marker.open(QIODevice::WriteOnly))
+            marker.close();
+    } else if (!image.save(fileName, "JPG", 90)) {
+        qDebug() << Q_FUNC_INFO << "could not store cover" << fileName;
+        return;
+    }
+
+    if (p->diskUsage < 0) {
+        p->diskUsage = 0;
+        QDir path(p->directory);
+        foreach (const QFileInfo& fileInfo, path.entryInfoList(QDir::Files))
+            p->diskUsage += fileInfo.size();
+    } else {
+        p->diskUsage += QFileInfo(fileName).size();
+    }
+
+    p->mutex.lock();
+    qint64 limit = p->diskLimit;
+    p->mutex.unlock();
+    if (p->diskUsage > limit)
+        evictCovers();
+}
+
+void CoverCache::evictCovers()
+{
+    p->mutex.lock();
+    qint64 target = p->diskLimit * 3 / 4;
+    p->mutex.unlock();
+
+    // oldest first, down to three quarters so not every store evicts again
+    QDir path(p->directory);
+    QFileInfoList files = path.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    foreach (const QFileInfo& fileInfo, files) {
+        if (p->diskUsage <= target)
+            break;
+        if (QFile::remove(fileInfo.absoluteFilePath()))
+            p->diskUsage -= fileInfo.size();
+    }
+}
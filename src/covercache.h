@@ -0,0 +1,61 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERCACHE_H
+#define COVERCACHE_H
+
+#include <QImage>
+#include <QObject>
+#include <QSize>
+#include <QUrl>
+
+/*
+ *  Cover thumbnails of tracks. Pictures are decoded and scaled down on a
+ *  worker thread, kept in a LRU memory cache and stored on disk, keyed by
+ *  the fingerprint of the file (path, size, modification time). The oldest
+ *  files on disk are removed when the disk limit is exceeded.
+ */
+class CoverCache : public QObject {
+    Q_OBJECT
+
+public:
+    static CoverCache* instance();
+    ~CoverCache();
+
+    static QSize defaultSize() { return QSize(120, 120); }
+
+    /** Look up the memory cache only, true if the cover is known */
+    bool findCover(const QUrl& url, QImage& image, const QSize& size = defaultSize());
+    /** Load the cover in background, coverReady is emitted when done */
+    void requestCover(const QUrl& url, const QSize& size = defaultSize());
+    void setMemoryLimit(int kbytes);
+    void setDiskLimit(int kbytes);
+
+Q_SIGNALS:
+    /** image is null if the file has no embedded picture */
+    void coverReady(const QUrl& url, const QImage& image);
+
+private:
+    explicit CoverCache(QObject* parent = nullptr);
+    void processRequests();
+    QImage loadCover(const QUrl& url, const QSize& size);
+    void storeCover(const QImage& image, const QString& fileName);
+    void evictCovers();
+    struct CoverCachePrivate* p;
+};
+
+#endif // COVERCACHE_H
@@ -20,11 +20,17 @@
 #include "dj.h"
 #include "djfilterwidget.h"
 #include "djwidget.h"
+#include "tracer.h"
 
 #include <QListWidget>
 #include <QPushButton>
 #include <QSplitter>
 #include <QVBoxLayout>
+#if QT_VERSION >= 0x050000
+#include <QtConcurrent/QtConcurrent>
+#else
+#include <QtConcurrentRun>
+#endif
 
 class DjBrowserPrivate {
 public:
@@ -36,6 +42,8 @@ public:
     QStringList allGenres;
     QStringList allArtists;
     CollectionDB* database;
+    // artists and genres read in background
+    QFutureWatcher<QList<QStringList> > tagWatcher;
 };
 
 DjBrowser::DjBrowser(QWidget* parent)
@@ -43,16 +51,7 @@ DjBrowser::DjBrowser(QWidget* parent)
 {
     p = new DjBrowserPrivate;
     p->database = new CollectionDB();
-
-    QList<QStringList> tags = p->database->selectArtists();
-    p->allArtists.append(QString::null);
-    foreach (QStringList tag, tags)
-        p->allArtists.append(tag[0]);
-
-    tags = p->database->selectGenres();
-    p->allGenres.append(QString::null);
-    foreach (QStringList tag, tags)
-        p->allGenres.append(tag[0]);
+    connect(&p->tagWatcher, SIGNAL(finished()), this, SLOT(onTagsLoaded()));
 
     QPushButton* pushAddDj = new QPushButton();
     pushAddDj->setGeometry(QRect(1, 1, 60, 25));
@@ -160,6 +159,7 @@ DjBrowser::DjBrowser(QWidget* parent)
 
 DjBrowser::~DjBrowser()
 {
+    p->tagWatcher.waitForFinished();
     saveSettings();
 
     delete p;
@@ -198,6 +198,43 @@ void DjBrowser::saveSettings()
     settings.endGroup();
 }
 
+void DjBrowser::loadTags()
+{
+    // both lists scan the whole collection, a worker reads them
+    p->tagWatcher.setFuture(QtConcurrent::run(this, &DjBrowser::readTags));
+}
+
+QList<QStringList> DjBrowser::readTags()
+{
+    TraceZone zone("dj", "readTags");
+    QStringList artists;
+    artists.append(QString::null);
+    foreach (QStringList tag, p->database->selectArtists())
+        artists.append(tag[0]);
+
+    QStringList genres;
+    genres.append(QString::null);
+    foreach (QStringList tag, p->database->selectGenres())
+        genres.append(tag[0]);
+
+    return QList<QStringList>() << artists << genres;
+}
+
+void DjBrowser::onTagsLoaded()
+{
+    QList<QStringList> tags = p->tagWatcher.result();
+    p->allArtists = tags.at(0);
+    p->allGenres = tags.at(1);
+
+    // filters shown meanwhile have empty combos
+    for (int i = 0; i < p->listDjFilters->count(); i++) {
+        DjFilterWidget* djfw = static_cast<DjFilterWidget*>(p->listDjFilters->itemWidget(p->listDjFilters->item(i)));
+        djfw->setAllGenres(p->allGenres);
+        djfw->setAllArtists(p->allArtists);
+    }
+    Q_EMIT tagsLoaded();
+}
+
 void DjBrowser::updateList()
 {
     QSettings settings;
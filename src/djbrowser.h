@@ -30,10 +30,13 @@ public:
     ~DjBrowser();
     void updateList();
     void saveSettings();
+    /** Reads the artists and genres of the filters in background */
+    void loadTags();
 
 signals:
     void selectionChanged(Dj*);
     void selectionStarted();
+    void tagsLoaded();
 
 public slots:
     void addDj();
@@ -43,7 +46,11 @@ public slots:
     void addFilter();
     void removeFilter();
 
+private slots:
+    void onTagsLoaded();
+
 private:
+    QList<QStringList> readTags();
     class DjBrowserPrivate* p;
 };
 
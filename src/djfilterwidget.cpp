@@ -46,6 +46,9 @@ DjFilterWidget::DjFilterWidget(QWidget* parent)
     ui->cmbGenres->setAttribute(Qt::WA_MacShowFocusRect, false);
     ui->cmbArtists->setAttribute(Qt::WA_MacShowFocusRect, false);
 
+    p->filter = nullptr;
+    p->ready = false;
+
     ui->lblFilterValue->setText(QString::null);
     ui->stackDisplay->setCount(0);
 
@@ -104,12 +107,25 @@ void DjFilterWidget::slotSetFilter()
 
 void DjFilterWidget::setAllArtists(QStringList values)
 {
+    // the lists may arrive after the filter, keep its text
+    bool ready = p->ready;
+    p->ready = false;
+    QString text = ui->cmbArtists->currentText();
+    ui->cmbArtists->clear();
     ui->cmbArtists->addItems(values);
+    ui->cmbArtists->setEditText(text);
+    p->ready = ready;
 }
 
 void DjFilterWidget::setAllGenres(QStringList& values)
 {
+    bool ready = p->ready;
+    p->ready = false;
+    QString text = ui->cmbGenres->currentText();
+    ui->cmbGenres->clear();
     ui->cmbGenres->addItems(values);
+    ui->cmbGenres->setEditText(text);
+    p->ready = ready;
 }
 
 void DjFilterWidget::setID(QString value)
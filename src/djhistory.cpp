@@ -0,0 +1,155 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "djhistory.h"
+#include "track.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+
+namespace {
+QString titleKey(Track* track)
+{
+    return track->artist() + QLatin1Char('\t') + track->title();
+}
+}
+
+struct DjHistoryPrivate {
+    QMutex mutex;
+    int limit;
+    int artistSpacing;
+    // picks oldest first, the sets count them
+    QQueue<QString> urlOrder;
+    QQueue<QString> titleOrder;
+    QHash<QString, int> urls;
+    QHash<QString, int> titles;
+    // artists of the last artistSpacing picks
+    QQueue<QString> artistOrder;
+    QHash<QString, int> artists;
+    QSet<QString> listed[2];
+};
+
+// counted sets, a key leaves when its last occurrence leaves the ring
+static void addKey(QQueue<QString>& order, QHash<QString, int>& keys, const QString& key, int limit)
+{
+    order.enqueue(key);
+    keys[key]++;
+    while (order.count() > limit) {
+        QString old = order.dequeue();
+        if (--keys[old] <= 0)
+            keys.remove(old);
+    }
+}
+
+DjHistory::DjHistory()
+    : p(new DjHistoryPrivate)
+{
+    p->limit = 2000;
+    p->artistSpacing = 0;
+}
+
+DjHistory::~DjHistory()
+{
+    delete p;
+}
+
+int DjHistory::limit()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->limit;
+}
+
+void DjHistory::setLimit(int tracks)
+{
+    QMutexLocker locker(&p->mutex);
+    p->limit = qMax(1, tracks);
+    while (p->urlOrder.count() > p->limit) {
+        QString url = p->urlOrder.dequeue();
+        if (--p->urls[url] <= 0)
+            p->urls.remove(url);
+        QString title = p->titleOrder.dequeue();
+        if (--p->titles[title] <= 0)
+            p->titles.remove(title);
+    }
+}
+
+int DjHistory::artistSpacing()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->artistSpacing;
+}
+
+void DjHistory::setArtistSpacing(int tracks)
+{
+    QMutexLocker locker(&p->mutex);
+    p->artistSpacing = qMax(0, tracks);
+    while (p->artistOrder.count() > p->artistSpacing) {
+        QString artist = p->artistOrder.dequeue();
+        if (--p->artists[artist] <= 0)
+            p->artists.remove(artist);
+    }
+}
+
+void DjHistory::setListed(int list, const QList<Track*>& tracks)
+{
+    QSet<QString> keys;
+    keys.reserve(tracks.count());
+    foreach (Track* track, tracks)
+        keys.insert(titleKey(track));
+
+    QMutexLocker locker(&p->mutex);
+    p->listed[list == 2 ? 1 : 0] = keys;
+}
+
+bool DjHistory::isAllowed(Track* track, bool checkArtist)
+{
+    QString url = track->url().toString();
+    QString title = titleKey(track);
+
+    QMutexLocker locker(&p->mutex);
+    if (p->urls.contains(url) || p->titles.contains(title))
+        return false;
+    if (p->listed[0].contains(title) || p->listed[1].contains(title))
+        return false;
+    return !checkArtist || !p->artists.contains(track->artist());
+}
+
+void DjHistory::add(Track* track)
+{
+    QString url = track->url().toString();
+    QString title = titleKey(track);
+
+    QMutexLocker locker(&p->mutex);
+    addKey(p->urlOrder, p->urls, url, p->limit);
+    addKey(p->titleOrder, p->titles, title, p->limit);
+    if (p->artistSpacing > 0)
+        addKey(p->artistOrder, p->artists, track->artist(), p->artistSpacing);
+}
+
+void DjHistory::clear()
+{
+    QMutexLocker locker(&p->mutex);
+    p->urlOrder.clear();
+    p->titleOrder.clear();
+    p->urls.clear();
+    p->titles.clear();
+    p->artistOrder.clear();
+    p->artists.clear();
+}
@@ -0,0 +1,58 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DJHISTORY_H
+#define DJHISTORY_H
+
+#include <QList>
+#include <QString>
+
+class Track;
+
+/*
+ *  What the Auto DJ must not pick again: the urls and artist/title pairs
+ *  of its latest picks, the tracks both playlists hold and the artists of
+ *  the last few picks. Every check is a hash lookup, the history forgets
+ *  its oldest picks beyond limit(). Thread safe.
+ */
+class DjHistory {
+public:
+    DjHistory();
+    ~DjHistory();
+
+    /** Picks remembered */
+    int limit();
+    void setLimit(int tracks);
+    /** Picks before an artist may come again, 0 allows it right away */
+    int artistSpacing();
+    void setArtistSpacing(int tracks);
+
+    /** The tracks of playlist 1 or 2 */
+    void setListed(int list, const QList<Track*>& tracks);
+    /** false if the track was picked or is listed, or if its artist was
+        among the last picks and checkArtist is set */
+    bool isAllowed(Track* track, bool checkArtist);
+    void add(Track* track);
+    void clear();
+
+private:
+    Q_DISABLE_COPY(DjHistory)
+    struct DjHistoryPrivate* p;
+};
+
+#endif // DJHISTORY_H
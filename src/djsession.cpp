@@ -17,14 +17,24 @@
 
 #include "djsession.h"
 #include "dj.h"
+#include "djhistory.h"
+#include "playlistfile.h"
+#include "playlistwriter.h"
+#include "readahead.h"
+#include "similarityindex.h"
+#include "statisticsjournal.h"
+#include "tracer.h"
 #include "track.h"
+#include "trackweights.h"
 
 #if QT_VERSION >= 0x050000
 #include <QtConcurrent/QtConcurrent>
 #else
 #include <QtConcurrentRun>
 #endif
-#include <QtXml>
+#include <QHash>
+#include <QSettings>
+#include <QThread>
 
 struct DjSessionPrivate {
     QMutex mutex1;
@@ -35,8 +45,13 @@ struct DjSessionPrivate {
     QList<Track*> playList2_Tracks;
     QPair<int, int> playList1_Info;
     QPair<int, int> playList2_Info;
-    QStringList seenUrls;
+    DjHistory history;
     bool isEnabledAutoDJCount;
+    // picks that sound like the last listed track come first
+    bool similar;
+    QString seedUrl;
+    QThread writerThread;
+    PlaylistWriter* writer;
 };
 
 DjSession::DjSession()
@@ -46,10 +61,29 @@ DjSession::DjSession()
     p->minCount = 10;
     p->currentDj = nullptr;
     p->isEnabledAutoDJCount = false;
+
+    QSettings settings;
+    p->history.setLimit(settings.value("AutoDjHistory", 2000).toInt());
+    p->similar = settings.value("AutoDjSimilar", true).toBool();
+    p->history.setArtistSpacing(settings.value("AutoDjArtistSpacing", 3).toInt());
+    // the picks are drawn in the search thread, the weights belong to this one
+    TrackWeights::instance();
+
+    // playlists are written by their own thread, away from the fade path
+    p->writer = new PlaylistWriter(QSqlDatabase::database().databaseName());
+    p->writer->moveToThread(&p->writerThread);
+    connect(p->writer, SIGNAL(stored(QString)), this, SIGNAL(savedPlaylists()));
+    p->writerThread.start();
+    p->writer->recover();
 }
 
 DjSession::~DjSession()
 {
+    StatisticsJournal::instance()->sync();
+    p->writer->stop();
+    p->writerThread.quit();
+    p->writerThread.wait();
+    delete p->writer;
     delete p;
 }
 
@@ -77,6 +111,7 @@ void DjSession::searchTracks()
     qsrand((uint)time.msec());
 
     // how many tracks are needed
+    TraceZone zone("dj", "refill");
     p->mutex1.lock();
     int diffCount1 = p->minCount - p->playList1_Tracks.count();
     int diffCount2 = p->minCount - p->playList2_Tracks.count();
@@ -86,75 +121,157 @@ void DjSession::searchTracks()
     qDebug() << Q_FUNC_INFO << " need " << diffCount1 << " tracks left and " << diffCount2 << " tracks right ";
     qDebug() << Q_FUNC_INFO << " needed together: " << needed;
 
+    // the track the new picks follow
+    p->seedUrl.clear();
+    if (!p->playList1_Tracks.isEmpty())
+        p->seedUrl = p->playList1_Tracks.last()->url().toLocalFile();
+    else if (!p->playList2_Tracks.isEmpty())
+        p->seedUrl = p->playList2_Tracks.last()->url().toLocalFile();
+
     // retrieve new random tracks for both playlists
+    QList<Track*> picks = getRandomTracks(needed);
     QList<Track*> tracks1;
     QList<Track*> tracks2;
-    for (int i = 0; i < needed; i++) {
+    for (int i = 0; i < picks.count(); i++) {
         if (i % 2 == 0) {
             if (diffCount1 > 0) {
-                tracks1.append(getRandomTrack());
+                tracks1.append(picks.at(i));
                 diffCount1--;
             } else
-                tracks2.append(getRandomTrack());
+                tracks2.append(picks.at(i));
         } else {
             if (diffCount2 > 0) {
-                tracks2.append(getRandomTrack());
+                tracks2.append(picks.at(i));
                 diffCount2--;
             } else
-                tracks1.append(getRandomTrack());
+                tracks1.append(picks.at(i));
         }
     }
 
     // new tracks available, trigger fill up of playlists
     qDebug() << Q_FUNC_INFO << " provide " << tracks1.count() << " tracks left and " << tracks2.count() << " tracks right ";
 
+    // the picks are queued behind the listed tracks, read them ahead as well
+    QList<QUrl> upcoming;
+    foreach (Track* track, tracks1 + tracks2)
+        upcoming.append(track->url());
+    ReadAhead::instance()->setUpcoming("AutoDJ", upcoming);
+
     // emit if needed
     if (tracks1.count() > 0)
         emit foundTracks_Playlist1(tracks1);
     if (tracks2.count() > 0)
         emit foundTracks_Playlist2(tracks2);
 
+    // playlists copy the tracks when the queued signals arrive,
+    // free them right after in the same event queue
+    QMetaObject::invokeMethod(this, "releaseTracks", Qt::QueuedConnection,
+        Q_ARG(QList<Track*>, tracks1 + tracks2));
+
     p->mutex1.unlock();
 }
 
+void DjSession::releaseTracks(QList<Track*> tracks)
+{
+    qDeleteAll(tracks);
+}
+
 /*ToDo:
 - Genre: Combobox with distinct all genres
   */
 Track* DjSession::getRandomTrack()
 {
-    if (p->currentDj == nullptr)
-        return nullptr;
-
-    Track* track = nullptr;
-    int i = 0;
+    QList<Track*> tracks = getRandomTracks(1);
+    return tracks.isEmpty() ? nullptr : tracks.first();
+}
 
-    Filter* f = p->currentDj->requestFilter();
-    int maxCount = 0;
+QList<Track*> DjSession::getRandomTracks(int count)
+{
+    QList<Track*> tracks;
+    if (p->currentDj == nullptr || count <= 0)
+        return tracks;
+
+    // the filter rotation of all picks first, then one draw per filter
+    QList<Filter*> rotation;
+    QList<Filter*> filters;
+    for (int i = 0; i < count; i++) {
+        Filter* f = p->currentDj->requestFilter();
+        if (f == nullptr)
+            return tracks;
+        rotation.append(f);
+        if (!filters.contains(f))
+            filters.append(f);
+    }
 
-    do {
+    QHash<Filter*, QList<Track*> > picks;
+    foreach (Filter* f, filters)
+        picks.insert(f, pickTracks(f, rotation.count(f)));
 
-        track = new Track(p->database->getRandomEntry(f->path(), f->genre(), f->artist()));
+    foreach (Filter* f, rotation) {
+        QList<Track*>& list = picks[f];
+        if (!list.isEmpty())
+            tracks.append(list.takeFirst());
+    }
+    return tracks;
+}
 
-        if (maxCount == 0)
-            maxCount = p->database->lastMaxCount();
-        i++;
-    } while ((track->prettyLength() == "?"
-                 || track->containIn(p->playList1_Tracks)
-                 || track->containIn(p->playList2_Tracks)
-                 || p->seenUrls.contains(track->url().toString()))
-        && i < maxCount * 3);
-    if (i >= maxCount * 3)
+QList<Track*> DjSession::pickTracks(Filter* f, int count)
+{
+    TraceZone zone("dj", "pick");
+    QList<Track*> tracks;
+    int draws = 0;
+
+    // over-sampled draws absorb the rejects, the later rounds relax the
+    // artist spacing and then the history, so a narrow filter still fills up
+    for (int round = 0; round < 4 && tracks.count() < count; round++) {
+        int missing = count - tracks.count();
+        QList<QStringList> entries = p->database->getRandomEntries(f->path(), f->genre(), f->artist(), missing * 3 + 4);
+        draws++;
+        if (entries.isEmpty())
+            break;
+        if (p->similar && !p->seedUrl.isEmpty())
+            entries = rankBySimilarity(entries);
+
+        bool checkArtist = f->artist().isEmpty() && round < 2;
+        foreach (const QStringList& entry, entries) {
+            if (tracks.count() >= count)
+                break;
+            Track* track = new Track(entry);
+            if (track->prettyLength() == "?"
+                || (round < 3 && !p->history.isAllowed(track, checkArtist))) {
+                delete track;
+                continue;
+            }
+            p->history.add(track);
+            track->setFlags(track->flags() | Track::isAutoDjSelection);
+            tracks.append(track);
+        }
+    }
+    if (tracks.count() < count)
         qDebug() << Q_FUNC_INFO << " no new track found.";
     else
-        qDebug() << Q_FUNC_INFO << i << " iterations to found a new track " << i;
+        qDebug() << Q_FUNC_INFO << draws << " draws to find " << count << " new tracks";
+    if (zone.isActive())
+        zone.setDetail(QString("%1 tracks, %2 draws").arg(count).arg(draws));
 
-    f->setCount(maxCount);
+    f->setCount(p->database->lastMaxCount());
     f->setLength(p->database->lastLengthSum());
-    p->seenUrls.append(track->url().toString());
-    p->seenUrls.removeDuplicates();
+    return tracks;
+}
+
+QList<QStringList> DjSession::rankBySimilarity(const QList<QStringList>& entries)
+{
+    QStringList urls;
+    QHash<QString, QStringList> byUrl;
+    foreach (const QStringList& entry, entries) {
+        urls << entry.at(0);
+        byUrl.insert(entry.at(0), entry);
+    }
 
-    track->setFlags(track->flags() | Track::isAutoDjSelection);
-    return track;
+    QList<QStringList> ret;
+    foreach (const QString& url, SimilarityIndex::instance()->rank(p->database, p->seedUrl, urls))
+        ret << byUrl.value(url);
+    return ret;
 }
 
 void DjSession::updatePlaylists()
@@ -222,6 +339,7 @@ void DjSession::playDefaultList()
     }
 
     forceTracks(tracks);
+    qDeleteAll(tracks);
 }
 
 void DjSession::on_dj_filterChanged(Filter* f)
@@ -264,6 +382,7 @@ void DjSession::onTracksChanged_Playlist1(QList<Track*> tracks)
         p->playList1_Info.second += track->length();
     }
     p->playList1_Info.first = p->playList1_Tracks.count();
+    p->history.setListed(1, p->playList1_Tracks);
     Q_EMIT changed_Playlist1(p->playList1_Info);
 }
 
@@ -279,10 +398,11 @@ void DjSession::onTracksChanged_Playlist2(QList<Track*> tracks)
         p->playList2_Info.second += track->length();
     }
     p->playList2_Info.first = p->playList2_Tracks.count();
+    p->history.setListed(2, p->playList2_Tracks);
     Q_EMIT changed_Playlist2(p->playList2_Info);
 }
 
-void DjSession::storePlaylists(const QString& name, bool replace)
+void DjSession::storePlaylists(const QString& name, bool replace, int delay)
 {
     qDebug() << Q_FUNC_INFO << " Start";
 
@@ -290,48 +410,53 @@ void DjSession::storePlaylists(const QString& name, bool replace)
     listToStore.append(p->playList1_Tracks);
     listToStore.append(p->playList2_Tracks);
 
-    if (replace)
-        p->database->executeSql(QString("DELETE FROM playlists WHERE name ='%1';")
-                                    .arg(p->database->escapeString(name)));
-
+    QList<PlaylistRow> rows;
     int n = 0;
     QList<Track*>::Iterator i = listToStore.begin();
     while (i != listToStore.end()) {
-
-        QString command = QString("INSERT OR REPLACE INTO playlists "
-                                  "( url, name, length, flags, norder, changedate ) "
-                                  "VALUES('%1','%2', %3, %4, %5, strftime('%s', 'now'));")
-                              .arg(p->database->escapeString((*i)->url().toLocalFile()))
-                              .arg(p->database->escapeString(name))
-                              .arg((*i)->length())
-                              .arg((*i)->flags())
-                              .arg(n);
-
-        p->database->executeSql(command);
+        PlaylistRow row;
+        row.url = (*i)->url().toLocalFile();
+        row.length = (*i)->length();
+        row.flags = (*i)->flags();
+        row.norder = n;
+        rows.append(row);
         i++;
         n++;
     }
 
-    Q_EMIT savedPlaylists();
-    qDebug() << Q_FUNC_INFO << " Insert finish";
+    p->writer->store(name, rows, replace, delay);
+
+    qDebug() << Q_FUNC_INFO << " Queued " << n << " tracks";
 }
 
 void DjSession::summariseCount()
 {
     QString res;
-    int count = 0;
-    int length = 0;
-    QStringList artists;
+    QList<TrackBitmap> matches;
+    TrackBitmap all;
     int filterCount = p->currentDj->filters().count();
     for (int i = 0; i < filterCount; i++) {
         Filter* f = p->currentDj->filters().at(i);
         res += f->description();
-        count += f->count();
-        length += f->length();
+        matches.append(p->database->matchTracks(f->path(), f->genre(), f->artist()));
+        all |= matches.last();
+    }
+
+    // tracks matching more than one filter are counted once
+    for (int i = 0; i < filterCount; i++) {
+        for (int j = i + 1; j < filterCount; j++) {
+            uint shared = (matches.at(i) & matches.at(j)).cardinality();
+            if (shared > 0)
+                res += "\n" + tr("%1and %2share %3 tracks")
+                                  .arg(p->currentDj->filters().at(i)->description())
+                                  .arg(p->currentDj->filters().at(j)->description())
+                                  .arg(shared);
+        }
     }
-    p->currentDj->setLengthTracks(length);
+
+    p->currentDj->setLengthTracks(p->database->lengthSum(all));
     p->currentDj->setDescription(res);
-    p->currentDj->setCountTracks(count);
+    p->currentDj->setCountTracks(all.cardinality());
 }
 
 bool DjSession::isEnabledAutoDJCount()
@@ -354,73 +479,21 @@ void DjSession::setMinCount(int value)
     p->minCount = value;
 }
 
-// obsolate: keep this just in case we need an export function later
+// export both Auto-DJ lists into a xspf, m3u or pls file
 void DjSession::savePlaylists(const QString& filename)
 {
     qDebug() << Q_FUNC_INFO << "BEGIN ";
-    QFile file(filename);
-
-    if (!file.open(QFile::WriteOnly))
-        return;
 
     QList<Track*> listToSave;
     listToSave.append(p->playList1_Tracks);
     listToSave.append(p->playList2_Tracks);
 
-    QDomDocument newdoc;
-    QDomElement playlistElem = newdoc.createElement("playlist");
-    playlistElem.setAttribute("version", "1");
-    playlistElem.setAttribute("xmlns", "http://xspf.org/ns/0/");
-    newdoc.appendChild(playlistElem);
-
-    QDomElement elem = newdoc.createElement("creator");
-    QDomText t = newdoc.createTextNode("Knowthelist");
-    elem.appendChild(t);
-    playlistElem.appendChild(elem);
-
-    QDomElement listElem = newdoc.createElement("trackList");
-
-    QList<Track*>::Iterator i = listToSave.begin();
-    while (i != listToSave.end()) {
+    QList<QStringList> tags;
+    foreach (Track* track, listToSave)
+        tags << (track->tagList() << QString::number(int(track->flags())));
 
-        QDomElement trackElem = newdoc.createElement("track");
-
-        QDomElement extElem = newdoc.createElement("extension");
-
-        if ((*i)->flags().testFlag(Track::isAutoDjSelection))
-            extElem.setAttribute("isAutoDjSelection", "1");
-        if ((*i)->flags().testFlag(Track::isOnFirstPlayer))
-            extElem.setAttribute("isOnFirstPlayer", "1");
-        if ((*i)->flags().testFlag(Track::isOnSecondPlayer))
-            extElem.setAttribute("isOnSecondPlayer", "1");
-        extElem.setAttribute("Rating", (*i)->rate());
-
-        QStringList tag = (*i)->tagList();
-
-        for (int x = 0; x < tag.count(); ++x) {
-            if (x == 4 || x == 5) {
-                extElem.setAttribute(Track::tagNameList.at(x), tag.at(x));
-            } else {
-                QDomElement elem = newdoc.createElement(Track::tagNameList.at(x));
-                QDomText t = newdoc.createTextNode(tag.at(x));
-                elem.appendChild(t);
-                trackElem.appendChild(elem);
-            }
-        }
-
-        trackElem.appendChild(extElem);
-        listElem.appendChild(trackElem);
-
-        i++;
-    }
-
-    playlistElem.appendChild(listElem);
-
-    QTextStream stream(&file);
-    stream.setCodec("UTF-8");
-    stream << "<?xml version=\"1.0\" encoding=\"utf8\"?>\n";
-    stream << newdoc.toString();
-    file.close();
+    if (!PlaylistFile::save(filename, tags))
+        return;
 
     Q_EMIT savedPlaylists();
     qDebug() << Q_FUNC_INFO << "END ";
@@ -39,6 +39,8 @@ public:
     void setIsEnabledAutoDJCount(bool value);
     bool isEnabledAutoDJCount();
     Track* getRandomTrack();
+    /** count new tracks of the current DJ, in the order of its filter rotation */
+    QList<Track*> getRandomTracks(int count);
     Dj* currentDj();
 
 Q_SIGNALS:
@@ -59,12 +61,18 @@ public slots:
     void onResetStats();
     void onTrackPropertyChanged(Track* track);
     void savePlaylists( const QString &filename );
-    void storePlaylists(const QString &name , bool replace=false);
+    void storePlaylists(const QString &name , bool replace=false, int delay=0);
     void setCurrentDj(Dj*);
 
+private slots:
+    void releaseTracks(QList<Track*> tracks);
+
 private:
     struct DjSessionPrivate *p;
     void searchTracks();
+    QList<Track*> pickTracks(Filter* filter, int count);
+    /** Random entries that sound like the last listed track first, by SimilarityIndex */
+    QList<QStringList> rankBySimilarity(const QList<QStringList>& entries);
     void summariseCount();
 
 
@@ -0,0 +1,186 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dropoutmonitor.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QTextStream>
+#include <QVector>
+#include <qdebug.h>
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+namespace {
+// events kept for the tool tip and events()
+const int eventLimit = 200;
+const int kindCount = DropoutMonitor::Buffering + 1;
+}
+
+struct DropoutMonitorPrivate {
+    mutable QMutex mutex;
+    QMap<QString, QVector<int> > counters;
+    QList<DropoutMonitor::Event> events;
+    QString logName;
+};
+
+DropoutMonitor* DropoutMonitor::instance()
+{
+    static DropoutMonitor* monitor = new DropoutMonitor(QCoreApplication::instance());
+    return monitor;
+}
+
+DropoutMonitor::DropoutMonitor(QObject* parent)
+    : QObject(parent)
+    , p(new DropoutMonitorPrivate)
+{
+#if QT_VERSION >= 0x050000
+    QString pathName = QStandardPaths::standardLocations(QStandardPaths::DataLocation).at(0);
+#else
+    QString pathName = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+#endif
+    p->logName = pathName + "/dropouts.log";
+}
+
+DropoutMonitor::~DropoutMonitor()
+{
+    delete p;
+}
+
+QString DropoutMonitor::kindName(Kind kind)
+{
+    switch (kind) {
+    case Dropped:
+        return "dropped";
+    case Late:
+        return "late";
+    case Underrun:
+        return "underrun";
+    case Buffering:
+        return "buffering";
+    }
+    return QString();
+}
+
+void DropoutMonitor::record(const QString& deck, Kind kind, const QString& track, const QString& detail)
+{
+    // no locks, logs or files on the streaming thread
+    QMetaObject::invokeMethod(this, "append", Qt::QueuedConnection,
+        Q_ARG(QString, deck), Q_ARG(int, kind), Q_ARG(QString, track), Q_ARG(QString, detail),
+        Q_ARG(QDateTime, QDateTime::currentDateTime()));
+}
+
+void DropoutMonitor::append(const QString& deck, int kind, const QString& track, const QString& detail, const QDateTime& time)
+{
+    Event event;
+    event.time = time;
+    event.deck = deck;
+    event.kind = Kind(kind);
+    event.track = track;
+    event.detail = detail;
+
+    qWarning() << Q_FUNC_INFO << deck << kindName(event.kind) << track << detail;
+    if (Tracer::isEnabled()) {
+        Tracer::instance()->instant("dropout", "dropout", deck + " " + kindName(event.kind) + " " + detail);
+        Tracer::instance()->counter("dropout", "dropouts", count() + 1);
+    }
+
+    p->mutex.lock();
+    QVector<int>& counters = p->counters[deck];
+    if (counters.isEmpty())
+        counters.fill(0, kindCount);
+    counters[kind]++;
+    p->events.append(event);
+    if (p->events.count() > eventLimit)
+        p->events.removeFirst();
+    p->mutex.unlock();
+
+    QFile file(p->logName);
+    if (QFileInfo(p->logName).absoluteDir().exists()
+        && file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        QTextStream stream(&file);
+        stream << event.time.toString(Qt::ISODate) << "\t" << deck << "\t" << kindName(event.kind)
+               << "\t" << track << "\t" << detail << "\n";
+    }
+
+    Q_EMIT dropout(deck, kind);
+}
+
+int DropoutMonitor::count(const QString& deck, int kind) const
+{
+    QMutexLocker locker(&p->mutex);
+    int ret = 0;
+    QMap<QString, QVector<int> >::const_iterator it;
+    for (it = p->counters.constBegin(); it != p->counters.constEnd(); ++it) {
+        if (!deck.isEmpty() && it.key() != deck)
+            continue;
+        for (int i = 0; i < kindCount; i++)
+            if (kind < 0 || kind == i)
+                ret += it.value().at(i);
+    }
+    return ret;
+}
+
+QStringList DropoutMonitor::decks() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->counters.keys();
+}
+
+QList<DropoutMonitor::Event> DropoutMonitor::events() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->events;
+}
+
+QString DropoutMonitor::summary() const
+{
+    QStringList lines;
+    foreach (QString deck, decks()) {
+        QStringList kinds;
+        for (int i = 0; i < kindCount; i++)
+            kinds << QString("%1 %2").arg(count(deck, i)).arg(kindName(Kind(i)));
+        lines << deck + ": " + kinds.join(", ");
+    }
+
+    // the latest events, newest first
+    QList<Event> latest = events();
+    for (int i = latest.count() - 1; i >= 0 && i >= latest.count() - 5; i--) {
+        const Event& event = latest.at(i);
+        lines << QString("%1 %2 %3 %4")
+                     .arg(event.time.toString("hh:mm:ss"))
+                     .arg(event.deck)
+                     .arg(kindName(event.kind))
+                     .arg(QFileInfo(event.track).fileName());
+    }
+    return lines.join("\n");
+}
+
+void DropoutMonitor::reset()
+{
+    QMutexLocker locker(&p->mutex);
+    p->counters.clear();
+    p->events.clear();
+}
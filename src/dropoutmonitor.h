@@ -0,0 +1,80 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DROPOUTMONITOR_H
+#define DROPOUTMONITOR_H
+
+#include <QDateTime>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+/*
+ *  Collects the audio glitches the players see on their buses: buffers
+ *  dropped or rendered late (QoS, see DropoutWatch), sink warnings about underruns and network buffering
+ *  while playing. Every event is counted per deck, appended to
+ *  dropouts.log in the data directory and put on the trace timeline, so
+ *  glitches can be matched with scans or analysis runs. Create the
+ *  instance in the GUI thread. record() is called from the streaming
+ *  threads, it only queues the event, the GUI thread counts and writes it.
+ */
+class DropoutMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    enum Kind {
+        Dropped,
+        Late,
+        Underrun,
+        Buffering
+    };
+
+    struct Event {
+        QDateTime time;
+        QString deck;
+        Kind kind;
+        QString track;
+        QString detail;
+    };
+
+    static DropoutMonitor* instance();
+    ~DropoutMonitor();
+
+    void record(const QString& deck, Kind kind, const QString& track, const QString& detail = QString());
+
+    /** An empty deck counts all decks, a negative kind all kinds */
+    int count(const QString& deck = QString(), int kind = -1) const;
+    QStringList decks() const;
+    QList<Event> events() const;
+    /** Counters and the latest events as text, for tool tips */
+    QString summary() const;
+    void reset();
+
+    static QString kindName(Kind kind);
+
+Q_SIGNALS:
+    void dropout(const QString& deck, int kind);
+
+private slots:
+    void append(const QString& deck, int kind, const QString& track, const QString& detail, const QDateTime& time);
+
+private:
+    explicit DropoutMonitor(QObject* parent = nullptr);
+    struct DropoutMonitorPrivate* p;
+};
+
+#endif // DROPOUTMONITOR_H
@@ -0,0 +1,106 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dropoutwatch.h"
+#include "dropoutmonitor.h"
+
+#include <qdebug.h>
+
+static void setQos(GstElement* element)
+{
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(element), "qos"))
+        g_object_set(element, "qos", TRUE, NULL);
+}
+
+static void cb_sinkadded(GstBin* bin, GstElement* element, gpointer data)
+{
+    Q_UNUSED(bin);
+    Q_UNUSED(data);
+    setQos(element);
+}
+
+DropoutWatch::DropoutWatch()
+    : dropped(0)
+    , isBuffering(false)
+{
+}
+
+void DropoutWatch::enableQos(GstElement* sink)
+{
+    // autoaudiosink adds the real sink when it starts
+    if (GST_IS_BIN(sink))
+        g_signal_connect(sink, "element-added", G_CALLBACK(cb_sinkadded), nullptr);
+    else
+        setQos(sink);
+}
+
+void DropoutWatch::reset()
+{
+    dropped = 0;
+    isBuffering = false;
+}
+
+void DropoutWatch::handleMessage(GstMessage* message, const QString& deck, const QString& track, bool isStarted)
+{
+    switch (GST_MESSAGE_TYPE(message)) {
+    case GST_MESSAGE_QOS: {
+        GstFormat format;
+        guint64 processed = 0;
+        guint64 count = 0;
+        gint64 jitter = 0;
+        gdouble proportion = 1.0;
+        gint quality = 0;
+        gst_message_parse_qos_stats(message, &format, &processed, &count);
+        gst_message_parse_qos_values(message, &jitter, &proportion, &quality);
+
+        // a QoS message without new drops is a buffer rendered late
+        bool isDropped = count > dropped;
+        dropped = count;
+        if (isDropped)
+            DropoutMonitor::instance()->record(deck, DropoutMonitor::Dropped, track,
+                QString("jitter %1 ms, %2 of %3 dropped").arg(jitter / 1000000.0).arg(count).arg(processed + count));
+        else if (jitter > 0)
+            DropoutMonitor::instance()->record(deck, DropoutMonitor::Late, track,
+                QString("jitter %1 ms").arg(jitter / 1000000.0));
+        break;
+    }
+    case GST_MESSAGE_BUFFERING: {
+        gint percent = 100;
+        gst_message_parse_buffering(message, &percent);
+        // count the stalls, not every progress message
+        if (percent < 100 && !isBuffering && isStarted)
+            DropoutMonitor::instance()->record(deck, DropoutMonitor::Buffering, track,
+                QString("%1% buffered").arg(percent));
+        isBuffering = percent < 100;
+        break;
+    }
+    case GST_MESSAGE_WARNING: {
+        GError* err;
+        gchar* debug;
+        gst_message_parse_warning(message, &err, &debug);
+        QString text = QString::fromUtf8(err->message);
+        qDebug() << Q_FUNC_INFO << deck << ": Gstreamer warning:" << text;
+        if (QString::fromUtf8(GST_MESSAGE_SRC_NAME(message)).contains("sink"))
+            DropoutMonitor::instance()->record(deck, DropoutMonitor::Underrun, track, text);
+        g_error_free(err);
+        g_free(debug);
+        break;
+    }
+    default:
+        break;
+    }
+}
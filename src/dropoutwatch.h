@@ -0,0 +1,52 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DROPOUTWATCH_H
+#define DROPOUTWATCH_H
+
+#include <QString>
+
+#define GST_DISABLE_LOADSAVE 1
+#define GST_DISABLE_REGISTRY 1
+#define GST_DISABLE_DEPRECATED 1
+#include <gst/gst.h>
+
+/*
+ *  The bus side of the DropoutMonitor, shared by Player and MonitorPlayer.
+ *  enableQos() makes a sink post QoS messages, handleMessage() turns the
+ *  QoS, buffering and sink warning messages of a player bus into dropout
+ *  events. Runs in the bus sync handler, i.e. on the streaming threads.
+ */
+class DropoutWatch {
+public:
+    DropoutWatch();
+
+    /** For a bin like autoaudiosink QoS is enabled on the sink it adds */
+    static void enableQos(GstElement* sink);
+
+    /** Records QoS, buffering and sink warning messages, other messages
+        are ignored. Buffering counts only while the player is started */
+    void handleMessage(GstMessage* message, const QString& deck, const QString& track, bool isStarted);
+    /** A new track is opened, the QoS counters of the sink start over */
+    void reset();
+
+private:
+    guint64 dropped;
+    bool isBuffering;
+};
+
+#endif // DROPOUTWATCH_H
@@ -16,16 +16,22 @@
 */
 
 #include "knowthelist.h"
+#include "covercache.h"
 #include "dj.h"
 #include "djfilterwidget.h"
 #include "djwidget.h"
+#include "dropoutmonitor.h"
 #include "playerwidget.h"
 #include "playlistbrowser.h"
+#include "previewcache.h"
 #include "qled.h"
+#include "startupprofiler.h"
+#include "tracer.h"
 #include "ui_knowthelist.h"
 
 #include <QBoxLayout>
 #include <QSettings>
+#include <QShortcut>
 #if QT_VERSION >= 0x050000
 #include <QtConcurrent/QtConcurrent>
 #else
@@ -37,6 +43,7 @@ Knowthelist::Knowthelist(QWidget* parent)
     : QMainWindow(parent)
     , ui(new Ui::Knowthelist)
 {
+    StartupProfiler::phase("decks");
     ui->setupUi(this);
 
     //create the UI
@@ -75,6 +82,7 @@ Knowthelist::~Knowthelist()
 
 void Knowthelist::createUI()
 {
+    StartupProfiler::phase("mixer");
 
     //hide place holders
     ui->phVU1->setVisible(false);
@@ -91,11 +99,18 @@ void Knowthelist::createUI()
     //Add player
     player1 = ui->player_L;
     player2 = ui->player_R;
-    monitorPlayer = new MonitorPlayer(this);
+    monitorPlayer = nullptr;
+    deferredStep = 0;
+    deferredPending = 0;
+    isInitialized = false;
 
     timerAutoFader = new QTimer(this);
     connect(timerAutoFader, SIGNAL(timeout()), SLOT(timerAutoFader_timerOut()));
 
+    // write the trace timeline on demand
+    QShortcut* traceShortcut = new QShortcut(QKeySequence("Ctrl+Shift+T"), this);
+    connect(traceShortcut, SIGNAL(activated()), Tracer::instance(), SLOT(dump()));
+
     vuMeter2 = new VUMeter(ui->frameMixer);
     vuMeter2->setLinesPerSegment(2);
     vuMeter2->setSpacesBetweenSegments(1);
@@ -121,11 +136,6 @@ void Knowthelist::createUI()
     vuMeter2->setGeometry(ui->phVU2->geometry());
     monitorMeter->setGeometry(ui->phVUMeter->geometry());
 
-    ui->potGain_1->setRange(10, 180);
-    ui->potGain_1->setValue(100);
-    ui->potGain_2->setRange(10, 180);
-    ui->potGain_2->setValue(100);
-
     timerMonitor = new QTimer(this);
     timerMonitor->setInterval(50);
     connect(timerMonitor, SIGNAL(timeout()), SLOT(timerMonitor_timeOut()));
@@ -139,7 +149,18 @@ void Knowthelist::createUI()
 
     qRegisterMetaType<QList<Track*>>("QList<Track*>");
 
+    //both deck pipelines were built meanwhile, the pots reach them
+    StartupProfiler::phase("deck pipelines");
+    player1->waitForPlayer();
+    player2->waitForPlayer();
+
+    ui->potGain_1->setRange(10, 180);
+    ui->potGain_1->setValue(100);
+    ui->potGain_2->setRange(10, 180);
+    ui->potGain_2->setValue(100);
+
     //Add DJ
+    StartupProfiler::phase("dj session");
     djSession = new DjSession();
 
     playList1 = ui->playlist_L;
@@ -150,6 +171,8 @@ void Knowthelist::createUI()
 
     connect(playList1, SIGNAL(currentTrackChanged(Track*)), player1, SLOT(loadTrack(Track*)));
     connect(playList2, SIGNAL(currentTrackChanged(Track*)), player2, SLOT(loadTrack(Track*)));
+    connect(playList1, SIGNAL(nextTrackChanged(Track*)), player1, SLOT(setNextTrack(Track*)));
+    connect(playList2, SIGNAL(nextTrackChanged(Track*)), player2, SLOT(setNextTrack(Track*)));
 
     connect(player1, SIGNAL(forwardPressed()), playList1, SLOT(skipForward()));
     connect(player2, SIGNAL(forwardPressed()), playList2, SLOT(skipForward()));
@@ -191,6 +214,7 @@ void Knowthelist::createUI()
     connect(djSession, SIGNAL(changed_Playlist2(QPair<int, int>)), player2, SLOT(setInfo(QPair<int, int>)));
 
     //Add Tracklist for Collection
+    StartupProfiler::phase("collection");
     trackList = new Playlist();
     trackList->setObjectName("tracklist");
     trackList->setAcceptDrops(false);
@@ -245,8 +269,18 @@ void Knowthelist::createUI()
     ui->ledAGC->off();
     ui->ledDJ->off();
 
-    //MonitorPlayer
-    initMonitorPlayer();
+    //Dropouts, lit for a while after every glitch, details in the tool tip
+    ui->ledDropout->setLook(QLed::Flat);
+    ui->ledDropout->setShape(QLed::Rectangular);
+    ui->ledDropout->off();
+    timerDropout = new QTimer(this);
+    timerDropout->setSingleShot(true);
+    timerDropout->setInterval(10000);
+    connect(timerDropout, SIGNAL(timeout()), ui->ledDropout, SLOT(off()));
+    connect(DropoutMonitor::instance(), SIGNAL(dropout(QString, int)), SLOT(dropoutDetected(QString, int)));
+
+    //MonitorPlayer, prepared once the window is shown
+    ui->MonitorPlayer->setEnabled(false);
 
     //change slider style for linux
 #if defined(Q_OS_LINUX)
@@ -264,6 +298,7 @@ void Knowthelist::createUI()
 #endif
 
     //Add the AutoDJ Browser
+    StartupProfiler::phase("browsers");
     djBrowser = new DjBrowser();
     QPixmap pixmap2(":DJ.png");
     ui->sideTab->AddTab(djBrowser, QIcon(pixmap2), tr("AutoDJ"));
@@ -271,6 +306,7 @@ void Knowthelist::createUI()
     connect(djBrowser, SIGNAL(selectionChanged(Dj*)), djSession, SLOT(setCurrentDj(Dj*)));
     connect(djBrowser, SIGNAL(selectionChanged(Dj*)), this, SLOT(currentDjChanged(Dj*)));
     connect(djBrowser, SIGNAL(selectionStarted()), this, SLOT(startAutoDj()));
+    connect(djBrowser, SIGNAL(tagsLoaded()), this, SLOT(deferredFinished()));
 
     //Add the FileBrowser
     filetree = new FileBrowser(this);
@@ -289,10 +325,12 @@ void Knowthelist::createUI()
     trackList2->setPlaylistMode(Playlist::Tracklist);
 
     connect(playlistBrowser, SIGNAL(selectionChanged(QList<Track*>)), trackList2, SLOT(changeTracks(QList<Track*>)));
+    connect(playlistBrowser, SIGNAL(selectionExtended(QList<Track*>)), trackList2, SLOT(appendTracks(QList<Track*>)));
     connect(playlistBrowser, SIGNAL(selectionStarted(QList<Track*>)), djSession, SLOT(forceTracks(QList<Track*>)));
     //connect(playlistBrowser,SIGNAL(savePlaylists(QString)),djSession, SLOT(savePlaylists(QString)));
     connect(playlistBrowser, SIGNAL(storePlaylists(QString)), djSession, SLOT(storePlaylists(QString)));
     connect(djSession, SIGNAL(savedPlaylists()), playlistBrowser, SLOT(updateLists()));
+    connect(playlistBrowser, SIGNAL(listsUpdated()), this, SLOT(deferredFinished()));
     connect(trackList2, SIGNAL(trackDoubleClicked(Track*)), SLOT(Track_doubleClicked(Track*)));
     connect(trackList2, SIGNAL(wantLoad(Track*, QString)), SLOT(trackList_wantLoad(Track*, QString)));
     connect(trackList2, SIGNAL(trackSelected(Track*)), SLOT(Track_selectionChanged(Track*)));
@@ -307,11 +345,15 @@ void Knowthelist::createUI()
     connect(preferences, SIGNAL(scanNowPressed()), collectionBrowser, SLOT(scan()));
     connect(preferences, SIGNAL(resetStatsPressed()), djSession, SLOT(onResetStats()));
 
+    StartupProfiler::phase("settings");
     loadStartSettings();
 
     ui->sideTab->SetCurrentIndex(0);
     ui->sideTab->SetMode(FancyTabWidget::Mode_LargeSidebar);
 
+    // the rest is not visible at first sight
+    QTimer::singleShot(0, this, SLOT(initDeferred()));
+
     //Collection ready?
     if (!collectionBrowser->hasItems()) {
         this->show();
@@ -357,7 +399,7 @@ void Knowthelist::loadStartSettings()
 
     loadCurrentSettings();
 
-    //now monitorplayer is initialized, restore monitor volume with effect
+    //applied to the monitor player once it is prepared
     ui->sliMonitorVolume->setValue(settings.value("VolumeMonitor").toDouble());
 }
 
@@ -365,20 +407,8 @@ void Knowthelist::loadCurrentSettings()
 {
     QSettings settings;
 
-    if (monitorPlayer) {
-        on_cmdMonitorStop_clicked();
-
-        monitorPlayer->setOutputDevice(settings.value("MonitorOutputDevice").toString());
-        QString outDev = monitorPlayer->outputDeviceName();
-        if (monitorPlayer->outputDeviceID() == monitorPlayer->defaultDeviceID()
-            || outDev.isEmpty()) {
-            ui->lblSoundcard->show();
-            monitorPlayer->disable();
-        } else {
-            ui->lblSoundcard->hide();
-            monitorPlayer->enable();
-        }
-    }
+    if (monitorPlayer)
+        loadMonitorSettings();
 
     //Auto DJ Settings
     djSession->setMinCount(settings.value("minTracks", "6").toInt());
@@ -387,7 +417,8 @@ void Knowthelist::loadCurrentSettings()
 
     playList1->setAutoClearOn(settings.value("checkAutoRemove", true).toBool());
     playList2->setAutoClearOn(settings.value("checkAutoRemove", true).toBool());
-    playlistBrowser->updateLists();
+    if (isInitialized)
+        playlistBrowser->updateLists();
 
     //Skip Silents Settings
     player1->setSkipSilentEnd(settings.value("checkSkipSilentEnd", true).toBool());
@@ -408,6 +439,59 @@ void Knowthelist::loadCurrentSettings()
     filetree->setRootPath(settings.value("editBrowerRoot", "").toString());
 }
 
+void Knowthelist::loadMonitorSettings()
+{
+    QSettings settings;
+
+    on_cmdMonitorStop_clicked();
+
+    monitorPlayer->setOutputDevice(settings.value("MonitorOutputDevice").toString());
+    QString outDev = monitorPlayer->outputDeviceName();
+    if (monitorPlayer->outputDeviceID() == monitorPlayer->defaultDeviceID()
+        || outDev.isEmpty()) {
+        ui->lblSoundcard->show();
+        monitorPlayer->disable();
+    } else {
+        ui->lblSoundcard->hide();
+        monitorPlayer->enable();
+    }
+}
+
+void Knowthelist::initDeferred()
+{
+    // the slow parts run on workers and report back to deferredFinished()
+    // through queued signals, the event loop keeps running meanwhile
+    if (deferredStep++ == 0) {
+        StartupProfiler::phase("deferred");
+        deferredPending = 3;
+        initMonitorPlayer();
+        djBrowser->loadTags();
+        playlistBrowser->updateLists();
+        QTimer::singleShot(0, this, SLOT(initDeferred()));
+    } else {
+        // a whole pass of the event loop got through after the start
+        StartupProfiler::interactive();
+    }
+}
+
+void Knowthelist::deferredFinished()
+{
+    // later reloads of the lists report here too
+    if (isInitialized || --deferredPending > 0)
+        return;
+    isInitialized = true;
+    StartupProfiler::finished();
+}
+
+void Knowthelist::monitorPlayerPrepared()
+{
+    monitorPlayer = qobject_cast<MonitorPlayer*>(sender());
+    loadMonitorSettings();
+    on_sliMonitorVolume_valueChanged(ui->sliMonitorVolume->value());
+    ui->MonitorPlayer->setEnabled(true);
+    deferredFinished();
+}
+
 void Knowthelist::closeEvent(QCloseEvent* event)
 {
     qDebug() << Q_FUNC_INFO << "for Knowthelist";
@@ -552,9 +636,12 @@ void Knowthelist::fadeNow()
         }
 
         isFading = true;
+        if (Tracer::isEnabled())
+            Tracer::instance()->instant("fade", "start");
 
         //ToDo: search for a right time to save
-        savePlaylists();
+        // saved on every fade, coalesce these saves
+        savePlaylists(QSettings().value("PlaylistSaveDelay", 3000).toInt());
     }
 }
 
@@ -600,8 +687,12 @@ void Knowthelist::sliFader_valueChanged(int)
 void Knowthelist::timerAutoFader_timerOut()
 
 {
+    TraceZone zone("fade", "step");
+
     //Auto-Fader moves
     ui->sliFader->setValue(ui->sliFader->value() + m_xfadeDir);
+    if (Tracer::isEnabled())
+        Tracer::instance()->counter("fade", "fader", ui->sliFader->value());
 
     //Blinking
     if (ui->sliFader->value() % 3 == 0) {
@@ -643,14 +734,19 @@ void Knowthelist::timerAutoFader_timerOut()
     changeVolumes();
 }
 
-void Knowthelist::savePlaylists()
+void Knowthelist::savePlaylists(int delay)
 {
-    djSession->storePlaylists("defaultKnowthelist", true);
+    djSession->storePlaylists("defaultKnowthelist", true, delay);
     //    playList1->saveXML( playList1->defaultPlaylistPath() );
     //    playList2->saveXML( playList2->defaultPlaylistPath() );
 }
 
 void Knowthelist::Track_selectionChanged(Track* track)
+{
+    loadMonitor(track, false);
+}
+
+void Knowthelist::loadMonitor(Track* track, bool preview)
 {
     if (track) {
 
@@ -661,10 +757,19 @@ void Knowthelist::Track_selectionChanged(Track* track)
 
         if (monitorPlayer) {
             on_cmdMonitorStop_clicked();
-            monitorPlayer->open(track->url());
-            QPixmap pix = QPixmap::fromImage(track->coverImage());
-            if (!pix.isNull())
-                ui->pixMonitorCover->setPixmap(pix);
+            // a decoded snippet starts where the pre-listen seek would go
+            QSharedPointer<PcmTrack> snippet;
+            if (preview)
+                snippet = PreviewCache::instance()->snippet(track->url());
+            if (snippet) {
+                monitorPlayer->openPreview(snippet);
+            } else {
+                monitorPlayer->open(track->url());
+                wantSeek = preview;
+                PreviewCache::instance()->prefer(track->url());
+            }
+            m_MonitorCoverTrack = *track;
+            CoverCache::instance()->requestCover(track->url());
             timerMonitor_timeOut();
         }
     } else {
@@ -673,6 +778,18 @@ void Knowthelist::Track_selectionChanged(Track* track)
     }
 }
 
+void Knowthelist::monitorCover_ready(const QUrl& url, const QImage& image)
+{
+    // skip covers of tracks the user has already moved away from
+    if (m_MonitorCoverTrack.url() != url)
+        return;
+
+    if (image.isNull())
+        ui->pixMonitorCover->setPixmap(QPixmap::fromImage(m_MonitorCoverTrack.defaultImage()));
+    else
+        ui->pixMonitorCover->setPixmap(QPixmap::fromImage(image));
+}
+
 void Knowthelist::timerMonitor_loadFinished()
 {
     timerMonitor_timeOut();
@@ -683,11 +800,9 @@ void Knowthelist::timerMonitor_loadFinished()
 
 void Knowthelist::Track_doubleClicked(Track* track)
 {
-    Track_selectionChanged(track);
-    if (monitorPlayer) {
-        wantSeek = true;
+    loadMonitor(track, true);
+    if (monitorPlayer)
         on_cmdMonitorPlay_clicked();
-    }
 }
 
 void Knowthelist::trackList_wantLoad(Track* track, QString target)
@@ -730,9 +845,11 @@ void Knowthelist::editSettings()
     djBrowser->saveSettings();
 
     // update hardware infos
-    monitorPlayer->readDevices();
     QSettings settings;
-    settings.setValue("MonitorOutputDevices", monitorPlayer->outputDevices());
+    if (monitorPlayer) {
+        monitorPlayer->readDevices();
+        settings.setValue("MonitorOutputDevices", monitorPlayer->outputDevices());
+    }
 
     if (preferences->exec() != QDialog::Rejected)
         loadCurrentSettings();
@@ -748,13 +865,18 @@ bool Knowthelist::initMonitorPlayer()
     //ToDo: spend a separate widget for Monitor player
     qDebug() << Q_FUNC_INFO << "BEGIN ";
 
-    monitorPlayer = new MonitorPlayer(this);
-    monitorPlayer->prepare();
-    monitorPlayer->setObjectName("monitorPlayer");
+    // set once the pipeline is prepared, the controls stay disabled until then
+    MonitorPlayer* player = new MonitorPlayer(this);
+    player->setObjectName("monitorPlayer");
+    connect(player, SIGNAL(prepared()), this, SLOT(monitorPlayerPrepared()));
+    player->prepareAsync();
+    PreviewCache::instance();
 
     ui->cmdMonitorStop->setIcon(QIcon(":stop.png"));
     ui->cmdMonitorPlay->setIcon(QIcon(":play.png"));
-    connect(monitorPlayer, SIGNAL(loadFinished()), this, SLOT(timerMonitor_loadFinished()));
+    connect(player, SIGNAL(loadFinished()), this, SLOT(timerMonitor_loadFinished()));
+    connect(CoverCache::instance(), SIGNAL(coverReady(QUrl, QImage)),
+        this, SLOT(monitorCover_ready(QUrl, QImage)));
 
     qDebug() << Q_FUNC_INFO << "END ";
     return true;
@@ -983,5 +1105,15 @@ void Knowthelist::on_sliMonitor_actionTriggered(int action)
 
 void Knowthelist::on_sliMonitorVolume_valueChanged(int value)
 {
-    monitorPlayer->setVolume(value / 100.0);
+    if (monitorPlayer)
+        monitorPlayer->setVolume(value / 100.0);
+}
+
+void Knowthelist::dropoutDetected(const QString& deck, int kind)
+{
+    Q_UNUSED(deck);
+    Q_UNUSED(kind);
+    ui->ledDropout->on();
+    ui->ledDropout->setToolTip(DropoutMonitor::instance()->summary());
+    timerDropout->start();
 }
@@ -76,7 +76,7 @@ private Q_SLOTS:
     void slider2_valueChanged(int);
     void sliFader_valueChanged(int);
 
-    void savePlaylists();
+    void savePlaylists(int delay = 0);
     void monitorPlayer_trackTimeChanged(qint64, qint64);
     void timerMonitor_loadFinished();
     void startAutoDj();
@@ -87,6 +87,7 @@ private Q_SLOTS:
     void Track_doubleClicked(Track*);
     void trackList_wantLoad(Track*, QString target);
     void Track_selectionChanged(Track*);
+    void monitorCover_ready(const QUrl& url, const QImage& image);
     bool initMonitorPlayer();
     void editSettings();
     void on_cmdOptions_clicked();
@@ -98,11 +99,18 @@ private Q_SLOTS:
 
     void on_sliMonitorVolume_valueChanged(int value);
 
+    void dropoutDetected(const QString& deck, int kind);
+
+    void initDeferred();
+    void monitorPlayerPrepared();
+    void deferredFinished();
+
 private:
     Ui::Knowthelist* ui;
     void createUI();
     void fadeNow();
     void setFaderModeToPlayer();
+    void loadMonitor(Track* track, bool preview);
     QTimer* timerAutoFader;
     int m_xfadeDir;
     int gain1Target;
@@ -115,6 +123,7 @@ private:
     QTimer* timerMonitor;
     QTimer* timerGain1;
     QTimer* timerGain2;
+    QTimer* timerDropout;
     Playlist* playList1;
     Playlist* playList2;
     Playlist* trackList;
@@ -142,7 +151,11 @@ private:
     int mAboutFinishTime;
     int mMinTracks;
     bool wantSeek;
+    int deferredStep;
+    int deferredPending;
+    bool isInitialized;
     Track* m_MonitorTrack;
+    Track m_MonitorCoverTrack;
 
 protected:
     virtual void closeEvent(QCloseEvent*);
@@ -150,6 +163,7 @@ protected:
     void changeVolumes();
     void loadStartSettings();
     void loadCurrentSettings();
+    void loadMonitorSettings();
 };
 
 #endif // KNOWTHELIST_H
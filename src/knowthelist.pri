@@ -0,0 +1,103 @@
+#
+# Knowthelist
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Sources of the application without main.cpp, shared with the tools in bench/.
+# The core without widgets is in core.pri and the knowthelist-core library.
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/knowthelist.cpp \
+    $$PWD/player.cpp \
+    $$PWD/vumeter.cpp \
+    $$PWD/playerwidget.cpp \
+    $$PWD/qled.cpp \
+    $$PWD/playlistitem.cpp \
+    $$PWD/playlist.cpp \
+    $$PWD/progressbar.cpp \
+    $$PWD/settingsdialog.cpp \
+    $$PWD/djsession.cpp \
+    $$PWD/djhistory.cpp \
+    $$PWD/dj.cpp \
+    $$PWD/filter.cpp \
+    $$PWD/djwidget.cpp \
+    $$PWD/djfilterwidget.cpp \
+    $$PWD/fancytabwidget.cpp \
+    $$PWD/stylehelper.cpp \
+    $$PWD/filebrowser.cpp \
+    $$PWD/collectionwidget.cpp \
+    $$PWD/collectiontree.cpp \
+    $$PWD/collectiontreeitem.cpp \
+    $$PWD/monitorplayer.cpp \
+    $$PWD/collectionsetupmodel.cpp \
+    $$PWD/stackdisplay.cpp \
+    $$PWD/djsettings.cpp \
+    $$PWD/modeselector.cpp \
+    $$PWD/playlistbrowser.cpp \
+    $$PWD/playlistwidget.cpp \
+    $$PWD/djbrowser.cpp \
+    $$PWD/ratingwidget.cpp \
+    $$PWD/customdial.cpp \
+    $$PWD/covercache.cpp \
+    $$PWD/playlistwriter.cpp \
+    $$PWD/playlistfile.cpp \
+    $$PWD/dropoutmonitor.cpp \
+    $$PWD/dropoutwatch.cpp \
+    $$PWD/pcmcache.cpp \
+    $$PWD/pcmdecoder.cpp \
+    $$PWD/pcmfeeder.cpp \
+    $$PWD/previewcache.cpp \
+    $$PWD/startupprofiler.cpp
+HEADERS += \
+    $$PWD/knowthelist.h \
+    $$PWD/vumeter.h \
+    $$PWD/playerwidget.h \
+    $$PWD/qled.h \
+    $$PWD/playlistitem.h \
+    $$PWD/playlist.h \
+    $$PWD/player.h \
+    $$PWD/progressbar.h \
+    $$PWD/settingsdialog.h \
+    $$PWD/djsession.h \
+    $$PWD/djhistory.h \
+    $$PWD/dj.h \
+    $$PWD/filter.h \
+    $$PWD/djwidget.h \
+    $$PWD/djfilterwidget.h \
+    $$PWD/fancytabwidget.h \
+    $$PWD/stylehelper.h \
+    $$PWD/filebrowser.h \
+    $$PWD/collectionwidget.h \
+    $$PWD/collectiontree.h \
+    $$PWD/collectiontreeitem.h \
+    $$PWD/monitorplayer.h \
+    $$PWD/collectionsetupmodel.h \
+    $$PWD/stackdisplay.h \
+    $$PWD/djsettings.h \
+    $$PWD/modeselector.h \
+    $$PWD/playlistbrowser.h \
+    $$PWD/playlistwidget.h \
+    $$PWD/djbrowser.h \
+    $$PWD/ratingwidget.h \
+    $$PWD/customdial.h \
+    $$PWD/covercache.h \
+    $$PWD/playlistwriter.h \
+    $$PWD/playlistfile.h \
+    $$PWD/dropoutmonitor.h \
+    $$PWD/dropoutwatch.h \
+    $$PWD/pcmcache.h \
+    $$PWD/pcmdecoder.h \
+    $$PWD/pcmfeeder.h \
+    $$PWD/previewcache.h \
+    $$PWD/startupprofiler.h
+FORMS += \
+    $$PWD/settingsdialog.ui \
+    $$PWD/djwidget.ui \
+    $$PWD/djfilterwidget.ui \
+    $$PWD/playerwidget.ui \
+    $$PWD/knowthelist.ui \
+    $$PWD/djsettings.ui \
+    $$PWD/modeselector.ui \
+    $$PWD/playlistwidget.ui
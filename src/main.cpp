@@ -16,6 +16,8 @@
 */
 
 #include "knowthelist.h"
+#include "startupprofiler.h"
+#include "tracer.h"
 
 #include <QApplication>
 #include <QMessageBox>
@@ -38,6 +40,10 @@ int main(int argc, char* argv[])
     QCoreApplication::setApplicationName("knowthelist");
     QCoreApplication::setApplicationVersion("2.3.1");
 
+    // before any thread can record
+    Tracer::instance();
+    StartupProfiler::phase("translations");
+
     QSettings settings;
     QStringList languages;
     languages << ""
@@ -61,6 +67,7 @@ int main(int argc, char* argv[])
              << ":knowthelist_" + lang + ".qm result:" << result;
     a.installTranslator(&localization);
 
+    StartupProfiler::phase("database");
     if (!QSqlDatabase::drivers().contains("QSQLITE")) {
 #if QT_VERSION >= 0x050000
         QMessageBox::critical(nullptr, QObject::tr("Unable to load database"),
@@ -94,7 +101,9 @@ int main(int argc, char* argv[])
         return 1;
     }
     qDebug() << "load database: " << db.databaseName();
+    StartupProfiler::phase("window");
     Knowthelist w;
+    StartupProfiler::phase("show");
     w.show();
 
     return a.exec();
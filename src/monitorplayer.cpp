@@ -29,6 +29,13 @@
 #endif
 
 #include "monitorplayer.h"
+#include "dropoutmonitor.h"
+#include "dropoutwatch.h"
+#include "pcmcache.h"
+#include "pcmfeeder.h"
+#include "tracer.h"
+
+static MonitorPlayer::SinkFactory sinkFactory = nullptr;
 
 void MonitorPlayer::sync_set_state(GstElement* element, GstState state)
 {
@@ -91,10 +98,16 @@ void MonitorPlayer::newpad(GstElement* src,
 
 struct MonitorPlayerPrivate {
     QFutureWatcher<void> watcher;
+    QFutureWatcher<bool> prepareWatcher;
     QMutex mutex;
     bool isStarted;
     bool isLoaded;
     bool isDisabled;
+    // QoS, buffering and warnings of the bus, for the DropoutMonitor
+    DropoutWatch dropouts;
+    // written on open, read for the dropout log by the streaming threads
+    QMutex urlMutex;
+    QString url;
     QString error;
     QString deviceName;
     QString deviceID;
@@ -104,6 +117,10 @@ struct MonitorPlayerPrivate {
     dsDevice dev;
     double rms_l;
     double rms_r;
+    // the snippet feed and the latest open, the streaming thread reads while the others stop it
+    PcmFeeder feeder;
+    QMutex generationMutex;
+    int generation;
 };
 
 MonitorPlayer::MonitorPlayer(QWidget* parent)
@@ -116,14 +133,17 @@ MonitorPlayer::MonitorPlayer(QWidget* parent)
 {
     p->isStarted = false;
     p->isLoaded = false;
+    p->generation = 0;
     readDevices();
     p->deviceID = defaultDeviceID();
 
     connect(&p->watcher, SIGNAL(finished()), this, SLOT(loadThreadFinished()));
+    connect(&p->prepareWatcher, SIGNAL(finished()), this, SIGNAL(prepared()));
 }
 
 MonitorPlayer::~MonitorPlayer()
 {
+    p->prepareWatcher.waitForFinished();
     cleanup();
     delete p;
     p = nullptr;
@@ -140,6 +160,7 @@ GstBusSyncReply MonitorPlayer::bus_cb(GstBus* bus, GstMessage* msg, gpointer dat
 
 void MonitorPlayer::cleanup()
 {
+    p->feeder.setFeeding(false);
     if (pipeline)
         sync_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
     if (bus)
@@ -148,6 +169,11 @@ void MonitorPlayer::cleanup()
         gst_object_unref(G_OBJECT(pipeline));
 }
 
+void MonitorPlayer::setSinkFactory(SinkFactory factory)
+{
+    sinkFactory = factory;
+}
+
 bool MonitorPlayer::prepare()
 {
     // Init Gst
@@ -156,6 +182,7 @@ bool MonitorPlayer::prepare()
     QString caps_value;
 
     gst_init(nullptr, nullptr);
+    DropoutMonitor::instance();
 
     //prepare
     GstElement *src, *conv, *resample, *sink, *level, *vol;
@@ -172,12 +199,16 @@ bool MonitorPlayer::prepare()
     caps = gst_caps_new_simple(caps_value.toLatin1().data(),
         "channels", G_TYPE_INT, 2, NULL);
     g_signal_connect(src, "pad-added", G_CALLBACK(cb_newpad_mp), this);
+    p->feeder.attach(src);
 
     conv = gst_element_factory_make("audioconvert", "convert");
     vol = gst_element_factory_make("volume", "volume");
     resample = gst_element_factory_make("audioresample", "resample");
     level = gst_element_factory_make("level", "level");
 
+    if (sinkFactory) {
+        sink = sinkFactory("sink");
+    } else {
 #if defined(Q_OS_DARWIN)
     sink = gst_element_factory_make("osxaudiosink", "sink");
     g_object_set(sink, "device", 0, NULL);
@@ -194,6 +225,8 @@ bool MonitorPlayer::prepare()
     sink = gst_element_factory_make("fakesink", "sink");
     g_object_set(sink, "device", NULL, NULL);
 #endif
+    }
+    DropoutWatch::enableQos(sink);
 
     gst_bin_add_many(GST_BIN(pipeline), src, conv, resample, level, vol, sink, NULL);
     gst_element_link(conv, resample);
@@ -215,6 +248,13 @@ bool MonitorPlayer::prepare()
     return pipeline;
 }
 
+void MonitorPlayer::prepareAsync()
+{
+    // the singleton belongs to this thread, the pipeline is built by a worker
+    DropoutMonitor::instance();
+    p->prepareWatcher.setFuture(QtConcurrent::run(this, &MonitorPlayer::prepare));
+}
+
 bool MonitorPlayer::ready()
 {
     return pipeline;
@@ -225,31 +265,90 @@ void MonitorPlayer::open(QUrl url)
     if (p->isDisabled) {
         return;
     }
-    // To avoid delays, load track in another thread
     qDebug() << Q_FUNC_INFO << ":" << parentWidget()->objectName() << " url=" << url;
-    QFuture<void> future = QtConcurrent::run(this, &MonitorPlayer::asyncOpen, url);
+    start(url, QSharedPointer<PcmTrack>(), QTime(0, 0));
+}
+
+void MonitorPlayer::openPreview(QSharedPointer<PcmTrack> snippet)
+{
+    if (p->isDisabled || !snippet)
+        return;
+    qDebug() << Q_FUNC_INFO << ":" << parentWidget()->objectName() << " url=" << snippet->url();
+    start(snippet->url(), snippet, QTime(0, 0).addMSecs(snippet->offset() / GST_MSECOND));
+}
+
+void MonitorPlayer::start(QUrl url, QSharedPointer<PcmTrack> snippet, QTime position)
+{
+    // To avoid delays, load track in another thread
+    p->generationMutex.lock();
+    int generation = ++p->generation;
+    p->generationMutex.unlock();
+    QFuture<void> future = QtConcurrent::run(this, &MonitorPlayer::asyncOpen, url, snippet, position, generation);
     p->watcher.setFuture(future);
 }
 
-void MonitorPlayer::asyncOpen(QUrl url)
+void MonitorPlayer::asyncOpen(QUrl url, QSharedPointer<PcmTrack> snippet, QTime position, int generation)
 {
+    TraceZone zone("monitor", "open");
+    if (zone.isActive())
+        zone.setDetail(parentWidget()->objectName() + " " + url.toString() + (snippet ? " preview" : ""));
     p->mutex.lock();
+
+    // a quick click sequence queues opens, only the latest one counts
+    p->generationMutex.lock();
+    bool isLatest = generation == p->generation;
+    p->generationMutex.unlock();
+    if (!isLatest) {
+        p->mutex.unlock();
+        return;
+    }
+
     p->length = 0;
     p->isLoaded = false;
+    p->dropouts.reset();
+    p->urlMutex.lock();
+    p->url = url.toString();
+    p->urlMutex.unlock();
     p->error = "";
 
+    p->feeder.setFeeding(false);
     sync_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
 
+    p->feeder.setTrack(snippet);
+    if (snippet)
+        p->length = static_cast<uint>(snippet->trackLength() / GST_MSECOND);
+
     GstElement* src = gst_bin_get_by_name(GST_BIN(pipeline), "source");
-    g_object_set(G_OBJECT(src), "uri", (const char*)url.toString().toUtf8(), NULL);
+    QString uri = snippet ? QString("appsrc://") : url.toString();
+    g_object_set(G_OBJECT(src), "uri", (const char*)uri.toUtf8(), NULL);
 
     sync_set_state(GST_ELEMENT(pipeline), GST_STATE_PAUSED);
-    setPosition(QTime(0, 0));
+    setPosition(position);
 
     gst_object_unref(src);
     p->mutex.unlock();
 }
 
+QSharedPointer<PcmTrack> MonitorPlayer::preview()
+{
+    return p->feeder.track();
+}
+
+QString MonitorPlayer::currentUrl()
+{
+    QMutexLocker locker(&p->urlMutex);
+    return p->url;
+}
+
+void MonitorPlayer::continueFromFile()
+{
+    QSharedPointer<PcmTrack> snippet = preview();
+    if (!snippet)
+        return;
+    qint64 end = snippet->offset() + snippet->duration();
+    start(snippet->url(), QSharedPointer<PcmTrack>(), QTime(0, 0).addMSecs(end / GST_MSECOND));
+}
+
 void MonitorPlayer::loadThreadFinished()
 {
     // async load in MonitorPlayerGst done
@@ -274,7 +373,9 @@ void MonitorPlayer::play()
 void MonitorPlayer::stop()
 {
     p->isStarted = false;
+    p->feeder.setFeeding(false);
     gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_READY);
+    p->feeder.setFeeding(true);
 }
 
 void MonitorPlayer::pause()
@@ -287,17 +388,33 @@ void MonitorPlayer::pause()
 
 bool MonitorPlayer::close()
 {
+    p->feeder.setFeeding(false);
     gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
+    p->feeder.setFeeding(true);
     return true;
 }
 
 void MonitorPlayer::setPosition(QTime position)
 {
+    TraceZone zone("monitor", "seek");
     int time_milliseconds = QTime(0, 0).msecsTo(position);
     gint64 time_nanoseconds = (time_milliseconds * GST_MSECOND);
+
+    // a snippet covers only part of the track, beyond it the file plays
+    QSharedPointer<PcmTrack> snippet = preview();
+    if (snippet) {
+        time_nanoseconds -= snippet->offset();
+        if (time_nanoseconds < 0 || time_nanoseconds >= snippet->duration()) {
+            start(snippet->url(), QSharedPointer<PcmTrack>(), position);
+            return;
+        }
+    }
+
+    p->feeder.setFeeding(false);
     gst_element_seek(pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
         GST_SEEK_TYPE_SET, time_nanoseconds,
         GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
+    p->feeder.setFeeding(true);
     p->position = time_milliseconds;
     emit positionChanged();
 }
@@ -314,6 +431,9 @@ QTime MonitorPlayer::position()
         GstFormat fmt = GST_FORMAT_TIME;
         if (gst_element_query_position(pipeline, &fmt, &value)) {
 #endif
+            QSharedPointer<PcmTrack> snippet = preview();
+            if (snippet)
+                value += snippet->offset();
             p->position = static_cast<uint>((value / GST_MSECOND));
             return QTime(0, 0).addMSecs(p->position); // nanosec -> msec
         }
@@ -559,9 +679,19 @@ void MonitorPlayer::messageReceived(GstMessage* message)
         }
         break;
     }
+    case GST_MESSAGE_QOS:
+    case GST_MESSAGE_BUFFERING:
+    case GST_MESSAGE_WARNING:
+        p->dropouts.handleMessage(message, "monitor", currentUrl(), p->isStarted);
+        break;
     case GST_MESSAGE_EOS: {
         qDebug() << Q_FUNC_INFO << ":" << parentWidget()->objectName() << " End of track reached";
-        Q_EMIT finish();
+        if (Tracer::isEnabled())
+            Tracer::instance()->instant("monitor", "end of stream");
+        if (preview())
+            QMetaObject::invokeMethod(this, "continueFromFile", Qt::QueuedConnection);
+        else
+            Q_EMIT finish();
         break;
     }
     case GST_MESSAGE_STATE_CHANGED: {
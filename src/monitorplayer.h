@@ -31,6 +31,8 @@
 #define GST_DISABLE_DEPRECATED 1
 #include <gst/gst.h>
 
+class PcmTrack;
+
 typedef QPair<QString, QUuid> dsDevice;
 
 
@@ -42,10 +44,19 @@ public:
     ~MonitorPlayer();
 
 
+     /** Makes the audio sink of the following prepare() calls instead of
+         the platform sink, e.g. a fakesink for runs without a sound card */
+     typedef GstElement* (*SinkFactory)(const char* name);
+     static void setSinkFactory(SinkFactory factory);
+
      bool prepare();
+     /** Runs prepare() in a worker, prepared() is emitted when it is done */
+     void prepareAsync();
      bool ready();
      bool canOpen(QString mime);
      void open(QUrl url);
+     /** Plays a decoded snippet from memory, the file takes over at its end */
+     void openPreview(QSharedPointer<PcmTrack> snippet);
      void play();
      void stop();
      void pause();
@@ -79,8 +90,10 @@ public:
         void levelChanged();
         void positionChanged();
         void loadFinished();
+        void prepared();
  private slots:
         void loadThreadFinished();
+        void continueFromFile();
         void messageReceived(GstMessage* message);
 
  private:
@@ -91,7 +104,10 @@ public:
         gint64 Gstart;
         gint64 Glength;
         void setLink(int, QUrl&);
-        void asyncOpen(QUrl url);
+        void start(QUrl url, QSharedPointer<PcmTrack> snippet, QTime position);
+        void asyncOpen(QUrl url, QSharedPointer<PcmTrack> snippet, QTime position, int generation);
+        QSharedPointer<PcmTrack> preview();
+        QString currentUrl();
         void cleanup();
         void sync_set_state(GstElement*, GstState);
 
@@ -0,0 +1,520 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pcmcache.h"
+#include "pcmdecoder.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSettings>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <qdebug.h>
+
+struct PcmTrackPrivate {
+    QUrl url;
+    PcmTrack::SampleFormat format;
+    QMutex mutex;
+    QWaitCondition changed;
+    QByteArray data;
+    qint64 duration;
+    qint64 offset;
+    qint64 trackLength;
+    bool ready;
+    bool finished;
+    bool failed;
+    bool cancelled;
+};
+
+PcmTrack::PcmTrack(const QUrl& url, SampleFormat format)
+    : p(new PcmTrackPrivate)
+{
+    p->url = url;
+    p->format = format;
+    p->duration = 0;
+    p->offset = 0;
+    p->trackLength = 0;
+    p->ready = false;
+    p->finished = false;
+    p->failed = false;
+    p->cancelled = false;
+}
+
+PcmTrack::~PcmTrack()
+{
+    delete p;
+}
+
+QUrl PcmTrack::url() const
+{
+    return p->url;
+}
+
+PcmTrack::SampleFormat PcmTrack::format() const
+{
+    return p->format;
+}
+
+int PcmTrack::bytesPerFrame() const
+{
+    return channels() * (p->format == Float32 ? 4 : 2);
+}
+
+QString PcmTrack::caps() const
+{
+    bool littleEndian = G_BYTE_ORDER == G_LITTLE_ENDIAN;
+#ifdef GST_API_VERSION_1
+    return QString("audio/x-raw, format=(string)%1, layout=(string)interleaved, rate=(int)%2, channels=(int)%3")
+        .arg(p->format == Float32 ? (littleEndian ? "F32LE" : "F32BE") : (littleEndian ? "S16LE" : "S16BE"))
+        .arg(rate())
+        .arg(channels());
+#else
+    if (p->format == Float32)
+        return QString("audio/x-raw-float, endianness=(int)%1, width=(int)32, rate=(int)%2, channels=(int)%3")
+            .arg(littleEndian ? 1234 : 4321)
+            .arg(rate())
+            .arg(channels());
+    return QString("audio/x-raw-int, endianness=(int)%1, signed=(boolean)true, width=(int)16, depth=(int)16, rate=(int)%2, channels=(int)%3")
+        .arg(littleEndian ? 1234 : 4321)
+        .arg(rate())
+        .arg(channels());
+#endif
+}
+
+bool PcmTrack::waitReady(int timeout)
+{
+    QMutexLocker locker(&p->mutex);
+    QElapsedTimer timer;
+    timer.start();
+    while (!p->ready && timer.elapsed() < timeout)
+        p->changed.wait(&p->mutex, qMax(1, int(timeout - timer.elapsed())));
+    return p->ready && !p->failed;
+}
+
+qint64 PcmTrack::duration()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->duration;
+}
+
+qint64 PcmTrack::offset()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->offset;
+}
+
+qint64 PcmTrack::trackLength()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->trackLength > 0 ? p->trackLength : p->duration;
+}
+
+qint64 PcmTrack::size()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->data.size();
+}
+
+bool PcmTrack::isFinished()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->finished;
+}
+
+bool PcmTrack::isFailed()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->failed;
+}
+
+qint64 PcmTrack::read(qint64 offset, char* data, qint64 size, int timeout)
+{
+    QMutexLocker locker(&p->mutex);
+    if (p->data.size() <= offset && !p->finished)
+        p->changed.wait(&p->mutex, timeout);
+
+    qint64 available = p->data.size() - offset;
+    if (available > 0) {
+        qint64 count = qMin(size, available);
+        memcpy(data, p->data.constData() + offset, count);
+        return count;
+    }
+    return p->finished ? 0 : -1;
+}
+
+void PcmTrack::setDuration(qint64 duration)
+{
+    QMutexLocker locker(&p->mutex);
+    p->duration = duration;
+    // one allocation for the whole track, the readers copy while it grows
+    qint64 estimate = duration / 1000000 * rate() / 1000 * bytesPerFrame();
+    if (estimate > p->data.size() && estimate < Q_INT64_C(0x70000000))
+        p->data.reserve(estimate);
+    p->ready = true;
+    p->changed.wakeAll();
+}
+
+void PcmTrack::setSpan(qint64 offset, qint64 trackLength)
+{
+    QMutexLocker locker(&p->mutex);
+    p->offset = offset;
+    p->trackLength = trackLength;
+}
+
+void PcmTrack::append(const char* data, qint64 size)
+{
+    QMutexLocker locker(&p->mutex);
+    p->data.append(data, size);
+    p->changed.wakeAll();
+}
+
+void PcmTrack::finish()
+{
+    QMutexLocker locker(&p->mutex);
+    p->finished = true;
+    p->ready = true;
+    p->changed.wakeAll();
+}
+
+void PcmTrack::fail()
+{
+    QMutexLocker locker(&p->mutex);
+    p->failed = true;
+    p->finished = true;
+    p->ready = true;
+    p->changed.wakeAll();
+}
+
+void PcmTrack::cancel()
+{
+    QMutexLocker locker(&p->mutex);
+    p->cancelled = true;
+}
+
+bool PcmTrack::isCancelled()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->cancelled;
+}
+
+/*
+ *  Decodes a track as fast as the storage delivers into its PcmTrack.
+ */
+class CacheDecoder : public PcmDecoder {
+public:
+    CacheDecoder(PcmCache* cache, QSharedPointer<PcmTrack> track)
+        : m_cache(cache)
+    {
+        m_track = track;
+    }
+
+    void run()
+    {
+        TraceZone zone("pcmcache", "decode");
+        if (zone.isActive())
+            zone.setDetail(m_track->url().toString());
+
+        if (!create("pcmcache")) {
+            m_cache->remove(m_track.data());
+            return;
+        }
+        gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
+
+        bool done = false;
+        while (!done && !m_track->isCancelled()) {
+            GstMessage* message = gst_bus_timed_pop_filtered(m_bus, 100 * GST_MSECOND,
+                GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ASYNC_DONE));
+            if (!message)
+                continue;
+
+            switch (GST_MESSAGE_TYPE(message)) {
+            case GST_MESSAGE_ASYNC_DONE: {
+                qint64 value = queryDuration();
+                qint64 estimate = value / 1000000 * m_track->rate() / 1000 * m_track->bytesPerFrame();
+                if (estimate > m_cache->budget()) {
+                    qDebug() << Q_FUNC_INFO << "larger than the cache:" << m_track->url();
+                    m_track->fail();
+                    done = true;
+                } else {
+                    m_track->setDuration(value);
+                }
+                break;
+            }
+            case GST_MESSAGE_EOS:
+                m_track->finish();
+                done = true;
+                break;
+            case GST_MESSAGE_ERROR:
+                qDebug() << Q_FUNC_INFO << "could not decode" << m_track->url();
+                m_track->fail();
+                done = true;
+                break;
+            default:
+                break;
+            }
+            gst_message_unref(message);
+        }
+        destroy();
+
+        // dropped for the budget before the end
+        if (!m_track->isFinished())
+            m_track->fail();
+        if (m_track->isFailed())
+            m_cache->remove(m_track.data());
+        if (Tracer::isEnabled())
+            Tracer::instance()->counter("pcmcache", "pcm cache MB", m_cache->usage() / 1048576.0);
+    }
+
+protected:
+    void store(const char* data, qint64 size)
+    {
+        if (!m_cache->store(m_track.data(), data, size))
+            m_track->cancel();
+    }
+
+private:
+    PcmCache* m_cache;
+};
+
+struct PcmCachePrivate {
+    QMutex mutex;
+    QThreadPool pool;
+    bool enabled;
+    qint64 budget;
+    qint64 usage;
+    PcmTrack::SampleFormat format;
+    QHash<QString, QSharedPointer<PcmTrack> > tracks;
+    // least recently used first
+    QStringList order;
+    QHash<QString, QString> current;
+    QHash<QString, QString> next;
+    int hits;
+    int misses;
+};
+
+PcmCache* PcmCache::instance()
+{
+    static PcmCache* cache = new PcmCache(QCoreApplication::instance());
+    return cache;
+}
+
+PcmCache::PcmCache(QObject* parent)
+    : QObject(parent)
+    , p(new PcmCachePrivate)
+{
+    QSettings settings;
+    p->enabled = settings.value("PcmCache", false).toBool();
+    p->budget = qint64(qMax(16, settings.value("PcmCacheMB", 512).toInt())) * 1048576;
+    p->format = settings.value("PcmCacheFloat", false).toBool() ? PcmTrack::Float32 : PcmTrack::Integer16;
+    p->usage = 0;
+    p->hits = 0;
+    p->misses = 0;
+    // current and next track decode side by side, more would compete with the decks
+    p->pool.setMaxThreadCount(2);
+}
+
+PcmCache::~PcmCache()
+{
+    p->mutex.lock();
+    foreach (QSharedPointer<PcmTrack> track, p->tracks)
+        track->cancel();
+    p->mutex.unlock();
+    p->pool.waitForDone();
+    delete p;
+}
+
+bool PcmCache::isEnabled()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->enabled;
+}
+
+void PcmCache::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&p->mutex);
+    p->enabled = enabled;
+    if (!enabled) {
+        foreach (QSharedPointer<PcmTrack> track, p->tracks)
+            track->cancel();
+        p->tracks.clear();
+        p->order.clear();
+        p->usage = 0;
+    }
+}
+
+qint64 PcmCache::budget()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->budget;
+}
+
+void PcmCache::setBudget(qint64 bytes)
+{
+    QMutexLocker locker(&p->mutex);
+    p->budget = bytes;
+    evict(0);
+}
+
+qint64 PcmCache::usage()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->usage;
+}
+
+PcmTrack::SampleFormat PcmCache::sampleFormat()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->format;
+}
+
+void PcmCache::setSampleFormat(PcmTrack::SampleFormat format)
+{
+    QMutexLocker locker(&p->mutex);
+    p->format = format;
+}
+
+int PcmCache::hits()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->hits;
+}
+
+int PcmCache::misses()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->misses;
+}
+
+bool PcmCache::isDecoding()
+{
+    return p->pool.activeThreadCount() > 0;
+}
+
+QSharedPointer<PcmTrack> PcmCache::acquire(const QString& deck, const QUrl& url)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!p->enabled || url.isEmpty())
+        return QSharedPointer<PcmTrack>();
+
+    p->current.insert(deck, url.toString());
+    if (p->next.value(deck) == url.toString())
+        p->next.remove(deck);
+    QSharedPointer<PcmTrack> track = find(url, true);
+    qDebug() << Q_FUNC_INFO << deck << url << p->hits << "hits," << p->misses << "misses,"
+             << p->usage / 1048576 << "MB used";
+    return track;
+}
+
+void PcmCache::prefetch(const QString& deck, const QUrl& url)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!p->enabled)
+        return;
+
+    if (url.isEmpty()) {
+        p->next.remove(deck);
+        return;
+    }
+    p->next.insert(deck, url.toString());
+    find(url, false);
+}
+
+QSharedPointer<PcmTrack> PcmCache::find(const QUrl& url, bool count)
+{
+    // called with the mutex held
+    QString key = url.toString();
+    QSharedPointer<PcmTrack> track = p->tracks.value(key);
+    if (track && !track->isFailed()) {
+        if (count)
+            p->hits++;
+        p->order.removeOne(key);
+        p->order.append(key);
+        return track;
+    }
+
+    if (count)
+        p->misses++;
+    track = QSharedPointer<PcmTrack>(new PcmTrack(url, p->format));
+    p->tracks.insert(key, track);
+    p->order.removeOne(key);
+    p->order.append(key);
+    // a deck waits for the track it plays, it goes before the prefetches
+    p->pool.start(new CacheDecoder(this, track), count ? 1 : 0);
+    return track;
+}
+
+bool PcmCache::store(PcmTrack* track, const char* data, qint64 size)
+{
+    QMutexLocker locker(&p->mutex);
+    QString key = track->url().toString();
+    // evicted meanwhile
+    if (p->tracks.value(key).data() != track)
+        return false;
+
+    if (p->usage + size > p->budget) {
+        evict(size, key);
+        // the tracks of the decks may overdraw, others stop here
+        if (p->usage + size > p->budget && !isPinned(key)) {
+            p->tracks.remove(key);
+            p->order.removeOne(key);
+            p->usage -= track->size();
+            return false;
+        }
+    }
+    track->append(data, size);
+    p->usage += size;
+    return true;
+}
+
+void PcmCache::remove(PcmTrack* track)
+{
+    QMutexLocker locker(&p->mutex);
+    QString key = track->url().toString();
+    if (p->tracks.value(key).data() != track)
+        return;
+    p->tracks.remove(key);
+    p->order.removeOne(key);
+    p->usage -= track->size();
+}
+
+void PcmCache::evict(qint64 needed, const QString& keep)
+{
+    // called with the mutex held
+    for (int i = 0; i < p->order.count() && p->usage + needed > p->budget;) {
+        QString key = p->order.at(i);
+        if (key == keep || isPinned(key)) {
+            i++;
+            continue;
+        }
+        QSharedPointer<PcmTrack> track = p->tracks.take(key);
+        p->order.removeAt(i);
+        if (track) {
+            track->cancel();
+            p->usage -= track->size();
+        }
+    }
+}
+
+bool PcmCache::isPinned(const QString& url)
+{
+    // called with the mutex held
+    return p->current.values().contains(url) || p->next.values().contains(url);
+}
@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PCMCACHE_H
+#define PCMCACHE_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QUrl>
+
+class PcmCache;
+
+/*
+ *  The decoded audio of one track, interleaved stereo at 44.1 kHz. The
+ *  decoder appends while the decks read, a read ahead of the decoder waits
+ *  for it.
+ */
+class PcmTrack {
+public:
+    enum SampleFormat {
+        Integer16,
+        Float32
+    };
+
+    PcmTrack(const QUrl& url, SampleFormat format);
+    ~PcmTrack();
+
+    QUrl url() const;
+    SampleFormat format() const;
+    static int rate() { return 44100; }
+    static int channels() { return 2; }
+    int bytesPerFrame() const;
+    /** Caps of the samples for capsfilter and appsrc */
+    QString caps() const;
+
+    /** Waits until the length is known or decoding ended, false if the track cannot be used */
+    bool waitReady(int timeout);
+    /** Nanoseconds, 0 while unknown */
+    qint64 duration();
+    /** Nanoseconds of the track before the first sample, 0 unless a snippet */
+    qint64 offset();
+    /** Nanoseconds of the whole track, the duration unless a snippet */
+    qint64 trackLength();
+    qint64 size();
+    bool isFinished();
+    bool isFailed();
+
+    /** Copies up to size bytes from offset, waits up to timeout ms for the decoder.
+        Returns the bytes copied, 0 at the end of the track, -1 on timeout */
+    qint64 read(qint64 offset, char* data, qint64 size, int timeout);
+
+private:
+    friend class PcmCache;
+    friend class PcmDecoder;
+    friend class CacheDecoder;
+    friend class PreviewCache;
+    friend class PreviewDecoder;
+    void setDuration(qint64 duration);
+    void setSpan(qint64 offset, qint64 trackLength);
+    void append(const char* data, qint64 size);
+    void finish();
+    void fail();
+    void cancel();
+    bool isCancelled();
+    struct PcmTrackPrivate* p;
+};
+
+/*
+ *  Keeps the current and the next track of every deck decoded in memory,
+ *  so the decks play from RAM and storage stalls on a network share never
+ *  reach the output. Enabled by the setting "PcmCache", the budget is
+ *  "PcmCacheMB" (512 by default) and "PcmCacheFloat" stores 32 bit float
+ *  instead of 16 bit samples. The tracks of the decks are kept, others are
+ *  dropped oldest first when the budget is used up; a track that does not
+ *  fit is not cached and plays from its file as before.
+ *  Create the instance in the GUI thread.
+ */
+class PcmCache : public QObject {
+    Q_OBJECT
+
+public:
+    static PcmCache* instance();
+    ~PcmCache();
+
+    bool isEnabled();
+    void setEnabled(bool enabled);
+    /** Bytes */
+    qint64 budget();
+    void setBudget(qint64 bytes);
+    qint64 usage();
+    PcmTrack::SampleFormat sampleFormat();
+    void setSampleFormat(PcmTrack::SampleFormat format);
+
+    /** The track a deck plays now, decoding starts unless cached; null while disabled */
+    QSharedPointer<PcmTrack> acquire(const QString& deck, const QUrl& url);
+    /** Decodes the track a deck plays next in the background */
+    void prefetch(const QString& deck, const QUrl& url);
+
+    int hits();
+    int misses();
+    /** True while a deck track decodes, background decoders wait for it */
+    bool isDecoding();
+
+private:
+    friend class CacheDecoder;
+    explicit PcmCache(QObject* parent = nullptr);
+    QSharedPointer<PcmTrack> find(const QUrl& url, bool count);
+    /** Appends decoded samples, false if the track has no room left */
+    bool store(PcmTrack* track, const char* data, qint64 size);
+    void remove(PcmTrack* track);
+    /** Drops unused tracks except keep until needed more bytes fit the budget */
+    void evict(qint64 needed, const QString& keep = QString());
+    bool isPinned(const QString& url);
+    struct PcmCachePrivate* p;
+};
+
+#endif // PCMCACHE_H
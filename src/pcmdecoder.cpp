@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pcmdecoder.h"
+
+#include <qdebug.h>
+
+PcmDecoder::PcmDecoder()
+    : m_pipeline(nullptr)
+    , m_bus(nullptr)
+    , m_convert(nullptr)
+{
+}
+
+PcmDecoder::~PcmDecoder()
+{
+    destroy();
+}
+
+bool PcmDecoder::create(const char* name)
+{
+    m_pipeline = gst_pipeline_new(name);
+    GstElement* src = gst_element_factory_make("uridecodebin", nullptr);
+    m_convert = gst_element_factory_make("audioconvert", nullptr);
+    GstElement* resample = gst_element_factory_make("audioresample", nullptr);
+    GstElement* filter = gst_element_factory_make("capsfilter", nullptr);
+    GstElement* sink = gst_element_factory_make("fakesink", nullptr);
+    if (!src || !m_convert || !resample || !filter || !sink) {
+        qWarning() << Q_FUNC_INFO << "missing GStreamer elements";
+        m_track->fail();
+        gst_object_unref(m_pipeline);
+        m_pipeline = nullptr;
+        return false;
+    }
+
+    GstCaps* caps = gst_caps_from_string(m_track->caps().toLatin1().constData());
+    g_object_set(filter, "caps", caps, NULL);
+    gst_caps_unref(caps);
+    g_object_set(sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+    g_object_set(src, "uri", (const char*)m_track->url().toString().toUtf8(), NULL);
+
+    gst_bin_add_many(GST_BIN(m_pipeline), src, m_convert, resample, filter, sink, NULL);
+    gst_element_link_many(m_convert, resample, filter, sink, NULL);
+    g_signal_connect(src, "pad-added", G_CALLBACK(onPadAdded), this);
+    g_signal_connect(sink, "handoff", G_CALLBACK(onHandoff), this);
+
+    m_bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
+    return true;
+}
+
+void PcmDecoder::destroy()
+{
+    if (!m_pipeline)
+        return;
+    gst_element_set_state(m_pipeline, GST_STATE_NULL);
+    gst_object_unref(m_bus);
+    gst_object_unref(m_pipeline);
+    m_bus = nullptr;
+    m_pipeline = nullptr;
+    m_convert = nullptr;
+}
+
+qint64 PcmDecoder::queryDuration()
+{
+    gint64 value = 0;
+#ifdef GST_API_VERSION_1
+    if (!gst_element_query_duration(m_pipeline, GST_FORMAT_TIME, &value))
+        value = 0;
+#else
+    GstFormat format = GST_FORMAT_TIME;
+    if (!gst_element_query_duration(m_pipeline, &format, &value))
+        value = 0;
+#endif
+    return value;
+}
+
+void PcmDecoder::onPadAdded(GstElement* src, GstPad* pad, gpointer data)
+{
+    Q_UNUSED(src);
+    PcmDecoder* decoder = static_cast<PcmDecoder*>(data);
+    GstPad* sinkPad = gst_element_get_static_pad(decoder->m_convert, "sink");
+    if (!GST_PAD_IS_LINKED(sinkPad)) {
+#ifdef GST_API_VERSION_1
+        GstCaps* caps = gst_pad_query_caps(pad, nullptr);
+#else
+        GstCaps* caps = gst_pad_get_caps(pad);
+#endif
+        if (g_strrstr(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "audio"))
+            gst_pad_link(pad, sinkPad);
+        gst_caps_unref(caps);
+    }
+    gst_object_unref(sinkPad);
+}
+
+void PcmDecoder::onHandoff(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer data)
+{
+    Q_UNUSED(sink);
+    Q_UNUSED(pad);
+    PcmDecoder* decoder = static_cast<PcmDecoder*>(data);
+    if (decoder->m_track->isCancelled())
+        return;
+
+#ifdef GST_API_VERSION_1
+    GstMapInfo info;
+    if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+        return;
+    decoder->store(reinterpret_cast<const char*>(info.data), info.size);
+    gst_buffer_unmap(buffer, &info);
+#else
+    decoder->store(reinterpret_cast<const char*>(GST_BUFFER_DATA(buffer)), GST_BUFFER_SIZE(buffer));
+#endif
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PCMDECODER_H
+#define PCMDECODER_H
+
+#include "pcmcache.h"
+
+#include <QRunnable>
+#include <QSharedPointer>
+
+#define GST_DISABLE_LOADSAVE 1
+#define GST_DISABLE_REGISTRY 1
+#define GST_DISABLE_DEPRECATED 1
+#include <gst/gst.h>
+
+/*
+ *  Decodes the file of a PcmTrack into its sample format in a worker:
+ *  uridecodebin ! audioconvert ! audioresample ! capsfilter ! fakesink.
+ *  Shared by the PCM cache of the decks and the preview snippets, the
+ *  subclasses drive the pipeline and keep what store() receives.
+ */
+class PcmDecoder : public QRunnable {
+public:
+    PcmDecoder();
+    virtual ~PcmDecoder();
+
+protected:
+    /** Builds the pipeline for m_track, fails the track if elements are missing */
+    bool create(const char* name);
+    void destroy();
+    /** Nanoseconds, 0 while unknown */
+    qint64 queryDuration();
+    /** Every decoded buffer, called on the streaming thread */
+    virtual void store(const char* data, qint64 size) = 0;
+
+    QSharedPointer<PcmTrack> m_track;
+    GstElement* m_pipeline;
+    GstBus* m_bus;
+
+private:
+    static void onPadAdded(GstElement* src, GstPad* pad, gpointer data);
+    static void onHandoff(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer data);
+    GstElement* m_convert;
+};
+
+#endif // PCMDECODER_H
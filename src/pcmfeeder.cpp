@@ -0,0 +1,163 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pcmfeeder.h"
+#include "pcmcache.h"
+
+#include <QByteArray>
+
+namespace {
+// GST_APP_STREAM_TYPE_SEEKABLE, without linking the app library
+const int appStreamSeekable = 1;
+// frames per buffer pushed from a track
+const int feedFrames = 4096;
+}
+
+PcmFeeder::PcmFeeder()
+    : readOffset(0)
+    , isFeeding(true)
+    , hasDuration(false)
+{
+}
+
+void PcmFeeder::attach(GstElement* decodebin)
+{
+    g_signal_connect(decodebin, "source-setup", G_CALLBACK(cb_sourcesetup), this);
+}
+
+void PcmFeeder::cb_sourcesetup(GstElement* decodebin, GstElement* source, gpointer data)
+{
+    Q_UNUSED(decodebin);
+    static_cast<PcmFeeder*>(data)->setupSource(source);
+}
+
+void PcmFeeder::cb_needdata(GstElement* appsrc, guint length, gpointer data)
+{
+    Q_UNUSED(length);
+    static_cast<PcmFeeder*>(data)->feed(appsrc);
+}
+
+gboolean PcmFeeder::cb_seekdata(GstElement* appsrc, guint64 position, gpointer data)
+{
+    Q_UNUSED(appsrc);
+    return static_cast<PcmFeeder*>(data)->seek(position);
+}
+
+void PcmFeeder::setTrack(QSharedPointer<PcmTrack> track)
+{
+    QMutexLocker locker(&mutex);
+    current = track;
+    readOffset = 0;
+    isFeeding = true;
+    hasDuration = false;
+}
+
+QSharedPointer<PcmTrack> PcmFeeder::track()
+{
+    QMutexLocker locker(&mutex);
+    return current;
+}
+
+void PcmFeeder::setFeeding(bool feeding)
+{
+    QMutexLocker locker(&mutex);
+    isFeeding = feeding;
+}
+
+void PcmFeeder::setupSource(GstElement* source)
+{
+    QSharedPointer<PcmTrack> track = this->track();
+    if (!track || g_strcmp0(G_OBJECT_TYPE_NAME(source), "GstAppSrc") != 0)
+        return;
+
+    GstCaps* caps = gst_caps_from_string(track->caps().toLatin1().constData());
+    g_object_set(source, "caps", caps, "format", GST_FORMAT_TIME, "stream-type", appStreamSeekable, NULL);
+    gst_caps_unref(caps);
+
+    g_signal_connect(source, "need-data", G_CALLBACK(cb_needdata), this);
+    g_signal_connect(source, "seek-data", G_CALLBACK(cb_seekdata), this);
+}
+
+void PcmFeeder::feed(GstElement* appsrc)
+{
+    mutex.lock();
+    QSharedPointer<PcmTrack> track = current;
+    qint64 offset = readOffset;
+    bool knowsDuration = hasDuration;
+    mutex.unlock();
+    if (!track)
+        return;
+
+    // passed on as soon as the decoder knows it
+    if (!knowsDuration && track->duration() > 0
+        && g_object_class_find_property(G_OBJECT_GET_CLASS(appsrc), "duration")) {
+        g_object_set(appsrc, "duration", guint64(track->duration()), NULL);
+        mutex.lock();
+        hasDuration = true;
+        mutex.unlock();
+    }
+
+    int frameBytes = track->bytesPerFrame();
+    QByteArray chunk(feedFrames * frameBytes, '\0');
+    qint64 count = -1;
+    while (count < 0) {
+        // the decoder is behind, but a stop or seek must not wait for it
+        mutex.lock();
+        bool feeding = isFeeding;
+        mutex.unlock();
+        if (!feeding)
+            return;
+        count = track->read(offset, chunk.data(), chunk.size(), 50);
+    }
+
+    GstFlowReturn ret;
+    if (count == 0) {
+        g_signal_emit_by_name(appsrc, "end-of-stream", &ret);
+        return;
+    }
+
+    count -= count % frameBytes;
+    guint64 frame = offset / frameBytes;
+#ifdef GST_API_VERSION_1
+    GstBuffer* buffer = gst_buffer_new_allocate(nullptr, count, nullptr);
+    gst_buffer_fill(buffer, 0, chunk.constData(), count);
+    GST_BUFFER_PTS(buffer) = gst_util_uint64_scale(frame, GST_SECOND, track->rate());
+#else
+    GstBuffer* buffer = gst_buffer_new_and_alloc(count);
+    memcpy(GST_BUFFER_DATA(buffer), chunk.constData(), count);
+    GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(frame, GST_SECOND, track->rate());
+#endif
+    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(count / frameBytes, GST_SECOND, track->rate());
+
+    mutex.lock();
+    readOffset = offset + count;
+    mutex.unlock();
+
+    g_signal_emit_by_name(appsrc, "push-buffer", buffer, &ret);
+    gst_buffer_unref(buffer);
+}
+
+bool PcmFeeder::seek(guint64 position)
+{
+    QMutexLocker locker(&mutex);
+    if (!current)
+        return false;
+    // inside the track a seek only moves the read offset
+    guint64 frame = gst_util_uint64_scale(position, current->rate(), GST_SECOND);
+    readOffset = frame * current->bytesPerFrame();
+    return true;
+}
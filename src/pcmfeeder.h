@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PCMFEEDER_H
+#define PCMFEEDER_H
+
+#include <QMutex>
+#include <QSharedPointer>
+
+#define GST_DISABLE_LOADSAVE 1
+#define GST_DISABLE_REGISTRY 1
+#define GST_DISABLE_DEPRECATED 1
+#include <gst/gst.h>
+
+class PcmTrack;
+
+/*
+ *  Plays a PcmTrack through the appsrc:// uri of a uridecodebin, shared
+ *  by Player and MonitorPlayer. The streaming thread pulls the samples,
+ *  the other threads set the track and stop the feed around state
+ *  changes and seeks, a stop must not wait for the decoder.
+ */
+class PcmFeeder {
+public:
+    PcmFeeder();
+
+    /** Connects to "source-setup" of the uridecodebin */
+    void attach(GstElement* decodebin);
+
+    /** The track of the next appsrc://, null for none; the feed restarts at its begin */
+    void setTrack(QSharedPointer<PcmTrack> track);
+    QSharedPointer<PcmTrack> track();
+    void setFeeding(bool feeding);
+
+private:
+    static void cb_sourcesetup(GstElement* decodebin, GstElement* source, gpointer data);
+    static void cb_needdata(GstElement* appsrc, guint length, gpointer data);
+    static gboolean cb_seekdata(GstElement* appsrc, guint64 position, gpointer data);
+    void setupSource(GstElement* source);
+    void feed(GstElement* appsrc);
+    bool seek(guint64 position);
+
+    QMutex mutex;
+    QSharedPointer<PcmTrack> current;
+    qint64 readOffset;
+    bool isFeeding;
+    // the decoder may learn the length after the feed started
+    bool hasDuration;
+};
+
+#endif // PCMFEEDER_H
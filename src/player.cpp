@@ -16,6 +16,12 @@
 */
 
 #include "player.h"
+#include "dropoutmonitor.h"
+#include "dropoutwatch.h"
+#include "pcmcache.h"
+#include "pcmfeeder.h"
+#include "readahead.h"
+#include "tracer.h"
 
 #include <QtGui>
 #if QT_VERSION >= 0x050000
@@ -24,6 +30,8 @@
 #include <QtConcurrentRun>
 #endif
 
+static Player::SinkFactory sinkFactory = nullptr;
+
 void Player::sync_set_state(GstElement* element, GstState state)
 {
     GstStateChangeReturn res;
@@ -93,6 +101,11 @@ struct PlayerPrivate {
     QMutex mutex;
     bool isStarted;
     bool isLoaded;
+    // QoS, buffering and warnings of the bus, for the DropoutMonitor
+    DropoutWatch dropouts;
+    // written on open, read for the dropout log by the streaming threads
+    QMutex urlMutex;
+    QString url;
     QString error;
     int length;
     int position;
@@ -101,6 +114,11 @@ struct PlayerPrivate {
     double rms_r;
     double rmsout_l;
     double rmsout_r;
+    // tracks of the PCM cache play through appsrc://
+    PcmFeeder feeder;
+    // counts the opens, only the latest one loads
+    QMutex generationMutex;
+    int generation;
 };
 
 Player::Player(QWidget* parent)
@@ -113,6 +131,7 @@ Player::Player(QWidget* parent)
 {
     p->isStarted = false;
     p->isLoaded = false;
+    p->generation = 0;
 
     connect(&p->watcher, SIGNAL(finished()), this, SLOT(loadThreadFinished()));
 }
@@ -134,6 +153,7 @@ GstBusSyncReply Player::bus_cb(GstBus* bus, GstMessage* msg, gpointer data)
 
 void Player::cleanup()
 {
+    p->feeder.setFeeding(false);
     if (pipeline)
         sync_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
     if (bus)
@@ -142,13 +162,35 @@ void Player::cleanup()
         gst_object_unref(G_OBJECT(pipeline));
 }
 
+void Player::setSinkFactory(SinkFactory factory)
+{
+    sinkFactory = factory;
+}
+
 bool Player::prepare()
 {
-    // Init Gst
-    qDebug() << Q_FUNC_INFO << " "
-             << "START";
-    QString caps_value;
+    initGst();
+    return createPipeline();
+}
 
+QFuture<bool> Player::prepareAsync()
+{
+    // gst and the singletons are set up in this thread, the pipeline by a worker
+    initGst();
+    return QtConcurrent::run(this, &Player::readyPipeline);
+}
+
+bool Player::readyPipeline()
+{
+    if (!createPipeline())
+        return false;
+    stop();
+    return true;
+}
+
+void Player::initGst()
+{
+    // Init Gst
     // On mac we bundle the gstreamer plugins with knowthelist
 #if defined(Q_OS_DARWIN)
     QString scanner_path;
@@ -184,6 +226,16 @@ bool Player::prepare()
     //setenv("GST_DEBUG", "*:4", 1); // unix, mac
 
     gst_init(nullptr, nullptr);
+    DropoutMonitor::instance();
+    PcmCache::instance();
+    ReadAhead::instance();
+}
+
+bool Player::createPipeline()
+{
+    qDebug() << Q_FUNC_INFO << " "
+             << "START";
+    QString caps_value;
 
     //prepare
     GstElement *src, *conv, *resample, *sink, *gain, *vol, *level, *equalizer;
@@ -202,6 +254,7 @@ bool Player::prepare()
 
     src = gst_element_factory_make("uridecodebin", "source");
     g_signal_connect(src, "pad-added", G_CALLBACK(cb_newpad), this);
+    p->feeder.attach(src);
 
     conv = gst_element_factory_make("audioconvert", "convert");
     resample = gst_element_factory_make("audioresample", "resample");
@@ -210,7 +263,12 @@ bool Player::prepare()
     vol = gst_element_factory_make("volume", "volume");
     levelout = gst_element_factory_make("level", "levelout");
     equalizer = gst_element_factory_make("equalizer-3bands", "equalizer");
-    sink = gst_element_factory_make("autoaudiosink", "sink");
+    if (sinkFactory)
+        sink = sinkFactory("sink");
+    else
+        sink = gst_element_factory_make("autoaudiosink", "sink");
+
+    DropoutWatch::enableQos(sink);
 
     g_object_set(level, "message", TRUE, NULL);
     g_object_set(levelout, "message", TRUE, NULL);
@@ -265,23 +323,55 @@ void Player::open(QUrl url)
 {
     //To avoid delays load track in another thread
     qDebug() << Q_FUNC_INFO << ":" << parentWidget()->objectName() << " url=" << url;
-    QFuture<void> future = QtConcurrent::run(this, &Player::asyncOpen, url);
+    // acquired here, so the cache pins the deck's tracks in the order of the opens
+    QSharedPointer<PcmTrack> cached = PcmCache::instance()->acquire(parentWidget()->objectName(), url);
+    p->generationMutex.lock();
+    int generation = ++p->generation;
+    p->generationMutex.unlock();
+    QFuture<void> future = QtConcurrent::run(this, &Player::asyncOpen, url, cached, generation);
     p->watcher.setFuture(future);
 }
 
-void Player::asyncOpen(QUrl url)
+void Player::asyncOpen(QUrl url, QSharedPointer<PcmTrack> cached, int generation)
 {
+    TraceZone zone("player", "open");
+    if (zone.isActive())
+        zone.setDetail(parentWidget()->objectName() + " " + url.toString());
+
+    // played from memory right away, the decoder delivers the length later
+    if (cached && cached->isFailed()) {
+        qDebug() << Q_FUNC_INFO << ":" << parentWidget()->objectName() << "decoding failed, playing from file";
+        cached.clear();
+    }
+
     p->mutex.lock();
+    p->generationMutex.lock();
+    bool isLatest = generation == p->generation;
+    p->generationMutex.unlock();
+    if (!isLatest) {
+        p->mutex.unlock();
+        return;
+    }
+
     p->length = 0;
     p->position = 0;
     p->isLoaded = false;
+    p->dropouts.reset();
+    p->urlMutex.lock();
+    p->url = url.toString();
+    p->urlMutex.unlock();
     p->error = "";
     lastError = "";
 
+    p->feeder.setFeeding(false);
     sync_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
+    ReadAhead::instance()->opened(url);
+
+    p->feeder.setTrack(cached);
 
     GstElement* src = gst_bin_get_by_name(GST_BIN(pipeline), "source");
-    g_object_set(G_OBJECT(src), "uri", (const char*)url.toString().toUtf8(), NULL);
+    QString uri = cached ? QString("appsrc://") : url.toString();
+    g_object_set(G_OBJECT(src), "uri", (const char*)uri.toUtf8(), NULL);
 
     qDebug() << Q_FUNC_INFO << ":" << parentWidget()->objectName();
 
@@ -319,7 +409,9 @@ void Player::play()
 void Player::stop()
 {
     p->isStarted = false;
+    p->feeder.setFeeding(false);
     gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_READY);
+    p->feeder.setFeeding(true);
 }
 
 void Player::pause()
@@ -332,17 +424,33 @@ void Player::pause()
 
 bool Player::close()
 {
+    p->feeder.setFeeding(false);
     gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
+    p->feeder.setFeeding(true);
     return true;
 }
 
+void Player::prefetch(QUrl url)
+{
+    PcmCache::instance()->prefetch(parentWidget()->objectName(), url);
+}
+
+QString Player::currentUrl()
+{
+    QMutexLocker locker(&p->urlMutex);
+    return p->url;
+}
+
 void Player::setPosition(QTime position)
 {
+    TraceZone zone("player", "seek");
     int time_milliseconds = QTime(0, 0).msecsTo(position);
     gint64 time_nanoseconds = (time_milliseconds * GST_MSECOND);
+    p->feeder.setFeeding(false);
     gst_element_seek(pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
         GST_SEEK_TYPE_SET, time_nanoseconds,
         GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
+    p->feeder.setFeeding(true);
     p->position = time_milliseconds;
     emit positionChanged();
 }
@@ -371,7 +479,11 @@ QTime Player::length()
 {
     gint64 value = 0;
 
-    if (p->length == 0 && pipeline) {
+    // a cached track learns its length while it already plays
+    QSharedPointer<PcmTrack> cached = p->feeder.track();
+    if (p->length == 0 && cached) {
+        p->length = static_cast<int>(cached->duration() / GST_MSECOND);
+    } else if (p->length == 0 && pipeline) {
 
 #ifdef GST_API_VERSION_1
         if (gst_element_query_duration(pipeline, GST_FORMAT_TIME, &value)) {
@@ -447,6 +559,8 @@ void Player::messageReceived(GstMessage* message)
                 lastError = QString::fromUtf8(err->message);
             }
             qDebug() << Q_FUNC_INFO << ": Gstreamer error:" << p->error;
+            if (Tracer::isEnabled())
+                Tracer::instance()->instant("player", "error", p->error);
             g_error_free(err);
             g_free(debug);
             Q_EMIT error();
@@ -455,9 +569,16 @@ void Player::messageReceived(GstMessage* message)
     }
     case GST_MESSAGE_EOS: {
         qDebug() << Q_FUNC_INFO << ":" << parentWidget()->objectName() << " End of track reached";
+        if (Tracer::isEnabled())
+            Tracer::instance()->instant("player", "end of stream", parentWidget()->objectName());
         Q_EMIT finish();
         break;
     }
+    case GST_MESSAGE_QOS:
+    case GST_MESSAGE_BUFFERING:
+    case GST_MESSAGE_WARNING:
+        p->dropouts.handleMessage(message, parentWidget()->objectName(), currentUrl(), p->isStarted);
+        break;
     case GST_MESSAGE_STATE_CHANGED: {
         GstState old_state, new_state;
         gst_message_parse_state_changed(message, &old_state, &new_state, nullptr);
@@ -26,13 +26,23 @@
 
 #include <gst/gst.h>
 
+class PcmTrack;
+
 class Player : public QWidget {
     Q_OBJECT
 public:
     Player(QWidget* parent = nullptr);
     ~Player();
 
+    /** Makes the audio sink of the following prepare() calls instead of
+        autoaudiosink, e.g. a fakesink for runs without a sound card */
+    typedef GstElement* (*SinkFactory)(const char* name);
+    static void setSinkFactory(SinkFactory factory);
+
     bool prepare();
+    /** Like prepare() but the pipeline is built and made ready by a worker,
+        wait for the future before any other call */
+    QFuture<bool> prepareAsync();
     bool ready();
     bool canOpen(QString mime);
     void open(QUrl url);
@@ -57,6 +67,9 @@ public:
     double levelOutLeft();
     double levelOutRight();
 
+    /** Decode url into the PCM cache, it is the next track of this deck */
+    void prefetch(QUrl url);
+
     void newpad(GstElement* decodebin, GstPad* pad, gpointer data);
     static GstBusSyncReply bus_cb(GstBus* bus, GstMessage* msg, gpointer data);
 Q_SIGNALS:
@@ -76,8 +89,12 @@ private:
     GstElement* pipeline;
     GstBus* bus;
     gint64 Gstart, Glength;
+    static void initGst();
+    bool createPipeline();
+    bool readyPipeline();
     void setLink(int, QUrl&);
-    void asyncOpen(QUrl url);
+    QString currentUrl();
+    void asyncOpen(QUrl url, QSharedPointer<PcmTrack> cached, int generation);
     void cleanup();
     void sync_set_state(GstElement*, GstState);
 };
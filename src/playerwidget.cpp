@@ -25,6 +25,7 @@
 
 struct PlayerWidgetPrivate {
     bool isEndAnnounced;
+    QFuture<bool> prepared;
 };
 
 PlayerWidget::PlayerWidget(QWidget* parent)
@@ -42,9 +43,9 @@ PlayerWidget::PlayerWidget(QWidget* parent)
 
     p->isEndAnnounced = false;
 
-    //create the player
+    //create the player, the other deck is built at the same time
     player = new Player(this);
-    player->prepare();
+    p->prepared = player->prepareAsync();
 
     ui->butFwd->setIcon(QIcon(":forward.png"));
     ui->butRew->setIcon(QIcon(":backward.png"));
@@ -92,14 +93,15 @@ PlayerWidget::PlayerWidget(QWidget* parent)
 
     m_isStarted = false;
     setAcceptDrops(true);
-    this->stop();
 
     trackanalyser = new TrackAnalyser(this);
+    trackanalyser->setUseCache(true);
     connect(trackanalyser, SIGNAL(finishGain()), this, SLOT(analyseGainFinished()));
 }
 
 PlayerWidget::~PlayerWidget()
 {
+    p->prepared.waitForFinished();
     delete player;
     delete timerPosition;
     delete timerLevel;
@@ -181,6 +183,11 @@ void PlayerWidget::pause()
     Q_EMIT levelChanged(0, 0);
 }
 
+void PlayerWidget::waitForPlayer()
+{
+    p->prepared.waitForFinished();
+}
+
 void PlayerWidget::stop()
 {
     ui->butPlay->setIcon(QIcon(":play.png"));
@@ -288,6 +295,11 @@ void PlayerWidget::loadFile(QUrl file)
     loadTrack(new Track(file));
 }
 
+void PlayerWidget::setNextTrack(Track* track)
+{
+    player->prefetch(track ? track->url() : QUrl());
+}
+
 void PlayerWidget::loadTrack(Track* track)
 {
     if (track)
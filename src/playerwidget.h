@@ -49,6 +49,8 @@ public:
     float currentLevelLeft();
     float currentLevelRight();
     void loadFile(QUrl);
+    /** Blocks until the player built in background is ready, before any other call */
+    void waitForPlayer();
 
     void play();
     void stop();
@@ -72,6 +74,7 @@ public:
 
 public Q_SLOTS:
     void loadTrack(Track*);
+    void setNextTrack(Track*);
     void analyseGainFinished();
     void setEqualizer(EqBand, int);
     void setInfo(QPair<int, int> info);
@@ -17,13 +17,23 @@
 
 #include "playlist.h"
 #include "playlistitem.h"
+#include "collectiondb.h"
+#include "covercache.h"
+#include "playlistfile.h"
+#include "previewcache.h"
+#include "readahead.h"
+#include "tracer.h"
 
 #include <QMenu>
 #include <Qt>
 #include <qdebug.h>
+#if QT_VERSION >= 0x050000
+#include <QtConcurrent/QtConcurrent>
+#else
+#include <QtConcurrentRun>
+#endif
 
 #include <QtGui>
-#include <QtXml>
 #include <qprogressdialog.h>
 #include <qscrollbar.h>
 
@@ -33,6 +43,11 @@
 #include <QPainter>
 #include <qfile.h>
 
+namespace {
+// tracks added by "Add Similar Tracks"
+const int similarCount = 10;
+}
+
 Playlist::Playlist(QWidget* parent)
     : QTreeWidget(parent)
     , m_alternateMax(0)
@@ -50,6 +65,7 @@ Playlist::Playlist(QWidget* parent)
     , m_isInternDrop(false)
     , m_dragLocked(false)
     , isChangeSignalEnabled(true)
+    , database(nullptr)
 {
 
     setSortingEnabled(false);
@@ -87,6 +103,16 @@ Playlist::Playlist(QWidget* parent)
     timerDragLock->setInterval(300);
     connect(timerDragLock, SIGNAL(timeout()), this, SLOT(timeoutDragLock()));
 
+    // snippets of the shown rows, once scrolling stops
+    timerPreview = new QTimer(this);
+    timerPreview->setSingleShot(true);
+    timerPreview->setInterval(300);
+    connect(timerPreview, SIGNAL(timeout()), this, SLOT(requestPreviews()));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), timerPreview, SLOT(start()));
+
+    similarWatcher = new QFutureWatcher<QList<QStringList> >(this);
+    connect(similarWatcher, SIGNAL(finished()), this, SLOT(similarTracksFound()));
+
     connect(this, SIGNAL(itemClicked(QTreeWidgetItem*, int)), this,
         SLOT(slotItemClicked(QTreeWidgetItem*, int)));
     connect(this, SIGNAL(itemDoubleClicked(QTreeWidgetItem*, int)), this,
@@ -101,6 +127,9 @@ Playlist::~Playlist()
     // save width and sort settings
     QSettings settings;
     settings.setValue("playlist_" + objectName(), header()->saveState());
+
+    similarWatcher->waitForFinished();
+    delete database;
 }
 
 /** Add a song to the playlist */
@@ -299,6 +328,7 @@ void Playlist::checkCurrentItem()
         setCurrentPlaylistItem(firstChild());
 
     handleChanges();
+    timerPreview->start();
 }
 
 /** handle changes after remove or adding tracks to play list */
@@ -313,6 +343,20 @@ void Playlist::handleChanges()
         nextPlaylistItem = nullptr;
     }
 
+    Track* nextTrack = nextPlaylistItem ? nextPlaylistItem->track() : nullptr;
+    QUrl nextUrl = nextTrack ? nextTrack->url() : QUrl();
+    if (nextUrl != m_nextUrl) {
+        m_nextUrl = nextUrl;
+        Q_EMIT nextTrackChanged(nextTrack);
+    }
+
+    // warm the page cache for the tracks after the current one
+    QList<QUrl> upcoming;
+    int depth = ReadAhead::instance()->depth();
+    for (PlaylistItem* item = nextPlaylistItem; item && upcoming.count() < depth; item = item->nextSibling())
+        upcoming.append(item->track()->url());
+    ReadAhead::instance()->setUpcoming(objectName(), upcoming);
+
     updatePlaylistItems();
 
     Q_EMIT countChanged(countTrack());
@@ -458,133 +502,53 @@ QString Playlist::defaultPlaylistPath()
     return path.absolutePath() + "/" + this->objectName() + ".xspf";
 }
 
-// Export content as a xspf playlist
+// Export content as a xspf, m3u or pls playlist
 void Playlist::saveXML(const QString& path) const
 {
     qDebug() << Q_FUNC_INFO << "BEGIN ";
-    QFile file(path);
-
-    if (!file.open(QFile::WriteOnly))
-        return;
-
-    QDomDocument newdoc;
-    QDomElement playlistElem = newdoc.createElement("playlist");
-    playlistElem.setAttribute("version", "1");
-    playlistElem.setAttribute("xmlns", "http://xspf.org/ns/0/");
-    newdoc.appendChild(playlistElem);
-
-    QDomElement elem = newdoc.createElement("creator");
-    QDomText t = newdoc.createTextNode("Knowthelist");
-    elem.appendChild(t);
-    playlistElem.appendChild(elem);
-
-    QDomElement listElem = newdoc.createElement("trackList");
 
+    QList<QStringList> tags;
+    int current = -1;
+    int next = -1;
     for (PlaylistItem* item = firstChild(); item; item = item->nextSibling()) {
-        if (item) {
-            QDomElement trackElem = newdoc.createElement("track");
-
-            QDomElement extElem = newdoc.createElement("extension");
-
-            if (currentPlaylistItem && item == currentPlaylistItem) {
-                extElem.setAttribute("current", "1");
-            }
-            if (item == nextTrack()) {
-                extElem.setAttribute("next", "1");
-            }
-            if (item->track()->flags().testFlag(Track::isAutoDjSelection)) {
-                extElem.setAttribute("isAutoDjSelection", "1");
-            }
-
-            QStringList tag = item->track()->tagList();
-
-            for (int x = 0; x < tag.count(); ++x) {
-                if (x == 4 || x == 5) {
-                    extElem.setAttribute(Track::tagNameList.at(x), tag.at(x));
-                } else {
-                    QDomElement elem = newdoc.createElement(Track::tagNameList.at(x));
-                    QDomText t = newdoc.createTextNode(tag.at(x));
-                    elem.appendChild(t);
-                    trackElem.appendChild(elem);
-                }
-            }
-
-            trackElem.appendChild(extElem);
-            listElem.appendChild(trackElem);
-        }
+        if (currentPlaylistItem && item == currentPlaylistItem)
+            current = tags.count();
+        if (item == nextTrack())
+            next = tags.count();
+        tags << (item->track()->tagList() << QString::number(int(item->track()->flags())));
     }
 
-    playlistElem.appendChild(listElem);
-
-    QTextStream stream(&file);
-    stream.setCodec("UTF-8");
-    stream << "<?xml version=\"1.0\" encoding=\"utf8\"?>\n";
-    stream << newdoc.toString();
-    file.close();
+    PlaylistFile::save(path, tags, current, next);
     qDebug() << Q_FUNC_INFO << "END ";
 }
 
-void Playlist::loadXML(const QString& path)
+void Playlist::appendTags(const QList<QStringList>& tags, PlaylistItem* after)
 {
-    QFile file(path);
-
-    if (file.open(QFile::ReadOnly)) {
-        QTextStream stream(&file);
-
-        stream.setCodec(QTextCodec::codecForName("utf8"));
-        QDomDocument d;
-        if (!d.setContent(stream.readAll())) {
-            qDebug() << "Could not load XML\n";
-            return;
-        }
-
-        QDomNode n = d.namedItem("playlist").namedItem("trackList").firstChild();
+    setUpdatesEnabled(false);
+    bool doSort = isSortingEnabled();
+    setSortingEnabled(false);
 
-        const QString TRACK(
-            "track"); // so we don't construct the QStrings all the time
-        const QString URL("url");
-        const QString CURRENT("current");
-        const QString NEXT("next");
+    foreach (const QStringList& tag, tags) {
+        addTrack(new Track(tag), after);
+        after = this->newTrack();
+    }
 
-        while (!n.isNull()) {
-            if (n.nodeName() == TRACK) {
-                const QDomElement e = n.toElement();
-                if (e.isNull()) {
-                    qDebug() << "Element '" << n.nodeName() << "' is null, skipping.";
-                    continue;
-                }
+    setSortingEnabled(doSort);
+    setUpdatesEnabled(true);
+    checkCurrentItem();
+}
 
-                // qDebug() << "Add from xml url='" << e.attribute( URL );
-                Track* track = new Track();
-                track->setUrl(QUrl::fromLocalFile(
-                    e.namedItem("location").firstChild().nodeValue()));
-                track->setArtist(e.namedItem("creator").firstChild().nodeValue());
-                track->setTitle(e.namedItem("title").firstChild().nodeValue());
-                track->setAlbum(e.namedItem("album").firstChild().nodeValue());
-                track->setGenre(
-                    e.namedItem("extension").toElement().attribute("genre"));
-                track->setYear(e.namedItem("extension").toElement().attribute("year"));
-                track->setLength(e.namedItem("duration").firstChild().nodeValue());
-                track->setCounter("0");
-                if (e.namedItem("extension")
-                        .toElement()
-                        .attribute("isAutoDjSelection")
-                    == "1")
-                    track->setFlags(track->flags() | Track::isAutoDjSelection);
-
-                appendSong(track);
-
-                if (e.namedItem("extension").toElement().attribute(CURRENT) == "1")
-                    this->setCurrentPlaylistItem(newPlaylistItem);
-                if (e.namedItem("extension").toElement().attribute(NEXT) == "1")
-                    this->setNextPlaylistItem(newPlaylistItem);
-            }
-            n = n.nextSibling();
+void Playlist::similarTracksFound()
+{
+    // behind the item the search started from, at the end if it is gone
+    PlaylistItem* after = lastChild();
+    for (PlaylistItem* item = firstChild(); item; item = item->nextSibling()) {
+        if (item->track()->url().toLocalFile() == similarUrl) {
+            after = item;
+            break;
         }
     }
-    file.close();
-
-    qDebug() << "End " << Q_FUNC_INFO;
+    appendTags(similarWatcher->result(), after);
 }
 
 void Playlist::removeSelectedItems()
@@ -758,7 +722,10 @@ void Playlist::performDrag()
             QStringList tag = item->track()->tagList();
             tags << tag;
             if (i == 0) {
-                cover = QPixmap::fromImage(item->track()->coverImage());
+                QImage image;
+                if (!CoverCache::instance()->findCover(item->track()->url(), image) || image.isNull())
+                    image = item->track()->defaultImage();
+                cover = QPixmap::fromImage(image);
                 emit trackSelected(item->track());
             }
             i++;
@@ -852,6 +819,7 @@ void Playlist::dragLeaveEvent(QDragLeaveEvent* event)
 
 void Playlist::paintEvent(QPaintEvent* event)
 {
+    TraceZone zone("gui", "Playlist::paint");
     QTreeView::paintEvent(event);
     if (showDropHighlighter) {
         QPainter painter(viewport());
@@ -927,6 +895,19 @@ void Playlist::keyPressEvent(QKeyEvent* e)
         QTreeWidget::keyPressEvent(e);
 }
 
+// snippets of the rows on screen are decoded ahead for the monitor
+void Playlist::requestPreviews()
+{
+    QList<QUrl> urls;
+    if (isVisible()) {
+        for (QTreeWidgetItem* item = itemAt(0, 0);
+             item && visualItemRect(item).top() < viewport()->height();
+             item = itemBelow(item))
+            urls.append(((PlaylistItem*)item)->track()->url());
+    }
+    PreviewCache::instance()->request(objectName(), urls);
+}
+
 // needed for showContextMenu actions
 void Playlist::dummySlot() {}
 
@@ -971,6 +952,13 @@ void Playlist::showContextMenu(PlaylistItem* item, int col)
     popup.addAction(style()->standardPixmap(QStyle::SP_ArrowRight),
         tr("&Search for: '%1'").arg(item->text(col)), this,
         SLOT(dummySlot()), Qt::Key_S);
+    // the track list is replaced with every selection, nothing to add to;
+    // only offered once knowthelist-analyse --tempo stored features
+    if (!database)
+        database = new CollectionDB();
+    if (m_PlaylistMode != Playlist::Tracklist && database->hasTrackFeatures())
+        popup.addAction(style()->standardPixmap(QStyle::SP_ArrowRight),
+            tr("Add Si&milar Tracks"), this, SLOT(dummySlot()), Qt::Key_M);
     popup.addSeparator();
     if (!isCurrentPlaylistItem && m_PlaylistMode != Playlist::Tracklist)
         popup.addAction(style()->standardPixmap(QStyle::SP_TrashIcon),
@@ -1002,6 +990,10 @@ void Playlist::showContextMenu(PlaylistItem* item, int col)
         Q_EMIT itemDoubleClicked(item, col);
     } else if (shortcut == QKeySequence(Qt::Key_S)) {
         Q_EMIT wantSearch(item->text(col));
+    } else if (shortcut == QKeySequence(Qt::Key_M)) {
+        // the index may be built first, added behind the item once found
+        similarUrl = item->track()->url().toLocalFile();
+        similarWatcher->setFuture(QtConcurrent::run(database, &CollectionDB::selectSimilarTracks, similarUrl, similarCount));
     } else if (shortcut == QKeySequence(Qt::Key_V)) {
         showTrackInfo(item->track());
     } else if (shortcut == QKeySequence(Qt::Key_O)) {
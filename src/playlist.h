@@ -20,8 +20,11 @@
 
 #include "track.h"
 
+#include <QFutureWatcher>
 #include <QTreeWidget>
 
+class CollectionDB;
+
 class Playlist : public QTreeWidget {
     Q_OBJECT
 public:
@@ -42,9 +45,9 @@ public:
     void appendSong(QString songFileName);
     void appendList(QList<QUrl>, PlaylistItem* after);
     void appendTracks(const QList<Track*> tracks, PlaylistItem* after);
+    void appendTags(const QList<QStringList>& tags, PlaylistItem* after);
 
     void saveXML(const QString&) const;
-    void loadXML(const QString&);
 
     //----------------
     PlaylistItem* firstTrack() const { return firstChild(); }
@@ -111,6 +114,7 @@ public Q_SLOTS:
 
 Q_SIGNALS:
     void currentTrackChanged(Track*);
+    void nextTrackChanged(Track*);
     void trackDoubleClicked(Track*);
     void trackPropertyChanged(Track*);
     void trackSelected(Track*);
@@ -136,11 +140,17 @@ private:
     void performDrag();
     QTimer* timer;
     QTimer* timerDragLock;
+    QTimer* timerPreview;
     bool ignoreNextRelease;
     bool m_dragLocked;
 
     QPoint startPos;
 
+    // created on first use, the similar tracks are searched in a worker
+    CollectionDB* database;
+    QFutureWatcher<QList<QStringList> >* similarWatcher;
+    QString similarUrl;
+
     bool m_isPlaying;
     bool m_isCurrentList;
     bool m_isInternDrop;
@@ -149,6 +159,7 @@ private:
     bool autoClearOn;
 
     PlaylistItem* nextPlaylistItem; //the item to be played after the current track
+    QUrl m_nextUrl; //the url of the last nextTrackChanged()
     PlaylistItem* previousPlaylistItem;
     PlaylistItem* newPlaylistItem; //the latest item
     PlaylistItem* currentPlaylistItem; //the item that is playing
@@ -171,6 +182,8 @@ private Q_SLOTS:
     void timeoutDragLock();
     void handleChanges();
     void slotItemChanged(QTreeWidgetItem* current, QTreeWidgetItem* previous);
+    void requestPreviews();
+    void similarTracksFound();
     void dummySlot();
 };
 
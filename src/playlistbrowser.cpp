@@ -20,12 +20,21 @@
 #include "playlistwidget.h"
 #include "collectiondb.h"
 #include "track.h"
+#include "playlistfile.h"
 
-#include <QtXml>
 #include <QListWidget>
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QInputDialog>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#if QT_VERSION >= 0x050000
+#include <QtConcurrent/QtConcurrent>
+#else
+#include <QtConcurrentRun>
+#endif
 
 class Track;
 
@@ -36,6 +45,14 @@ class PlaylistBrowsertPrivate
     PlaylistWidget* currentPlaylist;
     CollectionDB* database;
     QString directory;
+    // the file list being read, batches of older loads are ignored
+    PlaylistFile* fileLoader;
+    bool fileStart;
+    bool fileFirstBatch;
+    // play time of the file lists while their counts are read
+    QHash<QString, int> fileDurations;
+    // name, count, play time and date of the stored lists
+    QFutureWatcher<QList<QStringList> > listWatcher;
 
 };
 
@@ -77,8 +94,7 @@ PlaylistBrowser::PlaylistBrowser(QWidget *parent) :
 
     p->database  = new CollectionDB();
     p->database->executeSql( "PRAGMA synchronous = OFF;" );
-
-    updateLists();
+    connect(&p->listWatcher,SIGNAL(finished()),this,SLOT(onPlaylistDataLoaded()));
 
     headWidget->raise();
     mainLayout->addWidget(headWidget);
@@ -90,6 +106,9 @@ PlaylistBrowser::PlaylistBrowser(QWidget *parent) :
     setMaximumWidth(400);
 
     p->directory = "";
+    p->fileLoader = nullptr;
+    p->fileStart = false;
+    p->fileFirstBatch = false;
 
     setLayout(mainLayout);
 
@@ -99,6 +118,7 @@ PlaylistBrowser::~PlaylistBrowser()
 {
     QSettings settings;
     //settings.setValue("",p->);
+    p->listWatcher.waitForFinished();
     delete p;
 }
 
@@ -158,8 +178,17 @@ void PlaylistBrowser::updateLists()
     p->listPlaylists->addItem(itm);
     p->listPlaylists->setItemWidget(itm,list);
 
+    // the stored lists are read by a worker
+    p->listWatcher.setFuture(QtConcurrent::run(p->database, &CollectionDB::selectPlaylistData));
+}
+
+void PlaylistBrowser::onPlaylistDataLoaded()
+{
+    PlaylistWidget* list;
+    QListWidgetItem* itm;
+
     // read stored lists
-    QList<QStringList> listData = p->database->selectPlaylistData();
+    QList<QStringList> listData = p->listWatcher.result();
     foreach ( QStringList data, listData) {
         QString name = data[0];
         int count = data[1].toInt();
@@ -184,39 +213,39 @@ void PlaylistBrowser::updateLists()
         p->listPlaylists->setItemWidget(itm,list);
     }
 
-    //// read saved lists
-    //QDir rDir( p->directory );
-    //rDir.setFilter(QDir::Files | QDir::NoDotDot | QDir::NoDot | QDir::Readable);
-    //QStringList filters;
-    //     filters << "*.xspf";
-    //rDir.setNameFilters(filters);
-    //QFileInfoList filelist = rDir.entryInfoList();
-
-    //Q_FOREACH (const QFileInfo fi, filelist) {
-    //        if ( fi.isFile() ) {
-    //            qDebug() << Q_FUNC_INFO << "add playlist: " << fi.fileName();
-    //            list = new PlaylistWidget(p->listPlaylists);
-    //            list->setName(fi.fileName().replace(".xspf",""));
-    //            list->setObjectName(fi.fileName());
-
-    //            QPair<int,int> count = readFileValues( p->directory+"/"+fi.fileName());
-    //            list->setDescription( fi.lastModified().toString("yyyy-MM-dd") + "    "
-    //                                  + QString::number(count.first) + " " + tr("tracks") + "    "
-    //                                  + Track::prettyTime( count.second ,true) + " " + tr("hours"));
-    //            connect(list,SIGNAL(activated()),this,SLOT(loadFileList()));
-    //            connect(list,SIGNAL(started()),this,SLOT(playFileList()));
-    //            connect(list,SIGNAL(deleted()),this,SLOT(removeFileList()));
-
-    //            itm = new QListWidgetItem(p->listPlaylists);
-
-    //            itm->setSizeHint(QSize(0,70));
-    //            p->listPlaylists->addItem(itm);
-    //            p->listPlaylists->setItemWidget(itm,list);
-    //        }
-
-    //}
-
-
+    // read saved lists, their counts arrive from the workers
+    if (p->directory.isEmpty()) {
+        emit listsUpdated();
+        return;
+    }
+    QDir rDir( p->directory );
+    rDir.setFilter(QDir::Files | QDir::NoDotDot | QDir::NoDot | QDir::Readable);
+    QStringList filters;
+    filters << "*.xspf" << "*.m3u" << "*.m3u8" << "*.pls";
+    rDir.setNameFilters(filters);
+    QFileInfoList filelist = rDir.entryInfoList();
+
+    Q_FOREACH (const QFileInfo fi, filelist) {
+        if ( fi.isFile() ) {
+            qDebug() << Q_FUNC_INFO << "add playlist: " << fi.fileName();
+            list = new PlaylistWidget(p->listPlaylists);
+            list->setName(fi.completeBaseName());
+            list->setObjectName(fi.fileName());
+            list->setDescription( fi.lastModified().toString("yyyy-MM-dd") );
+            connect(list,SIGNAL(activated()),this,SLOT(loadFileList()));
+            connect(list,SIGNAL(started()),this,SLOT(playFileList()));
+            connect(list,SIGNAL(deleted()),this,SLOT(removeFileList()));
+
+            itm = new QListWidgetItem(p->listPlaylists);
+
+            itm->setSizeHint(QSize(0,70));
+            p->listPlaylists->addItem(itm);
+            p->listPlaylists->setItemWidget(itm,list);
+
+            readFileValues( fi.fileName() );
+        }
+    }
+    emit listsUpdated();
 }
 
 void PlaylistBrowser::playDatabaseList()
@@ -227,7 +256,9 @@ void PlaylistBrowser::playDatabaseList()
 
         onSelectionChanged(item);
 
-        emit selectionStarted(selectedTracks());
+        QList<Track*> tracks = selectedTracks();
+        emit selectionStarted(tracks);
+        qDeleteAll(tracks);
     }
 }
 
@@ -238,7 +269,9 @@ void PlaylistBrowser::loadDatabaseList()
     if(PlaylistWidget* item = qobject_cast<PlaylistWidget*>(QObject::sender())){
         onSelectionChanged(item);
 
-        emit selectionChanged(selectedTracks());
+        QList<Track*> tracks = selectedTracks();
+        emit selectionChanged(tracks);
+        qDeleteAll(tracks);
     }
 }
 
@@ -319,117 +352,93 @@ void PlaylistBrowser::onPushSave()
         emit storePlaylists(listName);
 }
 
-// obsolate: save list into files
+// read lists from xspf, m3u or pls files, the workers complete entries
+// without metadata from the file tags, not the GUI thread
 
-QList<Track*> PlaylistBrowser::readFileList(QString filename)
+void PlaylistBrowser::readFileList(QString filename, bool start)
 {
-    QFile file( filename );
-    QList<Track*> tracks;
-
-    tracks.clear();
-
-    if( file.open( QFile::ReadOnly ) )
-    {
-        QTextStream stream( &file );
-
-      stream.setCodec( QTextCodec::codecForName("utf8") );
-      QDomDocument d;
-      if( !d.setContent(stream.readAll()) ) { qDebug() << "Could not load XML\n"; return tracks; }
-
-      QDomNode n = d.namedItem( "playlist" ).namedItem( "trackList" ).firstChild();
-
-      const QString TRACK( "track" ); //so we don't construct the QStrings all the time
-      const QString URL( "url" );
-      const QString CURRENT( "current" );
-      const QString NEXT( "next" );
-
-
-      while( !n.isNull() )
-      {
-           if( n.nodeName() == TRACK ) {
-              const QDomElement e = n.toElement();
-              if( e.isNull() ) {
-                 qDebug() << "Element '" << n.nodeName() << "' is null, skipping.";
-                 continue;
-              }
-
-              //qDebug() << "Add from xml url='" << e.attribute( URL );
-              Track *track = new Track();
-              track->setUrl( QUrl::fromLocalFile(e.namedItem("location").firstChild().nodeValue()));
-              track->setArtist( e.namedItem("creator").firstChild().nodeValue());
-              track->setTitle( e.namedItem("title").firstChild().nodeValue());
-              track->setAlbum( e.namedItem("album").firstChild().nodeValue());
-              track->setTracknumber( e.namedItem("trackNum").firstChild().nodeValue());
-              track->setGenre( e.namedItem("extension").toElement().attribute( "genre" ));
-              track->setYear( e.namedItem("extension").toElement().attribute( "year" ));
-              track->setLength( e.namedItem("duration").firstChild().nodeValue());
-              track->setCounter("0");
-              if ( e.namedItem("extension").toElement().attribute( "isAutoDjSelection" ) =="1" )
-                track->setFlags( track->flags() | Track::isAutoDjSelection );
-              if ( e.namedItem("extension").toElement().attribute( "isOnFirstPlayer" ) =="1" )
-                track->setFlags( track->flags() | Track::isOnFirstPlayer );
-              if ( e.namedItem("extension").toElement().attribute( "isOnSecondPlayer" ) =="1" )
-                track->setFlags( track->flags() | Track::isOnSecondPlayer );
-              track->setRate( e.namedItem("extension").toElement().attribute("Rating").toInt() );
-
-              tracks.append(track);
-
-            }
-          n = n.nextSibling();
-      }
-    }
-    file.close();
-
-    qDebug() << "End " << Q_FUNC_INFO;
-
-    return tracks;
+    PlaylistFile* file = new PlaylistFile();
+    connect(file, SIGNAL(tagsLoaded(QList<QStringList>)),
+        this, SLOT(onFileTagsLoaded(QList<QStringList>)), Qt::QueuedConnection);
+    connect(file, SIGNAL(loadFinished(int, int, int)),
+        this, SLOT(onFileListLoaded()), Qt::QueuedConnection);
+
+    p->fileLoader = file;
+    p->fileStart = start;
+    p->fileFirstBatch = true;
+    file->load(filename);
 }
 
-QPair<int,int> PlaylistBrowser::readFileValues(QString filename)
+void PlaylistBrowser::onFileTagsLoaded(const QList<QStringList>& tags)
 {
-    QFile file( filename );
-    QPair<int,int> pair;
-
-    int duration=0;
-    int count=0;
-
-    if( file.open( QFile::ReadOnly ) )
-    {
-      QTextStream stream( &file );
-
-      stream.setCodec( QTextCodec::codecForName("utf8") );
-      QDomDocument d;
-      if( !d.setContent(stream.readAll()) ) { qDebug() << "Could not load XML\n"; return pair; }
+    if (sender() != p->fileLoader)
+        return;
 
-      QDomNode n = d.namedItem( "playlist" ).namedItem( "trackList" ).firstChild();
+    // every batch reaches the playlist as it arrives
+    QList<Track*> tracks;
+    foreach ( QStringList tag, tags )
+        tracks.append( new Track(tag) );
 
-      const QString TRACK( "track" );
+    if (p->fileStart)
+        emit selectionStarted(tracks);
+    else if (p->fileFirstBatch)
+        emit selectionChanged(tracks);
+    else
+        emit selectionExtended(tracks);
+    p->fileFirstBatch = false;
+    qDeleteAll(tracks);
+}
 
+void PlaylistBrowser::onFileListLoaded()
+{
+    sender()->deleteLater();
+    if (sender() != p->fileLoader)
+        return;
+    p->fileLoader = nullptr;
+
+    // an empty list still replaces the shown tracks
+    if (p->fileFirstBatch && !p->fileStart)
+        emit selectionChanged(QList<Track*>());
+    qDebug() << "End " << Q_FUNC_INFO;
+}
 
-      while( !n.isNull() )
-      {
-           if( n.nodeName() == TRACK ) {
-              const QDomElement e = n.toElement();
-              if( e.isNull() ) {
-                 qDebug() << "Element '" << n.nodeName() << "' is null, skipping.";
-                 continue;
-              }
+void PlaylistBrowser::readFileValues(QString name)
+{
+    PlaylistFile* file = new PlaylistFile();
+    file->setObjectName(name);
+    connect(file, SIGNAL(tagsLoaded(QList<QStringList>)),
+        this, SLOT(onFileValuesLoaded(QList<QStringList>)), Qt::QueuedConnection);
+    connect(file, SIGNAL(loadFinished(int, int, int)),
+        this, SLOT(onFileValuesFinished(int)), Qt::QueuedConnection);
+
+    p->fileDurations.insert(name, 0);
+    file->load(p->directory + "/" + name);
+}
 
-              duration+= e.namedItem("duration").firstChild().nodeValue().toInt();
-              count++;
+void PlaylistBrowser::onFileValuesLoaded(const QList<QStringList>& tags)
+{
+    int duration = 0;
+    foreach ( QStringList tag, tags )
+        duration += qMax(0, tag.value(7).toInt());
+    p->fileDurations[sender()->objectName()] += duration;
+}
 
-            }
-          n = n.nextSibling();
-      }
+void PlaylistBrowser::onFileValuesFinished(int count)
+{
+    sender()->deleteLater();
+    QString name = sender()->objectName();
+    int duration = p->fileDurations.take(name);
+
+    // the list may have been rebuilt meanwhile, look the widget up by name
+    for (int d=0;d<p->listPlaylists->count();d++) {
+        PlaylistWidget* list = (PlaylistWidget*)p->listPlaylists->itemWidget(p->listPlaylists->item(d));
+        if (list && list->objectName() == name) {
+            QFileInfo fi( p->directory+"/"+name );
+            list->setDescription( fi.lastModified().toString("yyyy-MM-dd") + "    "
+                                  + QString::number(count) + " " + tr("tracks") + "    "
+                                  + Track::prettyTime( duration ,true) + " " + tr("hours"));
+        }
     }
-    file.close();
-
-    pair.first = count;
-    pair.second = duration;
-
-    qDebug() << "End " << Q_FUNC_INFO;
-
-    return pair;
 }
 
 
@@ -443,7 +452,7 @@ void PlaylistBrowser::playFileList()
 
         QString senderName = item->objectName();
 
-        emit selectionStarted( readFileList( p->directory+"/"+senderName) );
+        readFileList( p->directory+"/"+senderName, true );
     }
 }
 
@@ -458,7 +467,7 @@ void PlaylistBrowser::loadFileList()
         QString senderName = item->objectName();
 
         //Retrieve songs from file
-        emit selectionChanged( readFileList( p->directory+"/"+senderName) );
+        readFileList( p->directory+"/"+senderName, false );
     }
 }
 
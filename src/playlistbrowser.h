@@ -15,15 +15,21 @@ class PlaylistBrowser : public QWidget
 public:
     explicit PlaylistBrowser(QWidget *parent = 0);
     ~PlaylistBrowser();
-    QList<Track*> readFileList(QString filename);
-    QPair<int, int> readFileValues(QString filename);
+    /** Parse a xspf, m3u or pls file in background, the tracks are sent in batches */
+    void readFileList(QString filename, bool start);
+    /** Count tracks and play time of a file list in background for its description */
+    void readFileValues(QString name);
     QList<Track*> selectedTracks();
     
 signals:
     void selectionStarted(QList<Track*>);
     void selectionChanged(QList<Track*>);
+    /** More tracks of the list last sent by selectionChanged() */
+    void selectionExtended(QList<Track*>);
     void savePlaylists(QString);
     void storePlaylists(QString);
+    /** The lists are shown, after updateLists() */
+    void listsUpdated();
     
 public slots:
     void loadDatabaseList();
@@ -36,6 +42,13 @@ public slots:
     void onPushSave();
     void updateLists();
 
+private slots:
+    void onPlaylistDataLoaded();
+    void onFileTagsLoaded(const QList<QStringList>& tags);
+    void onFileListLoaded();
+    void onFileValuesLoaded(const QList<QStringList>& tags);
+    void onFileValuesFinished(int count);
+
 private:
     class PlaylistBrowsertPrivate *p;
     
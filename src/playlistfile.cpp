@@ -0,0 +1,450 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playlistfile.h"
+#include "track.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaType>
+#include <QTextStream>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#if QT_VERSION >= 0x050000
+#include <QtConcurrent/QtConcurrent>
+#else
+#include <QtConcurrentRun>
+#endif
+#include <qdebug.h>
+
+struct PlaylistFilePrivate {
+    int batchSize;
+};
+
+namespace {
+enum Column { Url = 0,
+    Artist,
+    Title,
+    Album,
+    Year,
+    Genre,
+    TrackNum,
+    Length,
+    Counter,
+    Rate,
+    Flags,
+    ColumnCount
+};
+
+QStringList emptyRow()
+{
+    QStringList row;
+    for (int i = 0; i < ColumnCount; i++)
+        row << QString();
+    row[Length] = "-1";
+    row[Counter] = "0";
+    row[Rate] = "0";
+    row[Flags] = "0";
+    return row;
+}
+
+// receives the parsed rows
+class TagSink {
+public:
+    TagSink()
+        : count(0)
+        , current(-1)
+        , next(-1)
+    {
+    }
+    virtual ~TagSink() {}
+    virtual void append(const QStringList& row) = 0;
+    virtual void finish() {}
+
+    int count;
+    int current;
+    int next;
+};
+
+QString localPath(const QString& entry, const QDir& base)
+{
+    if (entry.startsWith("file:"))
+        return QUrl(entry).toLocalFile();
+    // streams and other remote entries are not playable here
+    if (entry.contains("://"))
+        return QString();
+    return QDir::cleanPath(base.absoluteFilePath(entry));
+}
+
+// entries of m3u and pls lists may come without any tags
+QStringList completeRow(const QStringList& row)
+{
+    if (!row.at(Title).isEmpty() || !QFile::exists(row.at(Url)))
+        return row;
+
+    Track track(QUrl::fromLocalFile(row.at(Url)));
+    QStringList tags = track.tagList();
+    tags << row.at(Flags);
+    return tags;
+}
+
+void splitTitle(const QString& text, QStringList& row)
+{
+    int pos = text.indexOf(" - ");
+    if (pos > 0) {
+        row[Artist] = text.left(pos).trimmed();
+        row[Title] = text.mid(pos + 3).trimmed();
+    } else {
+        row[Title] = text.trimmed();
+    }
+}
+
+void setCodec(QTextStream& stream, const QString& fileName)
+{
+    // m3u8 is UTF-8, plain m3u and pls use the local encoding
+    if (fileName.endsWith(".m3u8", Qt::CaseInsensitive))
+        stream.setCodec("UTF-8");
+}
+
+void parseXspf(QFile& file, TagSink& sink)
+{
+    QXmlStreamReader xml(&file);
+    QStringList row;
+    bool inTrack = false;
+
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isStartElement()) {
+            QString name = xml.name().toString();
+            if (name == "track") {
+                row = emptyRow();
+                inTrack = true;
+            } else if (inTrack && name == "extension") {
+                QXmlStreamAttributes attributes = xml.attributes();
+                row[Year] = attributes.value("year").toString();
+                row[Genre] = attributes.value("genre").toString();
+                if (attributes.hasAttribute("Rating"))
+                    row[Rate] = attributes.value("Rating").toString();
+
+                Track::Options flags;
+                if (attributes.value("isAutoDjSelection") == QLatin1String("1"))
+                    flags |= Track::isAutoDjSelection;
+                if (attributes.value("isOnFirstPlayer") == QLatin1String("1"))
+                    flags |= Track::isOnFirstPlayer;
+                if (attributes.value("isOnSecondPlayer") == QLatin1String("1"))
+                    flags |= Track::isOnSecondPlayer;
+                row[Flags] = QString::number(int(flags));
+
+                if (attributes.value("current") == QLatin1String("1"))
+                    sink.current = sink.count;
+                if (attributes.value("next") == QLatin1String("1"))
+                    sink.next = sink.count;
+            } else if (inTrack) {
+                int column = Track::tagNameList.indexOf(name);
+                if (column >= 0 && column != Year && column != Genre)
+                    row[column] = xml.readElementText();
+            }
+        } else if (xml.isEndElement() && xml.name() == QLatin1String("track")) {
+            inTrack = false;
+            if (row.at(Url).startsWith("file:"))
+                row[Url] = QUrl(row.at(Url)).toLocalFile();
+            if (!row.at(Url).isEmpty())
+                sink.append(row);
+        }
+    }
+
+    if (xml.hasError())
+        qDebug() << Q_FUNC_INFO << file.fileName() << xml.errorString() << "at line" << xml.lineNumber();
+}
+
+void parseM3u(QFile& file, TagSink& sink)
+{
+    QDir base = QFileInfo(file).absoluteDir();
+    QTextStream stream(&file);
+    setCodec(stream, file.fileName());
+
+    QStringList row = emptyRow();
+    while (!stream.atEnd()) {
+        QString line = stream.readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        if (line.startsWith("#EXTINF:")) {
+            int comma = line.indexOf(',');
+            row[Length] = line.mid(8, comma - 8).trimmed();
+            if (comma > 0)
+                splitTitle(line.mid(comma + 1), row);
+        } else if (!line.startsWith('#')) {
+            row[Url] = localPath(line, base);
+            if (!row.at(Url).isEmpty())
+                sink.append(completeRow(row));
+            row = emptyRow();
+        }
+    }
+}
+
+void parsePls(QFile& file, TagSink& sink)
+{
+    QDir base = QFileInfo(file).absoluteDir();
+    QTextStream stream(&file);
+    setCodec(stream, file.fileName());
+
+    // entries are grouped by their number, pass one on when the next begins
+    QStringList row = emptyRow();
+    int entry = -1;
+    while (!stream.atEnd()) {
+        QString line = stream.readLine().trimmed();
+        int equal = line.indexOf('=');
+        if (equal < 0)
+            continue;
+
+        QString key = line.left(equal).toLower();
+        QString value = line.mid(equal + 1).trimmed();
+
+        int number = -1;
+        QString field;
+        if (key.startsWith("file"))
+            field = "file";
+        else if (key.startsWith("title"))
+            field = "title";
+        else if (key.startsWith("length"))
+            field = "length";
+        else
+            continue;
+        number = key.mid(field.length()).toInt();
+
+        if (number != entry) {
+            if (!row.at(Url).isEmpty())
+                sink.append(completeRow(row));
+            row = emptyRow();
+            entry = number;
+        }
+
+        if (field == "file")
+            row[Url] = localPath(value, base);
+        else if (field == "title")
+            splitTitle(value, row);
+        else
+            row[Length] = value;
+    }
+    if (!row.at(Url).isEmpty())
+        sink.append(completeRow(row));
+}
+
+bool parse(const QString& fileName, TagSink& sink)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qDebug() << Q_FUNC_INFO << "could not open" << fileName;
+        return false;
+    }
+
+    switch (PlaylistFile::format(fileName)) {
+    case PlaylistFile::Xspf:
+        parseXspf(file, sink);
+        break;
+    case PlaylistFile::M3u:
+        parseM3u(file, sink);
+        break;
+    case PlaylistFile::Pls:
+        parsePls(file, sink);
+        break;
+    default:
+        qDebug() << Q_FUNC_INFO << "unknown playlist format" << fileName;
+        return false;
+    }
+    sink.finish();
+    return true;
+}
+
+void writeXspf(QFile& file, const QList<QStringList>& tags, int current, int next)
+{
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("playlist");
+    xml.writeDefaultNamespace("http://xspf.org/ns/0/");
+    xml.writeAttribute("version", "1");
+    xml.writeTextElement("creator", "Knowthelist");
+    xml.writeStartElement("trackList");
+
+    for (int i = 0; i < tags.count(); i++) {
+        const QStringList& row = tags.at(i);
+        xml.writeStartElement("track");
+        for (int x = 0; x < Flags && x < row.count(); ++x) {
+            if (x != Year && x != Genre)
+                xml.writeTextElement(Track::tagNameList.at(x), row.at(x));
+        }
+
+        xml.writeStartElement("extension");
+        if (i == current)
+            xml.writeAttribute("current", "1");
+        if (i == next)
+            xml.writeAttribute("next", "1");
+        Track::Options flags = QFlag(row.value(Flags).toInt());
+        if (flags.testFlag(Track::isAutoDjSelection))
+            xml.writeAttribute("isAutoDjSelection", "1");
+        if (flags.testFlag(Track::isOnFirstPlayer))
+            xml.writeAttribute("isOnFirstPlayer", "1");
+        if (flags.testFlag(Track::isOnSecondPlayer))
+            xml.writeAttribute("isOnSecondPlayer", "1");
+        xml.writeAttribute("Rating", row.value(Rate, "0"));
+        xml.writeAttribute(Track::tagNameList.at(Year), row.value(Year));
+        xml.writeAttribute(Track::tagNameList.at(Genre), row.value(Genre));
+        xml.writeEndElement();
+
+        xml.writeEndElement();
+    }
+
+    xml.writeEndElement();
+    xml.writeEndElement();
+    xml.writeEndDocument();
+}
+
+QString prettyTitle(const QStringList& row)
+{
+    if (row.value(Artist).isEmpty())
+        return row.value(Title);
+    return row.value(Artist) + " - " + row.value(Title);
+}
+
+void writeM3u(QFile& file, const QList<QStringList>& tags)
+{
+    QTextStream stream(&file);
+    setCodec(stream, file.fileName());
+
+    stream << "#EXTM3U\n";
+    foreach (const QStringList& row, tags) {
+        stream << "#EXTINF:" << row.value(Length, "-1") << "," << prettyTitle(row) << "\n";
+        stream << row.value(Url) << "\n";
+    }
+}
+
+void writePls(QFile& file, const QList<QStringList>& tags)
+{
+    QTextStream stream(&file);
+    setCodec(stream, file.fileName());
+
+    stream << "[playlist]\n";
+    int n = 0;
+    foreach (const QStringList& row, tags) {
+        n++;
+        stream << "File" << n << "=" << row.value(Url) << "\n";
+        stream << "Title" << n << "=" << prettyTitle(row) << "\n";
+        stream << "Length" << n << "=" << row.value(Length, "-1") << "\n";
+    }
+    stream << "NumberOfEntries=" << n << "\n";
+    stream << "Version=2\n";
+}
+}
+
+// passes the parsed rows on in batches, a friend of PlaylistFile to emit its signal
+class BatchSink : public TagSink {
+public:
+    BatchSink(PlaylistFile* file, int size)
+        : file(file)
+        , size(size)
+    {
+    }
+    void append(const QStringList& row)
+    {
+        batch.append(row);
+        count++;
+        if (batch.count() >= size)
+            finish();
+    }
+    void finish()
+    {
+        if (batch.isEmpty())
+            return;
+        Q_EMIT file->tagsLoaded(batch);
+        batch.clear();
+    }
+
+private:
+    PlaylistFile* file;
+    int size;
+    QList<QStringList> batch;
+};
+
+PlaylistFile::PlaylistFile(QObject* parent)
+    : QObject(parent)
+    , p(new PlaylistFilePrivate)
+{
+    p->batchSize = 250;
+    qRegisterMetaType<QList<QStringList> >("QList<QStringList>");
+}
+
+PlaylistFile::~PlaylistFile()
+{
+    delete p;
+}
+
+PlaylistFile::Format PlaylistFile::format(const QString& fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "xspf")
+        return Xspf;
+    if (suffix == "m3u" || suffix == "m3u8")
+        return M3u;
+    if (suffix == "pls")
+        return Pls;
+    return Unknown;
+}
+
+bool PlaylistFile::save(const QString& fileName, const QList<QStringList>& tags, int current, int next)
+{
+    Format fileFormat = format(fileName);
+    if (fileFormat == Unknown) {
+        qDebug() << Q_FUNC_INFO << "unknown playlist format" << fileName;
+        return false;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    if (fileFormat == Xspf)
+        writeXspf(file, tags, current, next);
+    else if (fileFormat == M3u)
+        writeM3u(file, tags);
+    else
+        writePls(file, tags);
+
+    file.close();
+    return file.error() == QFile::NoError;
+}
+
+void PlaylistFile::setBatchSize(int size)
+{
+    p->batchSize = qMax(1, size);
+}
+
+void PlaylistFile::load(const QString& fileName)
+{
+    QtConcurrent::run(this, &PlaylistFile::asynchronLoad, fileName);
+}
+
+void PlaylistFile::asynchronLoad(QString fileName)
+{
+    BatchSink sink(this, p->batchSize);
+    parse(fileName, sink);
+    qDebug() << Q_FUNC_INFO << fileName << ":" << sink.count << "tracks";
+    Q_EMIT loadFinished(sink.count, sink.current, sink.next);
+}
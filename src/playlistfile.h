@@ -0,0 +1,59 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLAYLISTFILE_H
+#define PLAYLISTFILE_H
+
+#include <QObject>
+#include <QStringList>
+
+/*
+ *  Streaming import and export of XSPF, M3U and PLS playlists.
+ *  Tracks are passed as tag lists in the order of Track::tagList(),
+ *  followed by the track flags.
+ */
+class PlaylistFile : public QObject {
+    Q_OBJECT
+
+public:
+    enum Format { Unknown = 0,
+        Xspf = 1,
+        M3u = 2,
+        Pls = 3
+    };
+
+    explicit PlaylistFile(QObject* parent = nullptr);
+    ~PlaylistFile();
+
+    static Format format(const QString& fileName);
+    static bool save(const QString& fileName, const QList<QStringList>& tags, int current = -1, int next = -1);
+
+    /** Parse in background, tags are delivered in batches */
+    void load(const QString& fileName);
+    void setBatchSize(int size);
+
+Q_SIGNALS:
+    void tagsLoaded(const QList<QStringList>& tags);
+    void loadFinished(int count, int current, int next);
+
+private:
+    friend class BatchSink;
+    void asynchronLoad(QString fileName);
+    struct PlaylistFilePrivate* p;
+};
+
+#endif // PLAYLISTFILE_H
@@ -23,6 +23,22 @@
 #include <qdebug.h>
 #include <qlistview.h>
 
+// defined here, Track itself is part of the core without widgets
+Track::Track(const PlaylistItem* item)
+    : Track()
+{
+    setUrl(QUrl::fromLocalFile(item->urlString()));
+    setTitle(item->title());
+    setArtist(item->exactText(2));
+    setAlbum(item->exactText(4));
+    setYear(item->exactText(5));
+    setComment(item->exactText(6));
+    setGenre(item->exactText(7));
+    setTracknumber(item->exactText(8));
+    setCounter(item->exactText(9));
+    // setRate(item->rate());
+}
+
 PlaylistItem::PlaylistItem(Playlist* parent, QTreeWidgetItem* lvi)
     : QTreeWidgetItem(parent, lvi)
     , m_track(new Track())
@@ -39,6 +55,8 @@ PlaylistItem::~PlaylistItem()
 
 void PlaylistItem::setTrack(Track* track)
 {
+    if (m_track != track)
+        delete m_track;
     m_track = track;
     setTexts(m_track);
 }
@@ -72,6 +90,9 @@ void PlaylistItem::setTexts(Track* track)
 
     setToolTip(Column_Artist, str);
 
+    // the placeholder track created with the item is not needed anymore
+    if (m_track != track)
+        delete m_track;
     m_track = track;
 }
 
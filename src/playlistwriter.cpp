@@ -0,0 +1,363 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playlistwriter.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QTimer>
+#include <QtSql>
+#include <qdebug.h>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const quint32 journalMagic = 0x4b544c4a;
+const quint32 journalVersion = 1;
+const int retryDelay = 5000;
+
+struct PendingList {
+    QList<PlaylistRow> rows;
+    bool replace;
+};
+
+bool sameRow(const PlaylistRow& a, const PlaylistRow& b)
+{
+    return a.length == b.length
+        && a.flags == b.flags
+        && a.norder == b.norder;
+}
+}
+
+struct PlaylistWriterPrivate {
+    QMutex mutex;
+    QMap<QString, PendingList> pending;
+    QHash<QString, QHash<QString, PlaylistRow> > storedRows;
+    QString databaseName;
+    QString connectionName;
+    QString journalName;
+    QTimer* timer;
+};
+
+PlaylistWriter::PlaylistWriter(const QString& databaseName)
+    : QObject()
+    , p(new PlaylistWriterPrivate)
+{
+    p->databaseName = databaseName;
+    p->connectionName = "playlistwriter";
+    p->journalName = QFileInfo(databaseName).absolutePath() + "/playlists.journal";
+
+    // child of the writer, moves with it into the writer thread
+    p->timer = new QTimer(this);
+    p->timer->setSingleShot(true);
+    connect(p->timer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+PlaylistWriter::~PlaylistWriter()
+{
+    delete p;
+}
+
+void PlaylistWriter::store(const QString& name, const QList<PlaylistRow>& rows, bool replace, int delay)
+{
+    p->mutex.lock();
+    PendingList list;
+    list.rows = rows;
+    list.replace = replace;
+    p->pending.insert(name, list);
+    p->mutex.unlock();
+
+    QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection, Q_ARG(int, delay));
+}
+
+void PlaylistWriter::recover()
+{
+    if (QFile::exists(p->journalName) || QFile::exists(p->journalName + ".tmp"))
+        QMetaObject::invokeMethod(this, "replayJournal", Qt::BlockingQueuedConnection);
+}
+
+void PlaylistWriter::stop()
+{
+    QMetaObject::invokeMethod(this, "shutdown", Qt::BlockingQueuedConnection);
+}
+
+void PlaylistWriter::schedule(int delay)
+{
+    // journal first, the request survives a crash until it is committed
+    writeJournal();
+
+    if (delay > 0)
+        p->timer->start(delay);
+    else
+        flush();
+}
+
+void PlaylistWriter::flush()
+{
+    p->timer->stop();
+
+    p->mutex.lock();
+    QMap<QString, PendingList> jobs = p->pending;
+    p->pending.clear();
+    p->mutex.unlock();
+
+    if (jobs.isEmpty())
+        return;
+
+    if (!QSqlDatabase::contains(p->connectionName)) {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", p->connectionName);
+        db.setDatabaseName(p->databaseName);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+    }
+    QSqlDatabase db = QSqlDatabase::database(p->connectionName);
+
+    bool ok = db.isOpen() && db.transaction();
+    QMap<QString, PendingList>::const_iterator it;
+    for (it = jobs.constBegin(); ok && it != jobs.constEnd(); ++it)
+        ok = writeList(it.key(), it.value().rows, it.value().replace);
+
+    if (ok)
+        ok = db.commit();
+
+    if (!ok) {
+        qDebug() << Q_FUNC_INFO << "store failed, retry later:" << db.lastError().text();
+        db.rollback();
+        p->storedRows.clear();
+
+        // newer requests of the same list win over the failed ones
+        p->mutex.lock();
+        for (it = jobs.constBegin(); it != jobs.constEnd(); ++it)
+            if (!p->pending.contains(it.key()))
+                p->pending.insert(it.key(), it.value());
+        p->mutex.unlock();
+        p->timer->start(retryDelay);
+        return;
+    }
+
+    writeJournal();
+
+    for (it = jobs.constBegin(); it != jobs.constEnd(); ++it)
+        Q_EMIT stored(it.key());
+}
+
+bool PlaylistWriter::writeList(const QString& name, const QList<PlaylistRow>& rows, bool replace)
+{
+    QSqlDatabase db = QSqlDatabase::database(p->connectionName);
+
+    QHash<QString, PlaylistRow> now;
+    foreach (const PlaylistRow& row, rows)
+        now.insert(row.url, row);
+
+    // named lists are written completely to keep one change date per list,
+    // replaced lists only get the rows that differ from the stored ones
+    QHash<QString, PlaylistRow> old;
+    if (replace) {
+        // the cache is dropped if the list changed behind the writer's back,
+        // e.g. removed by CollectionDB::removePlaylist() or a table reset
+        if (p->storedRows.contains(name)) {
+            QSqlQuery count(db);
+            count.prepare("SELECT count(*) FROM playlists WHERE name = ?;");
+            count.addBindValue(name);
+            if (!count.exec() || !count.next())
+                return false;
+            if (count.value(0).toInt() == p->storedRows.value(name).count())
+                old = p->storedRows.value(name);
+            else
+                p->storedRows.remove(name);
+        }
+        if (!p->storedRows.contains(name)) {
+            QSqlQuery select(db);
+            select.prepare("SELECT url, length, flags, norder FROM playlists WHERE name = ?;");
+            select.addBindValue(name);
+            if (!select.exec())
+                return false;
+            while (select.next()) {
+                PlaylistRow row;
+                row.url = select.value(0).toString();
+                row.length = select.value(1).toInt();
+                row.flags = select.value(2).toInt();
+                row.norder = select.value(3).toInt();
+                old.insert(row.url, row);
+            }
+        }
+    }
+
+    int removed = 0;
+    int written = 0;
+
+    if (replace) {
+        QSqlQuery remove(db);
+        remove.prepare("DELETE FROM playlists WHERE name = ? AND url = ?;");
+        QHash<QString, PlaylistRow>::const_iterator it;
+        for (it = old.constBegin(); it != old.constEnd(); ++it) {
+            if (now.contains(it.key()))
+                continue;
+            remove.addBindValue(name);
+            remove.addBindValue(it.key());
+            if (!remove.exec())
+                return false;
+            removed++;
+        }
+    }
+
+    QSqlQuery insert(db);
+    insert.prepare("INSERT OR REPLACE INTO playlists "
+                   "( url, name, length, flags, norder, changedate ) "
+                   "VALUES(?, ?, ?, ?, ?, strftime('%s', 'now'));");
+    QHash<QString, PlaylistRow>::const_iterator it;
+    for (it = now.constBegin(); it != now.constEnd(); ++it) {
+        if (old.contains(it.key()) && sameRow(old.value(it.key()), it.value()))
+            continue;
+        insert.addBindValue(it.value().url);
+        insert.addBindValue(name);
+        insert.addBindValue(it.value().length);
+        insert.addBindValue(it.value().flags);
+        insert.addBindValue(it.value().norder);
+        if (!insert.exec())
+            return false;
+        written++;
+    }
+
+    if (replace)
+        p->storedRows.insert(name, now);
+    else
+        p->storedRows.remove(name);
+
+    qDebug() << Q_FUNC_INFO << name << ":" << written << "rows written," << removed << "removed";
+    return true;
+}
+
+void PlaylistWriter::writeJournal()
+{
+    p->mutex.lock();
+    QMap<QString, PendingList> lists = p->pending;
+    p->mutex.unlock();
+
+    QString tempName = p->journalName + ".tmp";
+    if (lists.isEmpty()) {
+        QFile::remove(p->journalName);
+        QFile::remove(tempName);
+        return;
+    }
+
+    QFile file(tempName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << Q_FUNC_INFO << "could not write" << tempName;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << journalMagic << journalVersion << quint32(lists.count());
+    QMap<QString, PendingList>::const_iterator it;
+    for (it = lists.constBegin(); it != lists.constEnd(); ++it) {
+        stream << it.key() << it.value().replace << quint32(it.value().rows.count());
+        foreach (const PlaylistRow& row, it.value().rows)
+            stream << row.url << qint32(row.length) << qint32(row.flags) << qint32(row.norder);
+    }
+    // on disk before it replaces the old journal
+    bool ok = stream.status() == QDataStream::Ok && file.flush();
+#ifdef Q_OS_WIN
+    ok = ok && _commit(file.handle()) == 0;
+#else
+    ok = ok && fsync(file.handle()) == 0;
+#endif
+    file.close();
+    if (!ok) {
+        qDebug() << Q_FUNC_INFO << "could not write" << tempName;
+        QFile::remove(tempName);
+        return;
+    }
+
+    // replace the journal in one step, a crash leaves the old or the new one
+    QFile::remove(p->journalName);
+    QFile::rename(tempName, p->journalName);
+}
+
+void PlaylistWriter::replayJournal()
+{
+    QFile file(p->journalName);
+    if (!file.exists())
+        file.setFileName(p->journalName + ".tmp");
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic, version, count;
+    stream >> magic >> version >> count;
+    if (magic != journalMagic || version != journalVersion) {
+        qDebug() << Q_FUNC_INFO << "ignore unknown journal" << file.fileName();
+        file.remove();
+        return;
+    }
+
+    QMap<QString, PendingList> lists;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QString name;
+        PendingList list;
+        quint32 rowCount;
+        stream >> name >> list.replace >> rowCount;
+        for (quint32 r = 0; r < rowCount && stream.status() == QDataStream::Ok; r++) {
+            PlaylistRow row;
+            qint32 length, flags, norder;
+            stream >> row.url >> length >> flags >> norder;
+            row.length = length;
+            row.flags = flags;
+            row.norder = norder;
+            list.rows.append(row);
+        }
+        lists.insert(name, list);
+    }
+    file.close();
+
+    if (stream.status() != QDataStream::Ok) {
+        qDebug() << Q_FUNC_INFO << "journal is truncated, ignored";
+        file.remove();
+        return;
+    }
+
+    qDebug() << Q_FUNC_INFO << "recover" << lists.count() << "unsaved playlists";
+    p->mutex.lock();
+    QMap<QString, PendingList>::const_iterator it;
+    for (it = lists.constBegin(); it != lists.constEnd(); ++it)
+        if (!p->pending.contains(it.key()))
+            p->pending.insert(it.key(), it.value());
+    p->mutex.unlock();
+
+    flush();
+}
+
+void PlaylistWriter::shutdown()
+{
+    flush();
+    p->timer->stop();
+
+    if (QSqlDatabase::contains(p->connectionName)) {
+        {
+            QSqlDatabase db = QSqlDatabase::database(p->connectionName, false);
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(p->connectionName);
+    }
+}
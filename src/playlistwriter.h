@@ -0,0 +1,67 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLAYLISTWRITER_H
+#define PLAYLISTWRITER_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+
+struct PlaylistRow {
+    QString url;
+    int length;
+    int flags;
+    int norder;
+};
+
+/*
+ *  Stores playlists into the playlists table from its own thread.
+ *  Requests are coalesced per list name, journaled to disk until they are
+ *  committed and written as the difference to the stored rows, in one
+ *  transaction.
+ */
+class PlaylistWriter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PlaylistWriter(const QString& databaseName);
+    ~PlaylistWriter();
+
+    /** Thread safe, the list is written after delay milliseconds */
+    void store(const QString& name, const QList<PlaylistRow>& rows, bool replace, int delay = 0);
+    /** Write lists left over by a crash, blocks the caller */
+    void recover();
+    /** Write all pending lists and close the connection, blocks the caller */
+    void stop();
+
+Q_SIGNALS:
+    void stored(const QString& name);
+
+private Q_SLOTS:
+    void schedule(int delay);
+    void flush();
+    void replayJournal();
+    void shutdown();
+
+private:
+    bool writeList(const QString& name, const QList<PlaylistRow>& rows, bool replace);
+    void writeJournal();
+    struct PlaylistWriterPrivate* p;
+};
+
+#endif // PLAYLISTWRITER_H
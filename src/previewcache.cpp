@@ -0,0 +1,366 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "previewcache.h"
+#include "pcmdecoder.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QSettings>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <qdebug.h>
+
+namespace {
+// a file that does not preroll in time is left to the monitor
+const int prerollTimeout = 10000;
+// files without a snippet, not tried again
+const int failedLimit = 64;
+}
+
+/*
+ *  Decodes the snippets PreviewCache hands out one after the other.
+ */
+class PreviewDecoder : public PcmDecoder {
+public:
+    explicit PreviewDecoder(PreviewCache* cache)
+        : m_cache(cache)
+        , m_limit(0)
+    {
+    }
+
+    void run()
+    {
+        // below the decoders of the decks when both need the CPU
+        QThread::currentThread()->setPriority(QThread::LowestPriority);
+        while (true) {
+            m_track = m_cache->take();
+            if (!m_track)
+                break;
+            decode(m_cache->seconds());
+            if (m_track->isFailed())
+                m_cache->remove(m_track.data());
+            m_track.clear();
+        }
+    }
+
+protected:
+    void store(const char* data, qint64 size)
+    {
+        qint64 room = m_limit - m_track->size();
+        if (room > 0)
+            m_track->append(data, qMin(size, room));
+    }
+
+private:
+    void decode(int seconds)
+    {
+        TraceZone zone("preview", "decode");
+        if (zone.isActive())
+            zone.setDetail(m_track->url().toString());
+
+        if (!create("preview"))
+            return;
+        gst_element_set_state(m_pipeline, GST_STATE_PAUSED);
+
+        // the length is known once prerolled, then jump to the snippet
+        bool prerolled = false;
+        bool done = false;
+        for (int waited = 0; !prerolled && !done && waited < prerollTimeout; waited += 100) {
+            if (m_track->isCancelled())
+                break;
+            GstMessage* message = gst_bus_timed_pop_filtered(m_bus, 100 * GST_MSECOND,
+                GstMessageType(GST_MESSAGE_ERROR | GST_MESSAGE_ASYNC_DONE));
+            if (!message)
+                continue;
+            if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ASYNC_DONE)
+                prerolled = true;
+            else
+                done = true;
+            gst_message_unref(message);
+        }
+
+        qint64 length = prerolled ? queryDuration() : 0;
+        qint64 start = PreviewCache::start(length);
+        qint64 stop = qMin(length, start + seconds * GST_SECOND);
+        if (length <= 0 || stop <= start
+            || !gst_element_seek(m_pipeline, 1.0, GST_FORMAT_TIME, GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE),
+                   GST_SEEK_TYPE_SET, start, GST_SEEK_TYPE_SET, stop)) {
+            qDebug() << Q_FUNC_INFO << "no snippet of" << m_track->url();
+            m_track->fail();
+            done = true;
+        } else {
+            m_limit = gst_util_uint64_scale(stop - start, m_track->rate(), GST_SECOND) * m_track->bytesPerFrame();
+            m_track->setSpan(start, length);
+            m_track->setDuration(stop - start);
+            gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
+        }
+
+        while (!done && !m_track->isCancelled() && m_track->size() < m_limit) {
+            GstMessage* message = gst_bus_timed_pop_filtered(m_bus, 100 * GST_MSECOND,
+                GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+            if (!message)
+                continue;
+            if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
+                qDebug() << Q_FUNC_INFO << "could not decode" << m_track->url();
+                m_track->fail();
+            }
+            done = true;
+            gst_message_unref(message);
+        }
+        if (!m_track->isFailed()) {
+            if (m_track->isCancelled())
+                m_track->fail();
+            else
+                m_track->finish();
+        }
+        destroy();
+    }
+
+    PreviewCache* m_cache;
+    qint64 m_limit;
+};
+
+struct PreviewCachePrivate {
+    QMutex mutex;
+    QThreadPool pool;
+    // woken on shutdown while waiting for the decks
+    QWaitCondition idle;
+    PcmCache* decks;
+    bool enabled;
+    bool running;
+    bool shutdown;
+    int seconds;
+    int capacity;
+    QHash<QString, QSharedPointer<PcmTrack> > snippets;
+    // least recently heard first
+    QStringList order;
+    // source -> urls, top first
+    QMap<QString, QStringList> requests;
+    QString preferred;
+    QStringList failed;
+    int hits;
+    int misses;
+};
+
+PreviewCache* PreviewCache::instance()
+{
+    static PreviewCache* cache = new PreviewCache(QCoreApplication::instance());
+    return cache;
+}
+
+PreviewCache::PreviewCache(QObject* parent)
+    : QObject(parent)
+    , p(new PreviewCachePrivate)
+{
+    QSettings settings;
+    p->enabled = settings.value("Preview", true).toBool();
+    p->seconds = qBound(5, settings.value("PreviewSeconds", 20).toInt(), 120);
+    qint64 budget = qint64(qMax(8, settings.value("PreviewCacheMB", 64).toInt())) * 1048576;
+    qint64 snippetSize = qint64(p->seconds) * PcmTrack::rate() * PcmTrack::channels() * 2;
+    p->capacity = qMax(qint64(1), budget / snippetSize);
+    p->running = false;
+    p->shutdown = false;
+    p->hits = 0;
+    p->misses = 0;
+    p->pool.setMaxThreadCount(1);
+    p->decks = PcmCache::instance();
+}
+
+PreviewCache::~PreviewCache()
+{
+    p->mutex.lock();
+    p->shutdown = true;
+    foreach (QSharedPointer<PcmTrack> track, p->snippets)
+        track->cancel();
+    p->idle.wakeAll();
+    p->mutex.unlock();
+    p->pool.waitForDone();
+    delete p;
+}
+
+bool PreviewCache::isEnabled()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->enabled;
+}
+
+void PreviewCache::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&p->mutex);
+    p->enabled = enabled;
+    if (enabled) {
+        schedule();
+    } else {
+        foreach (QSharedPointer<PcmTrack> track, p->snippets)
+            track->cancel();
+        p->snippets.clear();
+        p->order.clear();
+    }
+}
+
+int PreviewCache::seconds()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->seconds;
+}
+
+qint64 PreviewCache::start(qint64 length)
+{
+    return length / 10;
+}
+
+void PreviewCache::request(const QString& source, const QList<QUrl>& urls)
+{
+    QStringList keys;
+    foreach (const QUrl& url, urls)
+        keys.append(url.toString());
+
+    QMutexLocker locker(&p->mutex);
+    if (keys.isEmpty())
+        p->requests.remove(source);
+    else
+        p->requests.insert(source, keys);
+    schedule();
+}
+
+void PreviewCache::prefer(const QUrl& url)
+{
+    QMutexLocker locker(&p->mutex);
+    p->preferred = url.toString();
+    schedule();
+}
+
+QSharedPointer<PcmTrack> PreviewCache::snippet(const QUrl& url)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!p->enabled)
+        return QSharedPointer<PcmTrack>();
+
+    QString key = url.toString();
+    QSharedPointer<PcmTrack> track = p->snippets.value(key);
+    if (track && track->waitReady(0)) {
+        p->hits++;
+        p->order.removeOne(key);
+        p->order.append(key);
+    } else {
+        p->misses++;
+        track.clear();
+    }
+    qDebug() << Q_FUNC_INFO << url << p->hits << "hits," << p->misses << "misses";
+    return track;
+}
+
+int PreviewCache::hits()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->hits;
+}
+
+int PreviewCache::misses()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->misses;
+}
+
+void PreviewCache::schedule()
+{
+    // called with the mutex held
+    if (p->running || p->shutdown || !p->enabled)
+        return;
+    if (p->preferred.isEmpty() && p->requests.isEmpty())
+        return;
+    p->running = true;
+    p->pool.start(new PreviewDecoder(this));
+}
+
+QSharedPointer<PcmTrack> PreviewCache::take()
+{
+    QMutexLocker locker(&p->mutex);
+    // the tracks of the decks decode first
+    while (p->enabled && !p->shutdown && p->decks->isDecoding())
+        p->idle.wait(&p->mutex, 100);
+    if (p->enabled && !p->shutdown) {
+        // the selected track, then the top rows of every list
+        QStringList candidates;
+        if (!p->preferred.isEmpty())
+            candidates.append(p->preferred);
+        int rows = 0;
+        foreach (const QStringList& keys, p->requests)
+            rows = qMax(rows, keys.count());
+        for (int row = 0; row < rows; row++)
+            foreach (const QStringList& keys, p->requests)
+                if (row < keys.count())
+                    candidates.append(keys.at(row));
+
+        foreach (const QString& key, candidates) {
+            if (p->snippets.contains(key) || p->failed.contains(key))
+                continue;
+            if (p->snippets.count() >= p->capacity) {
+                // room only from a snippet no list shows any more
+                QString victim;
+                foreach (const QString& old, p->order) {
+                    if (!isRequested(old)) {
+                        victim = old;
+                        break;
+                    }
+                }
+                if (victim.isEmpty())
+                    break;
+                p->snippets.take(victim)->cancel();
+                p->order.removeOne(victim);
+            }
+            QSharedPointer<PcmTrack> track(new PcmTrack(QUrl(key), PcmTrack::Integer16));
+            p->snippets.insert(key, track);
+            p->order.append(key);
+            return track;
+        }
+    }
+    p->running = false;
+    return QSharedPointer<PcmTrack>();
+}
+
+bool PreviewCache::isRequested(const QString& url)
+{
+    // called with the mutex held
+    if (url == p->preferred)
+        return true;
+    foreach (const QStringList& keys, p->requests)
+        if (keys.contains(url))
+            return true;
+    return false;
+}
+
+void PreviewCache::remove(PcmTrack* track)
+{
+    QMutexLocker locker(&p->mutex);
+    QString key = track->url().toString();
+    if (p->snippets.value(key).data() == track) {
+        p->snippets.remove(key);
+        p->order.removeOne(key);
+    }
+    if (!track->isCancelled() && !p->failed.contains(key)) {
+        p->failed.append(key);
+        if (p->failed.count() > failedLimit)
+            p->failed.removeFirst();
+    }
+}
@@ -0,0 +1,76 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PREVIEWCACHE_H
+#define PREVIEWCACHE_H
+
+#include "pcmcache.h"
+
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QUrl>
+
+/*
+ *  Decodes short snippets of the tracks a list shows, from the point a
+ *  pre-listen jumps to, so the monitor starts them from memory without
+ *  opening and seeking the file. "PreviewSeconds" (20) is the length of
+ *  a snippet, "PreviewCacheMB" (64) the memory for all of them, the least
+ *  recently heard are dropped first; "Preview" turns it off. One thread
+ *  at lowest priority decodes, it waits while the PcmCache decodes a
+ *  track of the decks.
+ *  Create the instance in the GUI thread.
+ */
+class PreviewCache : public QObject {
+    Q_OBJECT
+
+public:
+    static PreviewCache* instance();
+    ~PreviewCache();
+
+    bool isEnabled();
+    void setEnabled(bool enabled);
+    int seconds();
+
+    /** Where a pre-listen starts, a tenth into the track */
+    static qint64 start(qint64 length);
+
+    /** Replaces the tracks source shows, decoded top first */
+    void request(const QString& source, const QList<QUrl>& urls);
+    /** Decodes url before all others, the selected track */
+    void prefer(const QUrl& url);
+    /** The snippet of url if it is decoding or done, null otherwise */
+    QSharedPointer<PcmTrack> snippet(const QUrl& url);
+
+    int hits();
+    int misses();
+
+private:
+    friend class PreviewDecoder;
+    explicit PreviewCache(QObject* parent = nullptr);
+    void schedule();
+    /** The next snippet to decode once the decks are decoded, null if nothing
+        is left or there is no room */
+    QSharedPointer<PcmTrack> take();
+    bool isRequested(const QString& url);
+    /** Drops a snippet that could not be decoded */
+    void remove(PcmTrack* track);
+    struct PreviewCachePrivate* p;
+};
+
+#endif // PREVIEWCACHE_H
@@ -0,0 +1,323 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "readahead.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QRunnable>
+#include <QSettings>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <qdebug.h>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+namespace {
+const int chunkSize = 256 * 1024;
+// the deck plays long before the end of a larger file is needed
+const qint64 fileLimit = 128 * 1048576;
+// files remembered as read, for the hit rate
+const int doneLimit = 64;
+}
+
+struct ReadAheadPrivate {
+    QMutex mutex;
+    QWaitCondition wake;
+    QThreadPool pool;
+    QElapsedTimer clock;
+    bool enabled;
+    bool running;
+    bool shutdown;
+    int depth;
+    qint64 bandwidth;
+    // source -> local files, nearest first
+    QMap<QString, QStringList> upcoming;
+    QStringList warm;
+    QStringList failed;
+    QString reading;
+    qint64 nextSlot;
+    qint64 bytesRead;
+    int hits;
+    int partials;
+    int misses;
+};
+
+class ReadAheadWorker : public QRunnable {
+public:
+    explicit ReadAheadWorker(ReadAhead* readAhead)
+        : readAhead(readAhead)
+    {
+    }
+
+    void run()
+    {
+        QString fileName;
+        while (!(fileName = readAhead->take()).isEmpty()) {
+            TraceZone zone("readahead", "read");
+            if (zone.isActive())
+                zone.setDetail(QFileInfo(fileName).fileName());
+
+            QFile file(fileName);
+            if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+                readAhead->finished(fileName, false);
+                continue;
+            }
+#ifdef Q_OS_LINUX
+            // a larger kernel read ahead window, fewer seeks next to a scan
+            posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            QByteArray chunk(chunkSize, '\0');
+            qint64 limit = qMin(file.size(), fileLimit);
+            qint64 total = 0;
+            bool complete = true;
+            while (total < limit) {
+                if (!readAhead->isWanted(fileName)) {
+                    complete = false;
+                    break;
+                }
+                qint64 count = file.read(chunk.data(), chunk.size());
+                if (count <= 0)
+                    break;
+                total += count;
+                if (!readAhead->throttle(count)) {
+                    complete = false;
+                    break;
+                }
+            }
+            // a file no longer upcoming may be read again later
+            if (complete)
+                readAhead->finished(fileName, true);
+        }
+    }
+
+private:
+    ReadAhead* readAhead;
+};
+
+ReadAhead* ReadAhead::instance()
+{
+    static ReadAhead* readAhead = new ReadAhead(QCoreApplication::instance());
+    return readAhead;
+}
+
+ReadAhead::ReadAhead(QObject* parent)
+    : QObject(parent)
+    , p(new ReadAheadPrivate)
+{
+    QSettings settings;
+    p->enabled = settings.value("ReadAhead", true).toBool();
+    p->depth = qMax(1, settings.value("ReadAheadTracks", 2).toInt());
+    p->bandwidth = qMax(64, settings.value("ReadAheadKBs", 8192).toInt()) * qint64(1024);
+    p->running = false;
+    p->shutdown = false;
+    p->nextSlot = 0;
+    p->bytesRead = 0;
+    p->hits = 0;
+    p->partials = 0;
+    p->misses = 0;
+    p->pool.setMaxThreadCount(1);
+    p->clock.start();
+}
+
+ReadAhead::~ReadAhead()
+{
+    p->mutex.lock();
+    p->shutdown = true;
+    p->wake.wakeAll();
+    p->mutex.unlock();
+    p->pool.waitForDone();
+    delete p;
+}
+
+bool ReadAhead::isEnabled()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->enabled;
+}
+
+void ReadAhead::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&p->mutex);
+    p->enabled = enabled;
+    if (enabled)
+        schedule();
+}
+
+int ReadAhead::depth()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->depth;
+}
+
+void ReadAhead::setDepth(int tracks)
+{
+    QMutexLocker locker(&p->mutex);
+    p->depth = qMax(1, tracks);
+}
+
+qint64 ReadAhead::bandwidth()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->bandwidth;
+}
+
+void ReadAhead::setBandwidth(qint64 bytes)
+{
+    QMutexLocker locker(&p->mutex);
+    p->bandwidth = qMax(qint64(65536), bytes);
+}
+
+void ReadAhead::setUpcoming(const QString& source, const QList<QUrl>& urls)
+{
+    QStringList files;
+    foreach (const QUrl& url, urls)
+        if (url.isLocalFile() && files.count() < depth())
+            files.append(url.toLocalFile());
+
+    QMutexLocker locker(&p->mutex);
+    if (files.isEmpty())
+        p->upcoming.remove(source);
+    else
+        p->upcoming.insert(source, files);
+    schedule();
+}
+
+void ReadAhead::opened(const QUrl& url)
+{
+    if (!url.isLocalFile())
+        return;
+    QString fileName = url.toLocalFile();
+
+    QMutexLocker locker(&p->mutex);
+    if (!p->enabled)
+        return;
+    if (p->warm.contains(fileName))
+        p->hits++;
+    else if (p->reading == fileName)
+        p->partials++;
+    else
+        p->misses++;
+
+    int count = p->hits + p->partials + p->misses;
+    qDebug() << Q_FUNC_INFO << p->hits << "hits," << p->partials << "partial," << p->misses << "misses,"
+             << p->bytesRead / 1048576 << "MB read ahead";
+    if (Tracer::isEnabled())
+        Tracer::instance()->counter("readahead", "read ahead hit rate", 100.0 * p->hits / count);
+}
+
+int ReadAhead::hits()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->hits;
+}
+
+int ReadAhead::partials()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->partials;
+}
+
+int ReadAhead::misses()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->misses;
+}
+
+double ReadAhead::hitRate()
+{
+    QMutexLocker locker(&p->mutex);
+    int count = p->hits + p->partials + p->misses;
+    return count > 0 ? double(p->hits) / count : 0;
+}
+
+qint64 ReadAhead::bytesRead()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->bytesRead;
+}
+
+void ReadAhead::schedule()
+{
+    // called with the mutex held
+    if (p->running || p->shutdown || !p->enabled || p->upcoming.isEmpty())
+        return;
+    p->running = true;
+    p->pool.start(new ReadAheadWorker(this));
+}
+
+QString ReadAhead::take()
+{
+    QMutexLocker locker(&p->mutex);
+    p->reading.clear();
+    if (p->enabled && !p->shutdown) {
+        // the next track of every source first, then the one after
+        for (int rank = 0; rank < p->depth; rank++) {
+            foreach (const QStringList& files, p->upcoming) {
+                if (rank >= files.count())
+                    continue;
+                const QString& fileName = files.at(rank);
+                if (!p->warm.contains(fileName) && !p->failed.contains(fileName)) {
+                    p->reading = fileName;
+                    return fileName;
+                }
+            }
+        }
+    }
+    p->running = false;
+    return QString();
+}
+
+bool ReadAhead::isWanted(const QString& fileName)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!p->enabled || p->shutdown)
+        return false;
+    foreach (const QStringList& files, p->upcoming)
+        if (files.contains(fileName))
+            return true;
+    return false;
+}
+
+bool ReadAhead::throttle(qint64 bytes)
+{
+    QMutexLocker locker(&p->mutex);
+    p->bytesRead += bytes;
+    p->nextSlot = qMax(p->nextSlot, p->clock.elapsed()) + bytes * 1000 / p->bandwidth;
+    while (!p->shutdown && p->clock.elapsed() < p->nextSlot)
+        p->wake.wait(&p->mutex, p->nextSlot - p->clock.elapsed());
+    return !p->shutdown;
+}
+
+void ReadAhead::finished(const QString& fileName, bool complete)
+{
+    QMutexLocker locker(&p->mutex);
+    p->reading.clear();
+    QStringList& list = complete ? p->warm : p->failed;
+    list.removeOne(fileName);
+    list.append(fileName);
+    if (list.count() > doneLimit)
+        list.removeFirst();
+}
@@ -0,0 +1,78 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+
+/*
+ *  Reads the files that play next into the page cache, so opening them
+ *  runs at memory speed. Every source (a playlist, the Auto DJ) names its
+ *  upcoming tracks, one thread reads them nearest first at no more than
+ *  "ReadAheadKBs" (8192 by default), so a running scan keeps its disk.
+ *  "ReadAheadTracks" is the number of tracks taken from each source, the
+ *  setting "ReadAhead" turns it off. Only local files are read.
+ *  Create the instance in the GUI thread, the rest is thread safe.
+ */
+class ReadAhead : public QObject {
+    Q_OBJECT
+
+public:
+    static ReadAhead* instance();
+    ~ReadAhead();
+
+    bool isEnabled();
+    void setEnabled(bool enabled);
+    /** Tracks taken from each source */
+    int depth();
+    void setDepth(int tracks);
+    /** Bytes per second */
+    qint64 bandwidth();
+    void setBandwidth(qint64 bytes);
+
+    /** Replaces the upcoming tracks of source, nearest first */
+    void setUpcoming(const QString& source, const QList<QUrl>& urls);
+    /** A deck opens url, counts a hit if it was read ahead */
+    void opened(const QUrl& url);
+
+    int hits();
+    /** Opened while its read was still running */
+    int partials();
+    int misses();
+    double hitRate();
+    qint64 bytesRead();
+
+private:
+    friend class ReadAheadWorker;
+    explicit ReadAhead(QObject* parent = nullptr);
+    void schedule();
+    /** The next file to read, empty if nothing is left */
+    QString take();
+    /** false once fileName is no longer upcoming */
+    bool isWanted(const QString& fileName);
+    /** Waits until the cap allows another chunk, false on shutdown */
+    bool throttle(qint64 bytes);
+    /** Remembers a file as read, or as not readable */
+    void finished(const QString& fileName, bool complete);
+    struct ReadAheadPrivate* p;
+};
+
+#endif // READAHEAD_H
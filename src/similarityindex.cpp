@@ -0,0 +1,383 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "similarityindex.h"
+#include "collectiondb.h"
+#include "tracer.h"
+#include "trackindex.h"
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
+#include <QTime>
+#include <QVector>
+#include <qdebug.h>
+
+#include <algorithm>
+#include <math.h>
+#include <queue>
+
+namespace {
+const int dimensions = TrackFeatures::Count;
+// points in a leaf of the tree
+const int leafSize = 8;
+
+// weight of a feature scaled to unit variance, the bands share about one
+float featureWeight(int index)
+{
+    switch (index) {
+    case TrackFeatures::Tempo:
+        return 1.5f;
+    case TrackFeatures::Centroid:
+    case TrackFeatures::OnsetDensity:
+        return 1.0f;
+    case TrackFeatures::Loudness:
+        return 0.5f;
+    }
+    return 0.35f;
+}
+
+float rawValue(const TrackFeatures& features, int index)
+{
+    float value = features.value(index);
+    // twice as fast is as far as half as fast
+    if (index == TrackFeatures::Tempo)
+        return value > 0 ? float(log(value) / log(2.0)) : 0.0f;
+    return value;
+}
+
+struct KdNode {
+    int begin;
+    int end;
+    int left;
+    int right;
+    int dimension;
+    float split;
+};
+
+struct ByDimension {
+    const float* points;
+    int dimension;
+    bool operator()(int a, int b) const
+    {
+        return points[a * dimensions + dimension] < points[b * dimensions + dimension];
+    }
+};
+
+struct Neighbour {
+    float distance;
+    int row;
+    bool operator<(const Neighbour& other) const { return distance < other.distance; }
+};
+
+// the farthest of the nearest found so far on top
+typedef std::priority_queue<Neighbour> NeighbourHeap;
+}
+
+struct SimilarityIndexPrivate {
+    QMutex mutex;
+    bool valid;
+    int generation;
+    // row count and last rowid of analysis, knowthelist-analyse writes from outside
+    QString tableStamp;
+    QStringList urls;
+    QHash<QString, int> rows;
+    // scaled features, dimensions values per row
+    QVector<float> points;
+    float mean[dimensions];
+    float scale[dimensions];
+    // rows in tree order, every node covers a range of it
+    QVector<int> order;
+    QVector<KdNode> nodes;
+
+    void project(const TrackFeatures& features, float* point) const
+    {
+        for (int d = 0; d < dimensions; d++)
+            point[d] = (rawValue(features, d) - mean[d]) * scale[d];
+    }
+
+    int buildNode(int begin, int end);
+    void searchNode(int index, const float* point, int count, int exclude, NeighbourHeap& heap) const;
+};
+
+int SimilarityIndexPrivate::buildNode(int begin, int end)
+{
+    KdNode node;
+    node.begin = begin;
+    node.end = end;
+    node.left = -1;
+    node.right = -1;
+    node.dimension = 0;
+    node.split = 0;
+    int index = nodes.count();
+    nodes.append(node);
+    if (end - begin <= leafSize)
+        return index;
+
+    // split the widest dimension at its median
+    float widest = -1;
+    int dimension = 0;
+    for (int d = 0; d < dimensions; d++) {
+        float low = points.at(order.at(begin) * dimensions + d);
+        float high = low;
+        for (int i = begin + 1; i < end; i++) {
+            float value = points.at(order.at(i) * dimensions + d);
+            low = qMin(low, value);
+            high = qMax(high, value);
+        }
+        if (high - low > widest) {
+            widest = high - low;
+            dimension = d;
+        }
+    }
+
+    int middle = (begin + end) / 2;
+    ByDimension less = { points.constData(), dimension };
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, less);
+    float split = points.at(order.at(middle) * dimensions + dimension);
+
+    int left = buildNode(begin, middle);
+    int right = buildNode(middle, end);
+    nodes[index].dimension = dimension;
+    nodes[index].split = split;
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+void SimilarityIndexPrivate::searchNode(int index, const float* point, int count, int exclude, NeighbourHeap& heap) const
+{
+    const KdNode& node = nodes.at(index);
+    if (node.left < 0) {
+        for (int i = node.begin; i < node.end; i++) {
+            int row = order.at(i);
+            if (row == exclude)
+                continue;
+            const float* other = points.constData() + row * dimensions;
+            Neighbour neighbour = { 0, row };
+            for (int d = 0; d < dimensions; d++) {
+                float diff = point[d] - other[d];
+                neighbour.distance += diff * diff;
+            }
+            if (int(heap.size()) < count) {
+                heap.push(neighbour);
+            } else if (neighbour.distance < heap.top().distance) {
+                heap.pop();
+                heap.push(neighbour);
+            }
+        }
+        return;
+    }
+
+    // the far side only while it may hold something nearer
+    float diff = point[node.dimension] - node.split;
+    searchNode(diff < 0 ? node.left : node.right, point, count, exclude, heap);
+    if (int(heap.size()) < count || diff * diff < heap.top().distance)
+        searchNode(diff < 0 ? node.right : node.left, point, count, exclude, heap);
+}
+
+SimilarityIndex* SimilarityIndex::instance()
+{
+    static SimilarityIndex* index = new SimilarityIndex(QCoreApplication::instance());
+    return index;
+}
+
+SimilarityIndex::SimilarityIndex(QObject* parent)
+    : QObject(parent)
+    , p(new SimilarityIndexPrivate)
+{
+    p->valid = false;
+    p->generation = -1;
+}
+
+SimilarityIndex::~SimilarityIndex()
+{
+    delete p;
+}
+
+void SimilarityIndex::invalidate()
+{
+    QMutexLocker locker(&p->mutex);
+    p->valid = false;
+}
+
+int SimilarityIndex::count(CollectionDB* db)
+{
+    QMutexLocker locker(&p->mutex);
+    update(db);
+    return p->urls.count();
+}
+
+QStringList SimilarityIndex::similar(CollectionDB* db, const QString& url, int count)
+{
+    TraceZone zone("similar", "search");
+    QMutexLocker locker(&p->mutex);
+    update(db);
+
+    QHash<QString, int>::const_iterator it = p->rows.constFind(url);
+    if (it == p->rows.constEnd())
+        return QStringList();
+
+    QVector<float> point(dimensions);
+    for (int d = 0; d < dimensions; d++)
+        point[d] = p->points.at(it.value() * dimensions + d);
+    return search(point, count, it.value());
+}
+
+QStringList SimilarityIndex::nearest(CollectionDB* db, const TrackFeatures& features, int count, const QString& exclude)
+{
+    if (!features.isValid())
+        return QStringList();
+
+    TraceZone zone("similar", "search");
+    QMutexLocker locker(&p->mutex);
+    update(db);
+
+    QVector<float> point(dimensions);
+    p->project(features, point.data());
+    return search(point, count, p->rows.value(exclude, -1));
+}
+
+QStringList SimilarityIndex::rank(CollectionDB* db, const QString& url, const QStringList& candidates)
+{
+    TraceZone zone("similar", "rank");
+    QMutexLocker locker(&p->mutex);
+    update(db);
+
+    QHash<QString, int>::const_iterator it = p->rows.constFind(url);
+    if (it == p->rows.constEnd())
+        return candidates;
+
+    const float* point = p->points.constData() + it.value() * dimensions;
+    QVector<Neighbour> analysed;
+    QStringList ret;
+    for (int i = 0; i < candidates.count(); i++) {
+        int row = p->rows.value(candidates.at(i), -1);
+        if (row < 0) {
+            ret << candidates.at(i);
+            continue;
+        }
+        const float* other = p->points.constData() + row * dimensions;
+        // the index into candidates, not the row of the index
+        Neighbour neighbour = { 0, i };
+        for (int d = 0; d < dimensions; d++) {
+            float diff = point[d] - other[d];
+            neighbour.distance += diff * diff;
+        }
+        analysed.append(neighbour);
+    }
+    std::stable_sort(analysed.begin(), analysed.end());
+
+    QStringList nearest;
+    foreach (const Neighbour& neighbour, analysed)
+        nearest << candidates.at(neighbour.row);
+    return nearest + ret;
+}
+
+// called with the mutex held
+QStringList SimilarityIndex::search(const QVector<float>& point, int count, int exclude)
+{
+    QStringList ret;
+    if (p->nodes.isEmpty() || count <= 0)
+        return ret;
+
+    NeighbourHeap heap;
+    p->searchNode(0, point.constData(), count, exclude, heap);
+
+    // the heap hands out the farthest first
+    QVector<int> rows(int(heap.size()));
+    for (int i = rows.count() - 1; i >= 0; i--) {
+        rows[i] = heap.top().row;
+        heap.pop();
+    }
+    foreach (int row, rows)
+        ret << p->urls.at(row);
+    return ret;
+}
+
+// called with the mutex held
+void SimilarityIndex::update(CollectionDB* db)
+{
+    // REPLACE gives a changed row a new rowid, a delete lowers the count
+    QList<QStringList> rows = db->selectSql("SELECT count(*), ifnull(max(rowid), 0) FROM analysis;");
+    QString tableStamp = rows.isEmpty() ? QString() : rows.first().join(",");
+    if (!p->valid || p->generation != TrackIndex::instance()->generation() || p->tableStamp != tableStamp) {
+        p->tableStamp = tableStamp;
+        build(db);
+    }
+}
+
+// called with the mutex held
+void SimilarityIndex::build(CollectionDB* db)
+{
+    TraceZone zone("similar", "build");
+    QTime time;
+    time.start();
+
+    p->generation = TrackIndex::instance()->generation();
+    p->urls.clear();
+    p->rows.clear();
+    p->points.clear();
+    p->order.clear();
+    p->nodes.clear();
+
+    // tracks still in the collection only
+    QList<QStringList> rows = db->selectSql("SELECT analysis.url, analysis.features FROM analysis "
+                                            "INNER JOIN tags ON tags.url = analysis.url "
+                                            "WHERE analysis.features IS NOT NULL;");
+    QVector<TrackFeatures> features;
+    features.reserve(rows.count());
+    foreach (const QStringList& row, rows) {
+        TrackFeatures trackFeatures = TrackFeatures::fromString(row.at(1));
+        if (!trackFeatures.isValid() || p->rows.contains(row.at(0)))
+            continue;
+        p->rows.insert(row.at(0), p->urls.count());
+        p->urls << row.at(0);
+        features << trackFeatures;
+    }
+
+    int n = features.count();
+    for (int d = 0; d < dimensions; d++) {
+        double sum = 0;
+        double squares = 0;
+        for (int i = 0; i < n; i++) {
+            double value = rawValue(features.at(i), d);
+            sum += value;
+            squares += value * value;
+        }
+        double mean = n > 0 ? sum / n : 0;
+        double deviation = n > 0 ? sqrt(qMax(0.0, squares / n - mean * mean)) : 0;
+        p->mean[d] = float(mean);
+        // a feature all tracks share tells them not apart
+        p->scale[d] = deviation > 1e-6 ? float(featureWeight(d) / deviation) : 0.0f;
+    }
+
+    p->points.resize(n * dimensions);
+    p->order.resize(n);
+    for (int i = 0; i < n; i++) {
+        p->project(features.at(i), p->points.data() + i * dimensions);
+        p->order[i] = i;
+    }
+    p->nodes.reserve(2 * n / leafSize + 1);
+    if (n > 0)
+        p->buildNode(0, n);
+    p->valid = true;
+
+    if (zone.isActive())
+        zone.setDetail(QString("%1 tracks").arg(n));
+    qDebug() << Q_FUNC_INFO << n << "tracks in" << time.elapsed() << "ms";
+}
@@ -0,0 +1,64 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMILARITYINDEX_H
+#define SIMILARITYINDEX_H
+
+#include "trackfeatures.h"
+
+#include <QObject>
+#include <QStringList>
+
+class CollectionDB;
+
+/*
+ *  Nearest neighbours of the analysed tracks by their features. Every
+ *  feature is scaled to unit variance over the collection, the tempo on a
+ *  log scale, and weighted so the band profile counts about as much as
+ *  one other feature. The points are kept in a k-d tree, the most similar
+ *  tracks of a large collection are found in about a millisecond. Built
+ *  on first use and again after a scan, invalidate() or when the analysis
+ *  table changed, e.g. by knowthelist-analyse.
+ */
+class SimilarityIndex : public QObject {
+    Q_OBJECT
+
+public:
+    static SimilarityIndex* instance();
+    ~SimilarityIndex();
+
+    /** Drop the index, the next search rebuilds it */
+    void invalidate();
+    /** Tracks with features in the index */
+    int count(CollectionDB* db);
+
+    /** Urls of the count tracks nearest to url, nearest first, empty if url was not analysed */
+    QStringList similar(CollectionDB* db, const QString& url, int count);
+    /** Urls of the count tracks nearest to features, exclude is left out */
+    QStringList nearest(CollectionDB* db, const TrackFeatures& features, int count, const QString& exclude = QString());
+    /** candidates nearest to url first, those not analysed after them in their order; unchanged if url was not analysed */
+    QStringList rank(CollectionDB* db, const QString& url, const QStringList& candidates);
+
+private:
+    explicit SimilarityIndex(QObject* parent = nullptr);
+    void update(CollectionDB* db);
+    void build(CollectionDB* db);
+    QStringList search(const QVector<float>& point, int count, int exclude);
+    struct SimilarityIndexPrivate* p;
+};
+
+#endif // SIMILARITYINDEX_H
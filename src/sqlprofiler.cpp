@@ -0,0 +1,253 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sqlprofiler.h"
+#include "json.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QRegExp>
+#include <QSettings>
+#include <QTextStream>
+#include <QVector>
+#include <QtSql>
+#include <qdebug.h>
+
+#include <algorithm>
+
+namespace {
+// latest samples per shape for the percentiles
+const int sampleLimit = 1024;
+
+struct ShapeStats {
+    ShapeStats()
+        : calls(0)
+        , total(0)
+        , waited(0)
+        , rows(0)
+        , maximum(0)
+        , next(0)
+    {
+    }
+    qint64 calls;
+    qint64 total;
+    qint64 waited;
+    qint64 rows;
+    qint64 maximum;
+    QVector<qint64> samples;
+    int next;
+};
+
+qint64 percentile(QVector<qint64> samples, int percent)
+{
+    if (samples.isEmpty())
+        return 0;
+    std::sort(samples.begin(), samples.end());
+    int index = qMin(samples.count() - 1, (samples.count() * percent) / 100);
+    return samples.at(index);
+}
+
+double msec(qint64 nsecs)
+{
+    return nsecs / 1000000.0;
+}
+}
+
+struct SqlProfilerPrivate {
+    // guards all members, record() runs on every thread with a query
+    QMutex mutex;
+    bool enabled;
+    qint64 threshold;
+    QHash<QString, ShapeStats> shapes;
+    QString directory;
+};
+
+SqlProfiler* SqlProfiler::instance()
+{
+    static SqlProfiler* profiler = new SqlProfiler(QCoreApplication::instance());
+    return profiler;
+}
+
+SqlProfiler::SqlProfiler(QObject* parent)
+    : QObject(parent)
+    , p(new SqlProfilerPrivate)
+{
+    QSettings settings;
+    p->enabled = settings.value("SqlProfiler", false).toBool()
+        || !qgetenv("KNOWTHELIST_SQL_PROFILE").isEmpty();
+    p->threshold = qint64(settings.value("SqlSlowQueryMs", 100).toInt()) * 1000000;
+    reopen();
+
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(dump()));
+}
+
+SqlProfiler::~SqlProfiler()
+{
+    delete p;
+}
+
+bool SqlProfiler::isEnabled() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->enabled;
+}
+
+void SqlProfiler::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&p->mutex);
+    p->enabled = enabled;
+}
+
+void SqlProfiler::setSlowThreshold(int msec)
+{
+    QMutexLocker locker(&p->mutex);
+    p->threshold = qint64(msec) * 1000000;
+}
+
+bool SqlProfiler::isSlow(qint64 nsecs) const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->enabled && nsecs >= p->threshold;
+}
+
+QString SqlProfiler::shape(const QString& statement)
+{
+    // QRegExp keeps match state, no sharing between threads
+    QRegExp literals("'([^']|'')*'");
+    QRegExp numbers("\\b\\d+\\b");
+    QRegExp lists("\\?(\\s*,\\s*\\?)+");
+    QRegExp spaces("\\s+");
+
+    QString ret = statement;
+    ret.replace(literals, "?");
+    ret.replace(numbers, "?");
+    ret.replace(lists, "?, ...");
+    ret.replace(spaces, " ");
+    return ret.trimmed();
+}
+
+void SqlProfiler::record(const QString& statement, qint64 elapsed, qint64 waited, int rows, const QString& plan)
+{
+    if (!isEnabled())
+        return;
+
+    QString key = shape(statement);
+
+    p->mutex.lock();
+    qint64 threshold = p->threshold;
+    ShapeStats& stats = p->shapes[key];
+    stats.calls++;
+    stats.total += elapsed;
+    stats.waited += waited;
+    stats.rows += qMax(rows, 0);
+    stats.maximum = qMax(stats.maximum, elapsed);
+    if (stats.samples.count() < sampleLimit)
+        stats.samples.append(elapsed);
+    else
+        stats.samples[stats.next] = elapsed;
+    stats.next = (stats.next + 1) % sampleLimit;
+    p->mutex.unlock();
+
+    if (elapsed < threshold)
+        return;
+
+    qWarning() << Q_FUNC_INFO << "slow statement" << msec(elapsed) << "ms:" << statement;
+
+    QMutexLocker locker(&p->mutex);
+    QFile file(p->directory + "/slowqueries.log");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        QTextStream stream(&file);
+        stream << QDateTime::currentDateTime().toString(Qt::ISODate)
+               << " " << msec(elapsed) << " ms, waited " << msec(waited) << " ms, "
+               << rows << " rows\n"
+               << statement << "\n";
+        foreach (QString line, plan.split("\n", QString::SkipEmptyParts))
+            stream << "    " << line << "\n";
+        stream << "\n";
+    }
+}
+
+void SqlProfiler::reset()
+{
+    QMutexLocker locker(&p->mutex);
+    p->shapes.clear();
+}
+
+void SqlProfiler::reopen()
+{
+    QMutexLocker locker(&p->mutex);
+    p->directory = QFileInfo(QSqlDatabase::database().databaseName()).absolutePath();
+}
+
+QString SqlProfiler::toJson()
+{
+    p->mutex.lock();
+    QHash<QString, ShapeStats> shapes = p->shapes;
+    qint64 threshold = p->threshold;
+    p->mutex.unlock();
+
+    // most expensive shapes first
+    QList<QPair<qint64, QString> > order;
+    QHash<QString, ShapeStats>::const_iterator it;
+    for (it = shapes.constBegin(); it != shapes.constEnd(); ++it)
+        order.append(qMakePair(-it.value().total, it.key()));
+    std::sort(order.begin(), order.end());
+
+    QString ret;
+    QTextStream stream(&ret);
+    stream << "{\n  \"thresholdMs\": " << msec(threshold) << ",\n  \"statements\": [";
+    for (int i = 0; i < order.count(); i++) {
+        const ShapeStats& stats = shapes[order.at(i).second];
+        stream << (i ? "," : "") << "\n    {"
+               << "\"shape\": " << Json::quote(order.at(i).second)
+               << ", \"calls\": " << stats.calls
+               << ", \"totalMs\": " << msec(stats.total)
+               << ", \"p50Ms\": " << msec(percentile(stats.samples, 50))
+               << ", \"p99Ms\": " << msec(percentile(stats.samples, 99))
+               << ", \"maxMs\": " << msec(stats.maximum)
+               << ", \"mutexWaitMs\": " << msec(stats.waited)
+               << ", \"rows\": " << stats.rows
+               << "}";
+    }
+    stream << "\n  ]\n}\n";
+    stream.flush();
+    return ret;
+}
+
+bool SqlProfiler::dump(const QString& fileName)
+{
+    p->mutex.lock();
+    bool enabled = p->enabled;
+    QString directory = p->directory;
+    p->mutex.unlock();
+    if (!enabled)
+        return false;
+
+    QFile file(fileName.isEmpty() ? directory + "/sqlprofile.json" : fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qDebug() << Q_FUNC_INFO << "could not write" << file.fileName();
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << toJson();
+    qDebug() << Q_FUNC_INFO << "profile written to" << file.fileName();
+    return true;
+}
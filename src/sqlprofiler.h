@@ -0,0 +1,61 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SQLPROFILER_H
+#define SQLPROFILER_H
+
+#include <QObject>
+#include <QString>
+
+/*
+ *  Opt-in statistics of the statements run by CollectionDB, grouped by
+ *  statement shape (literals replaced by ?). Enabled by the setting
+ *  "SqlProfiler" or the environment variable KNOWTHELIST_SQL_PROFILE,
+ *  slow statements are logged with their query plan to slowqueries.log
+ *  and the statistics are written to sqlprofile.json on quit.
+ */
+class SqlProfiler : public QObject {
+    Q_OBJECT
+
+public:
+    static SqlProfiler* instance();
+    ~SqlProfiler();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+    void setSlowThreshold(int msec);
+    bool isSlow(qint64 nsecs) const;
+
+    /** times in nanoseconds, plan is empty unless the statement was slow */
+    void record(const QString& statement, qint64 elapsed, qint64 waited, int rows, const QString& plan = QString());
+    void reset();
+    /** Log next to the database of the default connection, e.g. after it was replaced */
+    void reopen();
+    QString toJson();
+
+    static QString shape(const QString& statement);
+
+public slots:
+    /** Write the statistics, to sqlprofile.json next to the database by default */
+    bool dump(const QString& fileName = QString());
+
+private:
+    explicit SqlProfiler(QObject* parent = nullptr);
+    struct SqlProfilerPrivate* p;
+};
+
+#endif // SQLPROFILER_H
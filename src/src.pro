@@ -8,7 +8,6 @@ DEFINES += APP_VERSION="\\\"2.3.1\\\""
 
 QT += core \
     gui \
-    xml \
     sql
 
 greaterThan(QT_MAJOR_VERSION, 4){
@@ -20,84 +19,10 @@ greaterThan(QT_MAJOR_VERSION, 4){
 
 TARGET = knowthelist
 TEMPLATE = app
-SOURCES += main.cpp \
-    knowthelist.cpp \
-    player.cpp \
-    vumeter.cpp \
-    playerwidget.cpp \
-    qled.cpp \
-    playlistitem.cpp \
-    playlist.cpp \
-    progressbar.cpp \
-    collectiondb.cpp \
-    settingsdialog.cpp \
-    track.cpp \
-    trackanalyser.cpp \
-    djsession.cpp \
-    dj.cpp \
-    filter.cpp \
-    djwidget.cpp \
-    djfilterwidget.cpp \
-    fancytabwidget.cpp \
-    stylehelper.cpp \
-    filebrowser.cpp \
-    collectionwidget.cpp \
-    collectiontree.cpp \
-    collectionupdater.cpp \
-    collectiontreeitem.cpp \
-    monitorplayer.cpp \
-    collectionsetupmodel.cpp \
-    stackdisplay.cpp \
-    djsettings.cpp \
-    modeselector.cpp \
-    playlistbrowser.cpp \
-    playlistwidget.cpp \
-    djbrowser.cpp \
-    ratingwidget.cpp \
-    customdial.cpp
-HEADERS += knowthelist.h \
-    vumeter.h \
-    playerwidget.h \
-    qled.h \
-    playlistitem.h \
-    playlist.h \
-    player.h \
-    progressbar.h \
-    collectiondb.h \
-    settingsdialog.h \
-    track.h \
-    trackanalyser.h \
-    djsession.h \
-    dj.h \
-    filter.h \
-    djwidget.h \
-    djfilterwidget.h \
-    fancytabwidget.h \
-    stylehelper.h \
-    filebrowser.h \
-    collectionwidget.h \
-    collectiontree.h \
-    collectionupdater.h \
-    collectiontreeitem.h \
-    monitorplayer.h \
-    collectionsetupmodel.h \
-    stackdisplay.h \
-    djsettings.h \
-    modeselector.h \
-    playlistbrowser.h \
-    playlistwidget.h \
-    djbrowser.h \
-    ratingwidget.h \
-    customdial.h
-FORMS += \
-    settingsdialog.ui \
-    djwidget.ui \
-    djfilterwidget.ui \
-    playerwidget.ui \
-    knowthelist.ui \
-    djsettings.ui \
-    modeselector.ui \
-    playlistwidget.ui
+SOURCES += main.cpp
+include(knowthelist.pri)
+CORE_LIB_DIR = $$OUT_PWD
+include(core/link.pri)
 TRANSLATIONS += \
     ../locale/knowthelist_cs.ts \
     ../locale/knowthelist_de.ts \
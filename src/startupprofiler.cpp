@@ -0,0 +1,81 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "startupprofiler.h"
+#include "tracer.h"
+
+#include <qdebug.h>
+
+namespace {
+const char* currentPhase = "process";
+qint64 phaseStart = 0;
+qint64 interactiveAt = -1;
+bool isFinished = false;
+
+void endPhase()
+{
+    if (!currentPhase)
+        return;
+    qint64 now = Tracer::now();
+    qDebug() << "Startup:" << currentPhase << (now - phaseStart) / 1000000 << "ms,"
+             << "total" << now / 1000000 << "ms";
+    if (Tracer::isEnabled())
+        Tracer::instance()->complete("startup", currentPhase, phaseStart, now);
+    currentPhase = nullptr;
+    phaseStart = now;
+}
+}
+
+void StartupProfiler::phase(const char* name)
+{
+    if (isFinished)
+        return;
+    endPhase();
+    currentPhase = name;
+}
+
+void StartupProfiler::interactive()
+{
+    if (interactiveAt >= 0)
+        return;
+    endPhase();
+    interactiveAt = Tracer::now();
+    qDebug() << "Startup: time to interactive" << interactiveAt / 1000000 << "ms";
+    if (Tracer::isEnabled())
+        Tracer::instance()->instant("startup", "interactive");
+}
+
+void StartupProfiler::finished()
+{
+    if (isFinished)
+        return;
+    endPhase();
+    isFinished = true;
+    qDebug() << "Startup: deferred initialisation done after" << elapsed() << "ms";
+    if (Tracer::isEnabled())
+        Tracer::instance()->instant("startup", "finished");
+}
+
+qint64 StartupProfiler::elapsed()
+{
+    return Tracer::now() / 1000000;
+}
+
+qint64 StartupProfiler::timeToInteractive()
+{
+    return interactiveAt < 0 ? -1 : interactiveAt / 1000000;
+}
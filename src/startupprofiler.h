@@ -0,0 +1,43 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QtGlobal>
+
+/*
+ *  Phases of the application start, measured from the start of the
+ *  process. Every phase is logged with its duration and put on the trace
+ *  timeline. interactive() marks the first pass of the event loop that
+ *  got through with the main window shown and the deferred work handed
+ *  to workers, finished() is called once their results are applied.
+ *  Only called from the GUI thread.
+ */
+class StartupProfiler {
+public:
+    /** Ends the running phase and starts the next, names must be literals */
+    static void phase(const char* name);
+    static void interactive();
+    static void finished();
+
+    /** milliseconds since the start of the process */
+    static qint64 elapsed();
+    static qint64 timeToInteractive();
+};
+
+#endif // STARTUPPROFILER_H
@@ -0,0 +1,346 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "statisticsjournal.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QThread>
+#include <QTimer>
+#include <QtSql>
+#if QT_VERSION >= 0x050000
+#include <QtConcurrent/QtConcurrent>
+#else
+#include <QtConcurrentRun>
+#endif
+#include <qdebug.h>
+
+namespace {
+// the commit holds the commit lock the queries of the GUI wait for, it
+// only waits this long for other connections and tries again
+const int commitTimeout = 100;
+const int commitAttempts = 20;
+
+struct StatisticsEntry {
+    StatisticsEntry()
+        : plays(0)
+        , accessdate(0)
+        , rate(0)
+        , hasRate(false)
+    {
+    }
+    int plays;
+    uint accessdate;
+    int rate;
+    bool hasRate;
+};
+
+typedef QHash<QString, StatisticsEntry> StatisticsMap;
+
+// one connection per writing thread, a connection must not change threads
+QString connectionName()
+{
+    return QString("statistics_%1").arg(quintptr(QThread::currentThreadId()));
+}
+
+void applyEntries(const StatisticsMap& entries, QStringList& row, int counterColumn, int rateColumn)
+{
+    StatisticsMap::const_iterator it = entries.constFind(row.at(0));
+    if (it == entries.constEnd())
+        return;
+    if (it.value().plays > 0)
+        row[counterColumn] = QString::number(row.at(counterColumn).toInt() + it.value().plays);
+    if (it.value().hasRate)
+        row[rateColumn] = QString::number(it.value().rate);
+}
+}
+
+struct StatisticsJournalPrivate {
+    QMutex mutex;
+    QMutex writeMutex;
+    // taken for writing around the commit, see commitLock()
+    QReadWriteLock commitLock;
+    StatisticsMap pending;
+    StatisticsMap writing;
+    QString databaseName;
+    QTimer* timer;
+    QFuture<void> future;
+    int generation;
+};
+
+StatisticsJournal* StatisticsJournal::instance()
+{
+    static StatisticsJournal* journal = new StatisticsJournal(QCoreApplication::instance());
+    return journal;
+}
+
+StatisticsJournal::StatisticsJournal(QObject* parent)
+    : QObject(parent)
+    , p(new StatisticsJournalPrivate)
+{
+    p->databaseName = QSqlDatabase::database().databaseName();
+    p->generation = 0;
+
+    p->timer = new QTimer(this);
+    connect(p->timer, SIGNAL(timeout()), this, SLOT(flush()));
+    p->timer->start(30000);
+
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(sync()));
+}
+
+StatisticsJournal::~StatisticsJournal()
+{
+    p->timer->stop();
+    // normally written on aboutToQuit already
+    sync();
+    if (hasPending())
+        qDebug() << Q_FUNC_INFO << "statistics not written:" << p->pending.count();
+    delete p;
+}
+
+void StatisticsJournal::setFlushInterval(int msec)
+{
+    p->timer->start(msec);
+}
+
+void StatisticsJournal::addPlay(const QString& url)
+{
+    QMutexLocker locker(&p->mutex);
+    StatisticsEntry& entry = p->pending[url];
+    entry.plays++;
+    entry.accessdate = QDateTime::currentDateTime().toTime_t();
+    p->generation++;
+}
+
+void StatisticsJournal::setRate(const QString& url, int rate)
+{
+    QMutexLocker locker(&p->mutex);
+    StatisticsEntry& entry = p->pending[url];
+    entry.rate = rate;
+    entry.hasRate = true;
+    p->generation++;
+}
+
+void StatisticsJournal::resetPlays()
+{
+    // after a running write, so none of its plays is committed after the delete
+    QMutexLocker writer(&p->writeMutex);
+
+    p->mutex.lock();
+    StatisticsMap::iterator it = p->pending.begin();
+    while (it != p->pending.end()) {
+        if (it.value().hasRate) {
+            it.value().plays = 0;
+            ++it;
+        } else {
+            it = p->pending.erase(it);
+        }
+    }
+    p->generation++;
+    p->mutex.unlock();
+
+    QString name = connectionName();
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(p->databaseName);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        QWriteLocker commit(&p->commitLock);
+        if (!db.open() || !QSqlQuery(db).exec("DELETE FROM statistics;"))
+            qDebug() << Q_FUNC_INFO << "reset failed:" << db.lastError().text();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(name);
+}
+
+QReadWriteLock* StatisticsJournal::commitLock()
+{
+    return &p->commitLock;
+}
+
+bool StatisticsJournal::hasPending()
+{
+    QMutexLocker locker(&p->mutex);
+    return !p->pending.isEmpty();
+}
+
+int StatisticsJournal::generation()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->generation;
+}
+
+void StatisticsJournal::overlay(QList<QStringList>& rows, int counterColumn, int rateColumn)
+{
+    QMutexLocker locker(&p->mutex);
+    if (p->pending.isEmpty() && p->writing.isEmpty())
+        return;
+
+    int minCount = qMax(counterColumn, rateColumn) + 1;
+    for (int i = 0; i < rows.count(); i++) {
+        QStringList& row = rows[i];
+        if (row.count() < minCount)
+            continue;
+        // changes being written are not committed yet, newer ones come last
+        applyEntries(p->writing, row, counterColumn, rateColumn);
+        applyEntries(p->pending, row, counterColumn, rateColumn);
+    }
+}
+
+QList<QStringList> StatisticsJournal::pendingRows()
+{
+    QMutexLocker locker(&p->mutex);
+    QList<QStringList> ret;
+    // changes being written are not committed yet, newer ones come last
+    const StatisticsMap* maps[] = { &p->writing, &p->pending };
+    for (int i = 0; i < 2; i++) {
+        StatisticsMap::const_iterator it;
+        for (it = maps[i]->constBegin(); it != maps[i]->constEnd(); ++it) {
+            ret << (QStringList() << it.key()
+                                  << QString::number(it.value().plays)
+                                  << QString::number(it.value().accessdate)
+                                  << (it.value().hasRate ? QString::number(it.value().rate) : QString()));
+        }
+    }
+    return ret;
+}
+
+void StatisticsJournal::flush()
+{
+    if (!hasPending() || p->future.isRunning())
+        return;
+    p->future = QtConcurrent::run(this, &StatisticsJournal::write);
+}
+
+void StatisticsJournal::sync()
+{
+    p->future.waitForFinished();
+    write();
+}
+
+void StatisticsJournal::reopen()
+{
+    sync();
+    QMutexLocker writer(&p->writeMutex);
+    QMutexLocker locker(&p->mutex);
+    p->databaseName = QSqlDatabase::database().databaseName();
+    p->generation++;
+}
+
+void StatisticsJournal::write()
+{
+    QMutexLocker writer(&p->writeMutex);
+
+    p->mutex.lock();
+    if (p->pending.isEmpty()) {
+        p->mutex.unlock();
+        return;
+    }
+    p->writing = p->pending;
+    p->pending.clear();
+    StatisticsMap entries = p->writing;
+    p->mutex.unlock();
+
+    QString name = connectionName();
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(p->databaseName);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        ok = db.open() && db.transaction();
+
+        if (ok) {
+            QSqlQuery update(db);
+            update.prepare("UPDATE statistics SET playcounter = playcounter + ?, accessdate = ? WHERE url = ?;");
+            QSqlQuery insert(db);
+            insert.prepare("INSERT INTO statistics ( url, createdate, accessdate, playcounter ) VALUES ( ?, ?, ?, ? );");
+            QSqlQuery rate(db);
+            rate.prepare("INSERT OR REPLACE INTO favorites ( url, changedate, rate ) VALUES ( ?, strftime('%s', 'now'), ? );");
+
+            StatisticsMap::const_iterator it;
+            for (it = entries.constBegin(); ok && it != entries.constEnd(); ++it) {
+                const StatisticsEntry& entry = it.value();
+                if (entry.plays > 0) {
+                    update.addBindValue(entry.plays);
+                    update.addBindValue(entry.accessdate);
+                    update.addBindValue(it.key());
+                    ok = update.exec();
+                    if (ok && update.numRowsAffected() == 0) {
+                        insert.addBindValue(it.key());
+                        insert.addBindValue(entry.accessdate);
+                        insert.addBindValue(entry.accessdate);
+                        insert.addBindValue(entry.plays);
+                        ok = insert.exec();
+                    }
+                }
+                if (ok && entry.hasRate) {
+                    rate.addBindValue(it.key());
+                    rate.addBindValue(entry.rate);
+                    ok = rate.exec();
+                }
+            }
+
+            if (ok) {
+                // a busy commit keeps the transaction, the lock is given up
+                // between the attempts so the queries of the GUI go on
+                QSqlQuery(db).exec(QString("PRAGMA busy_timeout = %1;").arg(commitTimeout));
+                bool committed = false;
+                for (int attempt = 0; !committed && attempt < commitAttempts; attempt++) {
+                    if (attempt > 0)
+                        QThread::yieldCurrentThread();
+                    // readers see the rows either in the tables or in writing, never in both
+                    QWriteLocker commit(&p->commitLock);
+                    committed = db.commit();
+                    if (committed) {
+                        QMutexLocker locker(&p->mutex);
+                        p->writing.clear();
+                        p->generation++;
+                    }
+                }
+                ok = committed;
+            }
+            if (!ok)
+                db.rollback();
+        }
+
+        if (!ok)
+            qDebug() << Q_FUNC_INFO << "write failed, retry later:" << db.lastError().text();
+        else
+            qDebug() << Q_FUNC_INFO << entries.count() << "entries written";
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(name);
+
+    p->mutex.lock();
+    if (!ok) {
+        // keep the changes for the next attempt, newer values win
+        StatisticsMap::const_iterator it;
+        for (it = p->writing.constBegin(); it != p->writing.constEnd(); ++it) {
+            StatisticsEntry& target = p->pending[it.key()];
+            target.plays += it.value().plays;
+            target.accessdate = qMax(target.accessdate, it.value().accessdate);
+            if (it.value().hasRate && !target.hasRate) {
+                target.rate = it.value().rate;
+                target.hasRate = true;
+            }
+        }
+    }
+    p->writing.clear();
+    p->mutex.unlock();
+}
@@ -0,0 +1,68 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATISTICSJOURNAL_H
+#define STATISTICSJOURNAL_H
+
+#include <QObject>
+#include <QStringList>
+
+class QReadWriteLock;
+
+/*
+ *  Write-behind cache for play counters and ratings. Changes are collected
+ *  in memory, merged into query results and written to the statistics and
+ *  favorites tables in one transaction from time to time.
+ */
+class StatisticsJournal : public QObject {
+    Q_OBJECT
+
+public:
+    static StatisticsJournal* instance();
+    ~StatisticsJournal();
+
+    void addPlay(const QString& url);
+    void setRate(const QString& url, int rate);
+    /** Forget all play counters, written and pending; waits for a running write */
+    void resetPlays();
+
+    /** Merge pending changes into track rows (url, ..., playcounter, rate) */
+    void overlay(QList<QStringList>& rows, int counterColumn = 8, int rateColumn = 9);
+    /** Pending changes as rows (url, plays, accessdate, rate), the rate is empty if unchanged; newer ones come last */
+    QList<QStringList> pendingRows();
+    /** Hold it for reading from the query of the statistics until overlay() is done */
+    QReadWriteLock* commitLock();
+    bool hasPending();
+    /** Changes whenever statistics change, pending or written, for caches of the tables */
+    int generation();
+
+    /** Write pending changes, then use the database of the default connection, e.g. after it was replaced */
+    void reopen();
+    void setFlushInterval(int msec);
+
+public slots:
+    void flush();
+    /** Write pending changes now, blocks the caller; called before the application quits */
+    void sync();
+
+private:
+    explicit StatisticsJournal(QObject* parent = nullptr);
+    void write();
+    struct StatisticsJournalPrivate* p;
+};
+
+#endif // STATISTICSJOURNAL_H
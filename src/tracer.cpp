@@ -0,0 +1,243 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tracer.h"
+#include "json.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSettings>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <qdebug.h>
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+namespace {
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    char phase;
+    quintptr thread;
+    qint64 start;
+    qint64 duration;
+    double value;
+    QString detail;
+};
+
+// started before main(), all timestamps share it
+struct TraceClock {
+    TraceClock() { timer.start(); }
+    QElapsedTimer timer;
+};
+TraceClock traceClock;
+
+// trace-event timestamps are microseconds
+QString usec(qint64 nsecs)
+{
+    return QString::number(nsecs / 1000.0, 'f', 3);
+}
+}
+
+QAtomicInt Tracer::enabled(0);
+
+struct TracerPrivate {
+    QMutex mutex;
+    QVector<TraceEvent> events;
+    int capacity;
+    int next;
+    QHash<quintptr, QString> threads;
+};
+
+Tracer* Tracer::instance()
+{
+    static Tracer* tracer = new Tracer(QCoreApplication::instance());
+    return tracer;
+}
+
+Tracer::Tracer(QObject* parent)
+    : QObject(parent)
+    , p(new TracerPrivate)
+{
+    QSettings settings;
+    p->capacity = qMax(1024, settings.value("TraceBufferEvents", 262144).toInt());
+    p->next = 0;
+    setEnabled(settings.value("Tracing", false).toBool()
+        || !qgetenv("KNOWTHELIST_TRACE").isEmpty());
+
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(dump()));
+}
+
+Tracer::~Tracer()
+{
+    setEnabled(false);
+    delete p;
+}
+
+void Tracer::setEnabled(bool value)
+{
+    enabled.fetchAndStoreOrdered(value ? 1 : 0);
+}
+
+qint64 Tracer::now()
+{
+    return traceClock.timer.nsecsElapsed();
+}
+
+void Tracer::complete(const char* category, const char* name, qint64 start, qint64 end, const QString& detail)
+{
+    if (isEnabled())
+        append(category, name, 'X', start, end - start, 0, detail);
+}
+
+void Tracer::instant(const char* category, const char* name, const QString& detail)
+{
+    if (isEnabled())
+        append(category, name, 'i', now(), 0, 0, detail);
+}
+
+void Tracer::counter(const char* category, const char* name, double value)
+{
+    if (isEnabled())
+        append(category, name, 'C', now(), 0, value, QString());
+}
+
+void Tracer::append(const char* category, const char* name, char phase, qint64 start, qint64 duration, double value, const QString& detail)
+{
+    TraceEvent event;
+    event.category = category;
+    event.name = name;
+    event.phase = phase;
+    event.thread = quintptr(QThread::currentThreadId());
+    event.start = start;
+    event.duration = duration;
+    event.value = value;
+    event.detail = detail;
+
+    QMutexLocker locker(&p->mutex);
+    if (!p->threads.contains(event.thread)) {
+        // GStreamer threads are adopted by Qt without a name
+        QThread* thread = QThread::currentThread();
+        QString threadName;
+        if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+            threadName = "GUI";
+        else if (!thread->objectName().isEmpty())
+            threadName = thread->objectName();
+        else
+            threadName = QString("%1 thread %2").arg(category).arg(p->threads.count());
+        p->threads.insert(event.thread, threadName);
+    }
+
+    if (p->events.count() < p->capacity)
+        p->events.append(event);
+    else
+        p->events[p->next] = event;
+    p->next = (p->next + 1) % p->capacity;
+}
+
+void Tracer::clear()
+{
+    QMutexLocker locker(&p->mutex);
+    p->events.clear();
+    p->next = 0;
+}
+
+QString Tracer::toJson()
+{
+    p->mutex.lock();
+    QVector<TraceEvent> events = p->events;
+    int first = events.count() < p->capacity ? 0 : p->next;
+    QHash<quintptr, QString> threads = p->threads;
+    p->mutex.unlock();
+
+    QString ret;
+    QTextStream stream(&ret);
+    stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+    bool separator = false;
+    QHash<quintptr, QString>::const_iterator it;
+    for (it = threads.constBegin(); it != threads.constEnd(); ++it) {
+        stream << (separator ? "," : "")
+               << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << it.key()
+               << ", \"args\": {\"name\": " << Json::quote(it.value()) << "}}";
+        separator = true;
+    }
+
+    // oldest first
+    for (int i = 0; i < events.count(); i++) {
+        const TraceEvent& event = events.at((first + i) % events.count());
+        stream << (separator ? "," : "")
+               << "\n{\"name\": " << Json::quote(QString::fromLatin1(event.name))
+               << ", \"cat\": " << Json::quote(QString::fromLatin1(event.category))
+               << ", \"ph\": \"" << event.phase << "\""
+               << ", \"pid\": 1, \"tid\": " << event.thread
+               << ", \"ts\": " << usec(event.start);
+        switch (event.phase) {
+        case 'X':
+            stream << ", \"dur\": " << usec(event.duration);
+            break;
+        case 'i':
+            stream << ", \"s\": \"t\"";
+            break;
+        case 'C':
+            stream << ", \"args\": {\"value\": " << event.value << "}";
+            break;
+        }
+        if (!event.detail.isEmpty())
+            stream << ", \"args\": {\"detail\": " << Json::quote(event.detail) << "}";
+        stream << "}";
+        separator = true;
+    }
+    stream << "\n]}\n";
+    stream.flush();
+    return ret;
+}
+
+bool Tracer::dump(const QString& fileName)
+{
+    if (!isEnabled())
+        return false;
+
+    QString name = fileName;
+    if (name.isEmpty()) {
+#if QT_VERSION >= 0x050000
+        QString pathName = QStandardPaths::standardLocations(QStandardPaths::DataLocation).at(0);
+#else
+        QString pathName = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+#endif
+        QDir().mkpath(pathName);
+        name = pathName + "/trace.json";
+    }
+
+    QFile file(name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qDebug() << Q_FUNC_INFO << "could not write" << file.fileName();
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << toJson();
+    qDebug() << Q_FUNC_INFO << "trace written to" << file.fileName();
+    return true;
+}
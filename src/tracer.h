@@ -0,0 +1,103 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+
+/*
+ *  Timeline of zones, instants and counters of all threads, written as
+ *  Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev). Enabled by
+ *  the setting "Tracing" or the environment variable KNOWTHELIST_TRACE,
+ *  the latest events are kept in a ring buffer and written to trace.json
+ *  on Ctrl+Shift+T and on quit. Disabled, a zone costs one flag test.
+ *
+ *  Categories and names must be string literals, they are not copied.
+ */
+class Tracer : public QObject {
+    Q_OBJECT
+
+public:
+    static Tracer* instance();
+    ~Tracer();
+
+    static bool isEnabled()
+    {
+#if QT_VERSION >= 0x050000
+        return enabled.load();
+#else
+        return enabled;
+#endif
+    }
+    void setEnabled(bool value);
+
+    /** nanoseconds since the start of the process */
+    static qint64 now();
+
+    void complete(const char* category, const char* name, qint64 start, qint64 end, const QString& detail = QString());
+    void instant(const char* category, const char* name, const QString& detail = QString());
+    void counter(const char* category, const char* name, double value);
+
+    void clear();
+    QString toJson();
+
+public slots:
+    /** Write the timeline, to trace.json in the data directory by default */
+    bool dump(const QString& fileName = QString());
+
+private:
+    explicit Tracer(QObject* parent = nullptr);
+    void append(const char* category, const char* name, char phase, qint64 start, qint64 duration, double value, const QString& detail);
+
+    // read on every thread that traces, set by the GUI thread
+    static QAtomicInt enabled;
+    struct TracerPrivate* p;
+};
+
+/*
+ *  Records the lifetime of the object as a zone of the current thread.
+ */
+class TraceZone {
+public:
+    TraceZone(const char* category, const char* name)
+        : m_category(category)
+        , m_name(name)
+        , m_start(Tracer::isEnabled() ? Tracer::now() : -1)
+    {
+    }
+    ~TraceZone()
+    {
+        if (m_start >= 0)
+            Tracer::instance()->complete(m_category, m_name, m_start, Tracer::now(), m_detail);
+    }
+
+    /** Details cost a string, build them only for active zones */
+    bool isActive() const { return m_start >= 0; }
+    void setDetail(const QString& detail) { m_detail = detail; }
+
+private:
+    Q_DISABLE_COPY(TraceZone)
+    const char* m_category;
+    const char* m_name;
+    qint64 m_start;
+    QString m_detail;
+};
+
+#endif // TRACER_H
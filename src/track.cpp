@@ -17,10 +17,12 @@
 */
 
 #include "track.h"
-#include "playlistitem.h"
 
 #include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 #include <QPainter>
+#include <QSharedData>
 #include <qdebug.h>
 
 #include <taglib/audioproperties.h>
@@ -33,8 +35,21 @@
 #include <taglib/id3v2framefactory.h>
 #include <taglib/id3v2tag.h>
 #include <taglib/mpegfile.h>
+#include <taglib/taglib.h>
 #include <taglib/tbytevector.h>
 
+// pictures of FLAC, MP4 and Ogg files need the TagLib 1.11 API
+#if TAGLIB_MAJOR_VERSION > 1 || (TAGLIB_MAJOR_VERSION == 1 && TAGLIB_MINOR_VERSION >= 11)
+#define TAGLIB_HAS_PICTURES
+#include <taglib/flacfile.h>
+#include <taglib/flacpicture.h>
+#include <taglib/mp4coverart.h>
+#include <taglib/mp4file.h>
+#include <taglib/mp4tag.h>
+#include <taglib/vorbisfile.h>
+#include <taglib/xiphcomment.h>
+#endif
+
 QStringList Track::tagNameList = QStringList() << "location"
                                                << "creator"
                                                << "title"
@@ -46,7 +61,19 @@ QStringList Track::tagNameList = QStringList() << "location"
                                                << "counter"
                                                << "rate";
 
-struct TrackPrivate {
+/*
+ *  Immutable tag data of a track. Records built from collection rows are
+ *  interned by url, so every view, playlist and Auto-DJ selection showing
+ *  the same song shares one record. Setters detach (copy on write).
+ */
+class TrackRecord : public QSharedData {
+public:
+    TrackRecord()
+        : length(-1)
+        , rate(0)
+    {
+    }
+
     QUrl url;
     QString title;
     QString artist;
@@ -55,17 +82,102 @@ struct TrackPrivate {
     QString comment;
     QString genre;
     QString tracknumber;
-    int counter;
     int length;
     int rate;
+};
+
+typedef QExplicitlySharedDataPointer<TrackRecord> TrackRecordPtr;
+
+/*
+ *  Per instance state: the shared record plus the values a playlist may
+ *  change without touching other views of the same track.
+ */
+struct TrackPrivate {
+    TrackPrivate()
+        : d(new TrackRecord)
+        , counter(-1)
+    {
+    }
+
+    TrackRecordPtr d;
+    int counter;
     Track::Options flags;
 };
 
+namespace {
+
+QMutex registryMutex;
+QHash<QString, TrackRecordPtr> registry;
+int registryLimit = 1024;
+
+bool sameRecord(const TrackRecord* a, const TrackRecord* b)
+{
+    return a->url == b->url
+        && a->artist == b->artist
+        && a->title == b->title
+        && a->album == b->album
+        && a->year == b->year
+        && a->genre == b->genre
+        && a->tracknumber == b->tracknumber
+        && a->length == b->length
+        && a->rate == b->rate;
+}
+
+bool isUnused(const TrackRecordPtr& record)
+{
+#if QT_VERSION >= 0x050000
+    return record->ref.load() == 1;
+#else
+    return int(record->ref) == 1;
+#endif
+}
+
+// drop records nobody refers to anymore, called with registryMutex held
+void pruneRegistry()
+{
+    QHash<QString, TrackRecordPtr>::iterator it = registry.begin();
+    while (it != registry.end()) {
+        if (isUnused(it.value()))
+            it = registry.erase(it);
+        else
+            ++it;
+    }
+    registryLimit = qMax(1024, registry.count() * 2);
+}
+
+TrackRecordPtr internRecord(TrackRecord* candidate)
+{
+    TrackRecordPtr record(candidate);
+    QString key = record->url.toLocalFile();
+    if (key.isEmpty())
+        return record;
+
+    QMutexLocker locker(&registryMutex);
+    QHash<QString, TrackRecordPtr>::const_iterator it = registry.constFind(key);
+    if (it != registry.constEnd() && sameRecord(it.value().constData(), candidate))
+        return it.value();
+
+    // new or changed in the collection: newer data replaces the entry,
+    // tracks still holding the old record keep it until they go away
+    registry.insert(key, record);
+    if (registry.count() > registryLimit)
+        pruneRegistry();
+    return record;
+}
+
+template <typename T>
+void setField(TrackRecordPtr& d, T TrackRecord::*field, const T& value)
+{
+    if (d.constData()->*field == value)
+        return;
+    d.detach();
+    d.data()->*field = value;
+}
+}
+
 Track::Track()
     : p(new TrackPrivate)
 {
-    p->counter = -1;
-    p->rate = 0;
 }
 
 Track::~Track()
@@ -73,10 +185,22 @@ Track::~Track()
     delete p;
 }
 
+Track::Track(const Track& other)
+    : p(new TrackPrivate(*other.p))
+{
+}
+
+Track& Track::operator=(const Track& other)
+{
+    if (this != &other)
+        *p = *other.p;
+    return *this;
+}
+
 Track::Track(const QUrl& u)
     : p(new TrackPrivate)
 {
-    p->url = u;
+    p->d->url = u;
     readTags();
 }
 
@@ -84,39 +208,33 @@ Track::Track(const QStringList& list)
     : p(new TrackPrivate)
 {
     if (list.count() > 9) {
-        p->url = QUrl::fromLocalFile(list.at(0));
-        p->artist = list.at(1);
-        p->title = list.at(2);
-        p->album = list.at(3);
-        p->year = list.at(4);
-        p->genre = list.at(5);
-        p->tracknumber = list.at(6);
-        p->length = QString(list.at(7)).toInt();
+        TrackRecord* record = new TrackRecord;
+        record->url = QUrl::fromLocalFile(list.at(0));
+        record->artist = list.at(1);
+        record->title = list.at(2);
+        record->album = list.at(3);
+        record->year = list.at(4);
+        record->genre = list.at(5);
+        record->tracknumber = list.at(6);
+        record->length = QString(list.at(7)).toInt();
+        record->rate = QString(list.at(9)).toInt();
+        p->d = internRecord(record);
         p->counter = QString(list.at(8)).toInt();
-        p->rate = QString(list.at(9)).toInt();
     }
     if (list.count() > 10)
         p->flags = QFlag(list.at(10).toInt());
 }
 
-Track::Track(const PlaylistItem* item)
-    : p(new TrackPrivate)
+int Track::sharedRecordCount()
 {
-    p->url = QUrl::fromLocalFile(item->urlString());
-    p->title = item->title();
-    p->artist = item->exactText(2);
-    p->album = item->exactText(4);
-    p->year = item->exactText(5);
-    p->comment = item->exactText(6);
-    p->genre = item->exactText(7);
-    p->tracknumber = item->exactText(8);
-    p->counter = item->exactText(9).toInt();
-    // p->rate = item->rate();
+    QMutexLocker locker(&registryMutex);
+    return registry.count();
 }
 
 void Track::readTags()
 {
-    QString fileName = p->url.toLocalFile();
+    TrackRecord* d = p->d.data();
+    QString fileName = d->url.toLocalFile();
 
 #ifdef Q_OS_WIN32
     TagLib::FileRef fileref = TagLib::FileRef(fileName.toStdWString().c_str(), true, TagLib::AudioProperties::Fast);
@@ -129,21 +247,21 @@ void Track::readTags()
         if (fileref.tag()) {
             TagLib::Tag* tag = fileref.tag();
 
-            p->title = !tag->title().isNull() ? TStringToQString(tag->title()).trimmed() : QObject::tr("Unknown");
-            p->artist = !tag->artist().isNull() ? TStringToQString(tag->artist()).trimmed() : QObject::tr("Unknown");
-            p->album = !tag->album().isNull() ? TStringToQString(tag->album()).trimmed() : QObject::tr("Unknown");
-            p->comment = TStringToQString(tag->comment()).trimmed();
-            p->genre = !tag->genre().isNull() ? TStringToQString(tag->genre()).trimmed() : QObject::tr("Unknown");
-            p->year = tag->year() ? QString::number(tag->year()) : QString::null;
-            p->tracknumber = tag->track() ? QString::number(tag->track()) : QString::null;
-            p->length = fileref.audioProperties()->length();
+            d->title = !tag->title().isNull() ? TStringToQString(tag->title()).trimmed() : QObject::tr("Unknown");
+            d->artist = !tag->artist().isNull() ? TStringToQString(tag->artist()).trimmed() : QObject::tr("Unknown");
+            d->album = !tag->album().isNull() ? TStringToQString(tag->album()).trimmed() : QObject::tr("Unknown");
+            d->comment = TStringToQString(tag->comment()).trimmed();
+            d->genre = !tag->genre().isNull() ? TStringToQString(tag->genre()).trimmed() : QObject::tr("Unknown");
+            d->year = tag->year() ? QString::number(tag->year()) : QString::null;
+            d->tracknumber = tag->track() ? QString::number(tag->track()) : QString::null;
+            d->length = fileref.audioProperties()->length();
             p->counter = 0;
-            p->rate = 0;
+            d->rate = 0;
 
             //polish up empty tags
-            if (p->title == QObject::tr("Unknown")) {
-                QFileInfo fileInfo(p->url.toLocalFile());
-                p->title = fileInfo.fileName().replace('_', ' ').replace('.' + fileInfo.suffix(), "");
+            if (d->title == QObject::tr("Unknown")) {
+                QFileInfo fileInfo(d->url.toLocalFile());
+                d->title = fileInfo.fileName().replace('_', ' ').replace('.' + fileInfo.suffix(), "");
             }
         }
     }
@@ -154,8 +272,10 @@ bool Track::operator==(Track* track)
 
     if (!isValid())
         return false;
-    return p->artist == track->artist()
-        && p->title == track->title();
+    if (p->d == track->p->d)
+        return true;
+    return p->d->artist == track->artist()
+        && p->d->title == track->title();
 }
 
 bool Track::containIn(QList<Track*> list)
@@ -170,39 +290,96 @@ bool Track::containIn(QList<Track*> list)
 
 QImage Track::coverImage()
 {
-    if (!p->url.isValid())
+    if (!p->d->url.isValid())
         return QImage();
 
-    qDebug() << "image url:" << p->url;
-    if (p->url.path() == "")
+    qDebug() << "image url:" << p->d->url;
+    if (p->d->url.path() == "")
         return QImage();
 
-    QByteArray fileName = QFile::encodeName(p->url.toLocalFile());
-    const char* encodedName = fileName.constData();
-    TagLib::MPEG::File fileref(encodedName);
+    QImage image = embeddedImage(p->d->url.toLocalFile());
+    if (!image.isNull())
+        return image;
+
+    return defaultImage();
+}
 
-    if (!fileref.isOpen())
+namespace {
+QImage imageFromBytes(const TagLib::ByteVector& bytes)
+{
+    return QImage::fromData(reinterpret_cast<const uchar*>(bytes.data()), bytes.size());
+}
+
+#ifdef TAGLIB_HAS_PICTURES
+QImage imageFromPictures(const TagLib::List<TagLib::FLAC::Picture*>& pictures)
+{
+    if (pictures.isEmpty())
         return QImage();
 
-    TagLib::ID3v2::Tag* tag = fileref.ID3v2Tag();
+    // prefer the front cover, take any picture otherwise
+    TagLib::FLAC::Picture* picture = pictures.front();
+    for (TagLib::List<TagLib::FLAC::Picture*>::ConstIterator it = pictures.begin(); it != pictures.end(); ++it) {
+        if ((*it)->type() == TagLib::FLAC::Picture::FrontCover) {
+            picture = *it;
+            break;
+        }
+    }
+    return imageFromBytes(picture->data());
+}
+#endif
+}
 
-    if (tag) {
-        TagLib::ID3v2::FrameList l = fileref.ID3v2Tag()->frameListMap()["APIC"];
-        if (!l.isEmpty()) {
+/*
+ *  Decode the picture embedded in the tags of the file, full size.
+ *  Returns a null image if the file has none.
+ */
+QImage Track::embeddedImage(const QString& fileName)
+{
+#ifdef Q_OS_WIN32
+    TagLib::FileRef fileref = TagLib::FileRef(fileName.toStdWString().c_str(), false);
+#else
+    TagLib::FileRef fileref = TagLib::FileRef(QFile::encodeName(fileName).constData(), false);
+#endif
 
-            //qDebug() << "Found APIC frame(s)" << endl;
-            TagLib::ID3v2::Frame* f = l.front();
-            TagLib::ID3v2::AttachedPictureFrame* ap = (TagLib::ID3v2::AttachedPictureFrame*)f;
+    if (fileref.isNull())
+        return QImage();
 
-            const TagLib::ByteVector bytes = ap->picture();
-            QImage image = QImage::fromData(reinterpret_cast<const uchar*>(bytes.data()), bytes.size());
+    TagLib::File* file = fileref.file();
 
-            if (!image.isNull()) {
-                return image;
+    if (TagLib::MPEG::File* mpeg = dynamic_cast<TagLib::MPEG::File*>(file)) {
+        TagLib::ID3v2::Tag* tag = mpeg->ID3v2Tag();
+        if (tag) {
+            TagLib::ID3v2::FrameList l = tag->frameListMap()["APIC"];
+            if (!l.isEmpty()) {
+                TagLib::ID3v2::AttachedPictureFrame* ap = static_cast<TagLib::ID3v2::AttachedPictureFrame*>(l.front());
+                return imageFromBytes(ap->picture());
             }
         }
+        return QImage();
     }
-    return defaultImage();
+
+#ifdef TAGLIB_HAS_PICTURES
+    if (TagLib::FLAC::File* flac = dynamic_cast<TagLib::FLAC::File*>(file))
+        return imageFromPictures(flac->pictureList());
+
+    if (TagLib::Ogg::Vorbis::File* vorbis = dynamic_cast<TagLib::Ogg::Vorbis::File*>(file)) {
+        if (vorbis->tag())
+            return imageFromPictures(vorbis->tag()->pictureList());
+        return QImage();
+    }
+
+    if (TagLib::MP4::File* mp4 = dynamic_cast<TagLib::MP4::File*>(file)) {
+        TagLib::MP4::Tag* tag = mp4->tag();
+        if (tag && tag->contains("covr")) {
+            TagLib::MP4::CoverArtList covers = tag->item("covr").toCoverArtList();
+            if (!covers.isEmpty())
+                return imageFromBytes(covers.front().data());
+        }
+        return QImage();
+    }
+#endif
+
+    return QImage();
 }
 
 /*
@@ -227,7 +404,7 @@ QImage Track::defaultImage()
     painter.setFont(QFont("Monospace"));
     painter.translate(QPoint(-26, 62));
     painter.rotate(-45);
-    painter.drawText(img.rect(), Qt::AlignCenter, p->artist + '\n' + p->title);
+    painter.drawText(img.rect(), Qt::AlignCenter, p->d->artist + '\n' + p->d->title);
 
     return img;
 }
@@ -236,9 +413,9 @@ QString Track::prettyTitle() const
 {
 
     QString s = QString::null;
-    if (p->artist != QObject::tr("Unknown"))
-        s += p->artist + " - ";
-    s += p->title;
+    if (p->d->artist != QObject::tr("Unknown"))
+        s += p->d->artist + " - ";
+    s += p->d->title;
 
     return s;
 }
@@ -254,12 +431,12 @@ QString Track::prettyTitle(QString filename) //static
 
 QString Track::prettyArtist(int maxlen) const
 {
-    return this->rsqueeze(p->artist, maxlen);
+    return this->rsqueeze(p->d->artist, maxlen);
 }
 
 QString Track::prettyTitle(int maxlen) const
 {
-    return this->rsqueeze(p->title, maxlen);
+    return this->rsqueeze(p->d->title, maxlen);
 }
 
 QString Track::rsqueeze(const QString& str, int maxlen) const
@@ -279,7 +456,7 @@ void Track::setLengthFromPretty(QString s)
         i = list.at(0).toInt() * 60;
         i += list.at(1).toInt();
     }
-    p->length = i;
+    setField(p->d, &TrackRecord::length, i);
 }
 
 QString Track::prettyLength(int seconds)
@@ -313,21 +490,21 @@ QString Track::prettyTime(int seconds, bool showHours)
 
 bool Track::isValid()
 {
-    if (p->url.isEmpty() || !p->url.isValid())
+    if (p->d->url.isEmpty() || !p->d->url.isValid())
         return false;
 
-    if (p->url.toString().contains(".mp3", Qt::CaseInsensitive)
-        || p->url.toString().contains(".ogg", Qt::CaseInsensitive)
-        || p->url.toString().contains(".wav", Qt::CaseInsensitive)
-        || p->url.toString().contains(".m4a", Qt::CaseInsensitive)
-        || p->url.toString().contains(".m4p", Qt::CaseInsensitive)
-        || p->url.toString().contains(".flac", Qt::CaseInsensitive)
-        || p->url.toString().contains(".aiff", Qt::CaseInsensitive)
-        || p->url.toString().contains(".oga", Qt::CaseInsensitive)
-        || p->url.toString().contains(".wma", Qt::CaseInsensitive)
-        || p->url.toString().contains(".au", Qt::CaseInsensitive)
-        || p->url.toString().contains(".tta", Qt::CaseInsensitive)
-        || p->url.toString().contains(".raw", Qt::CaseInsensitive))
+    if (p->d->url.toString().contains(".mp3", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".ogg", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".wav", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".m4a", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".m4p", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".flac", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".aiff", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".oga", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".wma", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".au", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".tta", Qt::CaseInsensitive)
+        || p->d->url.toString().contains(".raw", Qt::CaseInsensitive))
         return true;
     else
         return false;
@@ -335,45 +512,45 @@ bool Track::isValid()
 
 QString Track::dirPath()
 {
-    QString localPath = p->url.toLocalFile();
+    QString localPath = p->d->url.toLocalFile();
     QFileInfo fileInfo(localPath);
     return fileInfo.absolutePath();
 }
 
-QStringList Track::tagList() { return (QStringList() << p->url.toLocalFile()
-                                                     << p->artist
-                                                     << p->title
-                                                     << p->album
-                                                     << p->year
-                                                     << p->genre
-                                                     << p->tracknumber
-                                                     << QString().setNum(p->length)
+QStringList Track::tagList() { return (QStringList() << p->d->url.toLocalFile()
+                                                     << p->d->artist
+                                                     << p->d->title
+                                                     << p->d->album
+                                                     << p->d->year
+                                                     << p->d->genre
+                                                     << p->d->tracknumber
+                                                     << QString().setNum(p->d->length)
                                                      << QString().setNum(p->counter)
-                                                     << QString().setNum(p->rate)); }
-
-int Track::length() { return p->length > 0 ? p->length : 0; }
-QUrl Track::url() { return p->url; }
-QString Track::title() { return p->title; }
-QString Track::artist() { return p->artist; }
-QString Track::album() { return p->album; }
-int Track::rate() { return p->rate; }
-QString Track::year() { return p->year; }
-QString Track::comment() { return p->comment; }
-QString Track::genre() { return p->genre; }
-QString Track::tracknumber() { return p->tracknumber > 0 ? p->tracknumber : "0"; }
+                                                     << QString().setNum(p->d->rate)); }
+
+int Track::length() { return p->d->length > 0 ? p->d->length : 0; }
+QUrl Track::url() { return p->d->url; }
+QString Track::title() { return p->d->title; }
+QString Track::artist() { return p->d->artist; }
+QString Track::album() { return p->d->album; }
+int Track::rate() { return p->d->rate; }
+QString Track::year() { return p->d->year; }
+QString Track::comment() { return p->d->comment; }
+QString Track::genre() { return p->d->genre; }
+QString Track::tracknumber() { return p->d->tracknumber > 0 ? p->d->tracknumber : "0"; }
 int Track::counter() { return p->counter; }
-QString Track::prettyLength() { return prettyLength(p->length); }
+QString Track::prettyLength() { return prettyLength(p->d->length); }
 Track::Options Track::flags() { return p->flags; }
 
-void Track::setUrl(QUrl url) { p->url = url; }
-void Track::setTitle(QString s) { p->title = s; }
-void Track::setArtist(QString s) { p->artist = s; }
-void Track::setAlbum(QString s) { p->album = s; }
-void Track::setRate(int s) { p->rate = s; }
-void Track::setYear(QString s) { p->year = s; }
-void Track::setComment(QString s) { p->comment = s; }
-void Track::setGenre(QString s) { p->genre = s; }
-void Track::setTracknumber(QString s) { p->tracknumber = s; }
-void Track::setLength(QString s) { p->length = s.toInt(); }
+void Track::setUrl(QUrl url) { setField(p->d, &TrackRecord::url, url); }
+void Track::setTitle(QString s) { setField(p->d, &TrackRecord::title, s); }
+void Track::setArtist(QString s) { setField(p->d, &TrackRecord::artist, s); }
+void Track::setAlbum(QString s) { setField(p->d, &TrackRecord::album, s); }
+void Track::setRate(int s) { setField(p->d, &TrackRecord::rate, s); }
+void Track::setYear(QString s) { setField(p->d, &TrackRecord::year, s); }
+void Track::setComment(QString s) { setField(p->d, &TrackRecord::comment, s); }
+void Track::setGenre(QString s) { setField(p->d, &TrackRecord::genre, s); }
+void Track::setTracknumber(QString s) { setField(p->d, &TrackRecord::tracknumber, s); }
+void Track::setLength(QString s) { setField(p->d, &TrackRecord::length, s.toInt()); }
 void Track::setCounter(QString s) { p->counter = s.toInt(); }
 void Track::setFlags(Track::Options flags) { p->flags = flags; }
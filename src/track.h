@@ -48,12 +48,16 @@ public:
     Track( const QUrl &u);
     Track( const QStringList& list );
     Track( const PlaylistItem *item );
+    Track( const Track &other );
     ~Track();
 
+    Track &operator=( const Track &other );
+
     static QStringList tagNameList;
     
     QImage coverImage();
     QImage defaultImage();
+    static QImage embeddedImage( const QString &fileName );
 
     bool operator==(Track* track);
     bool containIn(QList<Track*> list );
@@ -100,6 +104,9 @@ public:
     static QString zeroPad( uint i ) { return ( i < 10 ) ? QString( "0%1" ).arg( i ) : QString::number( i ); }
     static QString prettyTitle( QString );
 
+    /** Number of track records currently held by the shared registry */
+    static int sharedRecordCount();
+
 protected:
 
     QString rsqueeze( const QString&, int ) const;
@@ -16,6 +16,8 @@
 */
 
 #include "trackanalyser.h"
+#include "collectiondb.h"
+#include "tracer.h"
 
 #include <QtGui>
 #if QT_VERSION >= 0x050000
@@ -26,7 +28,7 @@
 
 #define AUDIOFREQ 32000
 #define SCAN_DURATION 60
-static const guint spect_bands = 8;
+static const guint spect_bands = TrackFeatures::Bands;
 
 struct TrackAnalyser_Private
 {
@@ -35,19 +37,33 @@ struct TrackAnalyser_Private
         guint64 fft_res;
         float lastSpectrum[spect_bands];
         QList<float> spectralFlux;
+        // summed power of every band, for the features
+        double bandPower[spect_bands];
+        int onsets;
         int bpm;
+        TrackFeatures features;
         GstElement *src, *conv, *sink, *cutter, *audio, *analysis, *spectrum;
         TrackAnalyser::modeType analysisMode;
+        qint64 traceStart;
+        QString traceUrl;
+        CollectionDB *database;
 };
 
-TrackAnalyser::TrackAnalyser(QWidget *parent) :
-        QWidget(parent),
+TrackAnalyser::TrackAnalyser(QObject *parent) :
+        QObject(parent),
     pipeline(nullptr), m_finished(false)
     , p( new TrackAnalyser_Private )
 {
     p->fft_res = 435; //sample rate for fft samples in Hz
-    for (int i=0;i<spect_bands;i++)
+    p->traceStart = 0;
+    p->database = nullptr;
+    p->analysisMode = STANDARD;
+    p->bpm = 0;
+    p->onsets = 0;
+    for (int i=0;i<spect_bands;i++) {
         p->lastSpectrum[i]=0.0;
+        p->bandPower[i]=0.0;
+    }
 
     gst_init (nullptr, nullptr);
     prepare();
@@ -68,6 +84,7 @@ void TrackAnalyser::sync_set_state(GstElement* element, GstState state)
 TrackAnalyser::~TrackAnalyser()
 {
     cleanup();
+    delete p->database;
     delete p;
     p = nullptr;
 }
@@ -172,6 +189,11 @@ int TrackAnalyser::bpm()
     return  p->bpm;
 }
 
+TrackFeatures TrackAnalyser::features()
+{
+    return  p->features;
+}
+
 double TrackAnalyser::gainDB()
 {
     return  m_GainDB;
@@ -229,20 +251,76 @@ void TrackAnalyser::setMode(modeType mode)
     }
 }
 
+void TrackAnalyser::setUseCache(bool use)
+{
+    if (use && !p->database)
+        p->database = new CollectionDB();
+    else if (!use) {
+        delete p->database;
+        p->database = nullptr;
+    }
+}
+
+QString TrackAnalyser::deckName() const
+{
+    return parent() ? parent()->objectName() : objectName();
+}
+
 void TrackAnalyser::open(QUrl url)
 {
     //To avoid delays load track in another thread
-    qDebug() << Q_FUNC_INFO <<":"<<parentWidget()->objectName()<<" url="<<url;
+    qDebug() << Q_FUNC_INFO <<":"<<deckName()<<" url="<<url;
+    p->traceStart = Tracer::now();
+    if (Tracer::isEnabled())
+        p->traceUrl = url.toString();
+
+    if (p->analysisMode == STANDARD && readCache(url)) {
+        // announced later, like the result of a run
+        QMetaObject::invokeMethod(this, "finishGain", Qt::QueuedConnection);
+        return;
+    }
+
     QFuture<void> future = QtConcurrent::run( this, &TrackAnalyser::asyncOpen,url);
     p->watcher.setFuture(future);
 }
 
+bool TrackAnalyser::readCache(const QUrl& url)
+{
+    if (!p->database || !url.isLocalFile())
+        return false;
+
+    QFileInfo fileInfo(url.toLocalFile());
+    QStringList row = p->database->selectAnalysis(fileInfo.absoluteFilePath());
+    if (row.count() < 6 || row.at(0).toLongLong() != (qint64)fileInfo.lastModified().toTime_t())
+        return false;
+
+    // a stopped pipeline keeps length() from asking the previous track
+    p->watcher.waitForFinished();
+    p->mutex.lock();
+    sync_set_state (GST_ELEMENT (pipeline), GST_STATE_NULL);
+    m_GainDB = row.at(1).toDouble();
+    m_StartPosition = QTime(0,0).addMSecs(row.at(2).toInt());
+    m_EndPosition = QTime(0,0).addMSecs(row.at(3).toInt());
+    m_MaxPosition = QTime(0,0).addMSecs(row.at(4).toInt());
+    p->bpm = row.at(5).toInt();
+    p->features = row.count() > 6 ? TrackFeatures::fromString(row.at(6)) : TrackFeatures();
+    m_finished = true;
+    p->mutex.unlock();
+    qDebug() << Q_FUNC_INFO <<":"<<deckName()<<" cached gain="<<m_GainDB;
+    return true;
+}
+
 void TrackAnalyser::asyncOpen(QUrl url)
 {
+    TraceZone zone("analyser", "open");
     p->mutex.lock();
     m_GainDB = GAIN_INVALID;
     //m_StartPosition = QTime(0,0);
     p->spectralFlux.clear();
+    p->features = TrackFeatures();
+    p->onsets = 0;
+    for (int i=0;i<spect_bands;i++)
+        p->bandPower[i]=0.0;
 
     sync_set_state (GST_ELEMENT (pipeline), GST_STATE_NULL);
 
@@ -261,7 +339,10 @@ void TrackAnalyser::asyncOpen(QUrl url)
 void TrackAnalyser::loadThreadFinished()
 {
     // async load in player done
-    qDebug() << Q_FUNC_INFO <<":"<<parentWidget()->objectName()<<" analysisMode="<<p->analysisMode;
+    qDebug() << Q_FUNC_INFO <<":"<<deckName()<<" analysisMode="<<p->analysisMode;
+    // a cached result replaced this run meanwhile
+    if (m_finished)
+        return;
 
     if ( p->analysisMode == TrackAnalyser::TEMPO ){
         //setPosition( m_EndPosition.addSecs(-SCAN_DURATION) );
@@ -275,7 +356,7 @@ void TrackAnalyser::loadThreadFinished()
 
 void TrackAnalyser::start()
 {
-    qDebug() << Q_FUNC_INFO <<":"<<parentWidget()->objectName();
+    qDebug() << Q_FUNC_INFO <<":"<<deckName();
     gst_element_set_state (GST_ELEMENT (pipeline), GST_STATE_PLAYING);
 }
 
@@ -327,7 +408,7 @@ void TrackAnalyser::messageReceived(GstMessage *message)
                 break;
         }
         case GST_MESSAGE_EOS:{
-                qDebug() << Q_FUNC_INFO <<":"<<parentWidget()->objectName()<<" End of track reached";
+                qDebug() << Q_FUNC_INFO <<":"<<deckName()<<" End of track reached";
                 need_finish();
                 break;
         }
@@ -354,6 +435,7 @@ void TrackAnalyser::messageReceived(GstMessage *message)
                     mag_value = pow (10.0, g_value_get_float (mag)/ 20.0);
                     float value = (mag_value - p->lastSpectrum[i]);
                     p->lastSpectrum[i] = mag_value;
+                    p->bandPower[i] += mag_value * mag_value;
                     flux += value < 0? 0: value;
                     //qDebug() << Q_FUNC_INFO <<"freq:"<<freq<<" flux:"<<flux;
                   }
@@ -409,10 +491,18 @@ void TrackAnalyser::need_finish()
     switch (p->analysisMode)
     {
         case TEMPO:
-            detectTempo();
+            {
+                TraceZone zone("analyser", "detectTempo");
+                detectTempo();
+                detectFeatures();
+            }
+            if (Tracer::isEnabled())
+                Tracer::instance()->complete("analyser", "tempo run", p->traceStart, Tracer::now(), p->traceUrl);
             Q_EMIT finishTempo();
             break;
         default:
+            if (Tracer::isEnabled())
+                Tracer::instance()->complete("analyser", "gain run", p->traceStart, Tracer::now(), p->traceUrl);
             Q_EMIT finishGain();
     }
 }
@@ -447,10 +537,14 @@ void TrackAnalyser::detectTempo()
     }
 
     //peak detection
+    p->onsets = 0;
     for( int i = 0; i < prunedSpectralFlux.size() - 1; i++ )
     {
-       if( prunedSpectralFlux.at(i) > prunedSpectralFlux.at(i+1) )
+       if( prunedSpectralFlux.at(i) > prunedSpectralFlux.at(i+1) ) {
           peaks.append( prunedSpectralFlux.at(i) );
+          if ( prunedSpectralFlux.at(i) > 0 )
+             p->onsets++;
+       }
        else
           peaks.append( (float)0 );
     }
@@ -467,6 +561,32 @@ void TrackAnalyser::detectTempo()
     p->bpm = qRound(bpm);
 }
 
+void TrackAnalyser::detectFeatures()
+{
+    int frames = p->spectralFlux.size();
+    double total = 0;
+    double weighted = 0;
+    for (guint i = 0; i < spect_bands; i++) {
+        total += p->bandPower[i];
+        weighted += p->bandPower[i] * (i + 0.5);
+    }
+    if ( frames == 0 || total <= 0 || p->bpm <= 0 ) {
+        p->features = TrackFeatures();
+        return;
+    }
+
+    //bands are linear in frequency, the centroid is a fraction of the spectrum
+    TrackFeatures features;
+    features.setValue(TrackFeatures::Tempo, p->bpm);
+    features.setValue(TrackFeatures::Centroid, weighted / total / spect_bands);
+    features.setValue(TrackFeatures::Loudness, 10.0 * log10(total / frames));
+    features.setValue(TrackFeatures::OnsetDensity, p->onsets * (float)p->fft_res / frames);
+    for (guint i = 0; i < spect_bands; i++)
+        features.setValue(TrackFeatures::Band + i, p->bandPower[i] / total);
+    p->features = features;
+    qDebug() << Q_FUNC_INFO << "features:" << features.toString();
+}
+
 float TrackAnalyser::AutoCorrelation( QList<float> buffer, int frames, int minBpm, int maxBpm, int sampleRate)
 {
 
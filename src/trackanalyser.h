@@ -18,24 +18,28 @@
 #define TRACKANALYSER_H
 
 #include <QtCore>
-#include <QWidget>
+#include <QObject>
+
+#include "trackfeatures.h"
 
 #define GST_DISABLE_LOADSAVE 1
 #define GST_DISABLE_REGISTRY 1
 #define GST_DISABLE_DEPRECATED 1
 #include <gst/gst.h>
 
-class TrackAnalyser : public QWidget
+class TrackAnalyser : public QObject
 {
     Q_OBJECT
 public:
-    TrackAnalyser(QWidget *parent = 0);
+    TrackAnalyser(QObject *parent = 0);
     ~TrackAnalyser();
 
     enum modeType { STANDARD, TEMPO };
 
     bool prepare();
     void open(QUrl url);
+    /** Take gain and markers of unchanged files from the collection database */
+    void setUseCache(bool use);
     void start();
     bool close();
 
@@ -44,6 +48,8 @@ public:
     QTime startPosition();
     QTime endPosition();
     int bpm();
+    /** Sound of the track for similarity searches, valid after a tempo run */
+    TrackFeatures features();
     bool finished() {return m_finished;}
     void setMode(modeType mode);
     void setPosition(QTime position);
@@ -75,10 +81,13 @@ public:
         bool m_finished;
 
         void detectTempo();
+        void detectFeatures();
         float AutoCorrelation( QList<float> buffer, int frames, int minBpm, int maxBpm, int sampleRate);
 
         void cleanup();
         void asyncOpen(QUrl url);
+        bool readCache(const QUrl& url);
+        QString deckName() const;
         void sync_set_state(GstElement*, GstState);
    };
 
@@ -0,0 +1,62 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "trackfeatures.h"
+
+#include <QStringList>
+
+TrackFeatures::TrackFeatures()
+    : m_valid(false)
+{
+    for (int i = 0; i < Count; i++)
+        m_values[i] = 0;
+}
+
+void TrackFeatures::setValue(int index, float value)
+{
+    m_values[index] = value;
+    m_valid = true;
+}
+
+QString TrackFeatures::toString() const
+{
+    if (!m_valid)
+        return QString();
+
+    QStringList values;
+    for (int i = 0; i < Count; i++)
+        values << QString::number(m_values[i], 'g', 5);
+    return values.join(" ");
+}
+
+TrackFeatures TrackFeatures::fromString(const QString& text)
+{
+    TrackFeatures ret;
+    QStringList values = text.split(' ', QString::SkipEmptyParts);
+    if (values.count() != Count)
+        return ret;
+
+    for (int i = 0; i < Count; i++) {
+        bool ok = false;
+        ret.m_values[i] = values.at(i).toFloat(&ok);
+        if (!ok)
+            return TrackFeatures();
+    }
+    ret.m_valid = true;
+    return ret;
+}
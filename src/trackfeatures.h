@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TRACKFEATURES_H
+#define TRACKFEATURES_H
+
+#include <QString>
+
+/*
+ *  Compact description of the sound of a track for similarity searches:
+ *  tempo in bpm, spectral centroid as fraction of the spectrum, loudness
+ *  in dB, onsets per second and the share of the energy in every band of
+ *  the spectrum. TrackAnalyser fills it in the tempo run, the analysis
+ *  cache keeps it as text.
+ */
+class TrackFeatures {
+public:
+    enum {
+        Bands = 8
+    };
+    enum Index {
+        Tempo,
+        Centroid,
+        Loudness,
+        OnsetDensity,
+        Band,
+        Count = Band + Bands
+    };
+
+    TrackFeatures();
+
+    bool isValid() const { return m_valid; }
+    float value(int index) const { return m_values[index]; }
+    void setValue(int index, float value);
+
+    /** Values separated by spaces, empty if not valid */
+    QString toString() const;
+    static TrackFeatures fromString(const QString& text);
+
+private:
+    float m_values[Count];
+    bool m_valid;
+};
+
+#endif // TRACKFEATURES_H
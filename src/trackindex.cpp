@@ -0,0 +1,461 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "trackindex.h"
+#include "cataloguesnapshot.h"
+#include "collectiondb.h"
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
+#include <QTime>
+#include <qdebug.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+const quint32 arrayLimit = 4096;
+const int bitsetWords = 1024;
+
+inline int popCount(quint64 v)
+{
+    v = v - ((v >> 1) & Q_UINT64_C(0x5555555555555555));
+    v = (v & Q_UINT64_C(0x3333333333333333)) + ((v >> 2) & Q_UINT64_C(0x3333333333333333));
+    v = (v + (v >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return int((v * Q_UINT64_C(0x0101010101010101)) >> 56);
+}
+
+typedef QHash<QString, TrackBitmap> BitmapMap;
+
+TrackBitmap matchValues(const BitmapMap& values, const QStringList& tokens)
+{
+    TrackBitmap ret;
+    foreach (QString token, tokens) {
+        token = token.toLower();
+        BitmapMap::const_iterator it;
+        for (it = values.constBegin(); it != values.constEnd(); ++it)
+            if (it.key().contains(token))
+                ret |= it.value();
+    }
+    return ret;
+}
+}
+
+int TrackBitmap::lowerBound(quint16 key) const
+{
+    int low = 0;
+    int high = m_containers.count();
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (m_containers.at(mid).key < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+void TrackBitmap::add(quint32 value)
+{
+    quint16 key = value >> 16;
+    quint16 low = value & 0xffff;
+
+    int i = lowerBound(key);
+    if (i == m_containers.count() || m_containers.at(i).key != key) {
+        Container c;
+        c.key = key;
+        c.cardinality = 0;
+        m_containers.insert(i, c);
+    }
+
+    Container& c = m_containers[i];
+    if (c.isBitset()) {
+        quint64 mask = Q_UINT64_C(1) << (low & 63);
+        if (!(c.bits[low >> 6] & mask)) {
+            c.bits[low >> 6] |= mask;
+            c.cardinality++;
+        }
+        return;
+    }
+
+    // the index is built in ascending order, appending is the usual case
+    if (c.array.isEmpty() || c.array.last() < low) {
+        c.array.append(low);
+    } else {
+        quint16* pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (*pos == low)
+            return;
+        c.array.insert(pos - c.array.begin(), low);
+    }
+    c.cardinality++;
+    if (c.cardinality > arrayLimit)
+        toBitset(c);
+}
+
+bool TrackBitmap::contains(quint32 value) const
+{
+    quint16 key = value >> 16;
+    quint16 low = value & 0xffff;
+
+    int i = lowerBound(key);
+    if (i == m_containers.count() || m_containers.at(i).key != key)
+        return false;
+
+    const Container& c = m_containers.at(i);
+    if (c.isBitset())
+        return c.bits.at(low >> 6) & (Q_UINT64_C(1) << (low & 63));
+    return std::binary_search(c.array.constBegin(), c.array.constEnd(), low);
+}
+
+bool TrackBitmap::isEmpty() const
+{
+    return m_containers.isEmpty();
+}
+
+quint32 TrackBitmap::cardinality() const
+{
+    quint32 ret = 0;
+    foreach (const Container& c, m_containers)
+        ret += c.cardinality;
+    return ret;
+}
+
+quint32 TrackBitmap::select(quint32 rank) const
+{
+    foreach (const Container& c, m_containers) {
+        if (rank >= c.cardinality) {
+            rank -= c.cardinality;
+            continue;
+        }
+        quint32 high = quint32(c.key) << 16;
+        if (!c.isBitset())
+            return high | c.array.at(rank);
+
+        for (int w = 0; w < bitsetWords; w++) {
+            quint64 word = c.bits.at(w);
+            quint32 count = popCount(word);
+            if (rank >= count) {
+                rank -= count;
+                continue;
+            }
+            for (int b = 0; b < 64; b++) {
+                if (!(word & (Q_UINT64_C(1) << b)))
+                    continue;
+                if (rank == 0)
+                    return high | quint32(w * 64 + b);
+                rank--;
+            }
+        }
+    }
+    return 0;
+}
+
+QVector<quint32> TrackBitmap::toVector() const
+{
+    QVector<quint32> ret;
+    ret.reserve(cardinality());
+    foreach (const Container& c, m_containers) {
+        quint32 high = quint32(c.key) << 16;
+        if (!c.isBitset()) {
+            foreach (quint16 low, c.array)
+                ret.append(high | low);
+            continue;
+        }
+        for (int w = 0; w < bitsetWords; w++) {
+            quint64 word = c.bits.at(w);
+            for (int b = 0; word; b++, word >>= 1)
+                if (word & 1)
+                    ret.append(high | quint32(w * 64 + b));
+        }
+    }
+    return ret;
+}
+
+TrackBitmap TrackBitmap::operator|(const TrackBitmap& other) const
+{
+    TrackBitmap ret;
+    int i = 0;
+    int j = 0;
+    while (i < m_containers.count() || j < other.m_containers.count()) {
+        if (j == other.m_containers.count()
+            || (i < m_containers.count() && m_containers.at(i).key < other.m_containers.at(j).key)) {
+            ret.m_containers.append(m_containers.at(i++));
+        } else if (i == m_containers.count() || other.m_containers.at(j).key < m_containers.at(i).key) {
+            ret.m_containers.append(other.m_containers.at(j++));
+        } else {
+            ret.m_containers.append(unite(m_containers.at(i++), other.m_containers.at(j++)));
+        }
+    }
+    return ret;
+}
+
+TrackBitmap TrackBitmap::operator&(const TrackBitmap& other) const
+{
+    TrackBitmap ret;
+    int i = 0;
+    int j = 0;
+    while (i < m_containers.count() && j < other.m_containers.count()) {
+        if (m_containers.at(i).key < other.m_containers.at(j).key) {
+            i++;
+        } else if (other.m_containers.at(j).key < m_containers.at(i).key) {
+            j++;
+        } else {
+            Container c = intersect(m_containers.at(i++), other.m_containers.at(j++));
+            if (c.cardinality > 0)
+                ret.m_containers.append(c);
+        }
+    }
+    return ret;
+}
+
+TrackBitmap& TrackBitmap::operator|=(const TrackBitmap& other)
+{
+    *this = *this | other;
+    return *this;
+}
+
+TrackBitmap& TrackBitmap::operator&=(const TrackBitmap& other)
+{
+    *this = *this & other;
+    return *this;
+}
+
+void TrackBitmap::toBitset(Container& c)
+{
+    if (c.isBitset())
+        return;
+    c.bits.fill(0, bitsetWords);
+    foreach (quint16 low, c.array)
+        c.bits[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+    c.array.clear();
+}
+
+void TrackBitmap::optimize(Container& c)
+{
+    if (!c.isBitset() || c.cardinality > arrayLimit)
+        return;
+    c.array.reserve(c.cardinality);
+    for (int w = 0; w < bitsetWords; w++) {
+        quint64 word = c.bits.at(w);
+        for (int b = 0; word; b++, word >>= 1)
+            if (word & 1)
+                c.array.append(quint16(w * 64 + b));
+    }
+    c.bits.clear();
+}
+
+TrackBitmap::Container TrackBitmap::unite(const Container& a, const Container& b)
+{
+    Container ret;
+    ret.key = a.key;
+
+    if (!a.isBitset() && !b.isBitset()) {
+        ret.array.reserve(a.array.count() + b.array.count());
+        std::set_union(a.array.constBegin(), a.array.constEnd(),
+            b.array.constBegin(), b.array.constEnd(),
+            std::back_inserter(ret.array));
+        ret.cardinality = ret.array.count();
+        if (ret.cardinality > arrayLimit)
+            toBitset(ret);
+        return ret;
+    }
+
+    ret.array = a.array;
+    ret.bits = a.bits;
+    toBitset(ret);
+    if (b.isBitset()) {
+        for (int w = 0; w < bitsetWords; w++)
+            ret.bits[w] |= b.bits.at(w);
+    } else {
+        foreach (quint16 low, b.array)
+            ret.bits[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+    }
+
+    ret.cardinality = 0;
+    for (int w = 0; w < bitsetWords; w++)
+        ret.cardinality += popCount(ret.bits.at(w));
+    return ret;
+}
+
+TrackBitmap::Container TrackBitmap::intersect(const Container& a, const Container& b)
+{
+    Container ret;
+    ret.key = a.key;
+
+    if (!a.isBitset() && !b.isBitset()) {
+        std::set_intersection(a.array.constBegin(), a.array.constEnd(),
+            b.array.constBegin(), b.array.constEnd(),
+            std::back_inserter(ret.array));
+    } else if (a.isBitset() && b.isBitset()) {
+        ret.bits.resize(bitsetWords);
+        ret.cardinality = 0;
+        for (int w = 0; w < bitsetWords; w++) {
+            ret.bits[w] = a.bits.at(w) & b.bits.at(w);
+            ret.cardinality += popCount(ret.bits.at(w));
+        }
+        optimize(ret);
+        return ret;
+    } else {
+        const Container& array = a.isBitset() ? b : a;
+        const Container& bitset = a.isBitset() ? a : b;
+        foreach (quint16 low, array.array)
+            if (bitset.bits.at(low >> 6) & (Q_UINT64_C(1) << (low & 63)))
+                ret.array.append(low);
+    }
+
+    ret.cardinality = ret.array.count();
+    return ret;
+}
+
+struct TrackIndexPrivate {
+    QMutex mutex;
+    bool valid;
+    int generation;
+    QVector<int> ids;
+    QVector<int> lengths;
+    BitmapMap genres;
+    BitmapMap artists;
+    BitmapMap dirs;
+    TrackBitmap all;
+};
+
+TrackIndex* TrackIndex::instance()
+{
+    static TrackIndex* index = new TrackIndex(QCoreApplication::instance());
+    return index;
+}
+
+TrackIndex::TrackIndex(QObject* parent)
+    : QObject(parent)
+    , p(new TrackIndexPrivate)
+{
+    p->valid = false;
+    p->generation = 0;
+}
+
+TrackIndex::~TrackIndex()
+{
+    delete p;
+}
+
+void TrackIndex::invalidate()
+{
+    QMutexLocker locker(&p->mutex);
+    p->valid = false;
+    p->generation++;
+    p->ids.clear();
+    p->lengths.clear();
+    p->genres.clear();
+    p->artists.clear();
+    p->dirs.clear();
+    p->all = TrackBitmap();
+}
+
+int TrackIndex::generation()
+{
+    QMutexLocker locker(&p->mutex);
+    return p->generation;
+}
+
+void TrackIndex::build(CollectionDB* db)
+{
+    QTime time;
+    time.start();
+
+    QList<QStringList> rows;
+    if (!CatalogueSnapshot::instance()->selectIndexRows(rows))
+        rows = db->selectSql("SELECT tags.id, tags.length, tags.dir, genre.name, artist.name "
+                             "FROM tags "
+                             "INNER JOIN genre ON tags.genre = genre.id "
+                             "INNER JOIN artist ON tags.artist = artist.id "
+                             "ORDER BY tags.id;");
+
+    p->ids.reserve(rows.count());
+    p->lengths.reserve(rows.count());
+    for (int i = 0; i < rows.count(); i++) {
+        const QStringList& row = rows.at(i);
+        quint32 ordinal = p->ids.count();
+        p->ids.append(row.at(0).toInt());
+        p->lengths.append(row.at(1).toInt());
+        // keys as the SQL filters see them: lower case, paths as in the url
+        p->dirs[row.at(2).toLower() + "/"].add(ordinal);
+        p->genres[row.at(3).toLower()].add(ordinal);
+        p->artists[row.at(4).toLower()].add(ordinal);
+        p->all.add(ordinal);
+    }
+    p->valid = true;
+
+    qDebug() << Q_FUNC_INFO << p->ids.count() << "tracks," << p->genres.count() << "genres,"
+             << p->artists.count() << "artists," << p->dirs.count() << "dirs in" << time.elapsed() << "ms";
+}
+
+TrackBitmap TrackIndex::match(CollectionDB* db, const QStringList& paths, const QStringList& genres, const QStringList& artists)
+{
+    QMutexLocker locker(&p->mutex);
+    if (!p->valid)
+        build(db);
+
+    TrackBitmap ret = p->all;
+    if (!paths.isEmpty())
+        ret &= matchValues(p->dirs, paths);
+    if (!genres.isEmpty())
+        ret &= matchValues(p->genres, genres);
+    if (!artists.isEmpty())
+        ret &= matchValues(p->artists, artists);
+    return ret;
+}
+
+TrackBitmap TrackIndex::match(CollectionDB* db, const QString& path, const QString& genre, const QString& artist)
+{
+    QStringList paths, genres, artists;
+    if (!path.isEmpty())
+        paths << path;
+    if (!genre.isEmpty())
+        genres << genre;
+    if (!artist.isEmpty())
+        artists << artist;
+    return match(db, paths, genres, artists);
+}
+
+long TrackIndex::lengthSum(const TrackBitmap& tracks)
+{
+    QMutexLocker locker(&p->mutex);
+    long ret = 0;
+    foreach (quint32 ordinal, tracks.toVector())
+        if (ordinal < quint32(p->lengths.count()))
+            ret += p->lengths.at(ordinal);
+    return ret;
+}
+
+int TrackIndex::trackId(quint32 ordinal)
+{
+    QMutexLocker locker(&p->mutex);
+    if (ordinal >= quint32(p->ids.count()))
+        return -1;
+    return p->ids.at(ordinal);
+}
+
+int TrackIndex::ordinal(int id)
+{
+    QMutexLocker locker(&p->mutex);
+    // both sources are ordered by tags.id
+    QVector<int>::const_iterator it = std::lower_bound(p->ids.constBegin(), p->ids.constEnd(), id);
+    if (it == p->ids.constEnd() || *it != id)
+        return -1;
+    return int(it - p->ids.constBegin());
+}
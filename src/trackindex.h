@@ -0,0 +1,98 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACKINDEX_H
+#define TRACKINDEX_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+class CollectionDB;
+
+/*
+ *  Compressed set of track ordinals. Values are split into chunks of 65536
+ *  by their upper 16 bits, a chunk is stored as sorted array while sparse
+ *  and as bitset of 1024 words when it holds more than 4096 values.
+ */
+class TrackBitmap {
+public:
+    void add(quint32 value);
+    bool contains(quint32 value) const;
+    bool isEmpty() const;
+    quint32 cardinality() const;
+    /** The value at position rank in ascending order */
+    quint32 select(quint32 rank) const;
+    QVector<quint32> toVector() const;
+
+    TrackBitmap operator|(const TrackBitmap& other) const;
+    TrackBitmap operator&(const TrackBitmap& other) const;
+    TrackBitmap& operator|=(const TrackBitmap& other);
+    TrackBitmap& operator&=(const TrackBitmap& other);
+
+private:
+    struct Container {
+        quint16 key;
+        quint32 cardinality;
+        QVector<quint16> array;
+        QVector<quint64> bits;
+        bool isBitset() const { return !bits.isEmpty(); }
+    };
+
+    static void toBitset(Container& c);
+    static void optimize(Container& c);
+    static Container unite(const Container& a, const Container& b);
+    static Container intersect(const Container& a, const Container& b);
+    int lowerBound(quint16 key) const;
+
+    QVector<Container> m_containers;
+};
+
+/*
+ *  In-memory index of the collection for the Auto-DJ filters. Every genre,
+ *  artist and directory maps to the bitmap of its track ordinals, filters
+ *  are evaluated by OR and AND of these bitmaps instead of LIKE over the
+ *  whole join. The index is built on first use and after invalidate().
+ */
+class TrackIndex : public QObject {
+    Q_OBJECT
+
+public:
+    static TrackIndex* instance();
+    ~TrackIndex();
+
+    /** Drop the index, the next match rebuilds it */
+    void invalidate();
+    int generation();
+
+    /** Substring match like the SQL filters, an empty list matches all */
+    TrackBitmap match(CollectionDB* db, const QStringList& paths, const QStringList& genres, const QStringList& artists);
+    TrackBitmap match(CollectionDB* db, const QString& path, const QString& genre, const QString& artist);
+
+    long lengthSum(const TrackBitmap& tracks);
+    /** tags.id of the ordinal, -1 if unknown */
+    int trackId(quint32 ordinal);
+    /** Ordinal of a tags.id, -1 if not indexed */
+    int ordinal(int id);
+
+private:
+    explicit TrackIndex(QObject* parent = nullptr);
+    void build(CollectionDB* db);
+    struct TrackIndexPrivate* p;
+};
+
+#endif // TRACKINDEX_H
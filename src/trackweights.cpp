@@ -0,0 +1,322 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "trackweights.h"
+#include "collectiondb.h"
+#include "statisticsjournal.h"
+#include "tracer.h"
+#include "trackindex.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QSettings>
+#include <QTime>
+#include <qdebug.h>
+
+#include <math.h>
+
+namespace {
+// tables kept for the latest filters
+const int tableLimit = 16;
+// the recency penalty fades, so tables are renewed now and then
+const uint tableSeconds = 15 * 60;
+// favorites.rate is ten times the stars
+const int maxRate = 50;
+
+struct TrackStatistics {
+    TrackStatistics()
+        : plays(0)
+        , accessdate(0)
+        , rate(0)
+    {
+    }
+    int plays;
+    uint accessdate;
+    int rate;
+};
+
+struct WeightTable {
+    QVector<quint32> ordinals;
+    AliasTable alias;
+    uint built;
+};
+}
+
+void AliasTable::build(const QVector<double>& weights)
+{
+    int n = weights.count();
+    m_probability.fill(1.0f, n);
+    m_alias.resize(n);
+    for (int i = 0; i < n; i++)
+        m_alias[i] = i;
+
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += qMax(0.0, weights.at(i));
+    if (sum <= 0)
+        return;
+
+    // columns below the mean are topped up by one above it
+    QVector<double> scaled(n);
+    QVector<quint32> small;
+    QVector<quint32> large;
+    for (int i = 0; i < n; i++) {
+        scaled[i] = qMax(0.0, weights.at(i)) * n / sum;
+        if (scaled.at(i) < 1.0)
+            small.append(i);
+        else
+            large.append(i);
+    }
+    while (!small.isEmpty() && !large.isEmpty()) {
+        quint32 less = small.last();
+        small.resize(small.count() - 1);
+        quint32 more = large.last();
+        large.resize(large.count() - 1);
+
+        m_probability[less] = float(scaled.at(less));
+        m_alias[less] = more;
+        scaled[more] = (scaled.at(more) + scaled.at(less)) - 1.0;
+        if (scaled.at(more) < 1.0)
+            small.append(more);
+        else
+            large.append(more);
+    }
+    // what is left is full but for rounding and keeps probability 1
+}
+
+int AliasTable::draw(std::mt19937& random) const
+{
+    // every column reachable and a fine grained coin, unlike qrand()
+    std::uniform_int_distribution<int> columns(0, m_alias.count() - 1);
+    std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+    int column = columns(random);
+    return coin(random) < m_probability.at(column) ? column : int(m_alias.at(column));
+}
+
+struct TrackWeightsPrivate {
+    QMutex mutex;
+    bool enabled;
+    double favoriteBoost;
+    double playCountPower;
+    double recentPenalty;
+    uint recentSeconds;
+    bool loaded;
+    int indexGeneration;
+    int statisticsGeneration;
+    QHash<quint32, TrackStatistics> statistics;
+    QHash<QString, WeightTable> tables;
+    std::mt19937 random;
+};
+
+TrackWeights* TrackWeights::instance()
+{
+    static TrackWeights* weights = new TrackWeights(QCoreApplication::instance());
+    return weights;
+}
+
+TrackWeights::TrackWeights(QObject* parent)
+    : QObject(parent)
+    , p(new TrackWeightsPrivate)
+{
+    QSettings settings;
+    p->enabled = settings.value("AutoDjWeighted", true).toBool();
+    p->favoriteBoost = settings.value("AutoDjFavoriteBoost", 2.0).toDouble();
+    p->playCountPower = settings.value("AutoDjPlayCountPower", 0.0).toDouble();
+    p->recentSeconds = qMax(0, settings.value("AutoDjRecentHours", 12).toInt()) * 3600;
+    p->recentPenalty = qBound(0.0, settings.value("AutoDjRecentPenalty", 0.1).toDouble(), 1.0);
+    p->loaded = false;
+    p->indexGeneration = 0;
+    p->statisticsGeneration = 0;
+    p->random.seed(quint32(QDateTime::currentMSecsSinceEpoch()));
+}
+
+TrackWeights::~TrackWeights()
+{
+    delete p;
+}
+
+bool TrackWeights::isEnabled() const
+{
+    QMutexLocker locker(&p->mutex);
+    return p->enabled;
+}
+
+void TrackWeights::setEnabled(bool value)
+{
+    QMutexLocker locker(&p->mutex);
+    p->enabled = value;
+}
+
+void TrackWeights::invalidate()
+{
+    QMutexLocker locker(&p->mutex);
+    p->loaded = false;
+    p->statistics.clear();
+    p->tables.clear();
+}
+
+// called with the mutex held
+void TrackWeights::load(CollectionDB* db)
+{
+    QTime time;
+    time.start();
+
+    // taken first, a change while reading renews the tables once more
+    p->indexGeneration = TrackIndex::instance()->generation();
+    p->statisticsGeneration = StatisticsJournal::instance()->generation();
+    p->statistics.clear();
+
+    // pending changes are added below, none of them may be in the tables too
+    QReadLocker commit(StatisticsJournal::instance()->commitLock());
+    TrackIndex* index = TrackIndex::instance();
+    QList<QStringList> rows = db->selectSql("SELECT tags.id, statistics.playcounter, statistics.accessdate "
+                                            "FROM statistics INNER JOIN tags ON tags.url = statistics.url;");
+    foreach (const QStringList& row, rows) {
+        int ordinal = index->ordinal(row.at(0).toInt());
+        if (ordinal < 0)
+            continue;
+        TrackStatistics& statistics = p->statistics[ordinal];
+        statistics.plays = row.at(1).toInt();
+        statistics.accessdate = row.at(2).toUInt();
+    }
+    rows = db->selectSql("SELECT tags.id, favorites.rate "
+                         "FROM favorites INNER JOIN tags ON tags.url = favorites.url;");
+    foreach (const QStringList& row, rows) {
+        int ordinal = index->ordinal(row.at(0).toInt());
+        if (ordinal >= 0)
+            p->statistics[ordinal].rate = row.at(1).toInt();
+    }
+    overlayPending(db);
+    p->loaded = true;
+    qDebug() << Q_FUNC_INFO << p->statistics.count() << "tracks with statistics in" << time.elapsed() << "ms";
+}
+
+// called with the mutex and the commit lock held
+void TrackWeights::overlayPending(CollectionDB* db)
+{
+    // like CollectionDB::overlayStatistics, the journal writes behind
+    QList<QStringList> pending = StatisticsJournal::instance()->pendingRows();
+    if (pending.isEmpty())
+        return;
+
+    QStringList keys;
+    foreach (const QStringList& row, pending)
+        keys << "'" + db->escapeString(row.at(0)) + "'";
+    keys.removeDuplicates();
+    QHash<QString, int> ordinals;
+    TrackIndex* index = TrackIndex::instance();
+    for (int i = 0; i < keys.count(); i += 500) {
+        QList<QStringList> rows = db->selectSql("SELECT url, id FROM tags WHERE url IN (" + keys.mid(i, 500).join(",") + ");");
+        foreach (const QStringList& row, rows) {
+            int ordinal = index->ordinal(row.at(1).toInt());
+            if (ordinal >= 0)
+                ordinals.insert(row.at(0), ordinal);
+        }
+    }
+
+    foreach (const QStringList& row, pending) {
+        QHash<QString, int>::const_iterator it = ordinals.constFind(row.at(0));
+        if (it == ordinals.constEnd())
+            continue;
+        TrackStatistics& statistics = p->statistics[it.value()];
+        statistics.plays += row.at(1).toInt();
+        statistics.accessdate = qMax(statistics.accessdate, row.at(2).toUInt());
+        if (!row.at(3).isEmpty())
+            statistics.rate = row.at(3).toInt();
+    }
+}
+
+// called with the mutex held
+double TrackWeights::weightOf(quint32 ordinal, uint now) const
+{
+    QHash<quint32, TrackStatistics>::const_iterator it = p->statistics.constFind(ordinal);
+    if (it == p->statistics.constEnd())
+        return 1.0;
+
+    const TrackStatistics& statistics = it.value();
+    double ret = 1.0 + p->favoriteBoost * qBound(0, statistics.rate, maxRate) / maxRate;
+    if (p->playCountPower != 0 && statistics.plays > 0)
+        ret *= pow(1.0 + statistics.plays, p->playCountPower);
+    if (statistics.accessdate > 0 && statistics.accessdate <= now && now - statistics.accessdate < p->recentSeconds) {
+        // the penalty of a track just played fades out over the recent hours
+        double faded = double(now - statistics.accessdate) / p->recentSeconds;
+        ret *= p->recentPenalty + (1.0 - p->recentPenalty) * faded;
+    }
+    return qMax(0.0, ret);
+}
+
+QVector<quint32> TrackWeights::draw(CollectionDB* db, const QString& key, const TrackBitmap& tracks, int count)
+{
+    QVector<quint32> ret;
+    int matches = int(tracks.cardinality());
+    if (matches == 0 || count <= 0)
+        return ret;
+
+    TraceZone zone("dj", "weightedDraw");
+    QMutexLocker locker(&p->mutex);
+    uint now = QDateTime::currentDateTime().toTime_t();
+    if (!p->loaded
+        || p->indexGeneration != TrackIndex::instance()->generation()
+        || p->statisticsGeneration != StatisticsJournal::instance()->generation()) {
+        p->tables.clear();
+        load(db);
+    }
+
+    QHash<QString, WeightTable>::iterator it = p->tables.find(key);
+    if (it == p->tables.end() || it.value().ordinals.count() != matches || now - it.value().built > tableSeconds) {
+        if (it == p->tables.end() && p->tables.count() >= tableLimit)
+            p->tables.clear();
+        WeightTable& table = p->tables[key];
+        table.ordinals = tracks.toVector();
+        QVector<double> weights(table.ordinals.count());
+        for (int i = 0; i < weights.count(); i++)
+            weights[i] = weightOf(table.ordinals.at(i), now);
+        table.alias.build(weights);
+        table.built = now;
+        it = p->tables.find(key);
+        if (zone.isActive())
+            zone.setDetail(QString("table of %1 tracks").arg(matches));
+    }
+    const WeightTable& table = it.value();
+
+    // distinct picks by rejection, ends early when a few tracks carry all the weight
+    int wanted = qMin(count, matches);
+    QSet<int> picked;
+    picked.reserve(wanted);
+    ret.reserve(wanted);
+    for (int attempt = 0; ret.count() < wanted && attempt < wanted * 8 + 32; attempt++) {
+        int index = table.alias.draw(p->random);
+        if (!picked.contains(index)) {
+            picked.insert(index);
+            ret.append(table.ordinals.at(index));
+        }
+    }
+    // the rest in a row from a random start
+    int start = std::uniform_int_distribution<int>(0, matches - 1)(p->random);
+    for (int i = 0; ret.count() < wanted && i < matches; i++) {
+        int index = (start + i) % matches;
+        if (!picked.contains(index)) {
+            picked.insert(index);
+            ret.append(table.ordinals.at(index));
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACKWEIGHTS_H
+#define TRACKWEIGHTS_H
+
+#include <QObject>
+#include <QVector>
+
+#include <random>
+
+class CollectionDB;
+class TrackBitmap;
+
+/*
+ *  Alias table of Walker and Vose. Set up once in O(n), every draw of the
+ *  weighted distribution costs one random column and one biased coin.
+ */
+class AliasTable {
+public:
+    void build(const QVector<double>& weights);
+    bool isEmpty() const { return m_alias.isEmpty(); }
+    int count() const { return m_alias.count(); }
+    /** An index below count(), chosen in proportion to its weight */
+    int draw(std::mt19937& random) const;
+
+private:
+    QVector<float> m_probability;
+    QVector<quint32> m_alias;
+};
+
+/*
+ *  Weights of the Auto-DJ picks from rating, play count and last play.
+ *  Favourites get a boost by their rate, tracks played in the last hours
+ *  a penalty that fades with time and the play count an optional power.
+ *  Every filter gets an alias table of its tracks, kept until the index
+ *  or the written statistics change. Set up by the settings AutoDjWeighted,
+ *  AutoDjFavoriteBoost, AutoDjPlayCountPower, AutoDjRecentHours and
+ *  AutoDjRecentPenalty. Create the instance in the GUI thread.
+ */
+class TrackWeights : public QObject {
+    Q_OBJECT
+
+public:
+    static TrackWeights* instance();
+    ~TrackWeights();
+
+    bool isEnabled() const;
+    void setEnabled(bool value);
+
+    /** Drop statistics and tables, the next draw reloads them */
+    void invalidate();
+
+    /** Up to count distinct ordinals of tracks by weight, key names the filter */
+    QVector<quint32> draw(CollectionDB* db, const QString& key, const TrackBitmap& tracks, int count);
+
+private:
+    explicit TrackWeights(QObject* parent = nullptr);
+    void load(CollectionDB* db);
+    void overlayPending(CollectionDB* db);
+    double weightOf(quint32 ordinal, uint now) const;
+    struct TrackWeightsPrivate* p;
+};
+
+#endif // TRACKWEIGHTS_H
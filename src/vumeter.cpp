@@ -16,6 +16,7 @@
 */
 
 #include "vumeter.h"
+#include "tracer.h"
 #include <QPainter>
 #include <QStyleOption>
 #include <QWidget>
@@ -181,6 +182,7 @@ void VUMeter::setMargin(int i)
 
 void VUMeter::paintEvent(QPaintEvent*)
 {
+    TraceZone zone("gui", "VUMeter::paint");
     drawMeter();
     QStyleOption opt;
     opt.init(this);
@@ -0,0 +1,12 @@
+#
+# Knowthelist command line tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Fills the analysis cache of a collection database without the GUI
+
+include(../tools.pri)
+
+TARGET = knowthelist-analyse
+
+SOURCES += main.cpp
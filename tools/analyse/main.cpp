@@ -0,0 +1,250 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ *  Analyses the tracks of the collection database without the GUI and
+ *  stores gain, start and end positions in its analysis cache, which the
+ *  decks read instead of analysing a track again.
+ *
+ *  knowthelist-analyse [--db collection.db] [--jobs N] [--tempo] [--force]
+ *                      [--limit N] [--verbose] [folder ...]
+ *
+ *  Only tracks below the given folders are analysed, all by default.
+ *  Tracks already in the cache with an unchanged file are skipped unless
+ *  --force. --jobs sets the analysers running in parallel, one per
+ *  processor by default, --tempo detects the tempo and the features for
+ *  "Add Similar Tracks" as well.
+ */
+
+#include "cli.h"
+#include "collectiondb.h"
+#include "commandline.h"
+#include "trackanalyser.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QUrl>
+
+#include <stdio.h>
+
+class AnalyseQueue : public QObject {
+    Q_OBJECT
+
+public:
+    AnalyseQueue(const QStringList& files, int jobs, bool tempo)
+        : m_files(files)
+        , m_next(0)
+        , m_running(0)
+        , m_tempo(tempo)
+        , m_analysed(0)
+        , m_failed(0)
+        , m_audio(0)
+        , m_bytes(0)
+    {
+        for (int i = 0; i < qMin(jobs, files.count()); i++) {
+            TrackAnalyser* analyser = new TrackAnalyser(this);
+            analyser->setObjectName(QString("analyser%1").arg(i));
+            // the analyser signals from the GStreamer streaming thread
+            connect(analyser, SIGNAL(finishGain()), this, SLOT(onGain()), Qt::QueuedConnection);
+            connect(analyser, SIGNAL(finishTempo()), this, SLOT(onTempo()), Qt::QueuedConnection);
+            m_analysers << analyser;
+        }
+    }
+
+    void start()
+    {
+        m_timer.start();
+        foreach (TrackAnalyser* analyser, m_analysers)
+            openNext(analyser);
+        if (m_running == 0)
+            Q_EMIT finished();
+    }
+
+    qint64 elapsed() const { return m_timer.nsecsElapsed(); }
+    int analysed() const { return m_analysed; }
+    int failed() const { return m_failed; }
+    /** seconds of audio analysed */
+    double audio() const { return m_audio / 1000.0; }
+    qint64 bytes() const { return m_bytes; }
+
+Q_SIGNALS:
+    void finished();
+
+private slots:
+    void onGain()
+    {
+        TrackAnalyser* analyser = qobject_cast<TrackAnalyser*>(sender());
+        if (!analyser)
+            return;
+
+        if (analyser->gainDB() == TrackAnalyser::GAIN_INVALID) {
+            fprintf(stderr, "could not analyse %s\n", qPrintable(m_current.value(analyser)));
+            m_failed++;
+            openNext(analyser);
+            return;
+        }
+        if (m_tempo) {
+            analyser->setMode(TrackAnalyser::TEMPO);
+            analyser->open(QUrl::fromLocalFile(m_current.value(analyser)));
+            return;
+        }
+        store(analyser);
+        openNext(analyser);
+    }
+
+    void onTempo()
+    {
+        TrackAnalyser* analyser = qobject_cast<TrackAnalyser*>(sender());
+        if (!analyser)
+            return;
+        store(analyser);
+        openNext(analyser);
+    }
+
+private:
+    void openNext(TrackAnalyser* analyser)
+    {
+        if (m_current.contains(analyser)) {
+            m_current.remove(analyser);
+            m_running--;
+        }
+        if (m_next >= m_files.count()) {
+            if (m_running == 0)
+                Q_EMIT finished();
+            return;
+        }
+
+        QString fileName = m_files.at(m_next++);
+        m_current.insert(analyser, fileName);
+        m_running++;
+        analyser->setMode(TrackAnalyser::STANDARD);
+        analyser->open(QUrl::fromLocalFile(fileName));
+
+        int done = m_next - m_running;
+        if (m_files.count() >= 20 && done > 0 && done % (m_files.count() / 20) == 0)
+            fprintf(stderr, "%d of %d\n", done, m_files.count());
+    }
+
+    void store(TrackAnalyser* analyser)
+    {
+        QFileInfo fileInfo(m_current.value(analyser));
+        int length = QTime(0, 0).msecsTo(analyser->length());
+        m_database.storeAnalysis(fileInfo.absoluteFilePath(), fileInfo.lastModified().toTime_t(),
+            analyser->gainDB(),
+            QTime(0, 0).msecsTo(analyser->startPosition()),
+            QTime(0, 0).msecsTo(analyser->endPosition()),
+            length, m_tempo ? analyser->bpm() : 0,
+            m_tempo ? analyser->features().toString() : QString());
+        m_analysed++;
+        m_audio += length;
+        m_bytes += fileInfo.size();
+    }
+
+    CollectionDB m_database;
+    QList<TrackAnalyser*> m_analysers;
+    QHash<TrackAnalyser*, QString> m_current;
+    QStringList m_files;
+    int m_next;
+    int m_running;
+    bool m_tempo;
+    int m_analysed;
+    int m_failed;
+    qint64 m_audio;
+    qint64 m_bytes;
+    QElapsedTimer m_timer;
+};
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    // share settings and data directory with the application
+    QCoreApplication::setOrganizationName("knowthelist-org");
+    QCoreApplication::setApplicationName("knowthelist");
+
+    QStringList arguments = app.arguments();
+    if (CommandLine::hasOption(arguments, "help")) {
+        fprintf(stderr, "usage: knowthelist-analyse [--db file] [--jobs N] [--tempo] [--force] [--limit N]\n"
+                        "       [--verbose] [folder ...]\n");
+        return 0;
+    }
+    Cli::setVerbose(CommandLine::hasOption(arguments, "verbose"));
+
+    if (!Cli::openDatabase(CommandLine::option(arguments, "db")))
+        return 1;
+    Tracer::instance();
+
+    CollectionDB database;
+    if (!database.isDbValid()) {
+        fprintf(stderr, "the collection is empty, run knowthelist-scan first\n");
+        return 1;
+    }
+    if (!database.hasAnalysisFeatures())
+        database.createAnalysisTable();
+
+    QStringList dirs = CommandLine::positional(arguments, QStringList() << "db" << "jobs" << "limit");
+    QString filter;
+    foreach (QString dir, dirs) {
+        if (dir.endsWith("/"))
+            dir.chop(1);
+        // the folder itself and its subfolders, not /music2 for /music
+        filter += QString("%1(dir = '%2' OR dir LIKE '%2/%') ").arg(filter.isEmpty() ? "WHERE " : "OR ").arg(database.escapeString(dir));
+    }
+
+    bool force = CommandLine::hasOption(arguments, "force");
+    int limit = CommandLine::option(arguments, "limit").toInt();
+    QStringList files;
+    int skipped = 0;
+    foreach (QStringList row, database.selectSql("SELECT url FROM tags " + filter + "ORDER BY url;")) {
+        QFileInfo fileInfo(row.at(0));
+        if (!fileInfo.exists())
+            continue;
+        if (!force) {
+            QStringList cached = database.selectAnalysis(fileInfo.absoluteFilePath());
+            if (!cached.isEmpty() && cached.at(0).toLongLong() == (qint64)fileInfo.lastModified().toTime_t()) {
+                skipped++;
+                continue;
+            }
+        }
+        files << fileInfo.absoluteFilePath();
+        if (limit > 0 && files.count() >= limit)
+            break;
+    }
+
+    int jobs = Cli::jobs(arguments);
+    bool tempo = CommandLine::hasOption(arguments, "tempo");
+    fprintf(stderr, "%d tracks to analyse, %d cached, %d analysers\n", files.count(), skipped, jobs);
+
+    AnalyseQueue queue(files, jobs, tempo);
+    QObject::connect(&queue, SIGNAL(finished()), &app, SLOT(quit()), Qt::QueuedConnection);
+    queue.start();
+    app.exec();
+
+    double seconds = queue.elapsed() / 1e9;
+    printf("analysed %d tracks, %d failed, %d cached in %.2f s with %d analysers%s\n",
+        queue.analysed(), queue.failed(), skipped, seconds, jobs, tempo ? " and tempo" : "");
+    if (seconds > 0)
+        printf("  %.2f tracks/s, %.1f MB/s, %.1fx realtime\n", queue.analysed() / seconds,
+            queue.bytes() / 1048576.0 / seconds, queue.audio() / seconds);
+    return queue.failed() > 0 ? 2 : 0;
+}
+
+#include "main.moc"
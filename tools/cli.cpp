@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cli.h"
+#include "commandline.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QThread>
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+#include <stdio.h>
+
+namespace {
+bool verboseLog = false;
+
+#if QT_VERSION >= 0x050000
+void messageHandler(QtMsgType type, const QMessageLogContext& context, const QString& message)
+{
+    Q_UNUSED(context);
+    if (type == QtDebugMsg && !verboseLog)
+        return;
+    fprintf(stderr, "%s\n", qPrintable(message));
+}
+#else
+void messageHandler(QtMsgType type, const char* message)
+{
+    if (type == QtDebugMsg && !verboseLog)
+        return;
+    fprintf(stderr, "%s\n", message);
+}
+#endif
+}
+
+QString Cli::defaultDatabase()
+{
+#if QT_VERSION >= 0x050000
+    QString pathName = QStandardPaths::standardLocations(QStandardPaths::DataLocation).at(0);
+#else
+    QString pathName = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+#endif
+    return pathName + "/collection.db";
+}
+
+bool Cli::openDatabase(const QString& fileName)
+{
+    if (!QSqlDatabase::drivers().contains("QSQLITE")) {
+        fprintf(stderr, "the Qt SQLite driver is missing\n");
+        return false;
+    }
+
+    QString name = fileName.isEmpty() ? defaultDatabase() : fileName;
+    QDir().mkpath(QFileInfo(name).absolutePath());
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
+    db.setDatabaseName(name);
+    if (!db.open()) {
+        fprintf(stderr, "could not open %s: %s\n", qPrintable(name), qPrintable(db.lastError().text()));
+        return false;
+    }
+    fprintf(stderr, "database %s\n", qPrintable(name));
+    return true;
+}
+
+void Cli::setVerbose(bool verbose)
+{
+    verboseLog = verbose;
+#if QT_VERSION >= 0x050000
+    qInstallMessageHandler(messageHandler);
+#else
+    qInstallMsgHandler(messageHandler);
+#endif
+}
+
+int Cli::jobs(const QStringList& arguments)
+{
+    int jobs = CommandLine::option(arguments, "jobs").toInt();
+    if (jobs <= 0)
+        jobs = qMax(1, QThread::idealThreadCount());
+    return jobs;
+}
@@ -0,0 +1,40 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLI_H
+#define CLI_H
+
+#include <QString>
+#include <QStringList>
+
+/*
+ *  Shared by the command line tools: the collection database of the
+ *  application and a log that keeps the debug output of the core quiet
+ *  unless asked for. The options are parsed by CommandLine.
+ */
+class Cli {
+public:
+    /** Opens fileName, by default collection.db in the data directory of the application */
+    static bool openDatabase(const QString& fileName = QString());
+    static QString defaultDatabase();
+
+    static void setVerbose(bool verbose);
+    /** --jobs, or one per processor */
+    static int jobs(const QStringList& arguments);
+};
+
+#endif // CLI_H
@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2005-2014 Mario Stephan <mstephan@shared-files.de>
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ *  Scans music folders into the collection database without the GUI.
+ *
+ *  knowthelist-scan [--db collection.db] [--jobs N] [--incremental]
+ *                   [--verbose] [folder ...]
+ *
+ *  The folders default to the collection folders of the settings. A full
+ *  scan rebuilds the collection, --incremental only rescans the folders
+ *  that changed since the last scan. --jobs sets the threads reading the
+ *  tags, one per processor by default.
+ */
+
+#include "cli.h"
+#include "collectionupdater.h"
+#include "commandline.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QSettings>
+
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    // share settings and data directory with the application
+    QCoreApplication::setOrganizationName("knowthelist-org");
+    QCoreApplication::setApplicationName("knowthelist");
+
+    QStringList arguments = app.arguments();
+    if (CommandLine::hasOption(arguments, "help")) {
+        fprintf(stderr, "usage: knowthelist-scan [--db file] [--jobs N] [--incremental] [--verbose] [folder ...]\n");
+        return 0;
+    }
+    Cli::setVerbose(CommandLine::hasOption(arguments, "verbose"));
+
+    QStringList dirs = CommandLine::positional(arguments, QStringList() << "db" << "jobs");
+    if (dirs.isEmpty())
+        dirs = QSettings().value("Dirs").toStringList();
+    bool incremental = CommandLine::hasOption(arguments, "incremental");
+    if (dirs.isEmpty() && !incremental) {
+        fprintf(stderr, "no folders to scan\n");
+        return 1;
+    }
+
+    if (!Cli::openDatabase(CommandLine::option(arguments, "db")))
+        return 1;
+    Tracer::instance();
+
+    int jobs = Cli::jobs(arguments);
+    CollectionUpdater updater(false);
+    updater.setTagReaders(jobs);
+    QObject::connect(&updater, SIGNAL(scanFinished()), &app, SLOT(quit()), Qt::QueuedConnection);
+
+    if (incremental)
+        updater.monitor();
+    else
+        updater.setDirectoryList(dirs, true);
+    app.exec();
+
+    CollectionUpdater::ScanStatistics statistics = updater.lastScan();
+    double seconds = statistics.totalTime / 1e9;
+    printf("%s scan of %d files, %d tracks in %.2f s with %d tag readers\n",
+        incremental ? "incremental" : "full", statistics.files, statistics.tracks, seconds, jobs);
+    printf("  walk %.2f s, tags %.2f s, database %.2f s\n",
+        statistics.walkTime / 1e9, statistics.tagTime / 1e9, statistics.sqlTime / 1e9);
+    if (seconds > 0)
+        printf("  %.1f files/s, %.1f tracks/s\n", statistics.files / seconds, statistics.tracks / seconds);
+    return 0;
+}
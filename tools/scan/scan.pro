@@ -0,0 +1,12 @@
+#
+# Knowthelist command line tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Scans music folders into a collection database without the GUI
+
+include(../tools.pri)
+
+TARGET = knowthelist-scan
+
+SOURCES += main.cpp
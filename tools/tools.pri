@@ -0,0 +1,72 @@
+#
+# Knowthelist command line tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+# Shared settings, the tools link the knowthelist-core library of ../src
+
+QT += core \
+    gui \
+    sql
+
+greaterThan(QT_MAJOR_VERSION, 4){
+     QT += concurrent
+     DEFINES += GST_API_VERSION_1
+}
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+CORE_LIB_DIR = $$OUT_PWD/../../src
+include(../src/core/link.pri)
+
+INCLUDEPATH += $$PWD
+SOURCES += $$PWD/cli.cpp
+HEADERS += $$PWD/cli.h
+
+# next to the application
+DESTDIR = $$OUT_PWD/../../
+
+win32 {
+    GST_HOME = $$quote($$(GSTREAMER_1_0_ROOT_X86))
+    INCLUDEPATH += $${GST_HOME}\include\gstreamer-1.0 \
+        $${GST_HOME}\include\glib-2.0 \
+        $${GST_HOME}\lib\glib-2.0\include \
+        $${GST_HOME}\include
+    LIBS += $${GST_HOME}\lib\gstreamer-1.0.lib \
+        $${GST_HOME}\lib\gobject-2.0.lib \
+        $${GST_HOME}\lib\glib-2.0.lib \
+        $${GST_HOME}\lib\libtag.dll.a
+}
+macx {
+    DEFINES += GST_API_VERSION_1
+    INCLUDEPATH += /usr/local/include/gstreamer-1.0 \
+        /usr/local/include/glib-2.0 \
+        /usr/local/lib/glib-2.0/include \
+        /usr/local/include
+    LIBS += -L/usr/local/lib \
+        -lgstreamer-1.0 \
+        -lglib-2.0 \
+        -lgobject-2.0 \
+        -ltag
+}
+unix:!macx {
+    isEmpty(PREFIX):PREFIX = /usr
+    target.path = $$PREFIX/bin
+    INSTALLS += target
+
+contains(DEFINES, GST_API_VERSION_1) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += gstreamer-1.0 \
+        taglib
+}
+else {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += gstreamer-0.10 \
+        taglib
+}
+}
+
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
+QMAKE_CXXFLAGS_WARN_ON += -Wno-reorder
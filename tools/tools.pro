@@ -0,0 +1,10 @@
+#
+# Knowthelist command line tools
+# Copyright (C) 2011-2019 Mario Stephan <mstephan@shared-files.de>
+# License: LGPL-3.0+
+#
+
+TEMPLATE = subdirs
+
+SUBDIRS += scan \
+    analyse